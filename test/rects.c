@@ -0,0 +1,93 @@
+/* rects.c: times XFillRectangles and XDrawRectangles with many rectangles,
+ * in the manner of x11perf's -rect10 and -orect10. */
+
+#include <X11/Xlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define WIN_W		(600)
+#define WIN_H		(600)
+#define RECTS		(10000)
+#define REPEATS		(20)
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+make_rects(XRectangle* rects, int size)
+{
+	int i;
+	for (i = 0; i < RECTS; i++) {
+		rects[i].x = rand() % (WIN_W - size);
+		rects[i].y = rand() % (WIN_H - size);
+		rects[i].width = rects[i].height = size;
+	}
+}
+
+static void
+run(Display* dpy, Window win, GC gc, const char* name, int fill, XRectangle* rects)
+{
+	double start;
+	int i;
+
+	XSync(dpy, False);
+	start = now();
+	for (i = 0; i < REPEATS; i++) {
+		XSetForeground(dpy, gc, (i % 2) ? BlackPixel(dpy, 0) : WhitePixel(dpy, 0));
+		if (fill)
+			XFillRectangles(dpy, win, gc, rects, RECTS);
+		else
+			XDrawRectangles(dpy, win, gc, rects, RECTS);
+	}
+	XSync(dpy, False);
+	printf("%-36s %10.3f us/rectangle\n", name,
+		(now() - start) * 1e6 / ((double)RECTS * REPEATS));
+}
+
+int
+main(int argc, char* argv[])
+{
+	Display* dpy;
+	Window win;
+	GC gc;
+	XEvent event;
+	static XRectangle rects[RECTS];
+
+	dpy = XOpenDisplay(NULL);
+	if (dpy == NULL) {
+		fprintf(stderr, "cannot open display\n");
+		return 1;
+	}
+	win = XCreateSimpleWindow(dpy, RootWindow(dpy, 0), 20, 20, WIN_W, WIN_H, 0,
+		BlackPixel(dpy, 0), BlackPixel(dpy, 0));
+	XStoreName(dpy, win, "rects");
+	XSelectInput(dpy, win, ExposureMask);
+	XMapWindow(dpy, win);
+	do {
+		XNextEvent(dpy, &event);
+	} while (event.type != Expose);
+
+	gc = XCreateGC(dpy, win, 0, NULL);
+	srand(1);
+
+	make_rects(rects, 10);
+	run(dpy, win, gc, "10000 10x10 filled rectangles", 1, rects);
+	run(dpy, win, gc, "10000 10x10 rectangle outlines", 0, rects);
+
+	make_rects(rects, 100);
+	run(dpy, win, gc, "10000 100x100 filled rectangles", 1, rects);
+	run(dpy, win, gc, "10000 100x100 rectangle outlines", 0, rects);
+
+	XSetLineAttributes(dpy, gc, 5, LineSolid, CapButt, JoinMiter);
+	run(dpy, win, gc, "10000 100x100 5-wide outlines", 0, rects);
+
+	XFreeGC(dpy, gc);
+	XCloseDisplay(dpy);
+	return 0;
+}
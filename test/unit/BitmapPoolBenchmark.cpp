@@ -0,0 +1,41 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "BitmapPool.h"
+
+#include "Test.h"
+
+/* The overhead of the pool itself, without the app_server round-trips it saves. */
+
+static const int kCount = 100000;
+
+int
+main()
+{
+	BitmapPool::set_limits(32 * 1024 * 1024, 64);
+
+	// Double-buffering: the same size, every frame.
+	BitmapPool::release(new BBitmap(BRect(0, 0, 639, 479), 0, B_RGB32));
+	benchmark("release and acquire, same size", kCount, [](int) {
+		BBitmap* bitmap = BitmapPool::acquire(BRect(0, 0, 639, 479), B_RGB32);
+		BitmapPool::release(bitmap);
+	});
+
+	// Many sizes in turn, as with glyph and icon pixmaps.
+	benchmark("release and acquire, 64 sizes", kCount, [](int i) {
+		const BRect bounds(0, 0, 15 + i % 64, 15);
+		BBitmap* bitmap = BitmapPool::acquire(bounds, B_RGB32);
+		if (bitmap == NULL)
+			bitmap = new BBitmap(bounds, 0, B_RGB32);
+		BitmapPool::release(bitmap);
+	});
+
+	// Always missing, and evicting.
+	benchmark("release with eviction", kCount, [](int i) {
+		BitmapPool::release(new BBitmap(BRect(0, 0, 15, i % 1024), 0, B_RGB32));
+	});
+
+	BitmapPool::clear();
+	return 0;
+}
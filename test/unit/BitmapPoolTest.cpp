@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "BitmapPool.h"
+
+#include "Test.h"
+
+static const size_t kLimit = 1024 * 1024, kCountLimit = 8;
+
+static BBitmap*
+new_bitmap(int32 width, int32 height, color_space colorSpace = B_RGB32)
+{
+	return new BBitmap(BRect(0, 0, width - 1, height - 1), 0, colorSpace);
+}
+
+// #pragma mark - tests
+
+static void
+test_reuse()
+{
+	BitmapPool::set_limits(kLimit, kCountLimit);
+	BBitmap* bitmap = new_bitmap(32, 16);
+	BitmapPool::release(bitmap);
+	CHECK_EQUAL(BitmapPool::statistics().bitmaps, 1);
+
+	// Only bitmaps of the same size and color space are reused.
+	CHECK(BitmapPool::acquire(BRect(0, 0, 15, 31), B_RGB32) == NULL);
+	CHECK(BitmapPool::acquire(BRect(0, 0, 31, 15), B_GRAY8) == NULL);
+	CHECK(BitmapPool::acquire(BRect(0, 0, 31, 15), B_RGB32) == bitmap);
+	CHECK(BitmapPool::acquire(BRect(0, 0, 31, 15), B_RGB32) == NULL);
+
+	const BitmapPool::Statistics statistics = BitmapPool::statistics();
+	CHECK_EQUAL(statistics.hits, 1);
+	CHECK_EQUAL(statistics.misses, 3);
+	CHECK_EQUAL(statistics.bitmaps, 0);
+	CHECK_EQUAL(statistics.bytes, 0);
+	delete bitmap;
+}
+
+static void
+test_byte_limit()
+{
+	BitmapPool::set_limits(kLimit, kCountLimit);
+	const int before = BBitmap::sCount;
+
+	// Just under 256 KB each: the oldest is evicted once there are more than four.
+	BBitmap* bitmaps[5];
+	for (int i = 0; i < 5; i++)
+		bitmaps[i] = new_bitmap(256, 250 + i);
+	for (int i = 0; i < 5; i++)
+		BitmapPool::release(bitmaps[i]);
+	CHECK_EQUAL(BBitmap::sCount, before + 4);
+	CHECK(BitmapPool::statistics().bytes <= kLimit);
+	CHECK(BitmapPool::acquire(BRect(0, 0, 255, 249), B_RGB32) == NULL);
+	CHECK(BitmapPool::acquire(BRect(0, 0, 255, 253), B_RGB32) == bitmaps[4]);
+	delete bitmaps[4];
+
+	// Bitmaps bigger than a quarter of the pool are not kept at all.
+	BitmapPool::release(new_bitmap(512, 256));
+	CHECK_EQUAL(BitmapPool::statistics().bitmaps, 3);
+
+	BitmapPool::clear();
+	CHECK_EQUAL(BBitmap::sCount, before);
+	CHECK_EQUAL(BitmapPool::statistics().bytes, 0);
+}
+
+static void
+test_count_limit()
+{
+	BitmapPool::set_limits(kLimit, kCountLimit);
+	const int before = BBitmap::sCount;
+
+	// Tiny bitmaps never reach the byte limit, but are still evicted.
+	for (int i = 0; i < 100; i++)
+		BitmapPool::release(new_bitmap(1 + i, 1));
+	CHECK_EQUAL(BitmapPool::statistics().bitmaps, kCountLimit);
+	CHECK_EQUAL(BBitmap::sCount, before + int(kCountLimit));
+	CHECK(BitmapPool::acquire(BRect(0, 0, 0, 0), B_RGB32) == NULL);
+	BBitmap* newest = BitmapPool::acquire(BRect(0, 0, 99, 0), B_RGB32);
+	CHECK(newest != NULL);
+	delete newest;
+
+	// Lowering the limits evicts right away.
+	BitmapPool::set_limits(kLimit, 2);
+	CHECK_EQUAL(BitmapPool::statistics().bitmaps, 2);
+	BitmapPool::set_limits(0, kCountLimit);
+	CHECK_EQUAL(BitmapPool::statistics().bitmaps, 0);
+	CHECK_EQUAL(BBitmap::sCount, before);
+}
+
+int
+main()
+{
+	test_reuse();
+	test_byte_limit();
+	test_count_limit();
+	return test_result("BitmapPool");
+}
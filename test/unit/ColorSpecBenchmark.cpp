@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "ColorSpec.h"
+
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include "tables/ColorTable.h"
+}
+
+#include "Test.h"
+
+/* Parsing each kind of color specification. */
+
+static const int kCount = 1000000;
+
+int
+main()
+{
+	std::vector<size_t> order(kCount);
+	srand(1);
+	for (size_t& index : order)
+		index = rand() % X_COLORS_LENGTH;
+
+	XColor color;
+	unsigned long sum = 0;
+	benchmark("color name", kCount, [&](int i) {
+		ColorSpec::parse(xColors[order[i]].name, &color);
+		sum += color.red;
+	});
+	const char* specs[][2] = {
+		{"#RRGGBB", "#3c8dbc"},
+		{"rgb:", "rgb:3c/8d/bc"},
+		{"rgbi:", "rgbi:0.235/0.553/0.737"},
+		{"CIELab:", "CIELab:55.4/-7.5/-30.2"},
+		{"TekHVC:", "TekHVC:240.5/55.4/30.2"},
+	};
+	for (const auto& spec : specs) {
+		benchmark(spec[0], kCount, [&](int) {
+			ColorSpec::parse(spec[1], &color);
+			sum += color.red;
+		});
+	}
+	keep(sum);
+	return 0;
+}
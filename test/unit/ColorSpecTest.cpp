@@ -0,0 +1,134 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "ColorSpec.h"
+
+#include <cstdlib>
+
+extern "C" {
+#include "tables/ColorTable.h"
+}
+
+#include "Test.h"
+
+static bool
+parses_to(const char* spec, unsigned short red, unsigned short green, unsigned short blue,
+	int tolerance = 0)
+{
+	XColor color = {};
+	if (!ColorSpec::parse(spec, &color))
+		return false;
+	return abs(color.red - red) <= tolerance && abs(color.green - green) <= tolerance
+		&& abs(color.blue - blue) <= tolerance;
+}
+
+static bool
+fails(const char* spec)
+{
+	XColor color = {};
+	return !ColorSpec::parse(spec, &color);
+}
+
+// #pragma mark - tests
+
+static void
+test_names()
+{
+	CHECK(parses_to("red", 0xFFFF, 0, 0));
+	CHECK(parses_to("Dark Slate Gray", 0x2F2F, 0x4F4F, 0x4F4F));
+	CHECK(parses_to("ALICEBLUE", 0xF0F0, 0xF8F8, 0xFFFF));
+	CHECK(parses_to("gray50", 0x7F7F, 0x7F7F, 0x7F7F));
+	CHECK(fails("redd"));
+	CHECK(fails("re"));
+	CHECK(fails(""));
+	CHECK(fails(NULL));
+
+	int failures = 0;
+	for (size_t i = 0; i < X_COLORS_LENGTH; i++) {
+		if (!parses_to(xColors[i].name, xColors[i].red * 257, xColors[i].green * 257,
+				xColors[i].blue * 257))
+			failures++;
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+static void
+test_hex()
+{
+	// Components are the high bits, not scaled.
+	CHECK(parses_to("#f00", 0xF000, 0, 0));
+	CHECK(parses_to("#FF8000", 0xFF00, 0x8000, 0));
+	CHECK(parses_to("#123456789", 0x1230, 0x4560, 0x7890));
+	CHECK(parses_to("#123456789abc", 0x1234, 0x5678, 0x9ABC));
+	CHECK(fails("#"));
+	CHECK(fails("#12"));
+	CHECK(fails("#1234"));
+	CHECK(fails("#12g"));
+	CHECK(fails("#123456789abcdef"));
+
+	// Here they are scaled, and may have different lengths.
+	CHECK(parses_to("rgb:f/80/123", 0xFFFF, 0x8080, 0x1231));
+	CHECK(parses_to("RGB:0/ffff/8", 0, 0xFFFF, 0x8888));
+	CHECK(fails("rgb:1/2"));
+	CHECK(fails("rgb:1/2/3/"));
+	CHECK(fails("rgb:/0/0"));
+	CHECK(fails("rgb:12345/0/0"));
+	CHECK(fails("rgb:0/x/0"));
+}
+
+static void
+test_intensities()
+{
+	CHECK(parses_to("rgbi:1/0.5/0", 0xFFFF, 0x8000, 0));
+	CHECK(parses_to("rgbi:1e0/.25/5E-1", 0xFFFF, 0x4000, 0x8000));
+	CHECK(parses_to("RGBi:+0/0/1", 0, 0, 0xFFFF));
+	CHECK(fails("rgbi:1.5/0/0"));
+	CHECK(fails("rgbi:-0.1/0/0"));
+	CHECK(fails("rgbi:./0/0"));
+	CHECK(fails("rgbi:0/0"));
+	CHECK(fails("rgbi:0/0/0 "));
+}
+
+static void
+test_device_independent()
+{
+	// The white point of the default profile is white in each space.
+	const int kTolerance = 0x40;
+	CHECK(parses_to("CIEXYZ:0.95/1/1.39", 0xFFFF, 0xFFFF, 0xFFFF, 0x400));
+	CHECK(parses_to("CIEXYZ:0/0/0", 0, 0, 0));
+	CHECK(parses_to("CIELab:100/0/0", 0xFFFF, 0xFFFF, 0xFFFF, kTolerance));
+	CHECK(parses_to("cielab:0/0/0", 0, 0, 0, kTolerance));
+	CHECK(parses_to("CIELuv:100/0/0", 0xFFFF, 0xFFFF, 0xFFFF, kTolerance));
+	CHECK(parses_to("CIELuv:0/0/0", 0, 0, 0, kTolerance));
+	CHECK(parses_to("TekHVC:0/100/0", 0xFFFF, 0xFFFF, 0xFFFF, kTolerance));
+	CHECK(parses_to("TekHVC:120/0/0", 0, 0, 0, kTolerance));
+
+	// Grays are the same in every space.
+	XColor lab = {}, luv = {}, hvc = {};
+	CHECK(ColorSpec::parse("CIELab:50/0/0", &lab));
+	CHECK(ColorSpec::parse("CIELuv:50/0/0", &luv));
+	CHECK(ColorSpec::parse("TekHVC:0/50/0", &hvc));
+	CHECK(abs(lab.red - luv.red) <= kTolerance && abs(lab.red - hvc.red) <= kTolerance);
+	CHECK(abs(lab.red - lab.green) <= kTolerance && abs(lab.red - lab.blue) <= kTolerance);
+	CHECK(lab.red > 0x1000 && lab.red < 0xF000);
+
+	// Colors out of range are clamped; invalid values are refused.
+	CHECK(parses_to("CIEXYZ:0.4/0.2/0", 0xFFFF, 0, 0));
+	CHECK(fails("CIEXYZ:0/2/0"));
+	CHECK(fails("CIELab:101/0/0"));
+	CHECK(fails("TekHVC:361/50/0"));
+	CHECK(fails("CIExyY:0.3/0/0.5"));
+	CHECK(fails("CIEABC:0/0/0"));
+	CHECK(fails("CIE"));
+}
+
+int
+main()
+{
+	test_names();
+	test_hex();
+	test_intensities();
+	test_device_independent();
+	return test_result("ColorSpec");
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Compositor.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "Test.h"
+
+/* Composites 256x256 pictures, as x11perf's RENDER tests do. */
+
+static const int32_t kSize = 256;
+
+int
+main()
+{
+	std::vector<uint32_t> sourceBits(kSize * kSize, 0x80402010),
+		destBits(kSize * kSize, 0xFF808080);
+	std::vector<uint8_t> maskBits(kSize * kSize, 0x80);
+
+	Surface source;
+	source.bits = (uint8_t*)sourceBits.data();
+	source.bytes_per_row = kSize * 4;
+	source.width = source.height = kSize;
+	Surface dest = source;
+	dest.bits = (uint8_t*)destBits.data();
+	Surface mask = source;
+	mask.bits = maskBits.data();
+	mask.bytes_per_row = kSize;
+	mask.format = PixelFormat::A8;
+	Surface solid;
+	solid.solid = true;
+	solid.color = 0x80402010;
+
+	const struct {
+		const char* name;
+		int op;
+	} kOperators[] = {{"Src", PictOpSrc}, {"Over", PictOpOver}, {"In", PictOpIn},
+		{"Add", PictOpAdd}};
+	char name[64];
+	for (const auto& op : kOperators) {
+		snprintf(name, sizeof(name), "256x256 %s", op.name);
+		benchmark(name, 200, [&](int) {
+			Compositor::composite(op.op, source, 0, 0, NULL, 0, 0, dest, 0, 0, kSize, kSize);
+		});
+		snprintf(name, sizeof(name), "256x256 %s, with an A8 mask", op.name);
+		benchmark(name, 200, [&](int) {
+			Compositor::composite(op.op, source, 0, 0, &mask, 0, 0, dest, 0, 0, kSize, kSize);
+		});
+		snprintf(name, sizeof(name), "256x256 solid %s", op.name);
+		benchmark(name, 200, [&](int) {
+			Compositor::composite(op.op, solid, 0, 0, NULL, 0, 0, dest, 0, 0, kSize, kSize);
+		});
+	}
+	keep(destBits);
+	return 0;
+}
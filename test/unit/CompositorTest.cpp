@@ -0,0 +1,261 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Compositor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "Test.h"
+
+static uint32_t
+random_pixel()
+{
+	uint32_t alpha = rand() % 256;
+	if (rand() % 4 == 0)
+		alpha = 255;
+	else if (rand() % 5 == 0)
+		alpha = 0;
+	return (alpha << 24) | ((rand() % (alpha + 1)) << 16) | ((rand() % (alpha + 1)) << 8)
+		| (rand() % (alpha + 1));
+}
+
+/* The Porter-Duff factors of each operator, as in the RENDER specification. */
+enum Factor { kZero, kOne, kSourceAlpha, kDestAlpha, kInverseSourceAlpha, kInverseDestAlpha };
+
+static const Factor kFactors[][2] = {
+	{kZero, kZero},								// Clear
+	{kOne, kZero},								// Src
+	{kZero, kOne},								// Dst
+	{kOne, kInverseSourceAlpha},				// Over
+	{kInverseDestAlpha, kOne},					// OverReverse
+	{kDestAlpha, kZero},						// In
+	{kZero, kSourceAlpha},						// InReverse
+	{kInverseDestAlpha, kZero},					// Out
+	{kZero, kInverseSourceAlpha},				// OutReverse
+	{kDestAlpha, kInverseSourceAlpha},			// Atop
+	{kInverseDestAlpha, kSourceAlpha},			// AtopReverse
+	{kInverseDestAlpha, kInverseSourceAlpha},	// Xor
+	{kOne, kOne},								// Add
+};
+
+static double
+factor(Factor factor, double sourceAlpha, double destAlpha)
+{
+	switch (factor) {
+		case kZero:					return 0;
+		case kOne:					return 1;
+		case kSourceAlpha:			return sourceAlpha;
+		case kDestAlpha:			return destAlpha;
+		case kInverseSourceAlpha:	return 1 - sourceAlpha;
+		case kInverseDestAlpha:		return 1 - destAlpha;
+	}
+	return 0;
+}
+
+/* Composites one pixel in floating point, returning the largest error of the
+ * compositor's result in any channel. Channels are in [0, 1], premultiplied. */
+static int
+reference_error(int op, const double source[4], double mask, const double dest[4],
+	uint32_t result)
+{
+	double masked[4];
+	for (int c = 0; c < 4; c++)
+		masked[c] = source[c] * mask;
+
+	int worst = 0;
+	for (int c = 0; c < 4; c++) {
+		double expected = masked[c] * factor(kFactors[op][0], masked[3], dest[3])
+			+ dest[c] * factor(kFactors[op][1], masked[3], dest[3]);
+		expected = std::min(expected, 1.0);
+		const int error = std::abs(int(lround(expected * 255)) - int((result >> (8 * c)) & 0xFF));
+		worst = std::max(worst, error);
+	}
+	return worst;
+}
+
+static uint32_t
+composite_pixel(int op, const Surface& source, const uint8_t* mask, uint32_t dest)
+{
+	uint8_t maskBits[4] = {};
+	Surface maskSurface;
+	if (mask != NULL) {
+		maskBits[0] = *mask;
+		maskSurface.bits = maskBits;
+		maskSurface.bytes_per_row = 4;
+		maskSurface.width = maskSurface.height = 1;
+		maskSurface.format = PixelFormat::A8;
+	}
+
+	Surface destSurface;
+	destSurface.bits = (uint8_t*)&dest;
+	destSurface.bytes_per_row = 4;
+	destSurface.width = destSurface.height = 1;
+	Compositor::composite(op, source, 0, 0, mask != NULL ? &maskSurface : NULL, 0, 0,
+		destSurface, 0, 0, 1, 1);
+	return dest;
+}
+
+static void
+channels(uint32_t pixel, double result[4])
+{
+	for (int c = 0; c < 4; c++)
+		result[c] = ((pixel >> (8 * c)) & 0xFF) / 255.0;
+}
+
+// #pragma mark - tests
+
+static void
+test_operators()
+{
+	srand(1);
+	int worst = 0;
+	for (int op = PictOpClear; op <= PictOpAdd; op++) {
+		for (int test = 0; test < 20000; test++) {
+			Surface source;
+			source.solid = true;
+			source.color = random_pixel();
+			const uint32_t dest = random_pixel();
+			const uint8_t mask = rand() % 256;
+			const bool masked = rand() % 2;
+			const uint32_t result = composite_pixel(op, source, masked ? &mask : NULL, dest);
+
+			double sourceChannels[4], destChannels[4];
+			channels(source.color, sourceChannels);
+			channels(dest, destChannels);
+			worst = std::max(worst, reference_error(op, sourceChannels,
+				masked ? mask / 255.0 : 1, destChannels, result));
+		}
+	}
+	CHECK(worst <= 2);
+}
+
+static void
+test_colors()
+{
+	// XRenderColors are premultiplied already: half-transparent white is (0x8000, ..., 0x8000).
+	const XRenderColor halfWhite = {0x8000, 0x8000, 0x8000, 0x8000};
+	CHECK_EQUAL(Compositor::pack_color(halfWhite), 0x80808080);
+	const XRenderColor opaqueRed = {0xFFFF, 0, 0, 0xFFFF};
+	CHECK_EQUAL(Compositor::pack_color(opaqueRed), 0xFFFF0000);
+
+	// Colors brighter than they are opaque are not valid premultiplied colors.
+	const XRenderColor invalid = {0xFFFF, 0x2000, 0, 0x4000};
+	CHECK_EQUAL(Compositor::pack_color(invalid), 0x40402000);
+
+	// Filling with colors which are not opaque matches the reference.
+	srand(2);
+	int worst = 0;
+	for (int test = 0; test < 20000; test++) {
+		XRenderColor color;
+		color.alpha = rand() % 0xFF00;
+		color.red = rand() % (color.alpha + 1);
+		color.green = rand() % (color.alpha + 1);
+		color.blue = rand() % (color.alpha + 1);
+
+		Surface source;
+		source.solid = true;
+		source.color = Compositor::pack_color(color);
+		const uint32_t dest = random_pixel();
+		for (int op : {PictOpSrc, PictOpOver, PictOpAdd}) {
+			const uint32_t result = composite_pixel(op, source, NULL, dest);
+			const double sourceChannels[4] = {color.blue / 65535.0, color.green / 65535.0,
+				color.red / 65535.0, color.alpha / 65535.0};
+			double destChannels[4];
+			channels(dest, destChannels);
+			worst = std::max(worst,
+				reference_error(op, sourceChannels, 1, destChannels, result));
+		}
+	}
+	CHECK(worst <= 2);
+
+	// Unpremultiplying gets the straight color back.
+	uint32_t pixel = Compositor::pack_color(halfWhite);
+	Compositor::unpremultiply(&pixel, 1);
+	CHECK_EQUAL(pixel, 0x80FFFFFF);
+}
+
+static void
+test_formats()
+{
+	// RGB24 destinations are opaque; A8 only keeps alpha.
+	Surface source;
+	source.solid = true;
+	source.color = 0x80404040;
+
+	uint32_t rgb = 0x00FFFFFF;
+	Surface rgbSurface;
+	rgbSurface.bits = (uint8_t*)&rgb;
+	rgbSurface.bytes_per_row = 4;
+	rgbSurface.width = rgbSurface.height = 1;
+	rgbSurface.format = PixelFormat::RGB24;
+	Compositor::composite(PictOpOver, source, 0, 0, NULL, 0, 0, rgbSurface, 0, 0, 1, 1);
+	CHECK_EQUAL(rgb, 0xFFBFBFBF);
+
+	uint8_t alpha[4] = {0x40};
+	Surface alphaSurface;
+	alphaSurface.bits = alpha;
+	alphaSurface.bytes_per_row = 4;
+	alphaSurface.width = alphaSurface.height = 1;
+	alphaSurface.format = PixelFormat::A8;
+	Compositor::composite(PictOpAdd, source, 0, 0, NULL, 0, 0, alphaSurface, 0, 0, 1, 1);
+	CHECK_EQUAL(alpha[0], 0xC0);
+}
+
+static void
+test_trapezoids()
+{
+	uint8_t bits[16 * 16] = {};
+	Surface mask;
+	mask.bits = bits;
+	mask.bytes_per_row = 16;
+	mask.width = mask.height = 16;
+	mask.format = PixelFormat::A8;
+
+	// A rectangle from (2.5, 2) to (8, 6) half covers its left column.
+	XTrapezoid trapezoid;
+	trapezoid.top = XDoubleToFixed(2);
+	trapezoid.bottom = XDoubleToFixed(6);
+	trapezoid.left.p1 = {XDoubleToFixed(2.5), XDoubleToFixed(0)};
+	trapezoid.left.p2 = {XDoubleToFixed(2.5), XDoubleToFixed(10)};
+	trapezoid.right.p1 = {XDoubleToFixed(8), XDoubleToFixed(0)};
+	trapezoid.right.p2 = {XDoubleToFixed(8), XDoubleToFixed(10)};
+	Compositor::rasterize_trapezoids(&trapezoid, 1, mask);
+	CHECK_EQUAL(bits[1 * 16 + 4], 0);
+	CHECK(std::abs(bits[3 * 16 + 2] - 128) <= 8);
+	CHECK_EQUAL(bits[3 * 16 + 4], 255);
+	CHECK_EQUAL(bits[5 * 16 + 7], 255);
+	CHECK_EQUAL(bits[5 * 16 + 8], 0);
+	CHECK_EQUAL(bits[6 * 16 + 4], 0);
+
+	// The area of a triangle.
+	memset(bits, 0, sizeof(bits));
+	trapezoid.top = XDoubleToFixed(0);
+	trapezoid.bottom = XDoubleToFixed(16);
+	trapezoid.left.p1 = {XDoubleToFixed(8), XDoubleToFixed(0)};
+	trapezoid.left.p2 = {XDoubleToFixed(0), XDoubleToFixed(16)};
+	trapezoid.right.p1 = {XDoubleToFixed(8), XDoubleToFixed(0)};
+	trapezoid.right.p2 = {XDoubleToFixed(16), XDoubleToFixed(16)};
+	Compositor::rasterize_trapezoids(&trapezoid, 1, mask);
+	double area = 0;
+	for (uint8_t coverage : bits)
+		area += coverage / 255.0;
+	CHECK(std::abs(area - 128) < 2);
+
+	int32_t left, top, right, bottom;
+	CHECK(Compositor::trapezoid_bounds(&trapezoid, 1, left, top, right, bottom));
+	CHECK(left == 0 && top == 0 && right == 16 && bottom == 16);
+}
+
+int
+main()
+{
+	test_operators();
+	test_colors();
+	test_formats();
+	test_trapezoids();
+	return test_result("Compositor");
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Dasher.h"
+
+#include <vector>
+
+#include "Test.h"
+
+/* Splitting the lines of x11perf's dashed line tests. */
+
+static const int kCount = 100000;
+
+int
+main()
+{
+	std::vector<Dasher::Dash> result;
+	const unsigned char onOff[] = {3, 2};
+	Dasher thin(onOff, 2, 0, true);
+	benchmark("100-pixel line, 3-2 dashes", kCount, [&](int i) {
+		result.clear();
+		thin.restart();
+		thin.add(i % 50, 0, i % 50 + 100, 37, result, false);
+	});
+
+	const unsigned char dots[] = {1};
+	Dasher dotted(dots, 1, 0, true);
+	benchmark("100-pixel line, dotted", kCount, [&](int i) {
+		result.clear();
+		dotted.restart();
+		dotted.add(0, i % 50, 100, i % 50, result, false);
+	});
+
+	const unsigned char pattern[] = {20, 5, 5, 5};
+	Dasher wide(pattern, 4, 7, false);
+	benchmark("100-pixel wide line, double dashed", kCount, [&](int i) {
+		result.clear();
+		wide.restart();
+		wide.add(0, 0, 80, 60 + i % 10, result, true);
+	});
+
+	benchmark("10-segment polyline, 3-2 dashes", kCount, [&](int) {
+		result.clear();
+		thin.restart();
+		for (int segment = 0; segment < 10; segment++)
+			thin.add(segment * 10, 0, segment * 10 + 10, 7, result, false);
+	});
+	keep(result);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Dasher.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Test.h"
+
+static bool
+near(float a, float b)
+{
+	return fabsf(a - b) < 1e-3f;
+}
+
+static bool
+dash_is(const Dasher::Dash& dash, float x1, float y1, float x2, float y2, bool on = true)
+{
+	return near(dash.x1, x1) && near(dash.y1, y1) && near(dash.x2, x2) && near(dash.y2, y2)
+		&& dash.on == on;
+}
+
+/* The pixels a thin horizontal line from 0 covers, as a string of '#' and '.'. */
+static std::string
+thin_pixels(Dasher& dasher, int length)
+{
+	std::vector<Dasher::Dash> dashes;
+	dasher.add(0, 0, length, 0, dashes, false);
+	std::string pixels(length, '.');
+	for (const Dasher::Dash& dash : dashes) {
+		for (int x = int(lroundf(dash.x1)); x <= int(lroundf(dash.x2)); x++)
+			pixels[x] = '#';
+	}
+	return pixels;
+}
+
+// #pragma mark - tests
+
+static void
+test_thin()
+{
+	// A dash of N covers N pixels of zero-width lines.
+	const unsigned char dashes[] = {3, 2};
+	Dasher dasher(dashes, 2, 0, true);
+	CHECK(thin_pixels(dasher, 12) == "###..###..##");
+
+	const unsigned char ones[] = {1};
+	Dasher dotted(ones, 1, 0, true);
+	CHECK(thin_pixels(dotted, 8) == "#.#.#.#.");
+
+	// Diagonals are measured along their major axis.
+	std::vector<Dasher::Dash> result;
+	dasher.restart();
+	dasher.add(0, 0, 10, 5, result, false);
+	CHECK_EQUAL(result.size(), 2);
+	CHECK(dash_is(result[0], 0, 0, 2, 1));
+	CHECK(dash_is(result[1], 5, 2.5f, 7, 3.5f));
+}
+
+static void
+test_wide()
+{
+	// Wide lines use their actual length, and dashes end where the next begins.
+	const unsigned char dashes[] = {6, 4};
+	Dasher dasher(dashes, 2, 0, false);
+	std::vector<Dasher::Dash> result;
+	dasher.add(0, 0, 12, 16, result, true);
+	CHECK_EQUAL(result.size(), 4);
+	CHECK(dash_is(result[0], 0, 0, 3.6f, 4.8f, true));
+	CHECK(dash_is(result[1], 3.6f, 4.8f, 6, 8, false));
+	CHECK(dash_is(result[2], 6, 8, 9.6f, 12.8f, true));
+	CHECK(dash_is(result[3], 9.6f, 12.8f, 12, 16, false));
+
+	// The total length of on and off dashes is the line's.
+	srand(1);
+	for (int test = 0; test < 100; test++) {
+		unsigned char list[5];
+		const int count = 1 + rand() % 5;
+		for (int i = 0; i < count; i++)
+			list[i] = 1 + rand() % 20;
+		Dasher random(list, count, rand() % 50, false);
+		const float x = rand() % 200, y = rand() % 200;
+		result.clear();
+		random.add(0, 0, x, y, result, true);
+		float total = 0;
+		for (const Dasher::Dash& dash : result)
+			total += hypotf(dash.x2 - dash.x1, dash.y2 - dash.y1);
+		CHECK(fabsf(total - hypotf(x, y)) < 0.01f);
+	}
+}
+
+static void
+test_pattern()
+{
+	// Odd lists are used twice, so that the second time round on and off swap.
+	const unsigned char odd[] = {2, 1, 3};
+	Dasher dasher(odd, 3, 0, true);
+	CHECK(thin_pixels(dasher, 12) == "##.###..#...");
+
+	// The offset starts that far into the pattern, and may be past its end.
+	const unsigned char dashes[] = {3, 2};
+	Dasher offset(dashes, 2, 2, true);
+	CHECK(thin_pixels(offset, 8) == "#..###..");
+	Dasher wrapped(dashes, 2, 12, true);
+	CHECK(thin_pixels(wrapped, 8) == "#..###..");
+
+	// The pattern continues across segments until restarted.
+	Dasher continued(dashes, 2, 0, true);
+	std::vector<Dasher::Dash> result;
+	continued.add(0, 0, 4, 0, result, false);
+	continued.add(4, 0, 4, 6, result, false);
+	CHECK_EQUAL(result.size(), 2);
+	CHECK(dash_is(result[1], 4, 1, 4, 3));
+	continued.restart();
+	CHECK(thin_pixels(continued, 5) == "###..");
+
+	// Empty lines and patterns produce nothing.
+	result.clear();
+	continued.add(3, 3, 3, 3, result, true);
+	const unsigned char zeros[] = {0, 0};
+	Dasher empty(zeros, 2, 0, true);
+	empty.add(0, 0, 10, 0, result, true);
+	CHECK(result.empty());
+}
+
+int
+main()
+{
+	test_thin();
+	test_wide();
+	test_pattern();
+	return test_result("Dasher");
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "KeyMap.h"
+
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include "tables/keysymlist.h"
+}
+
+#include "Test.h"
+
+/* Keysym name lookups in both directions, over the whole table. */
+
+static const int kCount = 1000000;
+
+int
+main()
+{
+	std::vector<size_t> order(kCount);
+	srand(1);
+	for (size_t& index : order)
+		index = rand() % KEY_SYM_LIST_LENGTH;
+
+	KeySym keysyms = 0;
+	benchmark("name to keysym", kCount, [&](int i) {
+		keysyms += KeyMap::keysym_for_name(KEY_SYM_LIST[order[i]].name);
+	});
+	benchmark("unknown name to keysym", kCount, [&](int i) {
+		keysyms += KeyMap::keysym_for_name((i % 2) ? "NoSuchKey" : "U1F600");
+	});
+	const char* name = NULL;
+	benchmark("keysym to name", kCount, [&](int i) {
+		name = KeyMap::keysym_name(KEY_SYM_LIST[order[i]].keySym);
+	});
+	keep(keysyms);
+	keep(name);
+	return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "KeyMap.h"
+
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include <X11/keysym.h>
+
+#include "tables/keysymlist.h"
+}
+
+#include "Test.h"
+
+// Key codes of the synthetic keymap, which are offset by kMinKeyCode in X.
+enum {
+	kKeyA = 0x3c,
+	kKeyOne = 0x12,
+	kKeySpace = 0x5e,
+	kKeyShift = 0x4b,
+	kKeyOption = 0x5d,
+	kKeyCyrillic = 0x40,
+	kKeyReturn = 0x47,
+	kKeyKeypadSeven = 0x37,
+	kKeyKeypadPlus = 0x3a,
+	kKeyKeypadEnter = 0x5b,
+};
+
+static KeyMap
+synthetic_keymap()
+{
+	static KeyMap::Key keys[KeyMap::kKeyCount] = {};
+	keys[kKeyA] = {{"a", "A", "å", "Å"}, {}, false};
+	keys[kKeyOne] = {{"1", "!", "¡", "⁄"}, {}, false};
+	keys[kKeySpace] = {{" ", " ", " ", " "}, {}, false};
+	keys[kKeyShift] = {{}, {XK_Shift_L}, false};
+	keys[kKeyOption] = {{}, {XK_Mode_switch}, false};
+	keys[kKeyCyrillic] = {{"ж", NULL, NULL, NULL}, {}, false};
+	keys[kKeyReturn] = {{"\n", "\n", "\n", "\n"}, {XK_Return, XK_Return}, false};
+	keys[kKeyKeypadSeven] = {{"\x01", "7", "\x01", "7"}, {XK_Home, NoSymbol, XK_Home}, true};
+	keys[kKeyKeypadPlus] = {{"+", "+", "+", "+"}, {}, true};
+	keys[kKeyKeypadEnter] = {{"\n", "\n", "\n", "\n"}, {XK_Return}, true};
+
+	KeyMap keyMap;
+	keyMap.build(keys);
+	return keyMap;
+}
+
+static std::string
+text(KeySym keysym, unsigned int state, const char* typed = NULL)
+{
+	char buffer[16];
+	const int length = KeyMap::lookup_text(keysym, state, typed, buffer, sizeof(buffer));
+	return std::string(buffer, length);
+}
+
+// #pragma mark - tests
+
+static void
+test_table()
+{
+	const KeyMap keyMap = synthetic_keymap();
+	const unsigned int a = kKeyA + KeyMap::kMinKeyCode;
+
+	// Letters are (lowercase, uppercase) pairs in both groups.
+	CHECK_EQUAL(keyMap.keysym(a, 0), XK_a);
+	CHECK_EQUAL(keyMap.keysym(a, 1), XK_A);
+	CHECK_EQUAL(keyMap.keysym(a, 2), XK_aring);
+	CHECK_EQUAL(keyMap.keysym(a, 3), XK_Aring);
+
+	// Keys which are the same in both groups only have the first.
+	const unsigned int space = kKeySpace + KeyMap::kMinKeyCode;
+	CHECK_EQUAL(keyMap.keysym(space, 0), XK_space);
+	CHECK_EQUAL(keyMap.keysym(space, 1), NoSymbol);
+	CHECK_EQUAL(keyMap.keysym(space, 2), NoSymbol);
+
+	// Lone letters get their uppercase forms, in Unicode keysyms past Latin-1.
+	const unsigned int cyrillic = kKeyCyrillic + KeyMap::kMinKeyCode;
+	CHECK_EQUAL(keyMap.keysym(cyrillic, 0), 0x1000436);
+	CHECK_EQUAL(keyMap.keysym(cyrillic, 1), 0x1000416);
+
+	// Fixed symbols, and modifiers.
+	CHECK_EQUAL(keyMap.keysym(kKeyReturn + KeyMap::kMinKeyCode, 0), XK_Return);
+	CHECK_EQUAL(keyMap.keysym(kKeyReturn + KeyMap::kMinKeyCode, 1), NoSymbol);
+	CHECK_EQUAL(keyMap.modifiers(kKeyShift + KeyMap::kMinKeyCode), ShiftMask);
+	CHECK_EQUAL(keyMap.modifiers(kKeyOption + KeyMap::kMinKeyCode), Mod5Mask);
+	CHECK_EQUAL(keyMap.modifiers(a), 0);
+
+	CHECK_EQUAL(keyMap.keycode(XK_A), a);
+	CHECK_EQUAL(keyMap.keycode(XK_exclamdown), kKeyOne + KeyMap::kMinKeyCode);
+	CHECK_EQUAL(keyMap.keycode(XK_F35), 0);
+	CHECK_EQUAL(keyMap.keysym(KeyMap::kMaxKeyCode + 1, 0), NoSymbol);
+}
+
+static void
+test_lookup()
+{
+	const KeyMap keyMap = synthetic_keymap();
+	const unsigned int a = kKeyA + KeyMap::kMinKeyCode, one = kKeyOne + KeyMap::kMinKeyCode;
+
+	unsigned int consumed;
+	CHECK_EQUAL(keyMap.lookup(a, 0, &consumed), XK_a);
+	CHECK_EQUAL(consumed, ShiftMask | LockMask | Mod5Mask);
+	CHECK_EQUAL(keyMap.lookup(a, ShiftMask), XK_A);
+	CHECK_EQUAL(keyMap.lookup(a, LockMask), XK_A);
+	CHECK_EQUAL(keyMap.lookup(a, ShiftMask | LockMask), XK_A);
+	CHECK_EQUAL(keyMap.lookup(a, Mod5Mask), XK_aring);
+	CHECK_EQUAL(keyMap.lookup(a, Mod5Mask | ShiftMask), XK_Aring);
+
+	// Lock only affects letters.
+	CHECK_EQUAL(keyMap.lookup(one, LockMask), XK_1);
+	CHECK_EQUAL(keyMap.lookup(one, ShiftMask), XK_exclam);
+
+	CHECK_EQUAL(keyMap.lookup(kKeySpace + KeyMap::kMinKeyCode, ShiftMask, &consumed), XK_space);
+	CHECK_EQUAL(consumed, 0);
+}
+
+static void
+test_keypad()
+{
+	const KeyMap keyMap = synthetic_keymap();
+	const unsigned int seven = kKeyKeypadSeven + KeyMap::kMinKeyCode,
+		plus = kKeyKeypadPlus + KeyMap::kMinKeyCode,
+		enter = kKeyKeypadEnter + KeyMap::kMinKeyCode;
+
+	CHECK_EQUAL(keyMap.keysym(seven, 0), XK_KP_Home);
+	CHECK_EQUAL(keyMap.keysym(seven, 1), XK_KP_7);
+	CHECK_EQUAL(keyMap.keysym(plus, 0), XK_KP_Add);
+	CHECK_EQUAL(keyMap.keysym(enter, 0), XK_KP_Enter);
+	CHECK_EQUAL(keyMap.keycode(XK_KP_7), seven);
+
+	// Num Lock selects the digits, and Shift undoes it.
+	unsigned int consumed;
+	CHECK_EQUAL(keyMap.lookup(seven, 0, &consumed), XK_KP_Home);
+	CHECK(consumed & Mod2Mask);
+	CHECK_EQUAL(keyMap.lookup(seven, Mod2Mask), XK_KP_7);
+	CHECK_EQUAL(keyMap.lookup(seven, Mod2Mask | ShiftMask), XK_KP_Home);
+	CHECK_EQUAL(keyMap.lookup(seven, ShiftMask), XK_KP_7);
+	CHECK_EQUAL(keyMap.lookup(plus, Mod2Mask), XK_KP_Add);
+
+	CHECK(text(XK_KP_7, 0) == "7");
+	CHECK(text(XK_KP_Add, 0) == "+");
+	CHECK(text(XK_KP_Enter, 0) == "\r");
+	CHECK(text(XK_KP_Home, 0).empty());
+}
+
+static void
+test_text()
+{
+	CHECK(text(XK_a, 0) == "a");
+	CHECK(text(XK_aring, 0) == "å");
+	CHECK(text(0x1000436, 0) == "ж");
+	CHECK(text(XK_Return, 0) == "\r");
+	CHECK(text(XK_Shift_L, 0).empty());
+
+	// Control, as the real Xlib does it.
+	CHECK(text(XK_a, ControlMask) == "\x01");
+	CHECK(text(XK_bracketleft, ControlMask) == "\x1b");
+	CHECK(text(XK_2, ControlMask) == std::string(1, '\0'));
+	CHECK(text(XK_slash, ControlMask) == "\x1f");
+
+	// What was typed wins if it is not the keysym's character, as after dead keys...
+	CHECK(text(XK_e, 0, "é") == "é");
+	CHECK(text(XK_e, ControlMask, "é") == "é");
+	CHECK(text(XK_e, 0, "e") == "e");
+	CHECK(text(XK_e, ControlMask, "e") == "\x05");
+	CHECK(text(NoSymbol, 0, "ŝ") == "ŝ");
+
+	// ...but not when it is a control character, as Haiku's Control is X's Mod1.
+	CHECK(text(XK_a, Mod1Mask, "\x01") == "a");
+
+	// Text which does not fit is not returned at all.
+	char buffer[1];
+	CHECK_EQUAL(KeyMap::lookup_text(XK_e, 0, "é", buffer, sizeof(buffer)), 0);
+	CHECK_EQUAL(KeyMap::lookup_text(XK_aring, 0, NULL, buffer, sizeof(buffer)), 0);
+}
+
+static void
+test_conversions()
+{
+	CHECK_EQUAL(KeyMap::keysym_for_utf8("a"), XK_a);
+	CHECK_EQUAL(KeyMap::keysym_for_utf8("é"), XK_eacute);
+	CHECK_EQUAL(KeyMap::keysym_for_utf8("€"), 0x10020ac);
+	CHECK_EQUAL(KeyMap::keysym_for_utf8("ab"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_utf8("\t"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_utf8("\xc3"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_utf8(NULL), NoSymbol);
+
+	KeySym lower, upper;
+	KeyMap::convert_case(XK_a, &lower, &upper);
+	CHECK(lower == XK_a && upper == XK_A);
+	KeyMap::convert_case(XK_Eacute, &lower, &upper);
+	CHECK(lower == XK_eacute && upper == XK_Eacute);
+	KeyMap::convert_case(XK_multiply, &lower, &upper);
+	CHECK(lower == XK_multiply && upper == XK_multiply);
+	KeyMap::convert_case(0x1000101, &lower, &upper);
+	CHECK(lower == 0x1000101 && upper == 0x1000100);
+	KeyMap::convert_case(0x1000130, &lower, &upper);
+	CHECK(lower == XK_i && upper == 0x1000130);
+	KeyMap::convert_case(0x1000131, &lower, &upper);
+	CHECK(lower == 0x1000131 && upper == XK_I);
+	KeyMap::convert_case(0x1000132, &lower, &upper);
+	CHECK(lower == 0x1000133 && upper == 0x1000132);
+	KeyMap::convert_case(0x1000178, &lower, &upper);
+	CHECK(lower == XK_ydiaeresis && upper == 0x1000178);
+	KeyMap::convert_case(XK_ydiaeresis, &lower, &upper);
+	CHECK(lower == XK_ydiaeresis && upper == 0x1000178);
+	KeyMap::convert_case(0x100017f, &lower, &upper);
+	CHECK(lower == 0x100017f && upper == XK_S);
+	KeyMap::convert_case(XK_mu, &lower, &upper);
+	CHECK(lower == XK_mu && upper == 0x100039c);
+	KeyMap::convert_case(XK_Greek_omega, &lower, &upper);
+	CHECK(lower == XK_Greek_omega && upper == XK_Greek_OMEGA);
+	KeyMap::convert_case(XK_Cyrillic_ZHE, &lower, &upper);
+	CHECK(lower == XK_Cyrillic_zhe && upper == XK_Cyrillic_ZHE);
+
+	CHECK_EQUAL(KeyMap::keypad_keysym(XK_0), XK_KP_0);
+	CHECK_EQUAL(KeyMap::keypad_keysym(XK_Page_Down), XK_KP_Page_Down);
+	CHECK_EQUAL(KeyMap::keypad_keysym(XK_a), XK_a);
+}
+
+static void
+test_names()
+{
+	CHECK_EQUAL(KeyMap::keysym_for_name("a"), XK_a);
+	CHECK_EQUAL(KeyMap::keysym_for_name("Return"), XK_Return);
+	CHECK_EQUAL(KeyMap::keysym_for_name("KP_Enter"), XK_KP_Enter);
+	CHECK_EQUAL(KeyMap::keysym_for_name("Cyrillic_zhe"), XK_Cyrillic_zhe);
+	CHECK_EQUAL(KeyMap::keysym_for_name("return"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("Retur"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name(""), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name(NULL), NoSymbol);
+
+	CHECK(strcmp(KeyMap::keysym_name(XK_a), "a") == 0);
+	CHECK(strcmp(KeyMap::keysym_name(XK_F12), "F12") == 0);
+	CHECK(KeyMap::keysym_name(0x1000436) == NULL);
+	CHECK(KeyMap::keysym_name(0x12345) == NULL);
+
+	// Aliases have the same keysym, whose name is the first of them.
+	CHECK_EQUAL(KeyMap::keysym_for_name("Mode_switch"), XK_Mode_switch);
+	CHECK_EQUAL(KeyMap::keysym_for_name("script_switch"), XK_script_switch);
+	CHECK(strcmp(KeyMap::keysym_name(XK_script_switch),
+		KeyMap::keysym_name(XK_Mode_switch)) == 0);
+
+	// Algorithmic names.
+	CHECK_EQUAL(KeyMap::keysym_for_name("U0436"), 0x1000436);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U1F600"), 0x101F600);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U00e9"), XK_eacute);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U0010"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U0085"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U110000"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U"), XK_U);
+	CHECK_EQUAL(KeyMap::keysym_for_name("U04G6"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("0xff0d"), XK_Return);
+	CHECK_EQUAL(KeyMap::keysym_for_name("0x20000000"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("0x"), NoSymbol);
+	CHECK_EQUAL(KeyMap::keysym_for_name("0x123456789abcdef01"), NoSymbol);
+}
+
+static void
+test_all_names()
+{
+	// Every name in the table maps to its keysym, and back to a name for it.
+	int failures = 0;
+	for (size_t i = 0; i < KEY_SYM_LIST_LENGTH; i++) {
+		const KeySym keysym = KeyMap::keysym_for_name(KEY_SYM_LIST[i].name);
+		const char* name = KeyMap::keysym_name(KEY_SYM_LIST[i].keySym);
+		if (keysym != KEY_SYM_LIST[i].keySym || name == NULL
+				|| KeyMap::keysym_for_name(name) != keysym) {
+			failures++;
+		}
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+int
+main()
+{
+	test_table();
+	test_lookup();
+	test_keypad();
+	test_text();
+	test_conversions();
+	test_names();
+	test_all_names();
+	return test_result("KeyMap");
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "MaskScanner.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "Test.h"
+
+/* Clip masks as applications set them: mostly shapes, and mostly empty. */
+
+static const int32_t kWidth = 512, kHeight = 512;
+static const int kCount = 200;
+
+int
+main()
+{
+	std::vector<uint8_t> empty(kWidth * kHeight, 0), full(kWidth * kHeight, 0xFF),
+		circle(kWidth * kHeight, 0), noise(kWidth * kHeight);
+	for (int32_t y = 0; y < kHeight; y++) {
+		for (int32_t x = 0; x < kWidth; x++) {
+			const int32_t dx = x - kWidth / 2, dy = y - kHeight / 2;
+			if (dx * dx + dy * dy < kWidth * kWidth / 4)
+				circle[y * kWidth + x] = 0xFF;
+		}
+	}
+	srand(1);
+	for (uint8_t& pixel : noise)
+		pixel = (rand() % 2) ? 0xFF : 0;
+
+	std::vector<MaskScanner::Rect> rects;
+	const struct { const char* name; const std::vector<uint8_t>& bits; } masks[] = {
+		{"512x512 empty mask", empty},
+		{"512x512 full mask", full},
+		{"512x512 circle mask", circle},
+		{"512x512 noise mask", noise},
+	};
+	for (const auto& mask : masks) {
+		benchmark(mask.name, kCount, [&](int) {
+			rects.clear();
+			MaskScanner::scan(mask.bits.data(), kWidth, kWidth, kHeight, rects);
+		});
+	}
+	keep(rects);
+	return 0;
+}
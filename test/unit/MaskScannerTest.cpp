@@ -0,0 +1,143 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "MaskScanner.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "Test.h"
+
+/* Checks that the rects cover exactly the set pixels, and form a y-banded
+ * region in which no two touching bands could have been merged. */
+static bool
+check_scan(const std::vector<uint8_t>& bits, int32_t bytesPerRow, int32_t width, int32_t height)
+{
+	std::vector<MaskScanner::Rect> rects;
+	MaskScanner::scan(bits.data(), bytesPerRow, width, height, rects);
+
+	std::vector<int> covered(width * height);
+	for (size_t i = 0; i < rects.size(); i++) {
+		const MaskScanner::Rect& rect = rects[i];
+		if (rect.left > rect.right || rect.top > rect.bottom || rect.left < 0
+				|| rect.right >= width || rect.top < 0 || rect.bottom >= height)
+			return false;
+		if (i > 0) {
+			const MaskScanner::Rect& previous = rects[i - 1];
+			const bool sameBand = previous.top == rect.top;
+			if (sameBand && (previous.bottom != rect.bottom || previous.right + 1 >= rect.left))
+				return false;
+			if (!sameBand && previous.bottom >= rect.top)
+				return false;
+		}
+		for (int32_t y = rect.top; y <= rect.bottom; y++) {
+			for (int32_t x = rect.left; x <= rect.right; x++)
+				covered[y * width + x]++;
+		}
+	}
+
+	for (int32_t y = 0; y < height; y++) {
+		for (int32_t x = 0; x < width; x++) {
+			const bool set = (bits[y * bytesPerRow + x] & 0x80) != 0;
+			if (covered[y * width + x] != (set ? 1 : 0))
+				return false;
+		}
+	}
+
+	// Touching bands with the same spans should have been one band.
+	for (size_t i = 0, next; i < rects.size(); i = next) {
+		for (next = i; next < rects.size() && rects[next].top == rects[i].top; next++)
+			;
+		size_t end = next;
+		for (; end < rects.size() && rects[end].top == rects[next].top; end++)
+			;
+		if (next == rects.size() || rects[next].top != rects[i].bottom + 1 || end - next != next - i)
+			continue;
+		bool same = true;
+		for (size_t j = 0; j < next - i; j++) {
+			same = same && rects[i + j].left == rects[next + j].left
+				&& rects[i + j].right == rects[next + j].right;
+		}
+		if (same)
+			return false;
+	}
+	return true;
+}
+
+// #pragma mark - tests
+
+static void
+test_shapes()
+{
+	// A rectangle is one rect; only the high bit of each byte counts.
+	const int32_t width = 20, height = 10;
+	std::vector<uint8_t> bits(width * height, 0x7F);
+	for (int32_t y = 2; y < 6; y++) {
+		for (int32_t x = 3; x < 17; x++)
+			bits[y * width + x] = 0x80;
+	}
+	std::vector<MaskScanner::Rect> rects;
+	MaskScanner::scan(bits.data(), width, width, height, rects);
+	CHECK_EQUAL(rects.size(), 1);
+	CHECK(rects[0].left == 3 && rects[0].top == 2 && rects[0].right == 16 && rects[0].bottom == 5);
+
+	// Empty and full masks.
+	std::vector<uint8_t> empty(width * height, 0);
+	rects.clear();
+	MaskScanner::scan(empty.data(), width, width, height, rects);
+	CHECK(rects.empty());
+	std::vector<uint8_t> full(width * height, 0xFF);
+	rects.clear();
+	MaskScanner::scan(full.data(), width, width, height, rects);
+	CHECK_EQUAL(rects.size(), 1);
+	CHECK(rects[0].right == width - 1 && rects[0].bottom == height - 1);
+
+	// A checkerboard has a rect per set pixel, in bands of one row.
+	std::vector<uint8_t> checkers(width * height);
+	for (int32_t i = 0; i < width * height; i++)
+		checkers[i] = ((i % width + i / width) % 2) ? 0xFF : 0;
+	CHECK(check_scan(checkers, width, width, height));
+	rects.clear();
+	MaskScanner::scan(checkers.data(), width, width, height, rects);
+	CHECK_EQUAL(rects.size(), width * height / 2);
+}
+
+static void
+test_random()
+{
+	srand(1);
+	int failures = 0;
+	for (int test = 0; test < 500; test++) {
+		// Odd widths and padded rows, so words straddle row ends.
+		const int32_t width = 1 + rand() % 70, height = 1 + rand() % 30;
+		const int32_t bytesPerRow = width + rand() % 9;
+		std::vector<uint8_t> bits(bytesPerRow * height);
+		const int density = rand() % 4;
+		for (int32_t y = 0; y < height; y++) {
+			// Runs of either value, and rows which repeat, as in real masks.
+			if (y > 0 && rand() % 3 == 0) {
+				std::copy(bits.begin() + (y - 1) * bytesPerRow, bits.begin() + y * bytesPerRow,
+					bits.begin() + y * bytesPerRow);
+				continue;
+			}
+			uint8_t value = 0;
+			for (int32_t x = 0; x < bytesPerRow; x++) {
+				if (rand() % (2 + density * 8) == 0)
+					value = value ? 0 : (0x80 | rand());
+				bits[y * bytesPerRow + x] = (x < width || rand() % 2) ? value : 0xFF;
+			}
+		}
+		if (!check_scan(bits, bytesPerRow, width, height))
+			failures++;
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+int
+main()
+{
+	test_shapes();
+	test_random();
+	return test_result("MaskScanner");
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "PaletteExpander.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "Test.h"
+
+/* Expanding a 1920-pixel row, as when an indexed pixmap is copied to a window. */
+
+static const int32_t kWidth = 1920;
+static const int kCount = 20000;
+
+int
+main()
+{
+	uint32_t palette[256];
+	std::vector<uint8_t> source(kWidth);
+	std::vector<uint32_t> dest(kWidth);
+	srand(1);
+	for (uint32_t& pixel : palette)
+		pixel = rand();
+	for (uint8_t& index : source)
+		index = rand();
+
+	benchmark("1920 indexes, scalar", kCount, [&](int) {
+		PaletteExpander::expand_scalar(source.data(), dest.data(), kWidth, palette);
+	});
+	if (PaletteExpander::have_avx2()) {
+		benchmark("1920 indexes, AVX2", kCount, [&](int) {
+			PaletteExpander::expand_avx2(source.data(), dest.data(), kWidth, palette);
+		});
+	}
+	keep(dest);
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "PaletteExpander.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Test.h"
+
+typedef void (*Kernel)(const uint8_t* source, uint32_t* dest, int32_t count,
+	const uint32_t* palette);
+
+/* Expands rows of every length up to a few vectors, from every alignment, and
+ * checks them against palette[source[i]]; nothing past the row may be written. */
+static bool
+check_kernel(Kernel kernel)
+{
+	uint32_t palette[256];
+	for (uint32_t& pixel : palette)
+		pixel = uint32_t(rand()) << 16 ^ rand();
+
+	const uint32_t kGuard = 0xDEADBEEF;
+	for (int32_t count = 0; count <= 67; count++) {
+		for (int32_t offset = 0; offset < 8; offset++) {
+			std::vector<uint8_t> source(offset + count);
+			for (uint8_t& index : source)
+				index = rand();
+			std::vector<uint32_t> dest(offset + count + 1, kGuard);
+
+			kernel(source.data() + offset, dest.data() + offset, count, palette);
+			for (int32_t i = 0; i < offset; i++) {
+				if (dest[i] != kGuard)
+					return false;
+			}
+			for (int32_t i = 0; i < count; i++) {
+				if (dest[offset + i] != palette[source[offset + i]])
+					return false;
+			}
+			if (dest[offset + count] != kGuard)
+				return false;
+		}
+	}
+	return true;
+}
+
+// #pragma mark - tests
+
+static void
+test_scalar()
+{
+	srand(1);
+	CHECK(check_kernel(PaletteExpander::expand_scalar));
+}
+
+static void
+test_avx2()
+{
+	if (!PaletteExpander::have_avx2()) {
+		printf("PaletteExpander: no AVX2, skipping its kernel\n");
+		return;
+	}
+	srand(2);
+	CHECK(check_kernel(PaletteExpander::expand_avx2));
+}
+
+static void
+test_expand()
+{
+	srand(3);
+	CHECK(check_kernel(PaletteExpander::expand));
+
+	// The highest index is the last entry.
+	uint32_t palette[256] = {};
+	palette[255] = 0xFF123456;
+	palette[0] = 0xFF000000;
+	const uint8_t source[9] = {255, 0, 255, 0, 255, 0, 255, 0, 255};
+	uint32_t dest[9];
+	PaletteExpander::expand(source, dest, 9, palette);
+	CHECK_EQUAL(dest[0], 0xFF123456);
+	CHECK_EQUAL(dest[7], 0xFF000000);
+	CHECK_EQUAL(dest[8], 0xFF123456);
+}
+
+int
+main()
+{
+	test_scalar();
+	test_avx2();
+	test_expand();
+	return test_result("PaletteExpander");
+}
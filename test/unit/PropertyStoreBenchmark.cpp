@@ -0,0 +1,62 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "PropertyStore.h"
+
+#include <vector>
+
+extern "C" {
+#include <X11/Xatom.h>
+}
+
+#include "Test.h"
+
+/* What toolkits do to the properties of a window. */
+
+static const int kCount = 100000;
+
+int
+main()
+{
+	// Setting the title, as some applications do every frame.
+	PropertyStore titles;
+	const char title[] = "xlibe benchmark - 60 fps";
+	benchmark("replace a 24-byte value", kCount, [&](int) {
+		titles.change(XA_WM_NAME, XA_STRING, 8, PropModeReplace,
+			(const unsigned char*)title, sizeof(title) - 1);
+	});
+
+	// Building a value up one item at a time, then starting over.
+	PropertyStore states;
+	benchmark("append one atom (up to 1000)", kCount, [&](int i) {
+		const long atom = i;
+		states.change(XA_ATOM, XA_ATOM, 32, (i % 1000) ? PropModeAppend : PropModeReplace,
+			(const unsigned char*)&atom, 1);
+	});
+
+	// Looking properties up among the couple dozen a toolkit window has.
+	PropertyStore window;
+	for (Atom property = 1; property <= 24; property++) {
+		const std::vector<long> value(property, property);
+		window.change(property, XA_CARDINAL, 32, PropModeReplace,
+			(const unsigned char*)value.data(), value.size());
+	}
+	benchmark("get one of 24 properties", kCount * 10, [&](int i) {
+		PropertyStore::Value value;
+		window.get(1 + i % 24, value);
+		keep(value);
+	});
+
+	// An icon: a large value, replaced now and then by one of a different size.
+	PropertyStore icons;
+	std::vector<long> icon(2 + 64 * 64, 0x7f7f7f7f);
+	benchmark("replace a 32 KB icon", kCount / 10, [&](int i) {
+		icons.change(XA_CARDINAL, XA_CARDINAL, 32, PropModeReplace,
+			(const unsigned char*)icon.data(), icon.size() - (i % 2) * 1024);
+	});
+
+	keep(titles);
+	keep(states);
+	return 0;
+}
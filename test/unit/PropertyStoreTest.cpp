@@ -0,0 +1,189 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "PropertyStore.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <X11/Xatom.h>
+}
+
+#include "Test.h"
+
+enum {
+	kName = 100,
+	kState,
+	kIcon,
+	kOther,
+};
+
+static std::string
+string_value(const PropertyStore& store, Atom property)
+{
+	PropertyStore::Value value;
+	if (!store.get(property, value) || value.format != 8)
+		return "(none)";
+	return std::string((const char*)value.data, value.nitems);
+}
+
+static std::vector<long>
+long_value(const PropertyStore& store, Atom property)
+{
+	PropertyStore::Value value;
+	if (!store.get(property, value) || value.format != 32)
+		return {};
+	const long* items = (const long*)value.data;
+	return std::vector<long>(items, items + value.nitems);
+}
+
+static int
+change_string(PropertyStore& store, Atom property, int mode, const char* string)
+{
+	return store.change(property, XA_STRING, 8, mode, (const unsigned char*)string,
+		strlen(string));
+}
+
+// #pragma mark - tests
+
+static void
+test_change()
+{
+	PropertyStore store;
+	CHECK_EQUAL(change_string(store, kName, PropModeReplace, "xlibe"), Success);
+	CHECK(string_value(store, kName) == "xlibe");
+	CHECK_EQUAL(change_string(store, kName, PropModeAppend, " rocks"), Success);
+	CHECK_EQUAL(change_string(store, kName, PropModePrepend, "the "), Success);
+	CHECK(string_value(store, kName) == "the xlibe rocks");
+	CHECK_EQUAL(change_string(store, kName, PropModeReplace, "x"), Success);
+	CHECK(string_value(store, kName) == "x");
+
+	// Appending to nothing is replacing.
+	CHECK_EQUAL(change_string(store, kOther, PropModeAppend, "new"), Success);
+	CHECK(string_value(store, kOther) == "new");
+
+	// Format 32 items are longs, as clients pass them.
+	const long states[] = {1, 2, 0x7fffffff};
+	CHECK_EQUAL(store.change(kState, XA_ATOM, 32, PropModeReplace,
+		(const unsigned char*)states, 2), Success);
+	CHECK_EQUAL(store.change(kState, XA_ATOM, 32, PropModeAppend,
+		(const unsigned char*)(states + 2), 1), Success);
+	CHECK(long_value(store, kState) == std::vector<long>({1, 2, 0x7fffffff}));
+
+	const short shorts[] = {-1, 7};
+	CHECK_EQUAL(store.change(kIcon, XA_INTEGER, 16, PropModeReplace,
+		(const unsigned char*)shorts, 2), Success);
+	PropertyStore::Value value;
+	CHECK(store.get(kIcon, value));
+	CHECK(value.nitems == 2 && ((const short*)value.data)[0] == -1
+		&& ((const short*)value.data)[1] == 7);
+}
+
+static void
+test_errors()
+{
+	PropertyStore store;
+	CHECK_EQUAL(change_string(store, kName, PropModeReplace, "a"), Success);
+
+	// Only replacing can change the type or format.
+	const long atom = XA_ATOM;
+	CHECK_EQUAL(store.change(kName, XA_ATOM, 32, PropModeAppend,
+		(const unsigned char*)&atom, 1), BadMatch);
+	CHECK_EQUAL(store.change(kName, XA_ATOM, 8, PropModePrepend,
+		(const unsigned char*)"b", 1), BadMatch);
+	CHECK(string_value(store, kName) == "a");
+
+	CHECK_EQUAL(store.change(kName, XA_STRING, 12, PropModeReplace,
+		(const unsigned char*)"b", 1), BadValue);
+	CHECK_EQUAL(store.change(kName, XA_STRING, 8, 7, (const unsigned char*)"b", 1), BadValue);
+	CHECK_EQUAL(store.change(kName, XA_ATOM, 32, PropModeReplace,
+		(const unsigned char*)&atom, 1), Success);
+	CHECK(long_value(store, kName) == std::vector<long>({XA_ATOM}));
+}
+
+static void
+test_remove_and_list()
+{
+	PropertyStore store;
+	change_string(store, kName, PropModeReplace, "name");
+	change_string(store, kIcon, PropModeReplace, "icon");
+	change_string(store, kOther, PropModeReplace, "other");
+	CHECK(store.remove(kIcon));
+	CHECK(!store.remove(kIcon));
+	CHECK(string_value(store, kIcon) == "(none)");
+	CHECK(string_value(store, kOther) == "other");
+
+	CHECK_EQUAL(store.count(), 2);
+	Atom properties[2];
+	store.list(properties);
+	CHECK(properties[0] == kName && properties[1] == kOther);
+}
+
+static void
+test_rotate()
+{
+	PropertyStore store;
+	change_string(store, kName, PropModeReplace, "a");
+	change_string(store, kIcon, PropModeReplace, "b");
+	change_string(store, kOther, PropModeReplace, "c");
+
+	// As XRotateWindowProperties: the value of each property moves "positions" on.
+	const Atom properties[] = {kName, kIcon, kOther};
+	CHECK(store.rotate(properties, 3, 1));
+	CHECK(string_value(store, kName) == "c");
+	CHECK(string_value(store, kIcon) == "a");
+	CHECK(string_value(store, kOther) == "b");
+	CHECK(store.rotate(properties, 3, -1));
+	CHECK(string_value(store, kName) == "a");
+
+	// Missing or repeated properties change nothing.
+	const Atom missing[] = {kName, kState};
+	CHECK(!store.rotate(missing, 2, 1));
+	const Atom repeated[] = {kName, kName};
+	CHECK(!store.rotate(repeated, 2, 1));
+	CHECK(string_value(store, kName) == "a");
+}
+
+static void
+test_compaction()
+{
+	// Values which grow and shrink must survive being moved around the arena.
+	PropertyStore store;
+	std::string expected;
+	for (int i = 0; i < 2000; i++) {
+		const std::string chunk(1 + i % 37, char('a' + i % 26));
+		if (i % 100 == 99) {
+			expected = chunk;
+			change_string(store, kName, PropModeReplace, chunk.c_str());
+		} else {
+			expected += chunk;
+			change_string(store, kName, PropModeAppend, chunk.c_str());
+		}
+		change_string(store, kOther + i % 3, PropModeReplace, std::string(i % 5000, 'x').c_str());
+		if (i % 7 == 0)
+			store.remove(kOther + 1);
+	}
+	CHECK(string_value(store, kName) == expected);
+	CHECK(string_value(store, kOther + 2) == std::string(1997 % 5000, 'x'));
+
+	// Items stay aligned for reading in place.
+	const long states[] = {1, 2};
+	store.change(kState, XA_ATOM, 32, PropModeReplace, (const unsigned char*)states, 2);
+	PropertyStore::Value value;
+	CHECK(store.get(kState, value));
+	CHECK_EQUAL((uintptr_t)value.data % sizeof(long), 0);
+}
+
+int
+main()
+{
+	test_change();
+	test_errors();
+	test_remove_and_list();
+	test_rotate();
+	test_compaction();
+	return test_result("PropertyStore");
+}
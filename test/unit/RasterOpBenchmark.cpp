@@ -0,0 +1,54 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "RasterOp.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+#include "Test.h"
+
+/* Combining 1920-pixel rows, as filling or copying a full-width 32-bit pixmap does. */
+
+static const int32_t kWidth = 1920;
+static const int kCount = 20000;
+
+int
+main()
+{
+	std::vector<uint32_t> source(kWidth), dest(kWidth);
+	std::vector<uint8_t> mask(kWidth);
+	srand(1);
+	for (int32_t x = 0; x < kWidth; x++) {
+		source[x] = rand();
+		dest[x] = rand();
+		mask[x] = (x / 7) % 2 ? 0xFF : 0;
+	}
+
+	benchmark("GXcopy, solid", kCount, [&](int) {
+		RasterOp::apply(GXcopy, 4, NULL, 0x123456, NULL, ~0u, dest.data(), kWidth);
+	});
+	benchmark("GXxor, solid", kCount, [&](int) {
+		RasterOp::apply(GXxor, 4, NULL, 0xFFFFFF, NULL, ~0u, dest.data(), kWidth);
+	});
+	benchmark("GXxor, source", kCount, [&](int) {
+		RasterOp::apply(GXxor, 4, source.data(), 0, NULL, ~0u, dest.data(), kWidth);
+	});
+	benchmark("GXand, source, plane mask", kCount, [&](int) {
+		RasterOp::apply(GXand, 4, source.data(), 0, NULL, 0x00FF00FF, dest.data(), kWidth);
+	});
+	benchmark("GXor, source, clip mask", kCount, [&](int) {
+		RasterOp::apply(GXor, 4, source.data(), 0, mask.data(), ~0u, dest.data(), kWidth);
+	});
+	benchmark("GXinvert, 8-bit", kCount, [&](int) {
+		RasterOp::apply(GXinvert, 1, NULL, 0, NULL, ~0u, dest.data(), kWidth);
+	});
+	keep(dest);
+	return 0;
+}
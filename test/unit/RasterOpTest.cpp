@@ -0,0 +1,142 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "RasterOp.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+#include "Test.h"
+
+/* The function, as a truth table: the GX code has the result for (source, dest) of
+ * (1, 1) in bit 0, (1, 0) in bit 1, (0, 1) in bit 2 and (0, 0) in bit 3. */
+static uint32_t
+reference_combine(int function, uint32_t source, uint32_t dest)
+{
+	uint32_t result = 0;
+	for (int bit = 0; bit < 32; bit++) {
+		const int s = (source >> bit) & 1, d = (dest >> bit) & 1;
+		result |= uint32_t((function >> (3 - (2 * s + d))) & 1) << bit;
+	}
+	return result;
+}
+
+static uint32_t
+load(const uint8_t* row, int bytesPerPixel, int32_t x)
+{
+	uint32_t pixel = 0;
+	memcpy(&pixel, row + x * bytesPerPixel, bytesPerPixel);
+	return pixel;
+}
+
+/* Applies the function to a row and compares every pixel with the reference. */
+static bool
+check_row(int function, int bytesPerPixel, bool solid, bool masked, uint32_t planes,
+	int32_t width)
+{
+	std::vector<uint8_t> source(width * bytesPerPixel), dest(width * bytesPerPixel),
+		mask(width);
+	for (uint8_t& byte : source)
+		byte = rand();
+	for (uint8_t& byte : dest)
+		byte = rand();
+	for (uint8_t& byte : mask)
+		byte = (rand() % 3 == 0) ? 0 : (rand() % 2 ? 0xFF : 0x80 | rand());
+	const uint32_t pixel = uint32_t(rand()) << 8 ^ rand();
+	const std::vector<uint8_t> before = dest;
+
+	RasterOp::apply(function, bytesPerPixel, solid ? NULL : source.data(), pixel,
+		masked ? mask.data() : NULL, planes, dest.data(), width);
+
+	const uint32_t pixelMask = bytesPerPixel == 4 ? ~0u : (1u << (8 * bytesPerPixel)) - 1;
+	for (int32_t x = 0; x < width; x++) {
+		const uint32_t d = load(before.data(), bytesPerPixel, x);
+		uint32_t expected = d;
+		if (!masked || (mask[x] & 0x80)) {
+			const uint32_t s = solid ? (pixel & pixelMask) : load(source.data(), bytesPerPixel, x);
+			expected = ((reference_combine(function, s, d) & planes) | (d & ~planes)) & pixelMask;
+		}
+		if (load(dest.data(), bytesPerPixel, x) != expected)
+			return false;
+	}
+	return true;
+}
+
+// #pragma mark - tests
+
+static void
+test_functions()
+{
+	srand(1);
+	// Widths around the vector size, so the tails are covered as well.
+	static const int32_t kWidths[] = {1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 100};
+	int failures = 0;
+	for (int function = GXclear; function <= GXset; function++) {
+		for (int bytesPerPixel : {1, 2, 4}) {
+			for (int32_t width : kWidths) {
+				for (int variant = 0; variant < 4; variant++) {
+					const bool solid = variant & 1, masked = variant & 2;
+					if (!check_row(function, bytesPerPixel, solid, masked, ~0u, width))
+						failures++;
+				}
+			}
+		}
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+static void
+test_planes()
+{
+	srand(2);
+	int failures = 0;
+	for (int function = GXclear; function <= GXset; function++) {
+		for (int bytesPerPixel : {1, 2, 4}) {
+			for (uint32_t planes : {0u, 0x0Fu, 0x00FF00FFu, 0x80000001u, uint32_t(rand())}) {
+				if (!check_row(function, bytesPerPixel, function % 2, function % 3 == 0,
+						planes, 37))
+					failures++;
+			}
+		}
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+static void
+test_examples()
+{
+	// XOR drawing, as rubber bands do it: twice gives back what was there.
+	uint32_t row[5] = {0, 0x00FFFFFF, 0x12345678, 0xFF000000, 0xDEADBEEF};
+	const uint32_t original[5] = {0, 0x00FFFFFF, 0x12345678, 0xFF000000, 0xDEADBEEF};
+	RasterOp::apply(GXxor, 4, NULL, 0x00FFFFFF, NULL, ~0u, row, 5);
+	CHECK_EQUAL(row[1], 0);
+	CHECK_EQUAL(row[2], 0x12CBA987);
+	RasterOp::apply(GXxor, 4, NULL, 0x00FFFFFF, NULL, ~0u, row, 5);
+	CHECK(memcmp(row, original, sizeof(row)) == 0);
+
+	// Only the planes in the mask change.
+	uint16_t pixels[3] = {0xFFFF, 0x0000, 0xF0F0};
+	RasterOp::apply(GXclear, 2, NULL, 0, NULL, 0x00FF, pixels, 3);
+	CHECK(pixels[0] == 0xFF00 && pixels[1] == 0 && pixels[2] == 0xF000);
+
+	// The mask's high bit selects pixels.
+	uint8_t bytes[4] = {1, 2, 3, 4};
+	const uint8_t mask[4] = {0xFF, 0x7F, 0x80, 0};
+	RasterOp::apply(GXset, 1, NULL, 0, mask, ~0u, bytes, 4);
+	CHECK(bytes[0] == 0xFF && bytes[1] == 2 && bytes[2] == 0xFF && bytes[3] == 4);
+}
+
+int
+main()
+{
+	test_functions();
+	test_planes();
+	test_examples();
+	return test_result("RasterOp");
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Rasterizer.h"
+
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+#include "Test.h"
+
+/* The shapes x11perf draws, scan-converted into a screen-sized mask. */
+
+static const int32_t kWidth = 1920, kHeight = 1080;
+static const int kCount = 10000;
+
+int
+main()
+{
+	std::vector<uint8_t> bits(kWidth * kHeight);
+	Rasterizer rasterizer(bits.data(), kWidth, kWidth, kHeight);
+	srand(1);
+	auto x = []() { return rand() % (kWidth - 120); };
+	auto y = []() { return rand() % (kHeight - 120); };
+
+	benchmark("10-pixel line", kCount, [&](int i) {
+		const int32_t left = x(), top = y();
+		rasterizer.line(left, top, left + i % 21 - 10, top + i % 17 - 8, true);
+	});
+	benchmark("100-pixel line", kCount, [&](int) {
+		const int32_t left = x(), top = y();
+		rasterizer.line(left, top, left + 100, top + 37, true);
+	});
+	benchmark("100x100 rectangle", kCount, [&](int) {
+		rasterizer.fill_rect(x(), y(), 100, 100);
+	});
+	benchmark("100-pixel polygon", kCount, [&](int) {
+		const int32_t left = x(), top = y();
+		const Rasterizer::Point points[] = {{left, top}, {left + 100, top + 20},
+			{left + 50, top + 100}, {left + 10, top + 60}};
+		rasterizer.fill_polygon(points, 4, false);
+	});
+	benchmark("10-wide polyline", kCount, [&](int) {
+		const int32_t left = x(), top = y();
+		const Rasterizer::Point points[] = {{left, top}, {left + 100, top + 20},
+			{left + 50, top + 70}};
+		rasterizer.wide_lines(points, 3, 10, CapButt, JoinMiter);
+	});
+	benchmark("100-pixel circle", kCount, [&](int) {
+		rasterizer.arc(x(), y(), 100, 100, 0, 360 * 64);
+	});
+	benchmark("100-pixel filled circle", kCount, [&](int) {
+		rasterizer.fill_arc(x(), y(), 100, 100, 0, 360 * 64, false);
+	});
+	benchmark("100-pixel pie slice", kCount, [&](int) {
+		rasterizer.fill_arc(x(), y(), 100, 100, 30 * 64, 100 * 64, false);
+	});
+	benchmark("100-pixel chord", kCount, [&](int) {
+		rasterizer.fill_arc(x(), y(), 100, 100, 30 * 64, 100 * 64, true);
+	});
+	benchmark("100-pixel 8-wide arc", kCount, [&](int) {
+		rasterizer.wide_arc(x(), y(), 100, 100, 0, 270 * 64, 8, CapRound);
+	});
+	keep(bits);
+	return 0;
+}
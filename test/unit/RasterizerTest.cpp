@@ -0,0 +1,616 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+#include "Test.h"
+
+static const int32_t kWidth = 200, kHeight = 150;
+
+struct Arc {
+	int32_t x, y, width, height, angle1, angle2;
+};
+
+struct Image {
+	std::vector<uint8_t> bits;
+
+	Image() : bits(kWidth * kHeight) {}
+
+	Rasterizer rasterizer() { return Rasterizer(bits.data(), kWidth, kWidth, kHeight); }
+	bool at(int32_t x, int32_t y) const { return bits[y * kWidth + x] != 0; }
+
+	int32_t count() const
+	{
+		return std::count_if(bits.begin(), bits.end(), [](uint8_t bit) { return bit != 0; });
+	}
+};
+
+/* Compares the image, starting at (x, y), with rows of '#' (set) and '.' (unset). */
+static bool
+matches(const Image& image, int32_t x, int32_t y, const char* const* rows, int32_t count)
+{
+	bool result = true;
+	const int32_t width = strlen(rows[0]);
+	// What is around the golden image must be unset.
+	for (int32_t row = std::max(y - 1, 0); row <= std::min(y + count, kHeight - 1); row++) {
+		for (int32_t column = std::max(x - 1, 0); column <= std::min(x + width, kWidth - 1);
+				column++) {
+			const bool inside = row >= y && row < y + count && column >= x && column < x + width;
+			const bool expected = inside && rows[row - y][column - x] == '#';
+			if (image.at(column, row) != expected)
+				result = false;
+		}
+	}
+	if (!result) {
+		for (int32_t row = std::max(y - 1, 0); row <= std::min(y + count, kHeight - 1); row++) {
+			fprintf(stderr, "  ");
+			for (int32_t column = std::max(x - 1, 0); column <= std::min(x + width, kWidth - 1);
+					column++)
+				fputc(image.at(column, row) ? '#' : '.', stderr);
+			fputc('\n', stderr);
+		}
+	}
+	return result;
+}
+
+#define CHECK_GOLDEN(image, x, y, ...) \
+	do { \
+		static const char* const _rows[] = { __VA_ARGS__ }; \
+		CHECK(matches(image, x, y, _rows, sizeof(_rows) / sizeof(_rows[0]))); \
+	} while (0)
+
+/* Whether the pixel is inside the polygon by the X rules, from the exact crossings
+ * of the row with its edges: pixels whose centers are on an edge belong to the
+ * side they are left of, and horizontal edges are never crossed. */
+static bool
+reference_inside(const Rasterizer::Point* points, int count, int32_t x, int32_t y,
+	bool winding)
+{
+	int crossings = 0, direction = 0;
+	for (int i = 0; i < count; i++) {
+		Rasterizer::Point a = points[i], b = points[(i + 1) % count];
+		if (a.y == b.y)
+			continue;
+		int edgeDirection = 1;
+		if (a.y > b.y) {
+			std::swap(a, b);
+			edgeDirection = -1;
+		}
+		if (y < a.y || y >= b.y)
+			continue;
+
+		// The crossing is at or left of the pixel if its ceiling is.
+		const int64_t numerator = int64_t(a.x) * (b.y - a.y) + int64_t(y - a.y) * (b.x - a.x),
+			denominator = b.y - a.y;
+		const int64_t crossing = numerator / denominator
+			+ ((numerator % denominator) > 0 ? 1 : 0);
+		if (crossing <= x) {
+			crossings++;
+			direction += edgeDirection;
+		}
+	}
+	return winding ? (direction != 0) : (crossings % 2) != 0;
+}
+
+/* Whether the pixel is inside the arc's pie slice, by angle. */
+static bool
+reference_in_slice(int32_t x, int32_t y, const Arc& arc)
+{
+	if (std::abs(arc.angle2) >= 360 * 64)
+		return true;
+
+	double start = arc.angle1 / 64.0 * M_PI / 180, extent = arc.angle2 / 64.0 * M_PI / 180;
+	if (extent < 0) {
+		start += extent;
+		extent = -extent;
+	}
+	const double u = (x - arc.x - arc.width / 2.0) / (arc.width / 2.0),
+		v = -(y - arc.y - arc.height / 2.0) / (arc.height / 2.0);
+	if (u == 0 && v == 0)
+		return true;
+	const double angle = remainder(atan2(v, u) - start - M_PI, 2 * M_PI) + M_PI;
+	return angle <= extent + 1e-9;
+}
+
+static int32_t
+differences(const Image& a, const Image& b)
+{
+	int32_t result = 0;
+	for (size_t i = 0; i < a.bits.size(); i++)
+		result += (a.bits[i] != 0) != (b.bits[i] != 0);
+	return result;
+}
+
+static Arc
+random_arc(bool emptyAllowed)
+{
+	Arc arc;
+	arc.x = rand() % 150 - 20;
+	arc.y = rand() % 100 - 20;
+	arc.width = rand() % 120 + (emptyAllowed ? 0 : 1);
+	arc.height = rand() % 120 + (emptyAllowed ? 0 : 1);
+	arc.angle1 = rand() % (720 * 64) - 360 * 64;
+	arc.angle2 = rand() % (800 * 64) - 400 * 64;
+	if (arc.angle2 == 0)
+		arc.angle2 = 1;
+	return arc;
+}
+
+// #pragma mark - tests
+
+static void
+test_golden()
+{
+	// Ties go towards the smaller coordinate, whichever way lines are drawn.
+	{
+		Image image;
+		image.rasterizer().line(10, 10, 15, 12, true);
+		CHECK_GOLDEN(image, 10, 10,
+			"##....",
+			"..##..",
+			"....##");
+		Image reverse;
+		reverse.rasterizer().line(15, 12, 10, 10, true);
+		CHECK_EQUAL(differences(image, reverse), 0);
+	}
+	{
+		Image image;
+		image.rasterizer().line(10, 10, 12, 11, true);
+		CHECK_GOLDEN(image, 10, 10,
+			"##.",
+			"..#");
+	}
+
+	// CapNotLast leaves out the final point, but lines still join up.
+	{
+		Image image;
+		Rasterizer rasterizer = image.rasterizer();
+		const Rasterizer::Point points[] = {{10, 10}, {14, 10}, {14, 13}};
+		rasterizer.lines(points, 3, false);
+		CHECK_GOLDEN(image, 10, 10,
+			"#####",
+			"....#",
+			"....#");
+	}
+
+	// Centers on the right or bottom edge of a polygon are outside it.
+	{
+		Image image;
+		const Rasterizer::Point points[] = {{10, 10}, {14, 10}, {10, 14}};
+		image.rasterizer().fill_polygon(points, 3, false);
+		CHECK_GOLDEN(image, 10, 10,
+			"####",
+			"###.",
+			"##..",
+			"#...");
+	}
+
+	// Circles cover the pixels whose centers are inside them. Coordinates are pixel
+	// centers, so the circle's center is on one here; of the centers on its outline,
+	// only those with the circle right of or below them are covered.
+	{
+		Image image;
+		image.rasterizer().fill_arc(10, 10, 6, 6, 0, 360 * 64, false);
+		CHECK_GOLDEN(image, 10, 10,
+			"...#..",
+			".#####",
+			".#####",
+			"######",
+			".#####",
+			".#####");
+	}
+	{
+		Image image;
+		image.rasterizer().fill_arc(10, 10, 7, 7, 0, 360 * 64, false);
+		CHECK_GOLDEN(image, 11, 11,
+			".####.",
+			"######",
+			"######",
+			"######",
+			"######",
+			".####.");
+	}
+
+	// A quarter pie slice, and the chord of the same quarter.
+	{
+		Image image;
+		image.rasterizer().fill_arc(10, 10, 8, 8, 0, 90 * 64, false);
+		CHECK_GOLDEN(image, 14, 10,
+			"#...",
+			"###.",
+			"####",
+			"####",
+			"####");
+		Image chord;
+		chord.rasterizer().fill_arc(10, 10, 8, 8, 0, 90 * 64, true);
+		CHECK_GOLDEN(chord, 14, 10,
+			"#...",
+			".##.",
+			"..##",
+			"...#");
+	}
+
+	// The outline of a thin circle is the edge of the filled one.
+	{
+		Image image;
+		image.rasterizer().arc(10, 10, 6, 6, 0, 360 * 64);
+		CHECK_GOLDEN(image, 10, 10,
+			"...#..",
+			".##.##",
+			".#...#",
+			"#....#",
+			".#...#",
+			".#####");
+	}
+
+	// Wide lines cover the pixels inside their outlines, here [8.5, 16.5) by [8.5, 11.5).
+	{
+		Image image;
+		const Rasterizer::Point points[] = {{10, 10}, {15, 10}};
+		image.rasterizer().wide_lines(points, 2, 3, CapProjecting, JoinMiter);
+		CHECK_GOLDEN(image, 9, 9,
+			"########",
+			"########",
+			"########");
+	}
+}
+
+static void
+test_polygons()
+{
+	// Rectangles are the same filled as rects or polygons.
+	{
+		Image rect, polygon;
+		rect.rasterizer().fill_rect(10, 20, 30, 40);
+		const Rasterizer::Point points[] = {{10, 20}, {40, 20}, {40, 60}, {10, 60}};
+		polygon.rasterizer().fill_polygon(points, 4, false);
+		CHECK_EQUAL(differences(rect, polygon), 0);
+		CHECK_EQUAL(rect.count(), 30 * 40);
+	}
+
+	srand(1);
+	for (int test = 0; test < 300; test++) {
+		const int count = 3 + rand() % 8;
+		Rasterizer::Point points[12];
+		for (int i = 0; i < count; i++) {
+			points[i].x = rand() % (kWidth + 40) - 20;
+			points[i].y = rand() % (kHeight + 40) - 20;
+		}
+		for (int winding = 0; winding < 2; winding++) {
+			Image image;
+			image.rasterizer().fill_polygon(points, count, winding);
+			int32_t wrong = 0;
+			for (int32_t y = 0; y < kHeight; y++) {
+				for (int32_t x = 0; x < kWidth; x++)
+					wrong += image.at(x, y) != reference_inside(points, count, x, y, winding);
+			}
+			CHECK_EQUAL(wrong, 0);
+		}
+	}
+}
+
+static void
+test_lines()
+{
+	srand(2);
+	for (int test = 0; test < 2000; test++) {
+		const int32_t x1 = rand() % kWidth, y1 = rand() % kHeight,
+			x2 = rand() % kWidth, y2 = rand() % kHeight;
+		Image forward, backward, notLast;
+		forward.rasterizer().line(x1, y1, x2, y2, true);
+		backward.rasterizer().line(x2, y2, x1, y1, true);
+		notLast.rasterizer().line(x1, y1, x2, y2, false);
+
+		// One pixel for every step along the major axis.
+		const int32_t major = std::max(std::abs(x2 - x1), std::abs(y2 - y1));
+		CHECK_EQUAL(differences(forward, backward), 0);
+		CHECK_EQUAL(forward.count(), major + 1);
+		CHECK_EQUAL(notLast.count(), major);
+		CHECK(major == 0 || !notLast.at(x2, y2));
+	}
+}
+
+static void
+test_wide_lines()
+{
+	const Rasterizer::Point line[] = {{10, 10}, {20, 10}};
+	{
+		Image image;
+		image.rasterizer().wide_lines(line, 2, 1, CapButt, JoinMiter);
+		CHECK_EQUAL(image.count(), 10);
+		CHECK(image.at(10, 10) && !image.at(20, 10));
+	}
+	{
+		// Projecting by half the width: [8.5, 21.5) by [8.5, 11.5).
+		Image image;
+		image.rasterizer().wide_lines(line, 2, 3, CapProjecting, JoinMiter);
+		CHECK_EQUAL(image.count(), 13 * 3);
+	}
+
+	// A closed rectangle has miter joins all around, and no caps.
+	const Rasterizer::Point frame[] = {{10, 10}, {30, 10}, {30, 20}, {10, 20}, {10, 10}};
+	{
+		Image image;
+		image.rasterizer().wide_lines(frame, 5, 2, CapButt, JoinMiter);
+		CHECK_EQUAL(image.count(), 22 * 12 - 18 * 8);
+		CHECK(image.at(9, 9) && image.at(30, 20) && !image.at(31, 21));
+	}
+	{
+		Image bevel, miter, round;
+		bevel.rasterizer().wide_lines(frame, 5, 4, CapButt, JoinBevel);
+		miter.rasterizer().wide_lines(frame, 5, 4, CapButt, JoinMiter);
+		round.rasterizer().wide_lines(frame, 5, 4, CapButt, JoinRound);
+		CHECK(bevel.count() < round.count() && round.count() < miter.count());
+	}
+}
+
+static void
+test_arcs()
+{
+	srand(3);
+
+	// Pie slices, against their angles.
+	for (int test = 0; test < 500; test++) {
+		const Arc arc = random_arc(true);
+		Image image, ellipse;
+		image.rasterizer().fill_arc(arc.x, arc.y, arc.width, arc.height,
+			arc.angle1, arc.angle2, false);
+		ellipse.rasterizer().fill_arc(arc.x, arc.y, arc.width, arc.height, 0, 360 * 64, false);
+
+		// Pixels right on a radius can go either way.
+		int32_t wrong = 0;
+		for (int32_t y = 0; y < kHeight; y++) {
+			for (int32_t x = 0; x < kWidth; x++) {
+				const bool inside = ellipse.at(x, y) && reference_in_slice(x, y, arc);
+				wrong += image.at(x, y) != inside;
+			}
+		}
+		CHECK(wrong <= 2);
+	}
+
+	// Chords, against the line between the arc's ends.
+	for (int test = 0; test < 500; test++) {
+		const Arc arc = random_arc(false);
+		Image image, ellipse;
+		image.rasterizer().fill_arc(arc.x, arc.y, arc.width, arc.height,
+			arc.angle1, arc.angle2, true);
+		ellipse.rasterizer().fill_arc(arc.x, arc.y, arc.width, arc.height, 0, 360 * 64, false);
+
+		double start = arc.angle1 / 64.0 * M_PI / 180, extent = arc.angle2 / 64.0 * M_PI / 180;
+		if (extent < 0) {
+			start += extent;
+			extent = -extent;
+		}
+		const double x1 = cos(start), y1 = sin(start),
+			x2 = cos(start + extent), y2 = sin(start + extent);
+		int32_t wrong = 0;
+		for (int32_t y = 0; y < kHeight; y++) {
+			for (int32_t x = 0; x < kWidth; x++) {
+				bool inside = ellipse.at(x, y);
+				if (inside && std::abs(arc.angle2) < 360 * 64) {
+					const double u = (x - arc.x - arc.width / 2.0) / (arc.width / 2.0),
+						v = -(y - arc.y - arc.height / 2.0) / (arc.height / 2.0);
+					inside = (x2 - x1) * (v - y1) - (y2 - y1) * (u - x1) <= 1e-9;
+				}
+				wrong += image.at(x, y) != inside;
+			}
+		}
+		CHECK(wrong <= 2);
+	}
+
+	// Half chords are half pies.
+	{
+		Image chord, pie;
+		chord.rasterizer().fill_arc(20, 20, 60, 40, 0, 180 * 64, true);
+		pie.rasterizer().fill_arc(20, 20, 60, 40, 0, 180 * 64, false);
+		CHECK(differences(chord, pie) <= 2);
+	}
+
+	// Thin ellipses are the pixels of the filled ones next to something outside.
+	for (int test = 0; test < 300; test++) {
+		Arc arc = random_arc(false);
+		arc.width += 1;
+		arc.height += 1;
+		Image outline, ellipse;
+		outline.rasterizer().arc(arc.x, arc.y, arc.width, arc.height, 0, 360 * 64);
+		ellipse.rasterizer().fill_arc(arc.x, arc.y, arc.width, arc.height, 0, 360 * 64, false);
+
+		int32_t wrong = 0;
+		for (int32_t y = 1; y < kHeight - 1; y++) {
+			for (int32_t x = 1; x < kWidth - 1; x++) {
+				const bool edge = ellipse.at(x, y) && !(ellipse.at(x - 1, y)
+					&& ellipse.at(x + 1, y) && ellipse.at(x, y - 1) && ellipse.at(x, y + 1));
+				wrong += outline.at(x, y) != edge;
+			}
+		}
+		CHECK_EQUAL(wrong, 0);
+	}
+
+	// Thin arcs are part of both the outline and the pie slice.
+	for (int test = 0; test < 200; test++) {
+		Arc arc = random_arc(false);
+		arc.x = arc.y = 10;
+		arc.width += 1;
+		arc.height += 1;
+		Image image, outline, pie;
+		image.rasterizer().arc(arc.x, arc.y, arc.width, arc.height, arc.angle1, arc.angle2);
+		outline.rasterizer().arc(arc.x, arc.y, arc.width, arc.height, 0, 360 * 64);
+		pie.rasterizer().fill_arc(arc.x, arc.y, arc.width, arc.height,
+			arc.angle1, arc.angle2, false);
+
+		int32_t outside = 0;
+		for (size_t i = 0; i < image.bits.size(); i++)
+			outside += image.bits[i] && (!outline.bits[i] || !pie.bits[i]);
+		CHECK_EQUAL(outside, 0);
+	}
+}
+
+static void
+test_wide_arcs()
+{
+	// A full wide circle is a ring.
+	{
+		Image image;
+		image.rasterizer().wide_arc(50, 30, 80, 80, 0, 360 * 64, 10, CapButt);
+		int32_t wrong = 0;
+		for (int32_t y = 0; y < kHeight; y++) {
+			for (int32_t x = 0; x < kWidth; x++) {
+				const double distance = hypot(x - 90.0, y - 70.0);
+				if (distance < 45 - 0.3 && distance > 35 + 0.3)
+					wrong += !image.at(x, y);
+				else if (distance > 45 + 0.3 || distance < 35 - 0.3)
+					wrong += image.at(x, y);
+			}
+		}
+		CHECK_EQUAL(wrong, 0);
+		CHECK(std::abs(image.count() - M_PI * (45 * 45 - 35 * 35)) < 60);
+	}
+
+	// Caps, which are the same whichever way arcs go.
+	{
+		Image butt, round, projecting, reverse;
+		butt.rasterizer().wide_arc(50, 30, 80, 80, 0, 180 * 64, 10, CapButt);
+		round.rasterizer().wide_arc(50, 30, 80, 80, 0, 180 * 64, 10, CapRound);
+		projecting.rasterizer().wide_arc(50, 30, 80, 80, 0, 180 * 64, 10, CapProjecting);
+		reverse.rasterizer().wide_arc(50, 30, 80, 80, 180 * 64, -180 * 64, 10, CapProjecting);
+		CHECK(butt.count() < round.count() && round.count() < projecting.count());
+		CHECK(!butt.at(130, 74) && round.at(130, 73) && projecting.at(130, 74));
+		CHECK(!butt.at(90, 72));
+		CHECK_EQUAL(differences(projecting, reverse), 0);
+	}
+
+	// Flat ellipses are wide lines.
+	{
+		Image image;
+		image.rasterizer().wide_arc(10, 50, 100, 0, 0, 360 * 64, 4, CapButt);
+		CHECK(image.count() > 300);
+	}
+}
+
+static void
+test_dashes()
+{
+	const unsigned char dashes[] = {4};
+	{
+		Image image;
+		Rasterizer rasterizer = image.rasterizer();
+		rasterizer.set_dashes(dashes, 1, 0);
+		rasterizer.line(0, 5, 15, 5, true);
+		CHECK_EQUAL(image.count(), 8);
+		CHECK(image.at(0, 5) && !image.at(4, 5) && image.at(8, 5));
+	}
+	{
+		Image image;
+		Rasterizer rasterizer = image.rasterizer();
+		rasterizer.set_dashes(dashes, 1, 2);
+		rasterizer.line(0, 5, 15, 5, true);
+		CHECK(image.at(0, 5) && image.at(1, 5) && !image.at(2, 5));
+	}
+
+	// Dashes continue from one line to the next, until restarted.
+	{
+		Image image;
+		Rasterizer rasterizer = image.rasterizer();
+		rasterizer.set_dashes(dashes, 1, 0);
+		rasterizer.line(0, 5, 2, 5, true);
+		rasterizer.line(3, 5, 6, 5, true);
+		CHECK(image.at(3, 5) && !image.at(4, 5));
+		rasterizer.restart_dashes();
+		rasterizer.line(0, 7, 6, 7, true);
+		CHECK(image.at(0, 7) && image.at(3, 7) && !image.at(4, 7));
+	}
+}
+
+static void
+test_origin()
+{
+	// Masks with an origin get what masks of the whole drawable would there.
+	const int32_t width = 60, height = 50;
+	srand(4);
+	for (int test = 0; test < 50; test++) {
+		const int32_t originX = rand() % 100 - 20, originY = rand() % 80 - 20;
+		Image whole;
+		Rasterizer wholeRasterizer = whole.rasterizer();
+		std::vector<uint8_t> part(width * height);
+		Rasterizer partRasterizer(part.data(), width, width, height);
+		partRasterizer.set_origin(originX, originY);
+
+		const int32_t x = rand() % 150, y = rand() % 100, w = rand() % 80, h = rand() % 80;
+		for (Rasterizer* rasterizer : {&wholeRasterizer, &partRasterizer}) {
+			rasterizer->fill_arc(x, y, w, h, 30 * 64, 200 * 64, true);
+			rasterizer->arc(x + 3, y, w, h, 0, 300 * 64);
+			rasterizer->wide_arc(x, y + 5, w, h, 10 * 64, 100 * 64, 7, CapRound);
+			const Rasterizer::Point points[] = {{x, y}, {x + w, y + 7}, {x + 3, y + h}};
+			rasterizer->fill_polygon(points, 3, false);
+			rasterizer->wide_lines(points, 3, 5, CapRound, JoinMiter);
+			rasterizer->fill_rect(x, y, w / 2, h / 3);
+			rasterizer->line(x, y, x + w, y + h, true);
+		}
+
+		int32_t wrong = 0;
+		for (int32_t row = 0; row < height; row++) {
+			for (int32_t column = 0; column < width; column++) {
+				const int32_t wholeX = column + originX, wholeY = row + originY;
+				if (wholeX < 0 || wholeX >= kWidth || wholeY < 0 || wholeY >= kHeight)
+					continue;
+				wrong += whole.at(wholeX, wholeY) != (part[row * width + column] != 0);
+			}
+		}
+		CHECK_EQUAL(wrong, 0);
+	}
+}
+
+static void
+test_bounds()
+{
+	// Huge coordinates are clipped, not overflowed.
+	{
+		Image image;
+		Rasterizer rasterizer = image.rasterizer();
+		rasterizer.line(-1000, -1000, 3000, 2000, true);
+		rasterizer.fill_arc(-500, -500, 3000, 3000, 0, 90 * 64, false);
+		rasterizer.arc(-30000, -30000, 60000, 60000, 0, 360 * 64);
+		rasterizer.wide_arc(-30000, -30000, 60000, 60000, 0, 360 * 64, 30, CapRound);
+		rasterizer.fill_arc(-30000, -30000, 60000, 60000, 10, 90 * 64, true);
+		const Rasterizer::Point points[] = {{-32768, -32768}, {32767, 0}, {0, 32767}};
+		rasterizer.fill_polygon(points, 3, true);
+		rasterizer.wide_lines(points, 3, 50, CapRound, JoinRound);
+	}
+
+	// What was drawn is tracked.
+	{
+		Image image;
+		Rasterizer rasterizer = image.rasterizer();
+		CHECK(rasterizer.drawn().left > rasterizer.drawn().right);
+		rasterizer.point(5, 6);
+		rasterizer.point(50, 60);
+		CHECK(rasterizer.drawn().left == 5 && rasterizer.drawn().top == 6
+			&& rasterizer.drawn().right == 50 && rasterizer.drawn().bottom == 60);
+	}
+}
+
+int
+main()
+{
+	test_golden();
+	test_polygons();
+	test_lines();
+	test_wide_lines();
+	test_arcs();
+	test_wide_arcs();
+	test_dashes();
+	test_origin();
+	test_bounds();
+	return test_result("Rasterizer");
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+/* Checks and timing for the unit tests and benchmarks. Tests are plain programs
+ * which return non-zero if any check failed. */
+
+static int sFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			sFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+	do { \
+		const long long _actual = (long long)(actual), _expected = (long long)(expected); \
+		if (_actual != _expected) { \
+			fprintf(stderr, "%s:%d: check failed: %s is %lld, not %lld\n", __FILE__, __LINE__, \
+				#actual, _actual, _expected); \
+			sFailures++; \
+		} \
+	} while (0)
+
+static inline int
+test_result(const char* name)
+{
+	if (sFailures != 0)
+		printf("%s: %d checks failed\n", name, sFailures);
+	else
+		printf("%s: passed\n", name);
+	return sFailures != 0;
+}
+
+/* Runs "function" (taking the iteration number) the given number of times, and
+ * prints how long each iteration took on average. */
+template<typename Function>
+static void
+benchmark(const char* name, int iterations, Function function)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		function(i);
+	const std::chrono::duration<double, std::micro> elapsed
+		= std::chrono::steady_clock::now() - start;
+	printf("%-48s %12.3f us\n", name, elapsed.count() / iterations);
+}
+
+/* Keeps the compiler from optimizing away what a benchmark computes. */
+template<typename Type>
+static inline void
+keep(const Type& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "UTF8.h"
+
+#include <cstring>
+#include <vector>
+
+#include "Test.h"
+
+/* Converting strings of the length applications draw at once. */
+
+static const int kCount = 1000000;
+
+int
+main()
+{
+	const char* ascii = "The quick brown fox jumps over the lazy dog.";
+	const size_t length = strlen(ascii);
+	std::vector<uint8_t> latin1(ascii, ascii + length);
+	for (size_t i = 0; i < length; i += 7)
+		latin1[i] = 0xe0 + i % 0x20;
+
+	std::vector<XChar2b> asciiChars(length), cjkChars(length);
+	for (size_t i = 0; i < length; i++) {
+		asciiChars[i] = {0, uint8_t(ascii[i])};
+		cjkChars[i] = {uint8_t(0x4e + i % 0x50), uint8_t(i)};
+	}
+
+	std::vector<char> out(length * 3);
+	size_t total = 0;
+	benchmark("ASCII length", kCount, [&](int) {
+		total += UTF8::ascii_length((const uint8_t*)ascii, length);
+	});
+	benchmark("ASCII as Latin-1", kCount, [&](int) {
+		total += UTF8::from_latin1((const uint8_t*)ascii, length, out.data()) - out.data();
+	});
+	benchmark("Latin-1", kCount, [&](int) {
+		total += UTF8::from_latin1(latin1.data(), length, out.data()) - out.data();
+	});
+	benchmark("ASCII as XChar2b", kCount, [&](int) {
+		total += UTF8::from_ucs2(asciiChars.data(), length, out.data()) - out.data();
+	});
+	benchmark("CJK as XChar2b", kCount, [&](int) {
+		total += UTF8::from_ucs2(cjkChars.data(), length, out.data()) - out.data();
+	});
+	keep(total);
+	keep(out);
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "UTF8.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Test.h"
+
+static void
+append_utf8(std::string& out, uint32_t c)
+{
+	if (c >= 0xd800 && c <= 0xdfff)
+		c = 0xfffd;
+	if (c < 0x80) {
+		out += char(c);
+	} else if (c < 0x800) {
+		out += char(0xc0 | (c >> 6));
+		out += char(0x80 | (c & 0x3f));
+	} else {
+		out += char(0xe0 | (c >> 12));
+		out += char(0x80 | ((c >> 6) & 0x3f));
+		out += char(0x80 | (c & 0x3f));
+	}
+}
+
+/* Mostly ASCII, as text usually is, with runs of other characters up to "max". */
+static uint32_t
+random_character(uint32_t max)
+{
+	if (rand() % 4 != 0)
+		return 0x20 + rand() % 0x5f;
+	return rand() % (max + 1);
+}
+
+static std::string
+latin1(const std::vector<uint8_t>& str)
+{
+	std::string result(str.size() * 2, '\0');
+	char* end = UTF8::from_latin1(str.data(), str.size(), &result[0]);
+	result.resize(end - result.data());
+	return result;
+}
+
+static std::string
+ucs2(const std::vector<XChar2b>& str)
+{
+	std::string result(str.size() * 3, '\0');
+	char* end = UTF8::from_ucs2(str.data(), str.size(), &result[0]);
+	result.resize(end - result.data());
+	return result;
+}
+
+// #pragma mark - tests
+
+static void
+test_ascii_length()
+{
+	std::vector<uint8_t> str(100, 'a');
+	CHECK_EQUAL(UTF8::ascii_length(str.data(), str.size()), 100);
+	CHECK_EQUAL(UTF8::ascii_length(str.data(), 0), 0);
+
+	// Every position, and every length around it, through each of the chunk sizes.
+	int failures = 0;
+	for (size_t position = 0; position < str.size(); position++) {
+		str[position] = 0x80 | position;
+		for (size_t length = 0; length <= str.size(); length++) {
+			const size_t expected = (position < length) ? position : length;
+			if (UTF8::ascii_length(str.data(), length) != expected)
+				failures++;
+		}
+		str[position] = 'a';
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+static void
+test_latin1()
+{
+	const std::vector<uint8_t> text = {'c', 'a', 'f', 0xe9, ' ', 0xa0, 0xff, '!'};
+	CHECK(latin1(text) == "caf\xc3\xa9 \xc2\xa0\xc3\xbf!");
+
+	srand(1);
+	int failures = 0;
+	for (int test = 0; test < 2000; test++) {
+		std::vector<uint8_t> str(rand() % 80);
+		std::string expected;
+		for (uint8_t& c : str) {
+			c = random_character(0xff);
+			append_utf8(expected, c);
+		}
+		if (latin1(str) != expected)
+			failures++;
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+static void
+test_ucs2()
+{
+	// The high byte comes first.
+	const std::vector<XChar2b> text = {{0, 'A'}, {0, 0xe9}, {0x04, 0x36}, {0x20, 0xac},
+		{0xd8, 0x3d}, {0xff, 0xfd}, {0, 0}};
+	CHECK(ucs2(text) == std::string("A\xc3\xa9\xd0\xb6\xe2\x82\xac\xef\xbf\xbd\xef\xbf\xbd", 14)
+		+ std::string(1, '\0'));
+
+	// Characters with a low byte which is ASCII are not.
+	const std::vector<XChar2b> lookalikes(16, {0x01, 'a'});
+	std::string expected;
+	for (int i = 0; i < 16; i++)
+		append_utf8(expected, 0x161);
+	CHECK(ucs2(lookalikes) == expected);
+
+	srand(2);
+	int failures = 0;
+	for (int test = 0; test < 2000; test++) {
+		std::vector<XChar2b> str(rand() % 80);
+		expected.clear();
+		const uint32_t max = (test % 2) ? 0xffff : 0x7ff;
+		for (XChar2b& c : str) {
+			const uint32_t character = random_character(max);
+			c.byte1 = character >> 8;
+			c.byte2 = character & 0xff;
+			append_utf8(expected, character);
+		}
+		if (ucs2(str) != expected)
+			failures++;
+	}
+	CHECK_EQUAL(failures, 0);
+}
+
+int
+main()
+{
+	test_ascii_length();
+	test_latin1();
+	test_ucs2();
+	return test_result("UTF8");
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "XSettings.h"
+
+#include "Test.h"
+
+/* What is done each time the system fonts change, with the settings Xlibe has. */
+
+static const int kCount = 100000;
+
+static std::vector<XSetting>
+settings(int i)
+{
+	std::vector<XSetting> settings;
+	settings.emplace_back("Net/IconThemeName", "haiku");
+	settings.emplace_back("Gtk/FontName", (i % 2) ? "Noto Sans" : "DejaVu Sans");
+	settings.emplace_back("Xft/DPI", 96 * 1024);
+	settings.emplace_back("Gdk/WindowScalingFactor", 2);
+	settings.emplace_back("Gdk/UnscaledDPI", 96 * 1024);
+	return settings;
+}
+
+int
+main()
+{
+	XSettings store;
+	size_t total = 0;
+	benchmark("unchanged settings", kCount, [&](int) {
+		total += store.update(settings(0));
+	});
+	benchmark("changed settings", kCount, [&](int i) {
+		total += store.update(settings(i));
+	});
+	std::vector<uint8_t> data;
+	const std::vector<XSetting> current = settings(0);
+	benchmark("encoding", kCount, [&](int i) {
+		XSettings::encode(i, current, data);
+	});
+	keep(total);
+	keep(data);
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "XSettings.h"
+
+#include <cstring>
+
+#include "Test.h"
+
+static uint32_t
+card32(const std::vector<uint8_t>& data, size_t offset)
+{
+	return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16)
+		| (uint32_t(data[offset + 3]) << 24);
+}
+
+static uint16_t
+card16(const std::vector<uint8_t>& data, size_t offset)
+{
+	return data[offset] | (data[offset + 1] << 8);
+}
+
+/* Parses the encoded settings back, following the specification; returns the
+ * number of settings, or -1 if the data is malformed. */
+static int
+decode(const std::vector<uint8_t>& data, std::vector<XSetting>& settings)
+{
+	if (data.size() < 12 || data[0] != 0 /* LSBFirst */)
+		return -1;
+	const uint32_t count = card32(data, 8);
+
+	size_t offset = 12;
+	for (uint32_t i = 0; i < count; i++) {
+		if (offset + 4 > data.size())
+			return -1;
+		const uint8_t type = data[offset];
+		const uint16_t nameLength = card16(data, offset + 2);
+		offset += 4;
+		const size_t paddedName = (nameLength + 3) & ~3;
+		if (offset + paddedName + 4 > data.size())
+			return -1;
+		const std::string name((const char*)&data[offset], nameLength);
+		offset += paddedName;
+		const uint32_t serial = card32(data, offset);
+		offset += 4;
+
+		if (type == XSetting::XSettingsTypeInteger) {
+			if (offset + 4 > data.size())
+				return -1;
+			settings.emplace_back(name, int32_t(card32(data, offset)));
+			offset += 4;
+		} else if (type == XSetting::XSettingsTypeString) {
+			if (offset + 4 > data.size())
+				return -1;
+			const uint32_t length = card32(data, offset);
+			offset += 4;
+			const size_t padded = (length + 3) & ~3;
+			if (offset + padded > data.size())
+				return -1;
+			settings.emplace_back(name, std::string((const char*)&data[offset], length));
+			offset += padded;
+		} else if (type == XSetting::XSettingsTypeColor) {
+			if (offset + 8 > data.size())
+				return -1;
+			settings.emplace_back(name, card16(data, offset), card16(data, offset + 2),
+				card16(data, offset + 4), card16(data, offset + 6));
+			offset += 8;
+		} else {
+			return -1;
+		}
+		settings.back().last_change_serial = serial;
+	}
+	if (offset != data.size())
+		return -1;
+	return count;
+}
+
+// #pragma mark - tests
+
+static void
+test_encoding()
+{
+	// As laid out by hand from the specification.
+	std::vector<XSetting> settings;
+	settings.emplace_back("Xft/DPI", 98304);
+	settings.emplace_back("Net/ThemeName", "Haiku");
+	settings.back().last_change_serial = 3;
+	const uint8_t expected[] = {
+		0, 0, 0, 0,  7, 0, 0, 0,  2, 0, 0, 0,
+		0, 0, 7, 0,  'X', 'f', 't', '/', 'D', 'P', 'I', 0,  0, 0, 0, 0,
+			0x00, 0x80, 0x01, 0x00,
+		1, 0, 13, 0,  'N', 'e', 't', '/', 'T', 'h', 'e', 'm', 'e', 'N', 'a', 'm', 'e', 0, 0, 0,
+			3, 0, 0, 0,  5, 0, 0, 0,  'H', 'a', 'i', 'k', 'u', 0, 0, 0,
+	};
+	std::vector<uint8_t> data;
+	XSettings::encode(7, settings, data);
+	CHECK_EQUAL(data.size(), sizeof(expected));
+	CHECK(data.size() == sizeof(expected) && memcmp(data.data(), expected, sizeof(expected)) == 0);
+
+	// Names and strings which are already aligned, or empty, are not padded.
+	settings.clear();
+	settings.emplace_back("Gtk/", "");
+	settings.emplace_back("A", 0x12345678, 0x9abc, 0xdef0);
+	XSettings::encode(1, settings, data);
+	const uint8_t expectedColor[] = {
+		0, 0, 0, 0,  1, 0, 0, 0,  2, 0, 0, 0,
+		1, 0, 4, 0,  'G', 't', 'k', '/',  0, 0, 0, 0,  0, 0, 0, 0,
+		2, 0, 1, 0,  'A', 0, 0, 0,  0, 0, 0, 0,  0x78, 0x56, 0xbc, 0x9a, 0xf0, 0xde, 0xff, 0xff,
+	};
+	CHECK(data.size() == sizeof(expectedColor)
+		&& memcmp(data.data(), expectedColor, sizeof(expectedColor)) == 0);
+
+	std::vector<XSetting> decoded;
+	CHECK_EQUAL(decode(data, decoded), 2);
+	CHECK(decoded.size() == 2 && decoded[0].SameValue(settings[0])
+		&& decoded[1].SameValue(settings[1]));
+}
+
+static void
+test_update()
+{
+	XSettings store;
+	CHECK(store.data().empty());
+
+	std::vector<XSetting> settings;
+	settings.emplace_back("Xft/DPI", 98304);
+	settings.emplace_back("Gtk/FontName", "Noto Sans");
+	CHECK(store.update(settings));
+	CHECK_EQUAL(store.serial(), 1);
+
+	std::vector<XSetting> decoded;
+	CHECK_EQUAL(decode(store.data(), decoded), 2);
+	CHECK_EQUAL(card32(store.data(), 4), 1);
+	CHECK(decoded[0].last_change_serial == 1 && decoded[1].last_change_serial == 1);
+
+	// Nothing changed: nothing to notify about.
+	const std::vector<uint8_t> before = store.data();
+	CHECK(!store.update(settings));
+	CHECK_EQUAL(store.serial(), 1);
+	CHECK(store.data() == before);
+
+	// Only what changed gets the new serial.
+	settings[1].string = "DejaVu Sans";
+	CHECK(store.update(settings));
+	CHECK_EQUAL(store.serial(), 2);
+	decoded.clear();
+	CHECK_EQUAL(decode(store.data(), decoded), 2);
+	CHECK_EQUAL(card32(store.data(), 4), 2);
+	CHECK_EQUAL(decoded[0].last_change_serial, 1);
+	CHECK_EQUAL(decoded[1].last_change_serial, 2);
+	CHECK(decoded[1].string == "DejaVu Sans");
+
+	// A setting which goes away is a change too, if nothing else is.
+	settings.pop_back();
+	CHECK(store.update(settings));
+	CHECK_EQUAL(store.serial(), 3);
+	decoded.clear();
+	CHECK_EQUAL(decode(store.data(), decoded), 1);
+	CHECK_EQUAL(decoded[0].last_change_serial, 1);
+
+	// A value of another type is a different value.
+	settings[0] = XSetting("Xft/DPI", "98304");
+	CHECK(store.update(settings));
+	decoded.clear();
+	CHECK_EQUAL(decode(store.data(), decoded), 1);
+	CHECK_EQUAL(decoded[0].last_change_serial, 4);
+}
+
+int
+main()
+{
+	test_encoding();
+	test_update();
+	return test_result("XSettings");
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Just enough of BBitmap for BitmapPool, counting the bitmaps which exist. */
+
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+enum color_space {
+	B_NO_COLOR_SPACE = 0x0000,
+	B_GRAY8 = 0x0002,
+	B_RGB32 = 0x0008,
+};
+
+class BRect {
+public:
+	float left, top, right, bottom;
+
+	BRect() : left(0), top(0), right(-1), bottom(-1) {}
+	BRect(float l, float t, float r, float b) : left(l), top(t), right(r), bottom(b) {}
+
+	int32 IntegerWidth() const { return int32(right - left); }
+	int32 IntegerHeight() const { return int32(bottom - top); }
+};
+
+class BBitmap {
+public:
+	static inline int sCount = 0;
+
+	BBitmap(BRect bounds, uint32 /*flags*/, color_space colorSpace)
+		: _bounds(bounds), _color_space(colorSpace) { sCount++; }
+	~BBitmap() { sCount--; }
+
+	BRect Bounds() const { return _bounds; }
+	color_space ColorSpace() const { return _color_space; }
+	int32 BytesPerRow() const
+		{ return (_bounds.IntegerWidth() + 1) * (_color_space == B_GRAY8 ? 1 : 4); }
+	int32 BitsLength() const { return BytesPerRow() * (_bounds.IntegerHeight() + 1); }
+
+private:
+	BRect _bounds;
+	color_space _color_space;
+};
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+
+#include <pthread.h>
+#include <map>
+
+#include "Drawables.h"
+#include "Drawing.h"
+#include "Extension.h"
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#include <X11/extensions/Xdbe.h>
+}
+
+/* Back buffers are ordinary pixmaps (and so get their bitmaps from the pixmap pool),
+ * which the back buffer names refer to directly; so everything that can draw into
+ * a pixmap can draw into a back buffer. Swapping copies the back buffer into the
+ * window in a single blit. */
+struct BackBuffer {
+	Window window;
+	Pixmap pixmap;
+	Pixmap untouched = None;
+		// Receives the front buffer, for XdbeUntouched.
+	GC gc;
+	int references = 0;
+};
+
+static pthread_mutex_t sBackBuffersLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<Window, BackBuffer> sBackBuffers;
+
+static BackBuffer*
+find_back_buffer(XdbeBackBuffer buffer)
+{
+	for (auto& it : sBackBuffers) {
+		if (it.second.pixmap == buffer)
+			return &it.second;
+	}
+	return NULL;
+}
+
+static void
+free_back_buffer(Display* dpy, BackBuffer& buffer)
+{
+	XFreePixmap(dpy, buffer.pixmap);
+	if (buffer.untouched != None)
+		XFreePixmap(dpy, buffer.untouched);
+	XFreeGC(dpy, buffer.gc);
+}
+
+static void
+window_destroyed(Display* dpy, Window w)
+{
+	pthread_mutex_lock(&sBackBuffersLock);
+	const auto it = sBackBuffers.find(w);
+	if (it != sBackBuffers.end()) {
+		free_back_buffer(dpy, it->second);
+		sBackBuffers.erase(it);
+	}
+	pthread_mutex_unlock(&sBackBuffersLock);
+}
+
+static void
+add_destroy_window_hook()
+{
+	_x_add_destroy_window_hook(window_destroyed);
+}
+
+static void
+fill_with_background(XWindow* window, XPixmap* pixmap)
+{
+	window->view()->LockLooper();
+	const rgb_color background = window->view()->ViewColor();
+	window->view()->UnlockLooper();
+	if (background == B_TRANSPARENT_COLOR)
+		return;
+
+	BView* view = pixmap->view();
+	view->LockLooper();
+	pixmap->mark_dirty();
+	_x_reset_gc_clipping(pixmap);
+	view->PushState();
+	view->SetHighColor(background);
+	view->SetDrawingMode(B_OP_COPY);
+	view->FillRect(view->Bounds());
+	view->PopState();
+	view->UnlockLooper();
+}
+
+static bool
+swap_buffers(Display* dpy, const XdbeSwapInfo& info)
+{
+	XWindow* window = Drawables::get_window(info.swap_window);
+	const auto& it = sBackBuffers.find(info.swap_window);
+	if (window == NULL || it == sBackBuffers.end())
+		return false;
+	BackBuffer& buffer = it->second;
+
+	XPixmap* pixmap = Drawables::get_pixmap(buffer.pixmap);
+	if (pixmap->size() != window->size()) {
+		// Back buffers follow the size of their window.
+		static_cast<XDrawable*>(pixmap)->resize(window->size());
+	}
+	const XRectangle rect = xrect_from_brect(BRect(B_ORIGIN, window->size()));
+
+	if (info.swap_action == XdbeUntouched) {
+		// Save the current front buffer, so that it can become the back buffer.
+		if (buffer.untouched == None) {
+			buffer.untouched = XCreatePixmap(dpy, buffer.window,
+				rect.width, rect.height, window->depth());
+		}
+		XPixmap* untouched = Drawables::get_pixmap(buffer.untouched);
+		if (untouched->size() != window->size())
+			static_cast<XDrawable*>(untouched)->resize(window->size());
+		XCopyArea(dpy, buffer.window, buffer.untouched, buffer.gc,
+			0, 0, rect.width, rect.height, 0, 0);
+	}
+
+	XCopyArea(dpy, buffer.pixmap, buffer.window, buffer.gc,
+		0, 0, rect.width, rect.height, 0, 0);
+
+	switch (info.swap_action) {
+	case XdbeBackground:
+		fill_with_background(window, pixmap);
+		break;
+
+	case XdbeUntouched:
+		pixmap->swap_offscreen(Drawables::get_pixmap(buffer.untouched));
+		break;
+
+	case XdbeUndefined:
+	case XdbeCopied:
+	default:
+		// The back buffer already has the right contents.
+		break;
+	}
+	return true;
+}
+
+extern "C" Status
+XdbeQueryExtension(Display* dpy, int* major_version_return, int* minor_version_return)
+{
+	*major_version_return = DBE_MAJOR_VERSION;
+	*minor_version_return = DBE_MINOR_VERSION;
+	return True;
+}
+
+extern "C" XdbeBackBuffer
+XdbeAllocateBackBufferName(Display* dpy, Window w, XdbeSwapAction swap_action)
+{
+	XWindow* window = Drawables::get_window(w);
+	if (!window)
+		return None;
+
+	// Back buffers go away with their windows.
+	static pthread_once_t sHookOnce = PTHREAD_ONCE_INIT;
+	pthread_once(&sHookOnce, add_destroy_window_hook);
+
+	pthread_mutex_lock(&sBackBuffersLock);
+	BackBuffer& buffer = sBackBuffers[w];
+	if (buffer.references == 0) {
+		const XRectangle rect = xrect_from_brect(BRect(B_ORIGIN, window->size()));
+		buffer.window = w;
+		buffer.pixmap = XCreatePixmap(dpy, w, rect.width, rect.height, window->depth());
+
+		XGCValues values;
+		values.graphics_exposures = False;
+		buffer.gc = XCreateGC(dpy, w, GCGraphicsExposures, &values);
+	}
+
+	// All names for the back buffer of a window refer to the same buffer.
+	buffer.references++;
+	const XdbeBackBuffer name = buffer.pixmap;
+	pthread_mutex_unlock(&sBackBuffersLock);
+	return name;
+}
+
+extern "C" Status
+XdbeDeallocateBackBufferName(Display* dpy, XdbeBackBuffer name)
+{
+	pthread_mutex_lock(&sBackBuffersLock);
+	BackBuffer* buffer = find_back_buffer(name);
+	if (buffer == NULL) {
+		pthread_mutex_unlock(&sBackBuffersLock);
+		return False;
+	}
+
+	if (--buffer->references == 0) {
+		free_back_buffer(dpy, *buffer);
+		sBackBuffers.erase(buffer->window);
+	}
+	pthread_mutex_unlock(&sBackBuffersLock);
+	return True;
+}
+
+extern "C" Status
+XdbeSwapBuffers(Display* dpy, XdbeSwapInfo* swap_info, int num_windows)
+{
+	Status status = True;
+	pthread_mutex_lock(&sBackBuffersLock);
+	for (int i = 0; i < num_windows; i++) {
+		if (!swap_buffers(dpy, swap_info[i]))
+			status = False;
+	}
+	pthread_mutex_unlock(&sBackBuffersLock);
+	return status;
+}
+
+extern "C" Status
+XdbeBeginIdiom(Display* dpy)
+{
+	return True;
+}
+
+extern "C" Status
+XdbeEndIdiom(Display* dpy)
+{
+	return True;
+}
+
+extern "C" XdbeScreenVisualInfo*
+XdbeGetVisualInfo(Display* dpy, Drawable* screen_specifiers, int* num_screens)
+{
+	// There is only one screen, and every visual can be double-buffered.
+	if (*num_screens == 0)
+		*num_screens = 1;
+
+	const Screen& screen = dpy->screens[0];
+	int count = 0;
+	for (int d = 0; d < screen.ndepths; d++)
+		count += screen.depths[d].nvisuals;
+
+	// The lists for all screens share one allocation, which is freed with the first.
+	XdbeScreenVisualInfo* info = (XdbeScreenVisualInfo*)calloc(*num_screens,
+		sizeof(XdbeScreenVisualInfo));
+	XdbeVisualInfo* visuals = (XdbeVisualInfo*)calloc(count * *num_screens,
+		sizeof(XdbeVisualInfo));
+	for (int i = 0; i < *num_screens; i++) {
+		info[i].visinfo = visuals + i * count;
+		for (int d = 0; d < screen.ndepths; d++) {
+			for (int v = 0; v < screen.depths[d].nvisuals; v++) {
+				XdbeVisualInfo& visual = info[i].visinfo[info[i].count++];
+				visual.visual = screen.depths[d].visuals[v].visualid;
+				visual.depth = screen.depths[d].depth;
+				visual.perflevel = 0;
+			}
+		}
+	}
+	return info;
+}
+
+extern "C" void
+XdbeFreeVisualInfo(XdbeScreenVisualInfo* visual_info)
+{
+	if (visual_info == NULL)
+		return;
+
+	free(visual_info[0].visinfo);
+	free(visual_info);
+}
+
+extern "C" XdbeBackBufferAttributes*
+XdbeGetBackBufferAttributes(Display* dpy, XdbeBackBuffer name)
+{
+	XdbeBackBufferAttributes* attributes
+		= (XdbeBackBufferAttributes*)malloc(sizeof(XdbeBackBufferAttributes));
+	attributes->window = None;
+
+	pthread_mutex_lock(&sBackBuffersLock);
+	BackBuffer* buffer = find_back_buffer(name);
+	if (buffer != NULL && Drawables::get_window(buffer->window) != NULL)
+		attributes->window = buffer->window;
+	pthread_mutex_unlock(&sBackBuffersLock);
+	return attributes;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "BitmapPool.h"
+
+#include <pthread.h>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <tuple>
+
+namespace BeXlib {
+
+static const size_t kDefaultLimit = 32 * 1024 * 1024;
+static const size_t kDefaultCountLimit = 64;
+
+typedef std::tuple<int32, int32, color_space> PoolKey;
+
+struct PoolEntry {
+	PoolKey key;
+	BBitmap* bitmap;
+	size_t size;
+};
+
+static pthread_mutex_t sPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static std::list<PoolEntry> sPool;
+	// Most recently released first.
+static std::multimap<PoolKey, std::list<PoolEntry>::iterator> sPoolIndex;
+static size_t sPoolBytes = 0;
+static size_t sPoolLimit = size_t(-1);
+static size_t sPoolCountLimit = kDefaultCountLimit;
+static BitmapPool::Statistics sPoolStatistics = {};
+
+static inline PoolKey
+pool_key(BRect bounds, color_space colorSpace)
+{
+	return PoolKey(bounds.IntegerWidth(), bounds.IntegerHeight(), colorSpace);
+}
+
+static size_t
+pool_limit()
+{
+	if (sPoolLimit == size_t(-1)) {
+		sPoolLimit = kDefaultLimit;
+		const char* limit = getenv("XLIBE_PIXMAP_POOL_SIZE");
+		if (limit != NULL)
+			sPoolLimit = size_t(strtoul(limit, NULL, 10)) * 1024 * 1024;
+	}
+	return sPoolLimit;
+}
+
+/* Must be called with the pool locked. The evicted bitmaps must be deleted after unlocking. */
+static void
+trim_pool(size_t limit, size_t countLimit, std::list<BBitmap*>& evicted)
+{
+	while ((sPoolBytes > limit || sPool.size() > countLimit) && !sPool.empty()) {
+		auto entry = std::prev(sPool.end());
+		auto range = sPoolIndex.equal_range(entry->key);
+		for (auto it = range.first; it != range.second; it++) {
+			if (it->second == entry) {
+				sPoolIndex.erase(it);
+				break;
+			}
+		}
+
+		sPoolBytes -= entry->size;
+		sPoolStatistics.evictions++;
+		evicted.push_back(entry->bitmap);
+		sPool.erase(entry);
+	}
+}
+
+static void
+delete_bitmaps(std::list<BBitmap*>& bitmaps)
+{
+	// Deleting an offscreen window needs the app_server, so don't hold the lock.
+	for (BBitmap* bitmap : bitmaps)
+		delete bitmap;
+}
+
+BBitmap*
+BitmapPool::acquire(BRect bounds, color_space colorSpace)
+{
+	pthread_mutex_lock(&sPoolLock);
+	auto it = sPoolIndex.find(pool_key(bounds, colorSpace));
+	if (it == sPoolIndex.end()) {
+		sPoolStatistics.misses++;
+		pthread_mutex_unlock(&sPoolLock);
+		return NULL;
+	}
+
+	auto entry = it->second;
+	BBitmap* bitmap = entry->bitmap;
+	sPoolBytes -= entry->size;
+	sPoolStatistics.hits++;
+	sPoolIndex.erase(it);
+	sPool.erase(entry);
+	pthread_mutex_unlock(&sPoolLock);
+	return bitmap;
+}
+
+void
+BitmapPool::release(BBitmap* bitmap)
+{
+	const size_t size = bitmap->BitsLength();
+	std::list<BBitmap*> evicted;
+
+	pthread_mutex_lock(&sPoolLock);
+	const size_t limit = pool_limit();
+	if (size > limit / 4) {
+		// Don't let one huge bitmap push out everything else.
+		pthread_mutex_unlock(&sPoolLock);
+		delete bitmap;
+		return;
+	}
+
+	const PoolKey key = pool_key(bitmap->Bounds(), bitmap->ColorSpace());
+	sPool.push_front({key, bitmap, size});
+	sPoolIndex.insert({key, sPool.begin()});
+	sPoolBytes += size;
+	trim_pool(limit, sPoolCountLimit, evicted);
+	pthread_mutex_unlock(&sPoolLock);
+
+	delete_bitmaps(evicted);
+}
+
+void
+BitmapPool::set_limits(size_t bytes, size_t bitmaps)
+{
+	std::list<BBitmap*> evicted;
+	pthread_mutex_lock(&sPoolLock);
+	sPoolLimit = bytes;
+	sPoolCountLimit = bitmaps;
+	trim_pool(bytes, bitmaps, evicted);
+	pthread_mutex_unlock(&sPoolLock);
+
+	delete_bitmaps(evicted);
+}
+
+void
+BitmapPool::clear()
+{
+	std::list<BBitmap*> evicted;
+	pthread_mutex_lock(&sPoolLock);
+	trim_pool(0, 0, evicted);
+	pthread_mutex_unlock(&sPoolLock);
+
+	delete_bitmaps(evicted);
+}
+
+BitmapPool::Statistics
+BitmapPool::statistics()
+{
+	pthread_mutex_lock(&sPoolLock);
+	Statistics statistics = sPoolStatistics;
+	statistics.bitmaps = sPool.size();
+	statistics.bytes = sPoolBytes;
+	pthread_mutex_unlock(&sPoolLock);
+	return statistics;
+}
+
+} // namespace BeXlib
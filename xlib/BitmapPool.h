@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <interface/Bitmap.h>
+
+namespace BeXlib {
+
+/* Offscreen bitmaps (which accept views) of freed pixmaps, kept for reuse.
+ *
+ * Creating one of these requires a round-trip to the app_server and a new
+ * offscreen window, and toolkits commonly create and free pixmaps of the
+ * same size every frame for double-buffering. Bitmaps are bucketed by size
+ * and color space, and the least recently freed are deleted once the pool
+ * grows past its limit (set with XLIBE_PIXMAP_POOL_SIZE, in megabytes), or
+ * holds too many bitmaps: each is an offscreen window, however small. */
+class BitmapPool {
+public:
+	struct Statistics {
+		uint64 hits;
+		uint64 misses;
+		uint64 evictions;
+		size_t bitmaps;
+		size_t bytes;
+	};
+
+public:
+	/* Returns a pooled bitmap, or NULL. Its contents are undefined. */
+	static BBitmap* acquire(BRect bounds, color_space colorSpace);
+
+	/* Takes ownership of the bitmap, which must not have any child views. */
+	static void release(BBitmap* bitmap);
+
+	static void set_limits(size_t bytes, size_t bitmaps);
+	static void clear();
+
+	static Statistics statistics();
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
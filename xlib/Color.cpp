@@ -5,20 +5,21 @@
  */
 #include "Color.h"
 
-#include <ctype.h>
-#include <cstdio>
 #include <cstring>
+#include <map>
 #include <interface/InterfaceDefs.h>
 
+#include "ColorSpec.h"
+#include "Drawables.h"
+#include "Locking.h"
+
 extern "C" {
 #include <X11/Xlib.h>
 #include <X11/Xlibint.h>
 #include <X11/Xutil.h>
-
-#include "tables/ColorTable.h"
 }
 
-static XID sDummy;
+static XID sDummy, sDummy16;
 
 color_space
 _x_color_space_for(Visual* v, int bits_per_pixel)
@@ -33,12 +34,56 @@ _x_color_space_for(Visual* v, int bits_per_pixel)
 	case 16: return B_RGB16;
 	case 24: return B_RGB24;
 	case 32: return B_RGBA32;
-	default:
-		debugger("Unsupported color space!");
-		return B_RGB24;
+	default: return B_NO_COLOR_SPACE;
+	}
+}
+
+color_space
+_x_color_space_for_depth(int depth)
+{
+	// These are what pixmaps of each depth are stored as. Depth 24 uses
+	// 32 bits per pixel (as with most real X servers), which is also what
+	// the app_server draws into natively. Other depths are not supported.
+	switch (depth) {
+	case 1:  return B_GRAY1;
+	case 8:  return B_GRAY8;
+	case 15: return B_RGB15;
+	case 16: return B_RGB16;
+	case 24: return B_RGB32;
+	case 32: return B_RGBA32;
+	default: return B_NO_COLOR_SPACE;
 	}
 }
 
+int
+_x_bits_per_pixel_for_depth(int depth)
+{
+	if (depth == 1)
+		return 1;
+	if (depth <= 8)
+		return 8;
+	if (depth <= 16)
+		return 16;
+	return 32;
+}
+
+int
+_x_depth_for_visual(Display* display, Visual* visual)
+{
+	const Screen& screen = display->screens[0];
+	if (!visual)
+		return screen.root_depth;
+
+	for (int i = 0; i < screen.ndepths; i++) {
+		for (int j = 0; j < screen.depths[i].nvisuals; j++) {
+			if (&screen.depths[i].visuals[j] == visual
+					|| screen.depths[i].visuals[j].visualid == visual->visualid)
+				return screen.depths[i].depth;
+		}
+	}
+	return screen.root_depth;
+}
+
 int
 _x_depth_for_color_space(color_space space)
 {
@@ -56,70 +101,11 @@ _x_depth_for_color_space(color_space space)
 	}
 }
 
-static int
-FindColor(const char *name, XColor *def)
-{
-	static int numXColors = 0;
-	if (numXColors == 0) {
-		XColorEntry *ePtr;
-		for (ePtr = xColors; ePtr->name != NULL; ePtr++) {
-			numXColors++;
-		}
-	}
-
-	int l, u, r, i;
-	l = 0;
-	u = numXColors - 1;
-	while (l <= u) {
-		i = (l + u) / 2;
-		r = strcasecmp(name, xColors[i].name);
-		if (r == 0) {
-			break;
-		} else if (r < 0) {
-			u = i-1;
-		} else {
-			l = i+1;
-		}
-	}
-	if (l > u) {
-		return 0;
-	}
-	def->red   = xColors[i].red << 8;
-	def->green = xColors[i].green << 8;
-	def->blue  = xColors[i].blue << 8;
-	return 1;
-}
-
 extern "C" int
 XParseColor(Display *dpy, Colormap cmap, const char *spec, XColor *def)
 {
-	if (spec[0] == '#') {
-		int i;
-		if (((i = strlen(spec + 1)) % 3) != 0)
-			return 0;
-		i /= 3;
-
-		char fmt[16];
-		int red, green, blue;
-		sprintf(fmt, "%%%dx%%%dx%%%dx", i, i, i);
-		if (sscanf(spec + 1, fmt, &red, &green, &blue) != 3)
-			return 0;
-
-		def->red = red << 8;
-		def->green = green << 8;
-		def->blue = blue << 8;
-	} else if (strncmp(spec, "rgb:", 4) == 0) {
-		int red, green, blue;
-		if (sscanf(spec + 4, "%2x/%2x/%2x", &red, &green, &blue) != 3)
-			return 0;
-
-		def->red = red << 8;
-		def->green = green << 8;
-		def->blue = blue << 8;
-	} else {
-		if (!FindColor(spec, def))
-			return 0;
-	}
+	if (!ColorSpec::parse(spec, def))
+		return 0;
 	def->pixel = _x_rgb_to_pixel(make_color(def->red / 257, def->green / 257, def->blue / 257));
 	def->flags = DoRed | DoGreen | DoBlue;
 	def->pad = 0;
@@ -133,7 +119,7 @@ XLookupColor(Display *dpy, Colormap cmap,
 {
 	if (!XParseColor(dpy, cmap, colorname, exact_def))
 		return 0;
-	hard_def->pixel = exact_def->pixel;
+	*hard_def = *exact_def;
 	return 1;
 }
 
@@ -141,35 +127,128 @@ extern "C" int
 XAllocNamedColor(Display *dpy, Colormap cmap,
 	const char *colorname, XColor *hard_def, XColor *exact_def)
 {
-	return XLookupColor(dpy, cmap, colorname, hard_def, exact_def);
+	if (!XLookupColor(dpy, cmap, colorname, hard_def, exact_def))
+		return 0;
+	if (!XAllocColor(dpy, cmap, hard_def))
+		return 0;
+	exact_def->pixel = hard_def->pixel;
+	return 1;
 }
 
-extern "C" Status
-XQueryColors(Display *display, Colormap colormap,
-	XColor *defs_in_out, int ncolors)
+// #pragma mark - colormaps
+
+XColormap::XColormap(Visual* visual)
+	:
+	visual(visual)
 {
-	for (int i = 0; i < ncolors; i++) {
-		rgb_color color = _x_pixel_to_rgb(defs_in_out[i].pixel);
-		defs_in_out[i].red = color.red * 257;
-		defs_in_out[i].green = color.green * 257;
-		defs_in_out[i].blue = color.blue * 257;
-		defs_in_out[i].flags = DoRed | DoGreen | DoBlue;
-		defs_in_out[i].pad = 0;
+	pthread_rwlock_init(&lock, NULL);
+	memset(palette, 0, sizeof(palette));
+	memset(references, 0, sizeof(references));
+	memset(writable, 0, sizeof(writable));
+	for (int i = 0; i < kSize; i++)
+		palette[i] = _x_rgb_to_pixel(make_color(0, 0, 0));
+}
+
+XColormap::~XColormap()
+{
+	pthread_rwlock_destroy(&lock);
+}
+
+static pthread_rwlock_t sColormapsLock = PTHREAD_RWLOCK_INITIALIZER;
+static std::map<Colormap, std::shared_ptr<XColormap>> sColormaps;
+
+std::shared_ptr<XColormap>
+_x_colormap(Colormap colormap)
+{
+	if (colormap == None || colormap == (Colormap)&sDummy || colormap == (Colormap)&sDummy16)
+		return NULL;
+
+	PthreadReadLocker rdlock(sColormapsLock);
+	const auto it = sColormaps.find(colormap);
+	if (it == sColormaps.end())
+		return NULL;
+	return it->second;
+}
+
+static void
+colormap_changed(XColormap* cmap, Colormap colormap)
+{
+	uint32 palette[XColormap::kSize];
+	{
+		PthreadReadLocker rdlock(cmap->lock);
+		memcpy(palette, cmap->palette, sizeof(palette));
+	}
+
+	// Windows using this colormap need to be redrawn with the new colors.
+	// What was copied into them from indexed pixmaps and images is expanded
+	// again; the pixel values anything else was drawn with are not kept,
+	// so the rest is exposed.
+	for (const Window& w : Drawables::windows()) {
+		XWindow* window = Drawables::get_window(w);
+		if (!window || window->colormap != colormap)
+			continue;
+
+		window->view()->LockLooper();
+		window->gc_state.invalidate(GCForeground | GCBackground);
+		BRegion exposed(BRect(B_ORIGIN, window->size()));
+		BRegion expanded;
+		window->expand_indexes(palette, expanded);
+		exposed.Exclude(&expanded);
+		if (exposed.CountRects() > 0)
+			window->view()->Invalidate(&exposed);
+		window->view()->UnlockLooper();
 	}
-	return Success;
 }
 
-extern "C" Status
-XQueryColor(Display *display, Colormap colormap,
-	XColor* defs_in_out)
+static int
+find_free_cell(XColormap* cmap)
 {
-	return XQueryColors(display, colormap, defs_in_out, 1);
+	for (int i = 0; i < XColormap::kSize; i++) {
+		if (cmap->references[i] == 0)
+			return i;
+	}
+	return -1;
 }
 
 extern "C" int
 XAllocColor(Display* dpy, Colormap cmap, XColor* def)
 {
-	def->pixel = _x_rgb_to_pixel(make_color(def->red / 257, def->green / 257, def->blue / 257));
+	const rgb_color color = make_color(def->red / 257, def->green / 257, def->blue / 257);
+	const std::shared_ptr<XColormap> colormap = _x_colormap(cmap);
+	if (!colormap) {
+		const int depth = (cmap == (Colormap)&sDummy16) ? 16 : 24;
+		def->pixel = _x_rgb_to_pixel_for_depth(color, depth);
+
+		const rgb_color actual = _x_pixel_to_rgb_for_depth(def->pixel, depth);
+		def->red = actual.red * 257;
+		def->green = actual.green * 257;
+		def->blue = actual.blue * 257;
+		return 1;
+	}
+
+	// Share an existing read-only cell if there is one, else take a free one.
+	PthreadWriteLocker wrlock(colormap->lock);
+	const uint32 value = _x_rgb_to_pixel(color);
+	int cell = -1;
+	for (int i = 0; i < XColormap::kSize; i++) {
+		if (colormap->references[i] != 0 && !colormap->writable[i]
+				&& colormap->palette[i] == value) {
+			cell = i;
+			break;
+		}
+	}
+	if (cell < 0) {
+		cell = find_free_cell(colormap.get());
+		if (cell < 0)
+			return 0;
+		colormap->palette[cell] = value;
+	}
+	colormap->references[cell]++;
+
+	def->pixel = cell;
+	def->red = color.red * 257;
+	def->green = color.green * 257;
+	def->blue = color.blue * 257;
 	return 1;
 }
 
@@ -177,10 +256,61 @@ extern "C" int
 XFreeColors(Display *display, Colormap colormap,
 	unsigned long *pixels, int npixels, unsigned long planes)
 {
-	// Nothing to do.
+	const std::shared_ptr<XColormap> cmap = _x_colormap(colormap);
+	if (!cmap) {
+		// Nothing to do.
+		return Success;
+	}
+
+	PthreadWriteLocker wrlock(cmap->lock);
+	for (int i = 0; i < npixels; i++) {
+		const unsigned long cell = pixels[i] & ~planes;
+		if (cell >= XColormap::kSize || cmap->references[cell] == 0)
+			return BadAccess;
+		if (--cmap->references[cell] == 0)
+			cmap->writable[cell] = false;
+	}
 	return Success;
 }
 
+extern "C" Status
+XQueryColors(Display *display, Colormap colormap,
+	XColor *defs_in_out, int ncolors)
+{
+	const std::shared_ptr<XColormap> cmap = _x_colormap(colormap);
+	const int depth = (colormap == (Colormap)&sDummy16) ? 16 : 24;
+	if (cmap)
+		pthread_rwlock_rdlock(&cmap->lock);
+	Status status = Success;
+	for (int i = 0; i < ncolors; i++) {
+		unsigned long pixel = defs_in_out[i].pixel;
+		if (cmap) {
+			if (pixel >= XColormap::kSize) {
+				status = BadValue;
+				break;
+			}
+			pixel = cmap->palette[pixel];
+		}
+
+		rgb_color color = _x_pixel_to_rgb_for_depth(pixel, cmap ? 24 : depth);
+		defs_in_out[i].red = color.red * 257;
+		defs_in_out[i].green = color.green * 257;
+		defs_in_out[i].blue = color.blue * 257;
+		defs_in_out[i].flags = DoRed | DoGreen | DoBlue;
+		defs_in_out[i].pad = 0;
+	}
+	if (cmap)
+		pthread_rwlock_unlock(&cmap->lock);
+	return status;
+}
+
+extern "C" Status
+XQueryColor(Display *display, Colormap colormap,
+	XColor* defs_in_out)
+{
+	return XQueryColors(display, colormap, defs_in_out, 1);
+}
+
 extern "C" XStandardColormap*
 XAllocStandardColormap()
 {
@@ -191,16 +321,48 @@ extern "C" Colormap
 XCreateColormap(Display* display, Window window, Visual* visual, int allocate)
 {
 	// Return a dummy colormap for TrueColor, so things do not complain.
-	if (allocate == AllocNone && ((visual && visual->c_class == TrueColor) || !visual))
+	// (Only the pixel format differs between the TrueColor visuals.)
+	if (allocate == AllocNone && ((visual && visual->c_class == TrueColor) || !visual)) {
+		if (_x_depth_for_visual(display, visual) == 16)
+			return (Colormap)&sDummy16;
 		return (Colormap)&sDummy;
-	return None;
+	}
+	if (!visual || visual->c_class != PseudoColor)
+		return None;
+
+	std::shared_ptr<XColormap> colormap = std::make_shared<XColormap>(visual);
+	if (allocate == AllocAll) {
+		for (int i = 0; i < XColormap::kSize; i++) {
+			colormap->references[i] = 1;
+			colormap->writable[i] = true;
+		}
+	}
+
+	const Colormap id = (Colormap)colormap.get();
+	PthreadWriteLocker wrlock(sColormapsLock);
+	sColormaps.insert({id, std::move(colormap)});
+	return id;
 }
 
 extern "C" Colormap
 XCopyColormapAndFree(Display* display, Colormap colormap)
 {
-	// We don't support multiple colormaps.
-	return None;
+	const std::shared_ptr<XColormap> cmap = _x_colormap(colormap);
+	if (!cmap) {
+		// We don't support multiple TrueColor colormaps.
+		return None;
+	}
+
+	Colormap copy = XCreateColormap(display, None, cmap->visual, AllocNone);
+	const std::shared_ptr<XColormap> copyCmap = _x_colormap(copy);
+	PthreadWriteLocker wrlock(cmap->lock);
+	memcpy(copyCmap->palette, cmap->palette, sizeof(cmap->palette));
+	memcpy(copyCmap->references, cmap->references, sizeof(cmap->references));
+	memcpy(copyCmap->writable, cmap->writable, sizeof(cmap->writable));
+
+	memset(cmap->references, 0, sizeof(cmap->references));
+	memset(cmap->writable, 0, sizeof(cmap->writable));
+	return copy;
 }
 
 extern "C" Status
@@ -208,17 +370,39 @@ XAllocColorCells(Display *display, Colormap colormap,
 	Bool contig, unsigned long* plane_masks_return, unsigned int nplanes,
 	unsigned long* pixels_return, unsigned int npixels)
 {
-	if (colormap == (Colormap)&sDummy)
+	if (colormap == (Colormap)&sDummy || colormap == (Colormap)&sDummy16)
 		return Success;
 
-	// We don't support anything else.
-	return BadImplementation;
+	const std::shared_ptr<XColormap> cmap = _x_colormap(colormap);
+	if (!cmap || npixels == 0)
+		return 0;
+
+	// Planes are not supported, only individual cells.
+	if (nplanes != 0)
+		return 0;
+
+	PthreadWriteLocker wrlock(cmap->lock);
+	unsigned int found = 0;
+	for (int i = 0; i < XColormap::kSize && found < npixels; i++) {
+		if (cmap->references[i] == 0)
+			pixels_return[found++] = i;
+		else if (contig)
+			found = 0;
+	}
+	if (found < npixels)
+		return 0;
+
+	for (unsigned int i = 0; i < npixels; i++) {
+		cmap->references[pixels_return[i]] = 1;
+		cmap->writable[pixels_return[i]] = true;
+	}
+	return 1;
 }
 
 extern "C" Status
 XInstallColormap(Display* display, Colormap colormap)
 {
-	if (colormap == (Colormap)&sDummy)
+	if (colormap == (Colormap)&sDummy || colormap == (Colormap)&sDummy16 || _x_colormap(colormap))
 		return Success;
 	return BadImplementation;
 }
@@ -232,7 +416,34 @@ XUninstallColormap(Display* display, Colormap colormap)
 extern "C" Status
 XStoreColors(Display* display, Colormap colormap, XColor* color, int ncolors)
 {
-	return BadColor;
+	const std::shared_ptr<XColormap> cmap = _x_colormap(colormap);
+	if (!cmap)
+		return BadColor;
+
+	pthread_rwlock_wrlock(&cmap->lock);
+	// Check every cell first, so that nothing is stored if any is not writable.
+	for (int i = 0; i < ncolors; i++) {
+		const unsigned long cell = color[i].pixel;
+		if (cell >= XColormap::kSize || !cmap->writable[cell]) {
+			pthread_rwlock_unlock(&cmap->lock);
+			return BadAccess;
+		}
+	}
+	for (int i = 0; i < ncolors; i++) {
+		const unsigned long cell = color[i].pixel;
+		rgb_color value = _x_pixel_to_rgb(cmap->palette[cell]);
+		if (color[i].flags & DoRed)
+			value.red = color[i].red / 257;
+		if (color[i].flags & DoGreen)
+			value.green = color[i].green / 257;
+		if (color[i].flags & DoBlue)
+			value.blue = color[i].blue / 257;
+		cmap->palette[cell] = _x_rgb_to_pixel(value);
+	}
+	pthread_rwlock_unlock(&cmap->lock);
+
+	colormap_changed(cmap.get(), colormap);
+	return Success;
 }
 
 extern "C" Status
@@ -244,5 +455,18 @@ XStoreColor(Display* dpy, Colormap cmap, XColor* color)
 extern "C" Status
 XFreeColormap(Display* display, Colormap colormap)
 {
+	{
+		PthreadWriteLocker wrlock(sColormapsLock);
+		if (sColormaps.erase(colormap) == 0)
+			return Success;
+	}
+
+	// Windows using the colormap no longer have one. Anything drawing with it
+	// right now holds a reference, so it is only deleted after that is done.
+	for (const Window& w : Drawables::windows()) {
+		XWindow* window = Drawables::get_window(w);
+		if (window && window->colormap == colormap)
+			window->colormap = None;
+	}
 	return Success;
 }
@@ -7,6 +7,9 @@
 
 #include <interface/GraphicsDefs.h>
 
+#include <memory>
+#include <pthread.h>
+
 extern "C" {
 #include <X11/Xlib.h>
 }
@@ -37,5 +40,71 @@ _x_pixel_to_rgb(unsigned long color, bool alpha = false)
 	return rgb;
 }
 
+static inline unsigned long
+_x_rgb_to_pixel_for_depth(rgb_color color, int depth)
+{
+	switch (depth) {
+	case 15:
+		return ((color.red >> 3) << 10) | ((color.green >> 3) << 5) | (color.blue >> 3);
+	case 16:
+		return ((color.red >> 3) << 11) | ((color.green >> 2) << 5) | (color.blue >> 3);
+	default:
+		return _x_rgb_to_pixel(color);
+	}
+}
+
+static inline rgb_color
+_x_pixel_to_rgb_for_depth(unsigned long color, int depth)
+{
+	rgb_color rgb;
+	switch (depth) {
+	case 15: {
+		const uint8 red = (color >> 10) & 0x1F, green = (color >> 5) & 0x1F, blue = color & 0x1F;
+		rgb.set_to((red << 3) | (red >> 2), (green << 3) | (green >> 2), (blue << 3) | (blue >> 2));
+		return rgb;
+	}
+	case 16: {
+		const uint8 red = (color >> 11) & 0x1F, green = (color >> 5) & 0x3F, blue = color & 0x1F;
+		rgb.set_to((red << 3) | (red >> 2), (green << 2) | (green >> 4), (blue << 3) | (blue >> 2));
+		return rgb;
+	}
+	case 32:
+		return _x_pixel_to_rgb(color, true);
+	default:
+		return _x_pixel_to_rgb(color);
+	}
+}
+
 color_space _x_color_space_for(Visual* v, int bits_per_pixel);
+color_space _x_color_space_for_depth(int depth);
 int _x_depth_for_color_space(color_space space);
+int _x_bits_per_pixel_for_depth(int depth);
+int _x_depth_for_visual(Display* display, Visual* visual);
+
+namespace BeXlib {
+
+// A PseudoColor colormap. (TrueColor colormaps are not backed by anything.)
+class XColormap {
+public:
+	static const int kSize = 256;
+
+	Visual* const visual;
+
+	// Guards the cells: drawing reads them while the client may be changing them.
+	pthread_rwlock_t lock;
+
+	// B_RGB32 values of each cell, so that indexes can be expanded directly.
+	uint32 palette[kSize];
+	uint16 references[kSize];
+	bool writable[kSize];
+
+public:
+	XColormap(Visual* visual);
+	~XColormap();
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
+
+// Colormaps stay alive while referenced, even if XFreeColormap is called meanwhile.
+std::shared_ptr<XColormap> _x_colormap(Colormap colormap);
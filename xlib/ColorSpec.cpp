@@ -0,0 +1,349 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "ColorSpec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <strings.h>
+
+#include "PerfectHash.h"
+
+extern "C" {
+#include "tables/ColorTable.h"
+}
+
+namespace BeXlib {
+
+static constexpr bool
+color_names_equal(const char* a, const char* b)
+{
+	for (; *a != '\0' && *b != '\0'; a++, b++) {
+		char ca = *a, cb = *b;
+		if (ca >= 'A' && ca <= 'Z')
+			ca += 'a' - 'A';
+		if (cb >= 'A' && cb <= 'Z')
+			cb += 'a' - 'A';
+		if (ca != cb)
+			return false;
+	}
+	return *a == *b;
+}
+
+static constexpr PerfectHash<X_COLORS_LENGTH, 2048> sColorsByName(
+	[](size_t i) { return perfect_hash_string(xColors[i].name, true); },
+	[](size_t a, size_t b) { return color_names_equal(xColors[a].name, xColors[b].name); });
+
+static bool
+find_color(const char* name, XColor* def)
+{
+	const int32_t index = sColorsByName.find(perfect_hash_string(name, true));
+	if (index < 0 || !color_names_equal(xColors[index].name, name))
+		return false;
+
+	def->red   = xColors[index].red * 257;
+	def->green = xColors[index].green * 257;
+	def->blue  = xColors[index].blue * 257;
+	return true;
+}
+
+// #pragma mark - color specifications
+
+static inline int
+hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static bool
+parse_hex_color(const char* spec, XColor* def)
+{
+	// "#RGB" through "#RRRRGGGGBBBB": components are the high bits.
+	const size_t length = strlen(spec);
+	if (length == 0 || length > 12 || (length % 3) != 0)
+		return false;
+
+	const int digits = length / 3;
+	unsigned short* components[3] = { &def->red, &def->green, &def->blue };
+	for (int i = 0; i < 3; i++) {
+		unsigned int value = 0;
+		for (int j = 0; j < digits; j++) {
+			const int digit = hex_digit(*spec++);
+			if (digit < 0)
+				return false;
+			value = (value << 4) | digit;
+		}
+		*components[i] = value << (16 - digits * 4);
+	}
+	return true;
+}
+
+static bool
+parse_rgb_color(const char* spec, XColor* def)
+{
+	// "rgb:r/g/b", with 1 to 4 hex digits per component, scaled.
+	unsigned short* components[3] = { &def->red, &def->green, &def->blue };
+	for (int i = 0; i < 3; i++) {
+		unsigned int value = 0;
+		int digits = 0;
+		for (; *spec != '\0' && *spec != '/'; spec++, digits++) {
+			const int digit = hex_digit(*spec);
+			if (digit < 0 || digits == 4)
+				return false;
+			value = (value << 4) | digit;
+		}
+		if (digits == 0)
+			return false;
+		if (*spec != ((i == 2) ? '\0' : '/'))
+			return false;
+		spec++;
+
+		const unsigned int max = (1 << (digits * 4)) - 1;
+		*components[i] = (value * 0xFFFF + max / 2) / max;
+	}
+	return true;
+}
+
+static bool
+parse_float(const char*& spec, double& value)
+{
+	// Like strtod, but locale-independent.
+	const char* start = spec;
+	bool negative = false;
+	if (*spec == '+' || *spec == '-')
+		negative = (*spec++ == '-');
+
+	value = 0;
+	bool digits = false;
+	for (; *spec >= '0' && *spec <= '9'; spec++, digits = true)
+		value = value * 10 + (*spec - '0');
+	if (*spec == '.') {
+		spec++;
+		double scale = 0.1;
+		for (; *spec >= '0' && *spec <= '9'; spec++, digits = true, scale /= 10)
+			value += (*spec - '0') * scale;
+	}
+	if (!digits) {
+		spec = start;
+		return false;
+	}
+	if (*spec == 'e' || *spec == 'E') {
+		const char* exponentStart = spec++;
+		bool negativeExponent = false;
+		if (*spec == '+' || *spec == '-')
+			negativeExponent = (*spec++ == '-');
+		if (*spec < '0' || *spec > '9') {
+			spec = exponentStart;
+		} else {
+			int exponent = 0;
+			for (; *spec >= '0' && *spec <= '9'; spec++)
+				exponent = std::min(exponent * 10 + (*spec - '0'), 1000);
+			value *= pow(10, negativeExponent ? -exponent : exponent);
+		}
+	}
+	if (negative)
+		value = -value;
+	return true;
+}
+
+static bool
+parse_floats(const char* spec, double values[3])
+{
+	for (int i = 0; i < 3; i++) {
+		if (!parse_float(spec, values[i]))
+			return false;
+		if (*spec++ != ((i == 2) ? '\0' : '/'))
+			return false;
+	}
+	return true;
+}
+
+// The default (linear) RGB device conversion of Xcms.
+static const double kRGBToXYZ[3][3] = {
+	{ 0.38106149108714790, 0.32025712365352110, 0.24834578525933100 },
+	{ 0.20729745115140850, 0.68054638776373240, 0.11215616108485920 },
+	{ 0.02133944350088028, 0.14297193020246480, 1.24172892629665200 },
+};
+static const double kXYZToRGB[3][3] = {
+	{  3.48340481253539000, -1.52176374927285200, -0.55923133354049780 },
+	{ -1.07152751306193600,  1.96593795204372400,  0.03673691339553462 },
+	{  0.06351179790497788, -0.20020501000496480,  0.81070942031648220 },
+};
+
+static void
+white_point(double& X, double& Y, double& Z)
+{
+	X = kRGBToXYZ[0][0] + kRGBToXYZ[0][1] + kRGBToXYZ[0][2];
+	Y = kRGBToXYZ[1][0] + kRGBToXYZ[1][1] + kRGBToXYZ[1][2];
+	Z = kRGBToXYZ[2][0] + kRGBToXYZ[2][1] + kRGBToXYZ[2][2];
+}
+
+static void
+white_point_uv(double& u, double& v)
+{
+	double X, Y, Z;
+	white_point(X, Y, Z);
+	const double denominator = X + 15 * Y + 3 * Z;
+	u = 4 * X / denominator;
+	v = 9 * Y / denominator;
+}
+
+static double
+lightness_to_Y(double L)
+{
+	if (L < 7.99953624)
+		return L / 903.29;
+	const double f = (L + 16) / 116;
+	return f * f * f;
+}
+
+static bool
+uvY_to_XYZ(double u, double v, double Y, double XYZ[3])
+{
+	if (u < 0 || v <= 0 || Y < 0 || Y > 1)
+		return false;
+	XYZ[0] = Y * 9 * u / (4 * v);
+	XYZ[1] = Y;
+	XYZ[2] = Y * (12 - 3 * u - 20 * v) / (4 * v);
+	return true;
+}
+
+static bool
+parse_cie_color(const char* spec, double XYZ[3])
+{
+	const char* separator = strchr(spec, ':');
+	if (separator == NULL)
+		return false;
+	const size_t prefixLength = separator - spec;
+
+	double values[3];
+	if (!parse_floats(separator + 1, values))
+		return false;
+
+#define PREFIX_IS(PREFIX) \
+	(prefixLength == strlen(PREFIX) && strncasecmp(spec, PREFIX, prefixLength) == 0)
+
+	if (PREFIX_IS("CIEXYZ")) {
+		memcpy(XYZ, values, sizeof(values));
+		return (XYZ[1] >= 0 && XYZ[1] <= 1);
+	}
+	if (PREFIX_IS("CIEuvY"))
+		return uvY_to_XYZ(values[0], values[1], values[2], XYZ);
+	if (PREFIX_IS("CIExyY")) {
+		const double x = values[0], y = values[1], Y = values[2];
+		if (x < 0 || y <= 0 || Y < 0 || Y > 1)
+			return false;
+		XYZ[0] = x * Y / y;
+		XYZ[1] = Y;
+		XYZ[2] = (1 - x - y) * Y / y;
+		return true;
+	}
+	if (PREFIX_IS("CIELab")) {
+		const double L = values[0], a = values[1], b = values[2];
+		if (L < 0 || L > 100)
+			return false;
+		double white[3];
+		white_point(white[0], white[1], white[2]);
+
+		const double fy = (L + 16) / 116;
+		const double f[3] = { fy + a / 500, fy, fy - b / 200 };
+		for (int i = 0; i < 3; i++) {
+			const double t = (f[i] > 6.0 / 29) ? (f[i] * f[i] * f[i])
+				: (3 * (6.0 / 29) * (6.0 / 29) * (f[i] - 4.0 / 29));
+			XYZ[i] = t * white[i];
+		}
+		XYZ[1] = lightness_to_Y(L) * white[1];
+		return true;
+	}
+	if (PREFIX_IS("CIELuv")) {
+		const double L = values[0];
+		if (L < 0 || L > 100)
+			return false;
+		double un, vn;
+		white_point_uv(un, vn);
+		if (L == 0)
+			return uvY_to_XYZ(un, vn, 0, XYZ);
+		return uvY_to_XYZ(values[1] / (13 * L) + un, values[2] / (13 * L) + vn,
+			lightness_to_Y(L), XYZ);
+	}
+	if (PREFIX_IS("TekHVC")) {
+		const double H = values[0], V = values[1], C = values[2];
+		if (H < 0 || H > 360 || V < 0 || V > 100 || C < 0)
+			return false;
+
+		double un, vn;
+		white_point_uv(un, vn);
+		if (V == 0 || C == 0)
+			return uvY_to_XYZ(un, vn, lightness_to_Y(V), XYZ);
+
+		// Hue is measured from "best red" (u' = 0.7127, v' = 0.4931.)
+		const double kChromaScale = 7.50725;
+		const double hue = H * M_PI / 180 + atan2(0.4931 - vn, 0.7127 - un);
+		return uvY_to_XYZ(cos(hue) * C / (V * kChromaScale) + un,
+			sin(hue) * C / (V * kChromaScale) + vn, lightness_to_Y(V), XYZ);
+	}
+
+#undef PREFIX_IS
+	return false;
+}
+
+static void
+intensities_to_color(const double rgb[3], XColor* def)
+{
+	unsigned short* components[3] = { &def->red, &def->green, &def->blue };
+	for (int i = 0; i < 3; i++) {
+		const double value = (rgb[i] < 0) ? 0 : ((rgb[i] > 1) ? 1 : rgb[i]);
+		*components[i] = (unsigned short)(value * 0xFFFF + 0.5);
+	}
+}
+
+// #pragma mark - parsing
+
+bool
+ColorSpec::parse(const char* spec, XColor* def)
+{
+	if (spec == NULL)
+		return false;
+
+	if (spec[0] == '#') {
+		if (!parse_hex_color(spec + 1, def))
+			return false;
+	} else if (strncasecmp(spec, "rgb:", 4) == 0) {
+		if (!parse_rgb_color(spec + 4, def))
+			return false;
+	} else if (strncasecmp(spec, "rgbi:", 5) == 0) {
+		double rgb[3];
+		if (!parse_floats(spec + 5, rgb))
+			return false;
+		for (int i = 0; i < 3; i++) {
+			if (rgb[i] < 0 || rgb[i] > 1)
+				return false;
+		}
+		intensities_to_color(rgb, def);
+	} else if (strncasecmp(spec, "CIE", 3) == 0 || strncasecmp(spec, "TekHVC:", 7) == 0) {
+		double XYZ[3];
+		if (!parse_cie_color(spec, XYZ))
+			return false;
+
+		double rgb[3];
+		for (int i = 0; i < 3; i++) {
+			rgb[i] = kXYZToRGB[i][0] * XYZ[0] + kXYZToRGB[i][1] * XYZ[1]
+				+ kXYZToRGB[i][2] * XYZ[2];
+		}
+		intensities_to_color(rgb, def);
+	} else {
+		if (!find_color(spec, def))
+			return false;
+	}
+	return true;
+}
+
+} // namespace BeXlib
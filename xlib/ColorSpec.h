@@ -0,0 +1,26 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+namespace BeXlib {
+
+/* Parses color specifications as XParseColor does: names from the color
+ * database (case-insensitively), "#RGB" through "#RRRRGGGGBBBB", "rgb:",
+ * "rgbi:", and the device-independent Xcms forms ("CIEXYZ:", "TekHVC:", etc.),
+ * which are converted with the default linear RGB profile.
+ *
+ * Only the red, green and blue of "def" are set. It is kept apart from the
+ * colormaps so that test/unit/ColorSpecTest.cpp can check it anywhere. */
+class ColorSpec {
+public:
+	static bool parse(const char* spec, XColor* def);
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
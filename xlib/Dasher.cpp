@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Dasher.h"
+
+#include <cmath>
+
+namespace BeXlib {
+
+Dasher::Dasher(const unsigned char* dashes, int count, int offset, bool thin)
+	: _total(0)
+	, _offset(offset)
+	, _thin(thin)
+{
+	// Lists of odd length are used twice, so that dashes alternate.
+	const int length = (count % 2) ? (count * 2) : count;
+	_dashes.reserve(length);
+	for (int i = 0; i < length; i++) {
+		_dashes.push_back(dashes[i % count]);
+		_total += _dashes.back();
+	}
+	restart();
+}
+
+void
+Dasher::restart()
+{
+	_index = 0;
+	_remaining = _dashes.empty() ? 0 : _dashes[0];
+	if (_total <= 0)
+		return;
+
+	float offset = fmodf(_offset, _total);
+	if (offset < 0)
+		offset += _total;
+	while (offset >= _remaining) {
+		offset -= _remaining;
+		_index = (_index + 1) % _dashes.size();
+		_remaining = _dashes[_index];
+	}
+	_remaining -= offset;
+}
+
+void
+Dasher::add(float x1, float y1, float x2, float y2,
+	std::vector<Dash>& result, bool offDashes)
+{
+	const float dx = x2 - x1, dy = y2 - y1;
+	const float length = _thin ? fmaxf(fabsf(dx), fabsf(dy)) : sqrtf(dx * dx + dy * dy);
+	if (length <= 0 || _total <= 0)
+		return;
+
+	// Thin dashes end on the last pixel they cover, rather than the one after.
+	const float end = _thin ? 1 : 0;
+	const float stepX = dx / length, stepY = dy / length;
+
+	float position = 0;
+	while (position < length) {
+		const bool finished = (position + _remaining) <= length;
+		const float dashEnd = finished ? (position + _remaining) : length;
+		const bool on = (_index % 2) == 0;
+		if (on || offDashes) {
+			const float last = fmaxf(dashEnd - end, position);
+			result.push_back({x1 + stepX * position, y1 + stepY * position,
+				x1 + stepX * last, y1 + stepY * last, on});
+		}
+
+		if (finished) {
+			// Whole dashes are consumed exactly, so rounding cannot leave slivers.
+			_index = (_index + 1) % _dashes.size();
+			_remaining = _dashes[_index];
+		} else {
+			_remaining -= dashEnd - position;
+		}
+		position = dashEnd;
+	}
+}
+
+} // namespace BeXlib
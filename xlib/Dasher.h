@@ -0,0 +1,44 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace BeXlib {
+
+/* Splits lines into the dashes of an X dash list. The pattern continues from
+ * one segment to the next, until restart() is called for a new line.
+ *
+ * Zero-width lines measure dashes in pixels along their major axis, and their
+ * dashes end one pixel early, so that a dash of N covers N pixels; wide lines
+ * use their actual length. (See test/unit/DasherTest.cpp for examples.) */
+class Dasher {
+public:
+	struct Dash {
+		float x1, y1, x2, y2;
+		bool on;
+			// Off dashes are only returned if asked for (for LineDoubleDash.)
+	};
+
+public:
+	Dasher(const unsigned char* dashes, int count, int offset, bool thin);
+
+	void restart();
+	void add(float x1, float y1, float x2, float y2,
+		std::vector<Dash>& result, bool offDashes);
+
+private:
+	std::vector<float> _dashes;
+	float _total;
+	int _offset;
+	bool _thin;
+
+	int _index;
+	float _remaining;
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
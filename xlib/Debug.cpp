@@ -12,6 +12,10 @@
 #include <storage/File.h>
 
 #include <cstdio>
+#include <cstdlib>
+
+#include "BitmapPool.h"
+#include "Drawables.h"
 
 extern "C" void
 _x_trace(const char* trace, const char* func)
@@ -35,3 +39,23 @@ WriteBitmapToFile(BBitmap* bitmap, const char* filename)
 	BFile file(filename, B_CREATE_FILE | B_ERASE_FILE | B_WRITE_ONLY);
 	roster->Translate(&stream, NULL, NULL, &file, B_PNG_FORMAT);
 }
+
+/* Prints cache statistics to stderr, if XLIBE_STATISTICS is set. */
+void
+_x_print_statistics()
+{
+	if (getenv("XLIBE_STATISTICS") == NULL)
+		return;
+
+	const BitmapPool::Statistics pool = BitmapPool::statistics();
+	const uint64 requests = pool.hits + pool.misses;
+	fprintf(stderr, "xlibe: pixmap pool: %" B_PRIu64 " hits, %" B_PRIu64 " misses (%.1f%%), "
+		"%" B_PRIu64 " evictions, %" B_PRIuSIZE " bitmaps (%" B_PRIuSIZE " KB) pooled\n",
+		pool.hits, pool.misses, requests ? (pool.hits * 100.0 / requests) : 0.0,
+		pool.evictions, pool.bitmaps, pool.bytes / 1024);
+
+	uint64 syncs, syncsAvoided;
+	XPixmap::sync_statistics(syncs, syncsAvoided);
+	fprintf(stderr, "xlibe: pixmap syncs: %" B_PRIu64 " performed, %" B_PRIu64 " avoided\n",
+		syncs, syncsAvoided);
+}
@@ -9,6 +9,7 @@
 class BBitmap;
 
 void WriteBitmapToFile(BBitmap* bitmap, const char* filename);
+void _x_print_statistics();
 
 extern "C" {
 #endif
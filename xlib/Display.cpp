@@ -9,17 +9,24 @@
 #include <atomic>
 
 #include <app/Application.h>
+#include <app/Clipboard.h>
 #include <interface/Screen.h>
 #include <storage/AppFileInfo.h>
 #include <private/app/AppMisc.h>
 
 #include "Atom.h"
+#include "BitmapPool.h"
+#include "Debug.h"
 #include "Drawables.h"
 #include "Font.h"
 #include "Color.h"
 #include "Extension.h"
 #include "Event.h"
+#include "Keyboard.h"
+#include "KeyMap.h"
 #include "Lock.h"
+#include "Selection.h"
+#include "Settings.h"
 
 extern "C" {
 #include <X11/Xlib.h>
@@ -57,6 +64,9 @@ XlibApplication::XlibApplication(Display* display, const char* signature)
 void
 XlibApplication::ReadyToRun()
 {
+	be_clipboard->StartWatching(be_app_messenger);
+	_x_clipboard_changed(NULL);
+
 	char dummy[1];
 	write(_display->conn_checker, dummy, 1);
 }
@@ -64,6 +74,19 @@ XlibApplication::ReadyToRun()
 void
 XlibApplication::MessageReceived(BMessage* message)
 {
+	switch (message->what) {
+	case B_KEY_MAP_LOADED:
+		_x_reload_keymap(_display);
+		return;
+
+	case B_CLIPBOARD_CHANGED:
+		_x_clipboard_changed(_display);
+		return;
+
+	case B_FONTS_UPDATED:
+		_x_settings_changed(_display);
+		return;
+	}
 	BApplication::MessageReceived(message);
 }
 
@@ -91,8 +114,8 @@ x_unlock_display(Display* dpy)
 static void
 set_display(Display* dpy)
 {
-	static Depth dlist[1];
-	static Visual vlist[1];
+	static Depth dlist[4];
+	static Visual vlist[4];
 	static Screen slist[1];
 	static char vstring[] = "Xlibe";
 
@@ -102,29 +125,68 @@ set_display(Display* dpy)
 
 	memset(slist, 0, sizeof(Screen));
 
-	dlist[0].depth		= _x_depth_for_color_space(screen.ColorSpace());
+	// The root visual. Depth 24 is stored as 32 bits per pixel (B_RGB32.)
+	dlist[0].depth		= 24;
 	dlist[0].nvisuals	= 1;
-	dlist[0].visuals	= vlist;
+	dlist[0].visuals	= &vlist[0];
 
 	vlist[0].ext_data     = NULL;
-	vlist[0].visualid     = 0;
+	vlist[0].visualid     = 1;
 	vlist[0].c_class      = TrueColor;
-	vlist[0].bits_per_rgb = dlist[0].depth;
+	vlist[0].bits_per_rgb = 8;
 	vlist[0].map_entries  = 256;
 	_x_get_rgb_masks(&vlist[0]);
 
+	// A 32-bit ARGB visual, for applications which want translucent drawing.
+	dlist[1].depth		= 32;
+	dlist[1].nvisuals	= 1;
+	dlist[1].visuals	= &vlist[1];
+
+	vlist[1].ext_data     = NULL;
+	vlist[1].visualid     = 2;
+	vlist[1].c_class      = TrueColor;
+	vlist[1].bits_per_rgb = 8;
+	vlist[1].map_entries  = 256;
+	_x_get_rgb_masks(&vlist[1]);
+
+	// A 16-bit (RGB565) visual.
+	dlist[2].depth		= 16;
+	dlist[2].nvisuals	= 1;
+	dlist[2].visuals	= &vlist[2];
+
+	vlist[2].ext_data     = NULL;
+	vlist[2].visualid     = 3;
+	vlist[2].c_class      = TrueColor;
+	vlist[2].bits_per_rgb = 6;
+	vlist[2].map_entries  = 64;
+	vlist[2].red_mask     = 0xF800;
+	vlist[2].green_mask   = 0x07E0;
+	vlist[2].blue_mask    = 0x001F;
+
+	// An 8-bit PseudoColor visual, for applications which need writable colormaps.
+	// Pixel values are expanded through the colormap when drawn to windows.
+	dlist[3].depth		= 8;
+	dlist[3].nvisuals	= 1;
+	dlist[3].visuals	= &vlist[3];
+
+	vlist[3].ext_data     = NULL;
+	vlist[3].visualid     = 4;
+	vlist[3].c_class      = PseudoColor;
+	vlist[3].bits_per_rgb = 8;
+	vlist[3].map_entries  = XColormap::kSize;
+	vlist[3].red_mask = vlist[3].green_mask = vlist[3].blue_mask = 0;
+
 	const BRect screenFrame = screen.Frame();
 	slist[0].width       = screenFrame.IntegerWidth();
 	slist[0].height      = screenFrame.IntegerHeight();
 	slist[0].mwidth      = screenFrame.Width() * 0.2646;
 	slist[0].mheight     = screenFrame.Height() * 0.2646;
 		// TODO: get real mm!
-	slist[0].ndepths     = 1;
+	slist[0].ndepths     = 4;
 	slist[0].depths      = dlist;
 	slist[0].root_depth  = dlist[0].depth;
-	slist[0].root_visual = vlist;
+	slist[0].root_visual = &vlist[0];
 	slist[0].default_gc  = NULL;
-	slist[0].cmap        = XCreateColormap(dpy, None, &vlist[0], AllocNone);
 	slist[0].white_pixel = _x_rgb_to_pixel(make_color(0xFF, 0xFF, 0xFF));
 	slist[0].black_pixel = _x_rgb_to_pixel(make_color(0, 0, 0));
 
@@ -138,9 +200,10 @@ set_display(Display* dpy)
 	dpy->display_name        = vstring;
 	dpy->nscreens            = 1;
 	dpy->screens             = slist;
+	slist[0].cmap            = XCreateColormap(dpy, None, &vlist[0], AllocNone);
 	dpy->default_screen		 = 0;
-	dpy->min_keycode		 = 8;
-	dpy->max_keycode         = 255;
+	dpy->min_keycode		 = KeyMap::kMinKeyCode;
+	dpy->max_keycode         = KeyMap::kMaxKeyCode;
 	dpy->max_request_size	 = 4096;
 	dpy->bigreq_size		 = dpy->max_request_size;
 	dpy->qlen                = 0;
@@ -208,6 +271,7 @@ XOpenDisplay(const char* name)
 
 	set_display(display);
 	_x_init_atoms();
+	_x_init_keymap();
 	_x_init_font();
 	_x_init_events(display);
 	sOpenDisplays++;
@@ -224,6 +288,8 @@ XCloseDisplay(Display* display)
 		if (sOpenDisplays == 0) {
 			// We need to destroy all open windows first, otherwise QUIT won't work.
 			Drawables::destroy();
+			_x_print_statistics();
+			BitmapPool::clear();
 
 			status_t result;
 			be_app->PostMessage(B_QUIT_REQUESTED);
@@ -249,12 +315,12 @@ XCloseDisplay(Display* display)
 }
 
 static void
-fill_visual_info(Visual* v, XVisualInfo* info)
+fill_visual_info(Visual* v, int depth, XVisualInfo* info)
 {
 	info->visual = v;
 	info->visualid = info->visual->visualid;
 	info->screen = 0;
-	info->depth = info->visual->bits_per_rgb;
+	info->depth = depth;
 	info->c_class = info->visual->c_class;
 	info->colormap_size = info->visual->map_entries;
 	info->bits_per_rgb = info->visual->bits_per_rgb;
@@ -266,34 +332,55 @@ fill_visual_info(Visual* v, XVisualInfo* info)
 extern "C" XVisualInfo*
 XGetVisualInfo(Display *display, long vinfo_mask, XVisualInfo *vinfo_template, int *nitems_return)
 {
-	XVisualInfo* info = (XVisualInfo*)calloc(1, sizeof(XVisualInfo));
-	fill_visual_info(DefaultVisual(display, 0), info);
-
-	if (((vinfo_mask & VisualIDMask)
-		 && (vinfo_template->visualid != info->visualid))
-			|| ((vinfo_mask & VisualScreenMask)
-				&& (vinfo_template->screen != info->screen))
-			|| ((vinfo_mask & VisualDepthMask)
-				&& (vinfo_template->depth != info->depth))
-			|| ((vinfo_mask & VisualClassMask)
-				&& (vinfo_template->c_class != info->c_class))
-			|| ((vinfo_mask & VisualColormapSizeMask)
-				&& (vinfo_template->colormap_size != info->colormap_size))
-			|| ((vinfo_mask & VisualBitsPerRGBMask)
-				&& (vinfo_template->bits_per_rgb != info->bits_per_rgb))
-			|| ((vinfo_mask & VisualRedMaskMask)
-				&& (vinfo_template->red_mask != info->red_mask))
-			|| ((vinfo_mask & VisualGreenMaskMask)
-				&& (vinfo_template->green_mask != info->green_mask))
-			|| ((vinfo_mask & VisualBlueMaskMask)
-				&& (vinfo_template->blue_mask != info->blue_mask))
-			) {
-		free(info);
+	*nitems_return = 0;
+
+	const Screen& scr = display->screens[0];
+	int count = 0;
+	for (int i = 0; i < scr.ndepths; i++)
+		count += scr.depths[i].nvisuals;
+
+	XVisualInfo* infos = (XVisualInfo*)calloc(count, sizeof(XVisualInfo));
+	for (int i = 0; i < scr.ndepths; i++) {
+		for (int j = 0; j < scr.depths[i].nvisuals; j++) {
+			XVisualInfo* info = &infos[*nitems_return];
+			fill_visual_info(&scr.depths[i].visuals[j], scr.depths[i].depth, info);
+
+			if (((vinfo_mask & VisualIDMask)
+				 && (vinfo_template->visualid != info->visualid))
+					|| ((vinfo_mask & VisualScreenMask)
+						&& (vinfo_template->screen != info->screen))
+					|| ((vinfo_mask & VisualDepthMask)
+						&& (vinfo_template->depth != info->depth))
+					|| ((vinfo_mask & VisualClassMask)
+						&& (vinfo_template->c_class != info->c_class))
+					|| ((vinfo_mask & VisualColormapSizeMask)
+						&& (vinfo_template->colormap_size != info->colormap_size))
+					|| ((vinfo_mask & VisualBitsPerRGBMask)
+						&& (vinfo_template->bits_per_rgb != info->bits_per_rgb))
+					|| ((vinfo_mask & VisualRedMaskMask)
+						&& (vinfo_template->red_mask != info->red_mask))
+					|| ((vinfo_mask & VisualGreenMaskMask)
+						&& (vinfo_template->green_mask != info->green_mask))
+					|| ((vinfo_mask & VisualBlueMaskMask)
+						&& (vinfo_template->blue_mask != info->blue_mask))
+					) {
+				continue;
+			}
+			(*nitems_return)++;
+		}
+	}
+
+	if (*nitems_return == 0) {
+		free(infos);
 		return NULL;
 	}
+	return infos;
+}
 
-	*nitems_return = 1;
-	return info;
+extern "C" VisualID
+XVisualIDFromVisual(Visual* visual)
+{
+	return visual ? visual->visualid : None;
 }
 
 extern "C" int
@@ -313,7 +400,7 @@ XMatchVisualInfo(Display* display, int screen, int depth, int c_class, XVisualIn
 			if (vis.c_class != c_class)
 				continue;
 
-			fill_visual_info((Visual*)&vis, vinfo_return);
+			fill_visual_info((Visual*)&vis, dpth.depth, vinfo_return);
 			vinfo_return->screen = screen;
 			return 1;
 		}
@@ -8,15 +8,23 @@
 #include <interface/Bitmap.h>
 #include <interface/Screen.h>
 
+#include <cstdlib>
+#include <cstring>
 #include <set>
 #include <atomic>
+#include <utility>
 
 #include "Atom.h"
+#include "BitmapPool.h"
 #include "Color.h"
 #include "Keyboard.h"
 #include "Event.h"
+#include "Extension.h"
 #include "Drawing.h"
 #include "Locking.h"
+#include "PaletteExpander.h"
+#include "Property.h"
+#include "Settings.h"
 
 namespace BeXlib {
 
@@ -26,6 +34,7 @@ std::map<Drawable, XDrawable*> Drawables::drawables;
 Drawable Drawables::last = 100000;
 
 static std::atomic<XWindow*> sFocusedWindow, sPointerWindow;
+static std::atomic<uint64> sPixmapSyncs, sPixmapSyncsAvoided;
 static XWindow* sPointerGrabWindow = NULL;
 
 Drawable
@@ -80,6 +89,18 @@ Drawables::get_pixmap(Drawable id)
 	return dynamic_cast<XPixmap*>(get(id));
 }
 
+std::list<Window>
+Drawables::windows()
+{
+	std::list<Window> windows;
+	PthreadReadLocker rdlock(lock);
+	for (const auto& drawable : drawables) {
+		if (dynamic_cast<XWindow*>(drawable.second))
+			windows.push_back(drawable.first);
+	}
+	return windows;
+}
+
 XWindow*
 Drawables::focused()
 {
@@ -120,6 +141,7 @@ XDrawable::XDrawable(Display* dpy, BRect rect)
 XDrawable::~XDrawable()
 {
 	delete scratch_bitmap;
+	delete raster_op_mask;
 	Drawables::erase(id());
 	remove();
 }
@@ -143,6 +165,37 @@ XDrawable::resize(BSize newSize)
 	return true;
 }
 
+rgb_color
+XDrawable::pixel_color(unsigned long pixel)
+{
+	if (const std::shared_ptr<XColormap> cmap = _x_colormap(colormap)) {
+		PthreadReadLocker rdlock(cmap->lock);
+		return _x_pixel_to_rgb(cmap->palette[pixel % XColormap::kSize]);
+	}
+	return _x_pixel_to_rgb_for_depth(pixel, depth());
+}
+
+/* Returns a bitmap of at least the given size, which is kept around for reuse. */
+BBitmap*
+XDrawable::scratch_bitmap_for(BSize size, color_space colorSpace)
+{
+	const BRect scratchBounds = scratch_bitmap ? scratch_bitmap->Bounds() : BRect();
+	if (scratch_bitmap == NULL
+			|| scratch_bitmap->ColorSpace() != colorSpace
+			|| scratchBounds.Width() < size.width
+			|| scratchBounds.Height() < size.height) {
+		// We need a bigger scratch bitmap.
+		if (size.width < scratchBounds.Width())
+			size.width = scratchBounds.Width();
+		if (size.height < scratchBounds.Height())
+			size.height = scratchBounds.Height();
+
+		delete scratch_bitmap;
+		scratch_bitmap = new BBitmap(BRect(BPoint(0, 0), size), 0, colorSpace);
+	}
+	return scratch_bitmap;
+}
+
 Drawable
 XDrawable::parent() const
 {
@@ -319,6 +372,8 @@ RootWindow::QuitRequested()
 
 XWindow::XWindow(Display* dpy, BRect rect)
 	: XDrawable(dpy, rect)
+	, _visual(DefaultVisual(dpy, DefaultScreen(dpy)))
+	, _depth(DefaultDepth(dpy, DefaultScreen(dpy)))
 	, _border_color(_x_pixel_to_rgb(0))
 	, _border_width(0)
 {
@@ -329,6 +384,8 @@ XWindow::~XWindow()
 {
 	if (sPointerGrabWindow == this)
 		ungrab_pointer();
+	_x_remove_properties(id());
+	_x_call_destroy_window_hooks(display(), id());
 
 	// Delete all children before sending our own DestroyNotify.
 	LockLooper();
@@ -348,6 +405,8 @@ XWindow::~XWindow()
 	Drawables_defocus(this);
 	remove();
 
+	delete _indexes;
+
 	if (bwindow) {
 		bwindow->LockLooper();
 		bwindow->Quit();
@@ -411,15 +470,23 @@ void
 XWindow::border_pixel(long border_color)
 {
 	LockLooper();
-	_border_color = _x_pixel_to_rgb(border_color);
+	_border_color = pixel_color(border_color);
 	Invalidate();
 	UnlockLooper();
 }
 
+void
+XWindow::visual(Visual* visual, int depth)
+{
+	_visual = visual;
+	_depth = depth;
+}
+
 color_space
 XWindow::colorspace()
 {
-	return BScreen(Window()).ColorSpace();
+	// Windows are always drawn in full color; only ARGB windows carry alpha.
+	return (_depth == 32) ? B_RGBA32 : B_RGB32;
 }
 
 int
@@ -494,6 +561,7 @@ XWindow::resize(BSize newSize)
 		return false; // Nothing to do.
 	}
 	_base_size = newSize;
+	forget_indexes();
 
 	ResizeTo(borderedSize);
 	if (bwindow)
@@ -514,6 +582,7 @@ XWindow::draw_border(BRect clipRect)
 		return;
 
 	LockLooper();
+	_x_reset_gc_clipping(this);
 
 	PushState();
 	SetOrigin(-_border_width, -_border_width);
@@ -532,6 +601,67 @@ XWindow::draw_border(BRect clipRect)
 	UnlockLooper();
 }
 
+void
+XWindow::store_indexes(const uint8* bits, int32 bytesPerRow, BRect srcRect, BPoint destPoint)
+{
+	const BRect bounds(B_ORIGIN, size());
+	if (_indexes == NULL || _indexes->Bounds() != bounds) {
+		delete _indexes;
+		_indexes = new BBitmap(bounds, 0, B_GRAY8);
+		_indexed.MakeEmpty();
+	}
+
+	const BRect destRect = srcRect.OffsetToCopy(destPoint) & bounds;
+	if (!destRect.IsValid())
+		return;
+	srcRect.OffsetBy(destRect.LeftTop() - destPoint);
+
+	const int32 width = destRect.IntegerWidth() + 1;
+	const uint8* source = bits + int32(srcRect.top) * bytesPerRow + int32(srcRect.left);
+	uint8* dest = (uint8*)_indexes->Bits() + int32(destRect.top) * _indexes->BytesPerRow()
+		+ int32(destRect.left);
+	for (int32 y = 0; y <= destRect.IntegerHeight(); y++) {
+		memcpy(dest, source, width);
+		source += bytesPerRow;
+		dest += _indexes->BytesPerRow();
+	}
+	_indexed.Include(destRect);
+}
+
+void
+XWindow::forget_indexes()
+{
+	_indexed.MakeEmpty();
+}
+
+void
+XWindow::expand_indexes(const uint32* palette, BRegion& expanded)
+{
+	// The looper must already be locked.
+	expanded.MakeEmpty();
+	if (_indexes == NULL || _indexes->Bounds() != BRect(B_ORIGIN, size()))
+		return;
+
+	_x_reset_gc_clipping(this);
+	PushState();
+	SetDrawingMode(B_OP_COPY);
+	for (int32 i = 0; i < _indexed.CountRects(); i++) {
+		const BRect rect = _indexed.RectAt(i);
+		BBitmap* scratch = scratch_bitmap_for(rect.Size(), B_RGB32);
+		const uint8* source = (const uint8*)_indexes->Bits()
+			+ int32(rect.top) * _indexes->BytesPerRow() + int32(rect.left);
+		uint8* dest = (uint8*)scratch->Bits();
+		for (int32 y = 0; y <= rect.IntegerHeight(); y++) {
+			PaletteExpander::expand(source, (uint32*)dest, rect.IntegerWidth() + 1, palette);
+			source += _indexes->BytesPerRow();
+			dest += scratch->BytesPerRow();
+		}
+		DrawBitmap(scratch, rect.OffsetToCopy(B_ORIGIN), rect);
+	}
+	PopState();
+	expanded = _indexed;
+}
+
 void
 XWindow::event_mask(long mask)
 {
@@ -613,6 +743,11 @@ XWindow::MessageReceived(BMessage* message)
 		_MouseEvent(ButtonPress, where, button);
 		_MouseEvent(ButtonRelease, where, button);
 	} break;
+
+	case B_FONTS_UPDATED:
+		// Only sent to windows, so the application may not see it.
+		_x_settings_changed(display());
+		break;
 	}
 
 	BView::MessageReceived(message);
@@ -901,7 +1036,7 @@ XWindow::KeyDown(const char* bytes, int32 numBytes)
 	if (!(event_mask() & KeyPressMask))
 		return;
 
-	_KeyEvent(KeyPress, bytes, numBytes);
+	_KeyEvent(KeyPress);
 }
 
 void
@@ -910,11 +1045,11 @@ XWindow::KeyUp(const char* bytes, int32 numBytes)
 	if (!(event_mask() & KeyPressMask))
 		return;
 
-	_KeyEvent(KeyRelease, bytes, numBytes);
+	_KeyEvent(KeyRelease);
 }
 
 void
-XWindow::_KeyEvent(int type, const char* bytes, int32 numBytes)
+XWindow::_KeyEvent(int type)
 {
 	BMessage* message = Looper()->CurrentMessage();
 
@@ -922,15 +1057,39 @@ XWindow::_KeyEvent(int type, const char* bytes, int32 numBytes)
 	event.type = type;
 	event.xkey.window = id();
 	event.xkey.time = _x_current_time();
-	_x_fill_key_event(&event, message, bytes, numBytes);
+	_x_fill_key_event(&event, message);
 	_x_put_event(display(), event);
 }
 
 // #pragma mark - XPixmap
 
+/* Bitmaps are rasterized in software by default, as their pixels are the ones most
+ * often relied on exactly (as clip masks, stipples and shapes.) Setting
+ * XLIBE_SOFTWARE_PIXMAPS to "all" or "none" changes that for every pixmap. */
+static bool
+software_by_default(unsigned int depth)
+{
+	static int sSoftware = -1;
+	if (sSoftware < 0) {
+		const char* setting = getenv("XLIBE_SOFTWARE_PIXMAPS");
+		if (setting != NULL && strcmp(setting, "all") == 0)
+			sSoftware = 1;
+		else if (setting != NULL && strcmp(setting, "none") == 0)
+			sSoftware = 0;
+		else
+			sSoftware = 2;
+	}
+	return (sSoftware == 2) ? (depth == 1) : (sSoftware == 1);
+}
+
 XPixmap::XPixmap(Display* dpy, BRect frame, unsigned int depth)
 	: XDrawable(dpy, frame)
 	, _depth((depth < 8) ? 8 : depth)
+	, _indexed(depth == 8)
+	, _one_bit(depth == 1)
+	, _software(software_by_default(depth))
+	, _dirty(false)
+	, _generation(0)
 {
 	resize(frame.Size());
 }
@@ -941,7 +1100,7 @@ XPixmap::~XPixmap()
 	RemoveSelf();
 	_offscreen->Unlock();
 
-	delete _offscreen;
+	BitmapPool::release(_offscreen);
 }
 
 color_space
@@ -950,6 +1109,19 @@ XPixmap::colorspace()
 	return _offscreen->ColorSpace();
 }
 
+rgb_color
+XPixmap::pixel_color(unsigned long pixel)
+{
+	// Indexed pixmaps store the pixel values themselves, which are only
+	// looked up in a colormap when they are copied to a window.
+	if (_indexed)
+		return make_color(pixel & 0xFF, pixel & 0xFF, pixel & 0xFF);
+	// Depth 1 pixmaps store 0xFF for set bits, as with XCreateBitmapFromData.
+	if (_one_bit)
+		return (pixel & 1) ? make_color(0xFF, 0xFF, 0xFF) : make_color(0, 0, 0);
+	return XDrawable::pixel_color(pixel);
+}
+
 bool
 XPixmap::resize(BSize newSize)
 {
@@ -958,21 +1130,67 @@ XPixmap::resize(BSize newSize)
 
 	if (_offscreen) {
 		RemoveSelf();
-		delete _offscreen;
+		BitmapPool::release(_offscreen);
 	}
 
-	_offscreen = new BBitmap(Frame(), _x_color_space_for(NULL, _depth), true);
-	memset(_offscreen->Bits(), 0, _offscreen->BitsLength());
+	// The contents of new pixmaps are undefined, so recycled bitmaps are not cleared.
+	const color_space colorSpace = _x_color_space_for_depth(_depth);
+	_offscreen = BitmapPool::acquire(Frame(), colorSpace);
+	if (_offscreen == NULL) {
+		_offscreen = new BBitmap(Frame(), colorSpace, true);
+		memset(_offscreen->Bits(), 0, _offscreen->BitsLength());
+		_dirty = false;
+	} else {
+		// There may still be drawing pending from the bitmap's previous owner.
+		_dirty = true;
+	}
 	_offscreen->AddChild(this);
+	mark_changed();
 	return true;
 }
 
 void
 XPixmap::sync()
 {
+	// Nothing needs to be waited for if nothing was drawn since the last sync.
+	if (!_dirty) {
+		sPixmapSyncsAvoided++;
+		return;
+	}
+
 	LockLooper();
+	_dirty = false;
 	Sync();
 	UnlockLooper();
+	sPixmapSyncs++;
+}
+
+/* Exchanges the contents of two pixmaps of the same size and depth, without copying. */
+void
+XPixmap::swap_offscreen(XPixmap* other)
+{
+	sync();
+	other->sync();
+
+	_offscreen->Lock();
+	RemoveSelf();
+	_offscreen->Unlock();
+	other->_offscreen->Lock();
+	other->RemoveSelf();
+	other->_offscreen->Unlock();
+
+	std::swap(_offscreen, other->_offscreen);
+	_offscreen->AddChild(this);
+	other->_offscreen->AddChild(other);
+	mark_changed();
+	other->mark_changed();
+}
+
+void
+XPixmap::sync_statistics(uint64& performed, uint64& avoided)
+{
+	performed = sPixmapSyncs;
+	avoided = sPixmapSyncsAvoided;
 }
 
 } // namespace BeXlib
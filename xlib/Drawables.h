@@ -4,13 +4,16 @@
  */
 #pragma once
 
+#include <interface/Region.h>
 #include <interface/View.h>
 #include <interface/Window.h>
 
+#include <atomic>
 #include <map>
 #include <list>
 
 #include "Event.h"
+#include "GC.h"
 
 extern "C" {
 #include <X11/Xlib.h>
@@ -41,6 +44,8 @@ public:
 	static XWindow* get_window(Window id);
 	static XPixmap* get_pixmap(Pixmap id);
 
+	static std::list<Window> windows();
+
 	static XWindow* focused();
 	static XWindow* pointer();
 	static XWindow* pointer_grab();
@@ -65,7 +70,9 @@ protected:
 
 public:
 	BBitmap* scratch_bitmap = NULL;
-	GC last_gc = NULL;
+	XPixmap* raster_op_mask = NULL;
+	GCState gc_state;
+	Colormap colormap = None;
 
 public:
 	XDrawable(Display* dpy, BRect rect);
@@ -73,6 +80,9 @@ public:
 
 	BView* view() { return this; }
 	virtual color_space colorspace() = 0;
+	virtual int depth() = 0;
+	virtual rgb_color pixel_color(unsigned long pixel);
+	BBitmap* scratch_bitmap_for(BSize size, color_space colorSpace);
 
 	Display* display() const { return _display; }
 	Drawable id() const { return _id; }
@@ -89,6 +99,9 @@ public:
 
 class XWindow : public XDrawable {
 private:
+	Visual* _visual;
+	int _depth;
+
 	rgb_color _border_color;
 	int _border_width;
 	BSize _min_size, _max_size;
@@ -98,6 +111,9 @@ private:
 	int last_buttons = 0;
 	bool current_focus = false;
 
+	BBitmap* _indexes = NULL;
+	BRegion _indexed;
+
 public:
 	BWindow* bwindow = NULL;
 
@@ -113,7 +129,11 @@ public:
 
 	void create_bwindow();
 
+	Visual* visual() { return _visual; }
+	void visual(Visual* visual, int depth);
+
 	virtual color_space colorspace() override;
+	virtual int depth() override { return _depth; }
 	int visibility(int oldState = -1);
 
 	void minimum_size(int width, int height);
@@ -126,6 +146,12 @@ public:
 	void border_pixel(long border_color);
 	void draw_border(BRect clipRect);
 
+	// The pixel values last copied in from indexed pixmaps and images, where
+	// nothing else was drawn since, so colormap changes can expand them again.
+	void store_indexes(const uint8* bits, int32 bytesPerRow, BRect srcRect, BPoint destPoint);
+	void forget_indexes();
+	void expand_indexes(const uint32* palette, BRegion& expanded);
+
 	long event_mask() { return _event_mask; }
 	void event_mask(long mask);
 
@@ -161,24 +187,46 @@ protected:
 
 	virtual	void KeyDown(const char* bytes, int32 numBytes) override;
 	virtual	void KeyUp(const char* bytes, int32 numBytes) override;
-	void _KeyEvent(int type, const char* bytes, int32 numBytes);
+	void _KeyEvent(int type);
 };
 
 class XPixmap : public XDrawable {
 private:
 	BBitmap* _offscreen = NULL;
 	int _depth;
+	bool _indexed;
+	bool _one_bit;
+	const bool _software;
+	std::atomic<bool> _dirty;
+	std::atomic<uint32> _generation;
 
 public:
 	XPixmap(Display* dpy, BRect frame, unsigned int depth);
 	virtual ~XPixmap() override;
 
 	virtual color_space colorspace() override;
+	virtual rgb_color pixel_color(unsigned long pixel) override;
 
-	int depth() { return _depth; }
+	virtual int depth() override { return _depth; }
+	bool indexed() { return _indexed; }
+	bool one_bit() { return _one_bit; }
 	BBitmap* offscreen() { return _offscreen; }
 
+	/* Whether drawing into the pixmap is rasterized straight into its bits (see
+	 * Rasterizer), rather than drawn with its view. This is decided by depth and
+	 * XLIBE_SOFTWARE_PIXMAPS when the pixmap is created, and never changes. */
+	bool software() { return _software; }
+
+	/* Changes whenever the contents might have. */
+	uint32 generation() { return _generation; }
+	/* Must be called after writing into the offscreen bitmap directly. */
+	void mark_changed() { _generation++; }
+
+	/* Must be called with the looper locked, before drawing into the pixmap. */
+	void mark_dirty() { _dirty = true; mark_changed(); }
 	void sync();
+	void swap_offscreen(XPixmap* other);
+	static void sync_statistics(uint64& performed, uint64& avoided);
 
 protected:
 	virtual bool resize(BSize newSize) override;
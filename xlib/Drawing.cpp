@@ -9,11 +9,23 @@
 #include <interface/Bitmap.h>
 #include <interface/Region.h>
 #include <interface/Polygon.h>
+#include <interface/Screen.h>
+
+#include <cmath>
+#include <list>
+#include <memory>
+#include <pthread.h>
 
 #include "Color.h"
 #include "Drawables.h"
 #include "Font.h"
 #include "GC.h"
+#include "Image.h"
+#include "Locking.h"
+#include "PaletteExpander.h"
+#include "Dasher.h"
+#include "RasterOp.h"
+#include "Rasterizer.h"
 
 extern "C" {
 #include <X11/Xlib.h>
@@ -23,32 +35,697 @@ extern "C" {
 #include "Debug.h"
 
 
+// #pragma mark - raster operations
+
+/* Records which pixels drawing covers, for the software raster operations:
+ * every pixel value is drawn as a set pixel. */
+class RasterOpMask : public XPixmap {
+public:
+	RasterOpMask(Display* dpy, BSize size)
+		: XPixmap(dpy, BRect(B_ORIGIN, size), 1) {}
+
+	virtual rgb_color pixel_color(unsigned long) override
+		{ return make_color(0xFF, 0xFF, 0xFF); }
+};
+
+static unsigned long
+all_planes(XDrawable* drawable)
+{
+	XPixmap* pixmap = dynamic_cast<XPixmap*>(drawable);
+	const int depth = (pixmap && pixmap->one_bit()) ? 1 : drawable->depth();
+	return (depth >= 32) ? 0xFFFFFFFFUL : ((1UL << depth) - 1);
+}
+
+/* Views only draw GXcopy exactly, and without plane masks. */
+static bool
+needs_raster_op(XDrawable* drawable, GC gc)
+{
+	const unsigned long planes = all_planes(drawable);
+	return gc->values.function != GXcopy || (gc->values.plane_mask & planes) != planes;
+}
+
+static int
+bytes_per_pixel(color_space colorSpace)
+{
+	switch (colorSpace) {
+	case B_GRAY8:	return 1;
+	case B_RGB16:	return 2;
+	case B_RGB32:
+	case B_RGBA32:	return 4;
+	default:		return 0;
+	}
+}
+
+/* Returns a pixel value and plane mask as they are stored in the drawable's bits.
+ * Windows are read back from the screen as B_RGB32. */
+static void
+stored_pixel(XDrawable* drawable, unsigned long pixel, unsigned long planes,
+	uint32& storedPixel, uint32& storedPlanes)
+{
+	XPixmap* pixmap = dynamic_cast<XPixmap*>(drawable);
+	if (pixmap == NULL) {
+		const rgb_color color = drawable->pixel_color(pixel);
+		storedPixel = (color.red << 16) | (color.green << 8) | color.blue;
+		// The planes of other visuals do not correspond to the screen's.
+		storedPlanes = (drawable->depth() == 24) ? (planes & 0xFFFFFF) : 0xFFFFFF;
+		return;
+	}
+
+	if (pixmap->one_bit()) {
+		storedPixel = (pixel & 1) ? 0xFF : 0;
+		storedPlanes = (planes & 1) ? 0xFF : 0;
+		return;
+	}
+	storedPixel = pixel;
+	storedPlanes = planes & all_planes(drawable);
+}
+
+static XPixmap*
+raster_op_mask(XDrawable* drawable)
+{
+	XPixmap* mask = drawable->raster_op_mask;
+	if (mask == NULL) {
+		mask = drawable->raster_op_mask = new RasterOpMask(drawable->display(), drawable->size());
+	} else if (!static_cast<XDrawable*>(mask)->resize(drawable->size())) {
+		// Masks are cleared after every use (see apply_raster_op.)
+		return mask;
+	}
+
+	BBitmap* bitmap = mask->offscreen();
+	memset(bitmap->Bits(), 0, bitmap->BitsLength());
+	mask->mark_changed();
+	return mask;
+}
+
+/* Returns the bounds of what was drawn into the mask. */
+static BRect
+mask_coverage(BBitmap* mask)
+{
+	const uint8* bits = (const uint8*)mask->Bits();
+	const int32 bytesPerRow = mask->BytesPerRow();
+	const int32 width = mask->Bounds().IntegerWidth() + 1,
+		height = mask->Bounds().IntegerHeight() + 1;
+
+	BRect coverage;
+	for (int32 y = 0; y < height; y++) {
+		const uint8* row = bits + y * bytesPerRow;
+		int32 left = 0, right = width - 1;
+		while (left <= right && row[left] == 0)
+			left++;
+		if (left > right)
+			continue;
+		while (row[right] == 0)
+			right--;
+
+		if (!coverage.IsValid()) {
+			coverage.Set(left, y, right, y);
+			continue;
+		}
+		if (left < coverage.left)
+			coverage.left = left;
+		if (right > coverage.right)
+			coverage.right = right;
+		coverage.bottom = y;
+	}
+	return coverage;
+}
+
+static inline int32
+positive_mod(int32 value, int32 divisor)
+{
+	const int32 result = value % divisor;
+	return (result < 0) ? (result + divisor) : result;
+}
+
+static void
+write_pixel(uint8* row, int32 x, int32 bytesPerPixel, uint32 value)
+{
+	switch (bytesPerPixel) {
+	case 1: row[x] = value; break;
+	case 2: ((uint16*)row)[x] = value; break;
+	case 4: ((uint32*)row)[x] = value; break;
+	}
+}
+
+// #pragma mark - fill patterns
+
+enum {
+	kPatternNone = 0,
+	kPatternPixels,		// in the color space the drawable's bits are combined in
+	kPatternCoverage,	// B_GRAY8, 0xFF where the stipple is set
+	kPatternAlpha,		// B_RGBA32, the foreground where the stipple is set
+};
+
+/* Patterns are expanded to at least this size, so that filling needs fewer blits. */
+static const int32 kMinimumPatternSize = 128;
+
+/* A tile or stipple, expanded for drawing into drawables. Pixel (0, 0) of the
+ * bitmap is drawn at the GC's tile/stipple origin. */
+struct FillPattern {
+	Pixmap pixmap;
+	uint32 generation;
+	bool tiled;
+	int kind;
+	color_space colorSpace;
+	unsigned long foreground, background;
+	Colormap colormap;
+	int depth;
+
+	BBitmap* bitmap;
+
+	~FillPattern() { delete bitmap; }
+};
+
+static const size_t kFillPatternsCacheSize = 16;
+static pthread_mutex_t sFillPatternsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::list<std::shared_ptr<FillPattern>> sFillPatterns;
+
+/* Stipples whose size evenly divides 8x8 can be drawn as native patterns, which
+ * are aligned to the view's origin rather than the GC's. */
+static bool
+native_stipple(GC gc, pattern& ptn)
+{
+	if (gc->values.fill_style != FillStippled && gc->values.fill_style != FillOpaqueStippled)
+		return false;
+
+	XPixmap* stipple = Drawables::get_pixmap(gc->values.stipple);
+	if (stipple == NULL || stipple->colorspace() != B_GRAY8)
+		return false;
+
+	BBitmap* bitmap = stipple->offscreen();
+	const int32 width = bitmap->Bounds().IntegerWidth() + 1,
+		height = bitmap->Bounds().IntegerHeight() + 1;
+	if ((8 % width) != 0 || (8 % height) != 0)
+		return false;
+
+	stipple->sync();
+	for (int32 y = 0; y < 8; y++) {
+		const uint8* row = (const uint8*)bitmap->Bits()
+			+ positive_mod(y - gc->values.ts_y_origin, height) * bitmap->BytesPerRow();
+		uint8 bits = 0;
+		for (int32 x = 0; x < 8; x++) {
+			if (row[positive_mod(x - gc->values.ts_x_origin, width)] & 0x80)
+				bits |= 0x80 >> x;
+		}
+		ptn.data[y] = bits;
+	}
+	return true;
+}
+
+/* Which pattern drawing with a GC needs besides what views can draw. Native opaque
+ * stipples cannot be used when what is drawn must be combined, as views then only
+ * draw what is covered. */
+static int
+pattern_kind(GC gc, bool nativeStipple, bool combined)
+{
+	switch (gc->values.fill_style) {
+	case FillTiled:
+		return kPatternPixels;
+	case FillOpaqueStippled:
+		return (nativeStipple && !combined) ? kPatternNone : kPatternPixels;
+	case FillStippled:
+		return nativeStipple ? kPatternNone : kPatternCoverage;
+	}
+	return kPatternNone;
+}
+
+static BBitmap*
+expand_pattern(XDrawable* drawable, XPixmap* source, const FillPattern& key)
+{
+	BBitmap* bits = source->offscreen();
+	const int32 width = bits->Bounds().IntegerWidth() + 1,
+		height = bits->Bounds().IntegerHeight() + 1;
+	const int32 bytesPerPixel = bytes_per_pixel(key.colorSpace);
+	if (bytesPerPixel == 0)
+		return NULL;
+
+	const int32 columns = (kMinimumPatternSize + width - 1) / width,
+		rows = (kMinimumPatternSize + height - 1) / height;
+	BBitmap* bitmap = new BBitmap(BRect(0, 0, width * columns - 1, height * rows - 1),
+		0, key.colorSpace);
+	const int32 bytesPerRow = bitmap->BytesPerRow();
+	uint8* dest = (uint8*)bitmap->Bits();
+
+	if (key.tiled) {
+		const std::shared_ptr<XColormap> colormap
+			= source->indexed() ? _x_colormap(key.colormap) : NULL;
+		if (bits->ColorSpace() == key.colorSpace) {
+			for (int32 y = 0; y < height; y++) {
+				memcpy(dest + y * bytesPerRow, (const uint8*)bits->Bits() + y * bits->BytesPerRow(),
+					width * bytesPerPixel);
+			}
+		} else if (colormap != NULL && key.colorSpace == B_RGB32) {
+			PthreadReadLocker rdlock(colormap->lock);
+			for (int32 y = 0; y < height; y++) {
+				PaletteExpander::expand((const uint8*)bits->Bits() + y * bits->BytesPerRow(),
+					(uint32*)(dest + y * bytesPerRow), width, colormap->palette);
+			}
+		} else if (dynamic_cast<XPixmap*>(drawable) != NULL
+				|| bitmap->ImportBits(bits, B_ORIGIN, B_ORIGIN, width, height) != B_OK) {
+			// Tiles must have the depth of the pixmaps they are drawn into.
+			delete bitmap;
+			return NULL;
+		}
+	} else {
+		if (bits->ColorSpace() != B_GRAY8) {
+			delete bitmap;
+			return NULL;
+		}
+
+		uint32 set = 0xFF, unset = 0, planes;
+		if (key.kind == kPatternAlpha) {
+			const rgb_color color = drawable->pixel_color(key.foreground);
+			set = (0xFFu << 24) | (color.red << 16) | (color.green << 8) | color.blue;
+		} else if (key.kind == kPatternPixels) {
+			stored_pixel(drawable, key.foreground, 0, set, planes);
+			stored_pixel(drawable, key.background, 0, unset, planes);
+		}
+
+		for (int32 y = 0; y < height; y++) {
+			const uint8* row = (const uint8*)bits->Bits() + y * bits->BytesPerRow();
+			for (int32 x = 0; x < width; x++)
+				write_pixel(dest + y * bytesPerRow, x, bytesPerPixel, (row[x] & 0x80) ? set : unset);
+		}
+	}
+
+	// Repeat the first repetition over the rest of the bitmap.
+	for (int32 y = 0; y < height; y++) {
+		uint8* row = dest + y * bytesPerRow;
+		for (int32 column = 1; column < columns; column++)
+			memcpy(row + column * width * bytesPerPixel, row, width * bytesPerPixel);
+	}
+	for (int32 y = height; y < height * rows; y++)
+		memcpy(dest + y * bytesPerRow, dest + (y - height) * bytesPerRow, bytesPerRow);
+
+	return bitmap;
+}
+
+/* Returns the GC's tile or stipple, expanded for drawing into the drawable.
+ * Expansions are cached, by the contents of the pixmap and the colors used. */
+static std::shared_ptr<FillPattern>
+fill_pattern(XDrawable* drawable, GC gc, int kind)
+{
+	const bool tiled = (gc->values.fill_style == FillTiled);
+	XPixmap* source = Drawables::get_pixmap(tiled ? gc->values.tile : gc->values.stipple);
+	if (source == NULL)
+		return NULL;
+	source->sync();
+
+	// Only what the expansion depends on is part of the key.
+	FillPattern key = {};
+	key.pixmap = source->id();
+	key.generation = source->generation();
+	key.tiled = tiled;
+	key.kind = kind;
+	const bool window = (dynamic_cast<XPixmap*>(drawable) == NULL);
+	switch (kind) {
+	case kPatternPixels:	key.colorSpace = window ? B_RGB32 : drawable->colorspace(); break;
+	case kPatternCoverage:	key.colorSpace = B_GRAY8; break;
+	case kPatternAlpha:		key.colorSpace = B_RGBA32; break;
+	}
+	if (kind == kPatternAlpha || (kind == kPatternPixels && !tiled))
+		key.foreground = gc->values.foreground;
+	if (kind == kPatternPixels && !tiled)
+		key.background = gc->values.background;
+	if (window) {
+		key.colormap = drawable->colormap;
+		key.depth = drawable->depth();
+	}
+
+	pthread_mutex_lock(&sFillPatternsLock);
+	for (auto it = sFillPatterns.begin(); it != sFillPatterns.end(); it++) {
+		const FillPattern& entry = **it;
+		if (entry.pixmap != key.pixmap || entry.tiled != key.tiled || entry.kind != key.kind
+				|| entry.colorSpace != key.colorSpace || entry.foreground != key.foreground
+				|| entry.background != key.background || entry.colormap != key.colormap
+				|| entry.depth != key.depth)
+			continue;
+
+		if (entry.generation == key.generation) {
+			sFillPatterns.splice(sFillPatterns.begin(), sFillPatterns, it);
+			std::shared_ptr<FillPattern> result = *it;
+			pthread_mutex_unlock(&sFillPatternsLock);
+			return result;
+		}
+		sFillPatterns.erase(it);
+		break;
+	}
+	pthread_mutex_unlock(&sFillPatternsLock);
+
+	BBitmap* bitmap = expand_pattern(drawable, source, key);
+	if (bitmap == NULL)
+		return NULL;
+
+	std::shared_ptr<FillPattern> result = std::make_shared<FillPattern>(key);
+	result->bitmap = bitmap;
+
+	pthread_mutex_lock(&sFillPatternsLock);
+	sFillPatterns.push_front(result);
+	if (sFillPatterns.size() > kFillPatternsCacheSize)
+		sFillPatterns.pop_back();
+	pthread_mutex_unlock(&sFillPatternsLock);
+	return result;
+}
+
+/* Combines a row of the drawable's pixels with the foreground, or with the fill
+ * pattern if there is one, using the GC's function and plane mask. "x" and "y" are
+ * where the row is in the drawable, to align the pattern. If "mask" is not NULL,
+ * only pixels whose mask byte has its high bit set are changed. */
+static void
+combine_row(GC gc, const FillPattern* fill, uint32 pixel, uint32 planes, int32 bytesPerPixel,
+	int32 x, int32 y, const uint8* mask, uint8* dest, int32 width)
+{
+	const int function = gc->values.function;
+	if (fill == NULL) {
+		RasterOp::apply(function, bytesPerPixel, NULL, pixel, mask, planes, dest, width);
+		return;
+	}
+
+	BBitmap* bitmap = fill->bitmap;
+	const int32 patternWidth = bitmap->Bounds().IntegerWidth() + 1,
+		patternHeight = bitmap->Bounds().IntegerHeight() + 1;
+	const uint8* patternRow = (const uint8*)bitmap->Bits()
+		+ positive_mod(y - gc->values.ts_y_origin, patternHeight) * bitmap->BytesPerRow();
+	int32 patternX = positive_mod(x - gc->values.ts_x_origin, patternWidth);
+
+	uint8 coverage[256];
+	for (int32 i = 0; i < width; ) {
+		int32 count = min_c(patternWidth - patternX, width - i);
+		if (fill->kind == kPatternCoverage) {
+			// The stipple limits what is changed; the foreground is used as is.
+			count = min_c(count, int32(sizeof(coverage)));
+			for (int32 j = 0; j < count; j++)
+				coverage[j] = (mask ? mask[i + j] : 0xFF) & patternRow[patternX + j];
+			RasterOp::apply(function, bytesPerPixel, NULL, pixel, coverage, planes,
+				dest + i * bytesPerPixel, count);
+		} else {
+			RasterOp::apply(function, bytesPerPixel, patternRow + patternX * bytesPerPixel, 0,
+				mask ? (mask + i) : NULL, planes, dest + i * bytesPerPixel, count);
+		}
+
+		i += count;
+		patternX = (patternX + count) % patternWidth;
+	}
+}
+
+/* Draws the pattern repeatedly over the rectangle, aligned to the origin. */
+static void
+draw_tiled(BView* view, BBitmap* bitmap, const BRect& rect, const BPoint& origin)
+{
+	const int32 width = bitmap->Bounds().IntegerWidth() + 1,
+		height = bitmap->Bounds().IntegerHeight() + 1;
+	// The phase is where in the pattern the rectangle starts.
+	view->DrawTiledBitmapAsync(bitmap, rect,
+		BPoint(positive_mod(int32(rect.left - origin.x), width),
+			positive_mod(int32(rect.top - origin.y), height)));
+}
+
+// #pragma mark - combining
+
+/* Clears what was drawn into a mask, for its next use. */
+static void
+clear_mask(XPixmap* mask, const BRect& coverage)
+{
+	BBitmap* bitmap = mask->offscreen();
+	const int32 left = int32(coverage.left), width = coverage.IntegerWidth() + 1;
+	for (int32 y = int32(coverage.top); y <= int32(coverage.bottom); y++)
+		memset((uint8*)bitmap->Bits() + y * bitmap->BytesPerRow() + left, 0, width);
+	mask->mark_changed();
+}
+
+/* Combines the foreground or fill pattern with the pixels drawn into the mask, using
+ * the GC's function and plane mask; then clears the mask again. Windows are read back
+ * from the screen, combined, and drawn again. Must be called with the looper locked.
+ *
+ * If the bounds of what was drawn are known, the mask is not searched for them; and
+ * if "clipping" is set, only what is inside it is combined (as for masks which were
+ * not drawn into with views, which would have clipped already.) */
+static void
+apply_raster_op(XDrawable* drawable, GC gc, XPixmap* mask, int patternKind,
+	const BRect* drawn = NULL, const BRegion* clipping = NULL)
+{
+	mask->sync();
+	BBitmap* maskBitmap = mask->offscreen();
+	const BRect coverage = drawn ? *drawn : mask_coverage(maskBitmap);
+	if (!coverage.IsValid())
+		return;
+
+	uint32 pixel, planes;
+	stored_pixel(drawable, gc->values.foreground, gc->values.plane_mask, pixel, planes);
+	std::shared_ptr<FillPattern> fill;
+	if (patternKind != kPatternNone)
+		fill = fill_pattern(drawable, gc, patternKind);
+
+	XPixmap* pixmap = dynamic_cast<XPixmap*>(drawable);
+	BBitmap* bitmap;
+	BPoint origin;
+	if (pixmap != NULL) {
+		pixmap->sync();
+		bitmap = pixmap->offscreen();
+		origin = coverage.LeftTop();
+	} else {
+		// Make sure everything drawn so far has reached the screen.
+		BView* view = drawable->view();
+		view->Sync();
+
+		bitmap = drawable->scratch_bitmap_for(coverage.Size(), B_RGB32);
+		BRect screenRect = view->ConvertToScreen(coverage);
+		if (BScreen().ReadBitmap(bitmap, false, &screenRect) != B_OK)
+			bitmap = NULL;
+	}
+
+	const int32 bytesPerPixel = bitmap ? bytes_per_pixel(bitmap->ColorSpace()) : 0;
+	const int32 count = (bytesPerPixel == 0) ? 0 : (clipping ? clipping->CountRects() : 1);
+	for (int32 i = 0; i < count; i++) {
+		const BRect rect = clipping ? (clipping->RectAt(i) & coverage) : coverage;
+		if (!rect.IsValid())
+			continue;
+
+		const int32 left = int32(rect.left), width = rect.IntegerWidth() + 1;
+		for (int32 y = int32(rect.top); y <= int32(rect.bottom); y++) {
+			const uint8* maskRow = (const uint8*)maskBitmap->Bits()
+				+ y * maskBitmap->BytesPerRow() + left;
+			uint8* row = (uint8*)bitmap->Bits()
+				+ int32(y - coverage.top + origin.y) * bitmap->BytesPerRow()
+				+ int32(left - coverage.left + origin.x) * bytesPerPixel;
+			combine_row(gc, fill.get(), pixel, planes, bytesPerPixel, left, y,
+				maskRow, row, width);
+		}
+	}
+
+	clear_mask(mask, coverage);
+
+	if (bytesPerPixel == 0)
+		return;
+	if (pixmap != NULL) {
+		pixmap->mark_changed();
+		return;
+	}
+
+	// The GC's clipping was already applied to the mask.
+	BView* view = drawable->view();
+	_x_reset_gc_clipping(drawable);
+	view->PushState();
+	view->SetDrawingMode(B_OP_COPY);
+	view->DrawBitmap(bitmap, coverage.OffsetToCopy(B_ORIGIN), coverage);
+	view->PopState();
+}
+
+/* Draws the fill pattern into a window where the mask is set, as a bitmap which is
+ * transparent elsewhere; then clears the mask again. Unlike apply_raster_op, the
+ * screen is not read back, so this is only for GXcopy with all planes. Must be
+ * called with the looper locked. */
+static void
+draw_through_mask(XDrawable* drawable, GC gc, XPixmap* mask, int patternKind)
+{
+	mask->sync();
+	BBitmap* maskBitmap = mask->offscreen();
+	const BRect coverage = mask_coverage(maskBitmap);
+	if (!coverage.IsValid())
+		return;
+
+	// Stipples are expanded to the foreground where they are set, and transparency
+	// elsewhere; tiles are opaque.
+	std::shared_ptr<FillPattern> fill = fill_pattern(drawable, gc,
+		(patternKind == kPatternCoverage) ? kPatternAlpha : patternKind);
+	BBitmap* bitmap = NULL;
+	if (fill && bytes_per_pixel(fill->bitmap->ColorSpace()) == 4) {
+		bitmap = drawable->scratch_bitmap_for(coverage.Size(), B_RGBA32);
+
+		BBitmap* patternBitmap = fill->bitmap;
+		const int32 patternWidth = patternBitmap->Bounds().IntegerWidth() + 1,
+			patternHeight = patternBitmap->Bounds().IntegerHeight() + 1;
+		const uint32 opaque = (fill->kind == kPatternAlpha) ? 0 : 0xFF000000;
+		const int32 left = int32(coverage.left), width = coverage.IntegerWidth() + 1;
+		for (int32 y = int32(coverage.top); y <= int32(coverage.bottom); y++) {
+			const uint8* maskRow = (const uint8*)maskBitmap->Bits()
+				+ y * maskBitmap->BytesPerRow() + left;
+			const uint32* patternRow = (const uint32*)((const uint8*)patternBitmap->Bits()
+				+ positive_mod(y - gc->values.ts_y_origin, patternHeight)
+					* patternBitmap->BytesPerRow());
+			uint32* row = (uint32*)((uint8*)bitmap->Bits()
+				+ int32(y - coverage.top) * bitmap->BytesPerRow());
+			int32 patternX = positive_mod(left - gc->values.ts_x_origin, patternWidth);
+			for (int32 x = 0; x < width; x++) {
+				row[x] = (maskRow[x] & 0x80) ? (patternRow[patternX] | opaque) : 0;
+				if (++patternX == patternWidth)
+					patternX = 0;
+			}
+		}
+	}
+
+	clear_mask(mask, coverage);
+	if (bitmap == NULL)
+		return;
+
+	// The GC's clipping was already applied to the mask.
+	BView* view = drawable->view();
+	_x_reset_gc_clipping(drawable);
+	view->PushState();
+	view->SetDrawingMode(B_OP_ALPHA);
+	view->SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+	view->DrawBitmap(bitmap, coverage.OffsetToCopy(B_ORIGIN), coverage);
+	view->PopState();
+}
+
+/* Combines a source bitmap of the pixmap's color space into it, using the GC's
+ * function and plane mask. Returns false if this cannot be done. */
+static bool
+apply_raster_op(XPixmap* pixmap, GC gc, BBitmap* source, BRect srcRect, BPoint destPoint)
+{
+	BBitmap* bitmap = pixmap->offscreen();
+	const int32 bytesPerPixel = bytes_per_pixel(bitmap->ColorSpace());
+	if (source->ColorSpace() != bitmap->ColorSpace() || bytesPerPixel == 0
+			|| _x_gc_has_clipping(gc))
+		return false;
+
+	// Clip to both bitmaps, keeping where the source is relative to the destination.
+	const BPoint offset = destPoint - srcRect.LeftTop();
+	srcRect = srcRect & source->Bounds();
+	const BRect destRect = srcRect.OffsetByCopy(offset) & bitmap->Bounds();
+	srcRect = destRect.OffsetByCopy(B_ORIGIN - offset);
+	if (!destRect.IsValid())
+		return true;
+
+	pixmap->sync();
+	uint32 pixel, planes;
+	stored_pixel(pixmap, 0, gc->values.plane_mask, pixel, planes);
+
+	const int32 width = destRect.IntegerWidth() + 1, height = destRect.IntegerHeight() + 1;
+	const int32 rowBytes = width * bytesPerPixel;
+	// Rows of a bitmap copied onto itself may overlap.
+	uint8* buffer = (source == bitmap) ? new uint8[rowBytes] : NULL;
+	const bool upwards = (source == bitmap) && destRect.top > srcRect.top;
+	for (int32 i = 0; i < height; i++) {
+		const int32 y = upwards ? (height - 1 - i) : i;
+		const uint8* sourceRow = (const uint8*)source->Bits()
+			+ (int32(srcRect.top) + y) * source->BytesPerRow()
+			+ int32(srcRect.left) * bytesPerPixel;
+		uint8* row = (uint8*)bitmap->Bits() + (int32(destRect.top) + y) * bitmap->BytesPerRow()
+			+ int32(destRect.left) * bytesPerPixel;
+		if (buffer != NULL) {
+			memcpy(buffer, sourceRow, rowBytes);
+			sourceRow = buffer;
+		}
+		RasterOp::apply(gc->values.function, bytesPerPixel, sourceRow, 0, NULL, planes, row, width);
+	}
+	delete[] buffer;
+
+	pixmap->mark_changed();
+	return true;
+}
+
+// #pragma mark - drawing
+
 class DrawStateManager
 {
 	XDrawable* _drawable;
 	GC _gc;
+	XPixmap* _mask = NULL;
+	Rasterizer* _rasterizer = NULL;
+	int _pattern_kind = kPatternNone;
+	bool _raster_op = false;
+	bool _kept_indexes = false;
+	pattern _pattern = B_SOLID_HIGH;
 
 public:
-	DrawStateManager(Drawable w, GC gc)
+	/* Drawing which only uses the GC's colors and fill ("solid" drawing) goes into a
+	 * mask instead, if it needs the software raster operations or a fill pattern
+	 * which views cannot draw. For pixmaps rasterized in software, it is rasterized
+	 * into the mask, unless "rasterize" is unset (for what the rasterizer cannot do.) */
+	DrawStateManager(Drawable w, GC gc, bool solid = true, bool rasterize = true)
+		: _gc(gc)
 	{
 		_drawable = Drawables::get(w);
-		_gc = gc;
 		if (!_drawable)
 			return;
 
 		if (!_drawable->view()->LockLooper())
 			debugger("Xlibe DrawStateManager: LockLooper failed!");
-		_x_check_gc(_drawable, gc);
+
+		XPixmap* pixmap = dynamic_cast<XPixmap*>(_drawable);
+		if (solid && rasterize && pixmap != NULL && pixmap->software()) {
+			// The view is not used at all, so the GC is not applied to it.
+			_mask = raster_op_mask(_drawable);
+			_pattern_kind = pattern_kind(gc, false, true);
+			BBitmap* bitmap = _mask->offscreen();
+			_rasterizer = new Rasterizer((uint8*)bitmap->Bits(), bitmap->BytesPerRow(),
+				bitmap->Bounds().IntegerWidth() + 1, bitmap->Bounds().IntegerHeight() + 1);
+			return;
+		}
+
+		XDrawable* target = _drawable;
+		bool stippled = false;
+		if (solid) {
+			const bool nativeStipple = native_stipple(gc, _pattern);
+			_raster_op = needs_raster_op(_drawable, gc);
+			_pattern_kind = pattern_kind(gc, nativeStipple, _raster_op);
+			if (_raster_op || _pattern_kind != kPatternNone) {
+				target = _mask = raster_op_mask(_drawable);
+				_mask->view()->LockLooper();
+			}
+			stippled = nativeStipple && gc->values.fill_style == FillStippled;
+		}
+
+		if (XPixmap* pixmap = dynamic_cast<XPixmap*>(target))
+			pixmap->mark_dirty();
+		_x_check_gc(target, gc);
+
+		if (_mask != NULL || stippled) {
+			// Masks only record what was drawn, whatever the function;
+			// and only the set bits of stipples are drawn.
+			target->view()->SetDrawingMode(stippled ? B_OP_OVER : B_OP_COPY);
+			target->gc_state.invalidate(GCFunction);
+		}
 	}
 	~DrawStateManager()
 	{
 		if (!_drawable)
 			return;
 
-		if (_x_gc_has_clipping(_gc)) {
-			_drawable->view()->ConstrainClippingRegion(NULL);
-			_gc->dirty |= GCClipMask;
+		if (_rasterizer) {
+			const Rasterizer::Rect& drawn = _rasterizer->drawn();
+			if (drawn.left <= drawn.right) {
+				const BRect rect(drawn.left, drawn.top, drawn.right, drawn.bottom);
+				apply_raster_op(_drawable, _gc, _mask, _pattern_kind, &rect,
+					_x_gc_clip_region(_gc));
+			}
+			delete _rasterizer;
+		} else if (_mask) {
+			_mask->view()->UnlockLooper();
+			// Patterns can be drawn into windows without reading the screen back.
+			if (!_raster_op && dynamic_cast<XPixmap*>(_drawable) == NULL)
+				draw_through_mask(_drawable, _gc, _mask, _pattern_kind);
+			else
+				apply_raster_op(_drawable, _gc, _mask, _pattern_kind);
 		}
+
+		// Windows only keep indexes where nothing else was drawn over them.
+		XWindow* window = dynamic_cast<XWindow*>(_drawable);
+		if (window != NULL && !_kept_indexes)
+			window->forget_indexes();
+
+		// Any clipping is left in place, for the next call with the same GC.
 		_drawable->view()->UnlockLooper();
 	}
 
@@ -57,30 +734,334 @@ public:
 	{
 		if (!_drawable)
 			return NULL;
+		if (_rasterizer)
+			debugger("Xlibe DrawStateManager: view used for rasterized drawing!");
+		if (_mask)
+			return _mask->view();
 		return _drawable->view();
 	}
-};
+	const pattern& drawing_pattern() { return _pattern; }
+	bool solid_pattern()
+		{ return memcmp(&_pattern, &B_SOLID_HIGH, sizeof(pattern)) == 0; }
+
+	/* Set if drawing must be rasterized rather than drawn with the view. */
+	Rasterizer* rasterizer() { return _rasterizer; }
 
+	/* Called after indexes were expanded into the drawable, so that windows keep
+	 * them if they were copied as they are. */
+	void keep_indexes(const uint8* bits, int32 bytesPerRow, const BRect& srcRect,
+		const BPoint& destPoint)
+	{
+		XWindow* window = dynamic_cast<XWindow*>(_drawable);
+		if (window == NULL || _gc->values.function != GXcopy || _x_gc_has_clipping(_gc))
+			return;
+		window->store_indexes(bits, bytesPerRow, srcRect, destPoint);
+		_kept_indexes = true;
+	}
+};
 
-static pattern
-pattern_for(GC gc)
+/* Fills rectangles with a tile or stipple, or with the raster operations, without
+ * drawing them into a mask first. Returns false if they must be drawn normally. */
+static bool
+fill_rectangles(Drawable w, GC gc, XRectangle* rects, int n)
 {
+	XDrawable* drawable = Drawables::get(w);
+	if (drawable == NULL)
+		return false;
+
+	const bool rasterOp = needs_raster_op(drawable, gc);
+	XPixmap* pixmap = dynamic_cast<XPixmap*>(drawable);
+	if (pixmap != NULL) {
+		// Pixmaps are filled in software, for which clipping is left to the mask.
+		const int kind = pattern_kind(gc, false, true);
+		if ((!rasterOp && kind == kPatternNone && !pixmap->software())
+				|| _x_gc_has_clipping(gc))
+			return false;
+
+		std::shared_ptr<FillPattern> fill;
+		if (kind != kPatternNone && !(fill = fill_pattern(drawable, gc, kind)))
+			return false;
+
+		uint32 pixel, planes;
+		stored_pixel(drawable, gc->values.foreground, gc->values.plane_mask, pixel, planes);
+
+		BView* view = pixmap->view();
+		view->LockLooper();
+		pixmap->sync();
+		BBitmap* bitmap = pixmap->offscreen();
+		const int32 bytesPerPixel = bytes_per_pixel(bitmap->ColorSpace());
+		for (int i = 0; i < n && bytesPerPixel != 0; i++) {
+			const BRect rect = brect_from_xrect(rects[i]) & bitmap->Bounds();
+			if (!rect.IsValid())
+				continue;
+
+			const int32 left = int32(rect.left), width = rect.IntegerWidth() + 1;
+			for (int32 y = int32(rect.top); y <= int32(rect.bottom); y++) {
+				uint8* row = (uint8*)bitmap->Bits() + y * bitmap->BytesPerRow()
+					+ left * bytesPerPixel;
+				combine_row(gc, fill.get(), pixel, planes, bytesPerPixel, left, y, NULL, row, width);
+			}
+		}
+		pixmap->mark_changed();
+		view->UnlockLooper();
+		return true;
+	}
+
+	// Windows would have to be read back from the screen to be combined.
 	pattern ptn;
-	switch (gc->values.fill_style) {
-	default:
-	case FillSolid:
-		ptn = B_SOLID_HIGH;
-	break;
-	case FillTiled:
-	case FillStippled:
-		// TODO: proper implementation?
-	case FillOpaqueStippled:
-		ptn = B_MIXED_COLORS;
-	break;
+	const int kind = pattern_kind(gc, native_stipple(gc, ptn), false);
+	if (rasterOp || kind == kPatternNone)
+		return false;
+
+	std::shared_ptr<FillPattern> fill = fill_pattern(drawable, gc,
+		(kind == kPatternCoverage) ? kPatternAlpha : kind);
+	if (!fill)
+		return false;
+
+	DrawStateManager stateManager(w, gc, false);
+	BView* view = stateManager.view();
+	view->PushState();
+	if (fill->kind == kPatternAlpha) {
+		view->SetDrawingMode(B_OP_ALPHA);
+		view->SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+	} else {
+		view->SetDrawingMode(B_OP_COPY);
+	}
+	const BPoint origin(gc->values.ts_x_origin, gc->values.ts_y_origin);
+	for (int i = 0; i < n; i++)
+		draw_tiled(view, fill->bitmap, brect_from_xrect(rects[i]), origin);
+	view->PopState();
+	return true;
+}
+
+// #pragma mark - dashes
+
+static const size_t kLineArrayBatch = 512;
+
+/* Strokes lines with the GC's dashes, in batches of line arrays: on dashes in the
+ * high color, and for LineDoubleDash, off dashes in the low color. */
+class DashedLines {
+	BView* _view;
+	const bool _double_dash;
+	Dasher _dasher;
+	std::vector<Dasher::Dash> _dashes;
+
+public:
+	DashedLines(BView* view, GC gc)
+		: _view(view)
+		, _double_dash(gc->values.line_style == LineDoubleDash)
+		, _dasher(dasher_for(gc))
+	{
+		_dashes.reserve(kLineArrayBatch);
+	}
+	~DashedLines()
+	{
+		flush();
+	}
+
+	/* Begins a new line, so that the dashes start again from the dash offset. */
+	void restart()
+	{
+		_dasher.restart();
+	}
+
+	void add(const BPoint& from, const BPoint& to)
+	{
+		_dasher.add(from.x, from.y, to.x, to.y, _dashes, _double_dash);
+		if (_dashes.size() >= kLineArrayBatch)
+			flush();
+	}
+
+	void flush()
+	{
+		const rgb_color high = _view->HighColor(), low = _view->LowColor();
+		for (size_t i = 0; i < _dashes.size(); i += kLineArrayBatch) {
+			const size_t count = min_c(_dashes.size() - i, kLineArrayBatch);
+			_view->BeginLineArray(count);
+			for (size_t j = i; j < i + count; j++) {
+				const Dasher::Dash& dash = _dashes[j];
+				_view->AddLine(BPoint(dash.x1, dash.y1), BPoint(dash.x2, dash.y2),
+					dash.on ? high : low);
+			}
+			_view->EndLineArray();
+		}
+		_dashes.clear();
+	}
+
+private:
+	static Dasher dasher_for(GC gc)
+	{
+		int count;
+		const unsigned char* dashes = _x_gc_dashes(gc, count);
+		return Dasher(dashes, count, gc->values.dash_offset, gc->values.line_width == 0);
+	}
+};
+
+// #pragma mark - rasterizing
+
+/* Whether the rasterizer can draw lines in the GC's style. It only draws in one
+ * color, so the off dashes of double dashes are left to views. */
+static bool
+rasterizable_lines(GC gc)
+{
+	return gc->values.line_style != LineDoubleDash;
+}
+
+/* Rasterizes lines with the GC's width, caps, joins and dashes. Zero-width lines
+ * are dashed by the rasterizer a pixel at a time; wide ones dash by dash. */
+class RasterizedLines {
+	Rasterizer* _rasterizer;
+	GC _gc;
+	std::unique_ptr<Dasher> _dasher;
+	std::vector<Dasher::Dash> _dashes;
+
+public:
+	RasterizedLines(Rasterizer* rasterizer, GC gc)
+		: _rasterizer(rasterizer)
+		, _gc(gc)
+	{
+		if (gc->values.line_style == LineSolid)
+			return;
+
+		int count;
+		const unsigned char* dashes = _x_gc_dashes(gc, count);
+		if (gc->values.line_width == 0)
+			_rasterizer->set_dashes(dashes, count, gc->values.dash_offset);
+		else
+			_dasher.reset(new Dasher(dashes, count, gc->values.dash_offset, false));
+	}
+
+	/* Begins a new line, so that the dashes start again from the dash offset. */
+	void restart()
+	{
+		if (_dasher)
+			_dasher->restart();
+		else
+			_rasterizer->restart_dashes();
+	}
+
+	/* Adds a polyline. The final point of closed ones is their first, which is
+	 * already drawn. */
+	void add(const Rasterizer::Point* points, int32 count, bool closed = false)
+	{
+		const XGCValues& values = _gc->values;
+		if (values.line_width == 0) {
+			_rasterizer->lines(points, count, !closed && values.cap_style != CapNotLast);
+			return;
+		}
+		if (!_dasher) {
+			_rasterizer->wide_lines(points, count, values.line_width,
+				values.cap_style, values.join_style);
+			return;
+		}
+
+		// Every dash has caps of its own.
+		for (int32 i = 0; i < (count - 1); i++) {
+			_dasher->add(points[i].x, points[i].y, points[i + 1].x, points[i + 1].y,
+				_dashes, false);
+		}
+		for (const Dasher::Dash& dash : _dashes) {
+			_rasterizer->wide_line(dash.x1, dash.y1, dash.x2, dash.y2,
+				values.line_width, values.cap_style);
+		}
+		_dashes.clear();
+	}
+};
+
+/* Rasterizes into a mask covering only part of a drawable, and then fills what was
+ * rasterized with the view as one region; for shapes which views do not draw with
+ * the pixels the X11 protocol says they cover. */
+class RasterizedRegion {
+	const int32 _left, _top, _width, _height;
+	std::vector<uint8> _bits;
+	Rasterizer _rasterizer;
+
+public:
+	/* "bounds" must already be within the drawable. */
+	RasterizedRegion(const BRect& bounds)
+		: _left(int32(bounds.left))
+		, _top(int32(bounds.top))
+		, _width(bounds.IsValid() ? (bounds.IntegerWidth() + 1) : 0)
+		, _height(bounds.IsValid() ? (bounds.IntegerHeight() + 1) : 0)
+		, _bits(_width * _height)
+		, _rasterizer(_bits.data(), _width, _width, _height)
+	{
+		_rasterizer.set_origin(_left, _top);
+	}
+
+	Rasterizer* rasterizer() { return &_rasterizer; }
+
+	void fill(BView* view, const pattern& ptn)
+	{
+		const Rasterizer::Rect& drawn = _rasterizer.drawn();
+		if (drawn.left > drawn.right)
+			return;
+
+		// Only what was drawn is scanned.
+		BRegion region;
+		_x_region_for_mask_bits(_bits.data() + (drawn.top - _top) * _width + (drawn.left - _left),
+			_width, drawn.right - drawn.left + 1, drawn.bottom - drawn.top + 1,
+			drawn.left, drawn.top, region);
+		view->FillRegion(&region, ptn);
+	}
+};
+
+/* Whether the rasterizer can draw arcs in the GC's style. Dashes only follow
+ * zero-width arcs. */
+static bool
+rasterizable_arcs(GC gc)
+{
+	return rasterizable_lines(gc)
+		&& (gc->values.line_width == 0 || gc->values.line_style == LineSolid);
+}
+
+/* Returns the bounds of the arcs, drawn with lines of this width, within the drawable. */
+static BRect
+arcs_bounds(XDrawable* drawable, const XArc* arcs, int n, int lineWidth)
+{
+	// Projecting caps reach out less than the width; and a pixel more for rounding.
+	const float outset = lineWidth + 1;
+	BRect bounds;
+	for (int i = 0; i < n; i++) {
+		const BRect rect(arcs[i].x - outset, arcs[i].y - outset,
+			arcs[i].x + arcs[i].width + outset, arcs[i].y + arcs[i].height + outset);
+		bounds = bounds.IsValid() ? (bounds | rect) : rect;
 	}
-	return ptn;
+	return bounds & BRect(B_ORIGIN, drawable->size());
 }
 
+static void
+rasterize_arc(Rasterizer* rasterizer, GC gc, const XArc& arc)
+{
+	if (gc->values.line_width == 0) {
+		rasterizer->arc(arc.x, arc.y, arc.width, arc.height, arc.angle1, arc.angle2);
+		return;
+	}
+	rasterizer->wide_arc(arc.x, arc.y, arc.width, arc.height, arc.angle1, arc.angle2,
+		gc->values.line_width, gc->values.cap_style);
+}
+
+/* Approximates an arc with a polyline, for dashing it. */
+static void
+arc_points(const XArc& arc, std::vector<BPoint>& points)
+{
+	const float radiusX = arc.width / 2.0f, radiusY = arc.height / 2.0f;
+	const BPoint center(arc.x + radiusX, arc.y + radiusY);
+	const float start = arc.angle1 / 64.0f * M_PI / 180,
+		extent = min_c(max_c(arc.angle2, -360 * 64), 360 * 64) / 64.0f * M_PI / 180;
+
+	// About one point every two pixels along the arc.
+	const int32 count = max_c(int32(fabsf(extent) * max_c(radiusX, radiusY) / 2), 4);
+	points.clear();
+	for (int32 i = 0; i <= count; i++) {
+		const float angle = start + extent * i / count;
+		points.push_back(BPoint(center.x + radiusX * cosf(angle),
+			center.y - radiusY * sinf(angle)));
+	}
+}
+
+// #pragma mark - drawing
+
 extern "C" int
 XDrawLine(Display *display, Drawable w, GC gc,
 	int x1, int y1, int x2, int y2)
@@ -97,12 +1078,33 @@ extern "C" int
 XDrawSegments(Display *display, Drawable w, GC gc,
 	XSegment *segments, int ns)
 {
-	DrawStateManager stateManager(w, gc);
+	DrawStateManager stateManager(w, gc, true, rasterizable_lines(gc));
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		RasterizedLines lines(rasterizer, gc);
+		for (int i = 0; i < ns; i++) {
+			const Rasterizer::Point points[] = {
+				{segments[i].x1, segments[i].y1}, {segments[i].x2, segments[i].y2}};
+			lines.restart();
+			lines.add(points, 2);
+		}
+		return 0;
+	}
+
 	BView* view = stateManager.view();
+	if (gc->values.line_style != LineSolid) {
+		DashedLines dashes(view, gc);
+		for (int i = 0; i < ns; i++) {
+			dashes.restart();
+			dashes.add(BPoint(segments[i].x1, segments[i].y1),
+				BPoint(segments[i].x2, segments[i].y2));
+		}
+		return 0;
+	}
+
 	for(int i = 0; i < ns; i++) {
 		BPoint point1(segments[i].x1, segments[i].y1);
 		BPoint point2(segments[i].x2, segments[i].y2);
-		view->StrokeLine(point1, point2, pattern_for(gc));
+		view->StrokeLine(point1, point2, stateManager.drawing_pattern());
 	}
 	return 0;
 }
@@ -111,30 +1113,37 @@ extern "C" int
 XDrawLines(Display *display, Drawable w, GC gc,
 	XPoint *points, int np, int mode)
 {
-	DrawStateManager stateManager(w, gc);
-	BView* view = stateManager.view();
-	switch (mode) {
-	case CoordModeOrigin:
-		for (int i = 0; i < (np - 1); i++) {
-			BPoint point1(points[i].x, points[i].y);
-			BPoint point2(points[i + 1].x, points[i + 1].y);
-			view->StrokeLine(point1, point2, pattern_for(gc));
-		}
-		break;
-	case CoordModePrevious: {
-		int wx = 0, wy = 0;
-		for (int i = 0; i < (np - 1); i++) {
-			wx += points[i].x;
-			wy += points[i].y;
-			BPoint point1(wx, wy);
-			wx += points[i + 1].x;
-			wy += points[i + 1].y;
-			BPoint point2(wx, wy);
-			view->StrokeLine(point1, point2, pattern_for(gc));
-		}
-		break;
+	if (np <= 0)
+		return 0;
+
+	std::vector<BPoint> line(np);
+	line[0] = BPoint(points[0].x, points[0].y);
+	for (int i = 1; i < np; i++) {
+		line[i] = BPoint(points[i].x, points[i].y);
+		if (mode == CoordModePrevious)
+			line[i] = line[i] + line[i - 1];
 	}
+
+	DrawStateManager stateManager(w, gc, true, rasterizable_lines(gc));
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		std::vector<Rasterizer::Point> path(np);
+		for (int i = 0; i < np; i++)
+			path[i] = {int32(line[i].x), int32(line[i].y)};
+		RasterizedLines(rasterizer, gc).add(path.data(), np);
+		return 0;
+	}
+
+	BView* view = stateManager.view();
+	if (gc->values.line_style != LineSolid) {
+		// The dashes continue from one line to the next.
+		DashedLines dashes(view, gc);
+		for (int i = 0; i < (np - 1); i++)
+			dashes.add(line[i], line[i + 1]);
+		return 0;
 	}
+
+	for (int i = 0; i < (np - 1); i++)
+		view->StrokeLine(line[i], line[i + 1], stateManager.drawing_pattern());
 	return 0;
 }
 
@@ -154,10 +1163,54 @@ extern "C" int
 XDrawRectangles(Display *display, Drawable w, GC gc,
 	XRectangle *rect, int n)
 {
-	DrawStateManager stateManager(w, gc);
+	DrawStateManager stateManager(w, gc, true, rasterizable_lines(gc));
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		RasterizedLines lines(rasterizer, gc);
+		for (int i = 0; i < n; i++) {
+			const int32 left = rect[i].x, top = rect[i].y,
+				right = left + rect[i].width, bottom = top + rect[i].height;
+			const Rasterizer::Point points[] = {
+				{left, top}, {right, top}, {right, bottom}, {left, bottom}, {left, top}};
+			lines.restart();
+			lines.add(points, 5, true);
+		}
+		return 0;
+	}
+
 	BView* view = stateManager.view();
+	if (gc->values.line_style != LineSolid) {
+		DashedLines dashes(view, gc);
+		for (int i = 0; i < n; i++) {
+			const BRect frame = brect_from_xrect(rect[i]);
+			dashes.restart();
+			dashes.add(frame.LeftTop(), frame.RightTop());
+			dashes.add(frame.RightTop(), frame.RightBottom());
+			dashes.add(frame.RightBottom(), frame.LeftBottom());
+			dashes.add(frame.LeftBottom(), frame.LeftTop());
+		}
+		return 0;
+	}
+
+	if (n > 1 && gc->values.line_width <= 1 && stateManager.solid_pattern()) {
+		// Thin edges meet without joins, so all of them can be one line array.
+		const rgb_color color = view->HighColor();
+		for (int i = 0; i < n; i += kLineArrayBatch / 4) {
+			const int count = min_c(n - i, int(kLineArrayBatch / 4));
+			view->BeginLineArray(count * 4);
+			for (int j = i; j < i + count; j++) {
+				const BRect frame = brect_from_xrect(rect[j]);
+				view->AddLine(frame.LeftTop(), frame.RightTop(), color);
+				view->AddLine(frame.RightTop(), frame.RightBottom(), color);
+				view->AddLine(frame.RightBottom(), frame.LeftBottom(), color);
+				view->AddLine(frame.LeftBottom(), frame.LeftTop(), color);
+			}
+			view->EndLineArray();
+		}
+		return 0;
+	}
+
 	for (int i = 0; i < n; i++) {
-		view->StrokeRect(brect_from_xrect(rect[i]), pattern_for(gc));
+		view->StrokeRect(brect_from_xrect(rect[i]), stateManager.drawing_pattern());
 	}
 	return 0;
 }
@@ -178,11 +1231,34 @@ extern "C" int
 XFillRectangles(Display *display, Drawable w, GC gc,
 	XRectangle *rect, int n)
 {
+	if (fill_rectangles(w, gc, rect, n))
+		return 0;
+
 	DrawStateManager stateManager(w, gc);
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		for (int i = 0; i < n; i++)
+			rasterizer->fill_rect(rect[i].x, rect[i].y, rect[i].width, rect[i].height);
+		return 0;
+	}
+
 	BView* view = stateManager.view();
+	if (n == 1) {
+		view->FillRect(brect_from_xrect(rect[0]), stateManager.drawing_pattern());
+		return 0;
+	}
+
+	// Everything is filled with the same color and pattern, so the union of the
+	// rectangles can be filled at once.
+	std::vector<clipping_rect> rects(n);
 	for (int i = 0; i < n; i++) {
-		view->FillRect(brect_from_xrect(rect[i]), pattern_for(gc));
+		rects[i].left = rect[i].x;
+		rects[i].top = rect[i].y;
+		rects[i].right = rect[i].x + rect[i].width - 1;
+		rects[i].bottom = rect[i].y + rect[i].height - 1;
 	}
+	BRegion region;
+	_x_region_for_rects(rects.data(), rects.size(), 0, 0, region);
+	view->FillRegion(&region, stateManager.drawing_pattern());
 	return 0;
 }
 
@@ -203,14 +1279,36 @@ XDrawArc(Display *display, Drawable w, GC gc,
 extern "C" int
 XDrawArcs(Display *display, Drawable w, GC gc, XArc *arc, int n)
 {
-	// FIXME: Take arc_mode into account!
-	DrawStateManager stateManager(w, gc);
+	DrawStateManager stateManager(w, gc, true, rasterizable_arcs(gc));
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		RasterizedLines lines(rasterizer, gc);
+		for (int i = 0; i < n; i++) {
+			lines.restart();
+			rasterize_arc(rasterizer, gc, arc[i]);
+		}
+		return 0;
+	}
+
 	BView* view = stateManager.view();
+	if (!rasterizable_arcs(gc)) {
+		DashedLines dashes(view, gc);
+		std::vector<BPoint> points;
+		for (int i = 0; i < n; i++) {
+			arc_points(arc[i], points);
+			dashes.restart();
+			for (size_t j = 1; j < points.size(); j++)
+				dashes.add(points[j - 1], points[j]);
+		}
+		return 0;
+	}
+
+	RasterizedRegion region(arcs_bounds(stateManager.drawable(), arc, n, gc->values.line_width));
+	RasterizedLines lines(region.rasterizer(), gc);
 	for (int i = 0; i < n; i++) {
-		view->StrokeArc(brect_from_xrect(make_xrect(arc[i].x, arc[i].y, arc[i].width, arc[i].height)),
-			((float)arc[i].angle1) / 64, ((float)arc[i].angle2) / 64,
-			pattern_for(gc));
+		lines.restart();
+		rasterize_arc(region.rasterizer(), gc, arc[i]);
 	}
+	region.fill(view, stateManager.drawing_pattern());
 	return 0;
 }
 
@@ -232,14 +1330,23 @@ extern "C" int
 XFillArcs(Display* display, Drawable w, GC gc,
 	XArc *arc, int n)
 {
-	// FIXME: Take arc_mode into account!
+	const bool chord = (gc->values.arc_mode == ArcChord);
 	DrawStateManager stateManager(w, gc);
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		for (int i = 0; i < n; i++) {
+			rasterizer->fill_arc(arc[i].x, arc[i].y, arc[i].width, arc[i].height,
+				arc[i].angle1, arc[i].angle2, chord);
+		}
+		return 0;
+	}
+
 	BView* view = stateManager.view();
+	RasterizedRegion region(arcs_bounds(stateManager.drawable(), arc, n, 0));
 	for (int i = 0; i < n; i++) {
-		view->FillArc(brect_from_xrect(make_xrect(arc[i].x, arc[i].y, arc[i].width, arc[i].height)),
-			((float)arc[i].angle1) / 64.0f, ((float)arc[i].angle2) / 64.0f,
-			pattern_for(gc));
+		region.rasterizer()->fill_arc(arc[i].x, arc[i].y, arc[i].width, arc[i].height,
+			arc[i].angle1, arc[i].angle2, chord);
 	}
+	region.fill(view, stateManager.drawing_pattern());
 	return 0;
 }
 
@@ -247,6 +1354,20 @@ extern "C" int
 XFillPolygon(Display *display, Drawable w, GC gc,
 	XPoint *points, int npoints, int shape, int mode)
 {
+	DrawStateManager stateManager(w, gc);
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		std::vector<Rasterizer::Point> path(npoints);
+		for (int i = 0; i < npoints; i++) {
+			path[i] = {points[i].x, points[i].y};
+			if (mode == CoordModePrevious && i > 0) {
+				path[i].x += path[i - 1].x;
+				path[i].y += path[i - 1].y;
+			}
+		}
+		rasterizer->fill_polygon(path.data(), npoints, gc->values.fill_rule == WindingRule);
+		return 0;
+	}
+
 	BPolygon polygon;
 	switch (mode) {
 	case CoordModeOrigin :
@@ -267,9 +1388,8 @@ XFillPolygon(Display *display, Drawable w, GC gc,
 	}
 	}
 
-	DrawStateManager stateManager(w, gc);
 	BView* view = stateManager.view();
-	view->FillPolygon(&polygon, pattern_for(gc));
+	view->FillPolygon(&polygon, stateManager.drawing_pattern());
 	return 0;
 }
 
@@ -287,6 +1407,21 @@ XDrawPoints(Display *display, Drawable w, GC gc,
 	XPoint* points, int n, int mode)
 {
 	DrawStateManager stateManager(w, gc);
+	if (Rasterizer* rasterizer = stateManager.rasterizer()) {
+		int32 x = 0, y = 0;
+		for (int i = 0; i < n; i++) {
+			if (mode == CoordModePrevious) {
+				x += points[i].x;
+				y += points[i].y;
+			} else {
+				x = points[i].x;
+				y = points[i].y;
+			}
+			rasterizer->point(x, y);
+		}
+		return 0;
+	}
+
 	BView* view = stateManager.view();
 	view->PushState();
 	view->SetPenSize(1);
@@ -294,7 +1429,7 @@ XDrawPoints(Display *display, Drawable w, GC gc,
 	case CoordModeOrigin :
 		for (int i = 0; i < n; i++) {
 			BPoint point(points[i].x, points[i].y);
-			view->StrokeLine(point, point, pattern_for(gc));
+			view->StrokeLine(point, point, stateManager.drawing_pattern());
 		}
 		break;
 	case CoordModePrevious: {
@@ -303,7 +1438,7 @@ XDrawPoints(Display *display, Drawable w, GC gc,
 			wx = wx + points[i].x;
 			wy = wy + points[i].y;
 			BPoint point(wx, wy);
-			view->StrokeLine(point, point, pattern_for(gc));
+			view->StrokeLine(point, point, stateManager.drawing_pattern());
 		}
 		break;
 	}
@@ -312,37 +1447,161 @@ XDrawPoints(Display *display, Drawable w, GC gc,
 	return 0;
 }
 
+static BBitmap*
+expand_indexed(XDrawable* drawable, const uint8* bits, int32 bytesPerRow,
+	const BRect& srcRect, XColormap* colormap)
+{
+	// Look up the pixel values in the colormap, into the scratch bitmap.
+	PthreadReadLocker rdlock(colormap->lock);
+	BBitmap* expanded = drawable->scratch_bitmap_for(srcRect.Size(), B_RGB32);
+	const int32 width = srcRect.IntegerWidth() + 1, height = srcRect.IntegerHeight() + 1;
+	const uint8* source = bits + int32(srcRect.top) * bytesPerRow + int32(srcRect.left);
+	uint8* dest = (uint8*)expanded->Bits();
+	for (int32 y = 0; y < height; y++) {
+		PaletteExpander::expand(source, (uint32*)dest, width, colormap->palette);
+		source += bytesPerRow;
+		dest += expanded->BytesPerRow();
+	}
+	return expanded;
+}
+
+/* Returns the part of the source rectangle whose contents can be copied: for windows,
+ * only what is actually visible on screen. Also returns where the window is on screen.
+ * If "sync" is set, pending drawing into the source is waited for. */
+static BRegion
+copyable_source_region(XDrawable* source, const BRect& rect, BPoint& screenOffset, bool sync)
+{
+	BRegion region;
+	if (XPixmap* pixmap = dynamic_cast<XPixmap*>(source)) {
+		if (sync)
+			pixmap->sync();
+		region.Set(rect & pixmap->offscreen()->Bounds());
+		return region;
+	}
+
+	BView* view = source->view();
+	view->LockLooper();
+	if (sync) {
+		// Make sure everything drawn so far has reached the screen.
+		view->Sync();
+	}
+	// Only what is visible matters, not the clipping of the GC which drew last.
+	_x_reset_gc_clipping(source);
+	view->GetClippingRegion(&region);
+	screenOffset = view->ConvertToScreen(B_ORIGIN);
+	view->UnlockLooper();
+
+	BRegion bounds(rect);
+	region.IntersectWith(&bounds);
+	return region;
+}
+
+/* Reads back what can be copied of a window from the screen into the destination,
+ * "delta" away from where it is in the window. */
+static void
+copy_from_screen(XDrawable* destination, GC gc, const BRegion& copyable,
+	const BPoint& screenOffset, const BPoint& delta)
+{
+	const BRect frame = copyable.Frame();
+	const BRect screenRect = frame.OffsetByCopy(screenOffset),
+		destRect = frame.OffsetByCopy(delta);
+
+	BScreen screen;
+	XPixmap* pixmap = dynamic_cast<XPixmap*>(destination);
+	if (pixmap != NULL && copyable.CountRects() == 1 && destRect.LeftTop() == B_ORIGIN
+			&& pixmap->offscreen()->Bounds().Contains(destRect)
+			&& (pixmap->colorspace() == B_RGB32 || pixmap->colorspace() == B_RGBA32)
+			&& !needs_raster_op(destination, gc) && !_x_gc_has_clipping(gc)) {
+		// The screen can be read straight into the pixmap.
+		pixmap->sync();
+		BRect bounds = screenRect;
+		screen.ReadBitmap(pixmap->offscreen(), false, &bounds);
+		pixmap->mark_changed();
+		return;
+	}
+
+	BBitmap* scratch = destination->scratch_bitmap_for(screenRect.Size(), B_RGB32);
+	BRect bounds = screenRect;
+	if (screen.ReadBitmap(scratch, false, &bounds) != B_OK)
+		return;
+
+	// The frame may also cover other windows, so only the copyable rects are used.
+	if (pixmap != NULL && needs_raster_op(destination, gc)) {
+		bool applied = true;
+		for (int32 i = 0; i < copyable.CountRects() && applied; i++) {
+			const BRect rect = copyable.RectAt(i);
+			applied = apply_raster_op(pixmap, gc, scratch,
+				rect.OffsetByCopy(-frame.left, -frame.top), rect.LeftTop() + delta);
+		}
+		if (applied)
+			return;
+	}
+
+	DrawStateManager destMgr(destination->id(), gc, false);
+	for (int32 i = 0; i < copyable.CountRects(); i++) {
+		const BRect rect = copyable.RectAt(i);
+		destMgr.view()->DrawBitmap(scratch, rect.OffsetByCopy(-frame.left, -frame.top),
+			rect.OffsetByCopy(delta));
+	}
+}
+
 extern "C" int
 XCopyArea(Display* display, Drawable src, Drawable dest, GC gc,
 	int src_x, int src_y, unsigned int width, unsigned int height, int dest_x, int dest_y)
 {
 	const BRect src_rect = brect_from_xrect(make_xrect(src_x, src_y, width, height));
 	const BRect dest_rect = brect_from_xrect(make_xrect(dest_x, dest_y, width, height));
+	const BPoint delta = dest_rect.LeftTop() - src_rect.LeftTop();
 
-	BRegion region(dest_rect);
-	if (src == dest) {
-		DrawStateManager srcMgr(src, gc);
-		if (!srcMgr.view())
-			return BadDrawable;
+	XDrawable* source = Drawables::get(src);
+	XDrawable* destination = Drawables::get(dest);
+	if (!source || !destination)
+		return BadDrawable;
 
-		srcMgr.view()->CopyBits(src_rect, dest_rect);
-		region.Exclude(srcMgr.view()->Bounds());
-	} else if (XPixmap* src_pxm = Drawables::get_pixmap(src)) {
-		src_pxm->sync();
+	BPoint screenOffset;
+	BRegion copyable = copyable_source_region(source, src_rect, screenOffset, src != dest);
+	XPixmap* src_pxm = dynamic_cast<XPixmap*>(source);
+	XPixmap* dest_pxm = dynamic_cast<XPixmap*>(destination);
 
-		DrawStateManager destMgr(dest, gc);
-		if (!destMgr.view())
-			return BadDrawable;
+	if (src_pxm && dest_pxm && (dest_pxm->software() || needs_raster_op(destination, gc))
+			&& apply_raster_op(dest_pxm, gc, src_pxm->offscreen(), src_rect, dest_rect.LeftTop())) {
+		// Already combined into the destination.
+	} else if (src == dest) {
+		DrawStateManager srcMgr(src, gc, false);
+		srcMgr.view()->CopyBits(src_rect, dest_rect);
+	} else if (src_pxm) {
+		DrawStateManager destMgr(dest, gc, false);
 
-		destMgr.view()->DrawBitmap(src_pxm->offscreen(), src_rect, dest_rect);
-		region.Exclude(destMgr.view()->Bounds());
-	} else {
-		// TODO?
-		UNIMPLEMENTED();
-		return BadValue;
+		const std::shared_ptr<XColormap> colormap = src_pxm->indexed()
+			? _x_colormap(destMgr.drawable()->colormap) : NULL;
+		if (colormap) {
+			BBitmap* offscreen = src_pxm->offscreen();
+			const BRect expandRect = src_rect & offscreen->Bounds();
+			if (expandRect.IsValid()) {
+				BBitmap* expanded = expand_indexed(destMgr.drawable(), (const uint8*)offscreen->Bits(),
+					offscreen->BytesPerRow(), expandRect, colormap.get());
+				destMgr.view()->DrawBitmap(expanded, expandRect.OffsetToCopy(0, 0),
+					expandRect.OffsetByCopy(delta));
+				destMgr.keep_indexes((const uint8*)offscreen->Bits(), offscreen->BytesPerRow(),
+					expandRect, expandRect.LeftTop() + delta);
+			}
+		} else {
+			destMgr.view()->DrawBitmap(src_pxm->offscreen(), src_rect, dest_rect);
+		}
+	} else if (copyable.CountRects() > 0) {
+		// Only read back what is visible; the rest is exposed below.
+		copy_from_screen(destination, gc, copyable, screenOffset, delta);
 	}
 
 	if (gc->values.graphics_exposures) {
+		// Whatever could not be copied needs to be redrawn by the client.
+		BRegion region(src_rect);
+		region.Exclude(&copyable);
+		region.OffsetBy(delta.x, delta.y);
+
+		BRegion destBounds(BRect(B_ORIGIN, destination->size()));
+		region.IntersectWith(&destBounds);
+
 		if (region.CountRects() == 0) {
 			XEvent event;
 			event.type = NoExpose;
@@ -381,46 +1640,79 @@ XCopyPlane(Display *display, Drawable src, Drawable dest, GC gc,
 	return XCopyArea(display, src, dest, gc, src_x, src_y, width, height, dest_x, dest_y);
 }
 
+/* Imports the part of the image inside the source rect, which must be within the
+ * image, into the origin of the drawable's scratch bitmap. */
+static BBitmap*
+import_image(XDrawable* drawable, XImage* image, const BRect& srcRect)
+{
+	BBitmap* scratch = drawable->scratch_bitmap_for(srcRect.Size(), drawable->colorspace());
+	if (scratch->ImportBits(image->data, image->height * image->bytes_per_line,
+			image->bytes_per_line, _x_color_space_for_ximage(image),
+			BPoint(srcRect.left + image->xoffset, srcRect.top), B_ORIGIN,
+			srcRect.IntegerWidth() + 1, srcRect.IntegerHeight() + 1) != B_OK)
+		return NULL;
+	return scratch;
+}
+
+/* Combines an image straight into the pixmap's bits, without drawing it with the
+ * pixmap's view. Returns false if this cannot be done. */
+static bool
+put_image(XPixmap* pixmap, GC gc, XImage* image, const BRect& srcRect, const BPoint& destPoint)
+{
+	BView* view = pixmap->view();
+	view->LockLooper();
+	BBitmap* scratch = import_image(pixmap, image, srcRect);
+	const bool result = scratch != NULL
+		&& apply_raster_op(pixmap, gc, scratch, srcRect.OffsetToCopy(B_ORIGIN), destPoint);
+	view->UnlockLooper();
+	return result;
+}
+
 extern "C" int
 XPutImage(Display *display, Drawable d, GC gc, XImage* image,
 	int src_x, int src_y, int dest_x, int dest_y,
 	unsigned int width, unsigned int height)
 {
-	DrawStateManager stateManager(d, gc);
+	// Only what is inside the image can be put.
+	const BRect srcRect = brect_from_xrect(make_xrect(src_x, src_y, width, height))
+		& BRect(0, 0, image->width - 1, image->height - 1);
+	if (!srcRect.IsValid())
+		return Success;
+	const BRect destRect = srcRect.OffsetByCopy(dest_x - src_x, dest_y - src_y);
+
+	XPixmap* pixmap = Drawables::get_pixmap(d);
+	if (pixmap && (pixmap->software() || needs_raster_op(pixmap, gc)) && !_x_gc_has_clipping(gc)
+			&& put_image(pixmap, gc, image, srcRect, destRect.LeftTop()))
+		return Success;
+
+	DrawStateManager stateManager(d, gc, false);
 	XDrawable* drawable = stateManager.drawable();
 	if (!drawable)
 		return BadDrawable;
 
-	const BRect srcRect = brect_from_xrect(make_xrect(src_x, src_y, width, height));
-	const BRect scratchBounds = drawable->scratch_bitmap
-		? drawable->scratch_bitmap->Bounds() : BRect();
-	if (drawable->scratch_bitmap == NULL
-			|| scratchBounds.Width() < srcRect.Width()
-			|| scratchBounds.Height() < srcRect.Height()) {
-		// We need a bigger scratch bitmap.
-		BSize size = srcRect.Size();
-		if (size.width < scratchBounds.Width())
-			size.width = scratchBounds.Width();
-		if (size.height < scratchBounds.Height())
-			size.height = scratchBounds.Height();
-
-		delete drawable->scratch_bitmap;
-		drawable->scratch_bitmap = new BBitmap(BRect(BPoint(0, 0), size), 0, drawable->colorspace());
-	}
-
-	// TODO: Optimization: Import only the bits we are about to draw!
-	drawable->scratch_bitmap->ImportBits(image->data, image->height * image->bytes_per_line,
-		image->bytes_per_line, image->xoffset, _x_color_space_for(NULL, image->bits_per_pixel));
-
-	stateManager.view()->DrawBitmap(drawable->scratch_bitmap, srcRect,
-		brect_from_xrect(make_xrect(dest_x, dest_y, width, height)));
+	const std::shared_ptr<XColormap> colormap = _x_colormap(drawable->colormap);
+	if (colormap && image->bits_per_pixel == 8) {
+		BBitmap* expanded = expand_indexed(drawable, (const uint8*)image->data,
+			image->bytes_per_line, srcRect, colormap.get());
+		stateManager.view()->DrawBitmap(expanded, srcRect.OffsetToCopy(0, 0), destRect);
+		stateManager.keep_indexes((const uint8*)image->data, image->bytes_per_line,
+			srcRect, destRect.LeftTop());
+		return Success;
+	}
+
+	BBitmap* scratch = import_image(drawable, image, srcRect);
+	if (scratch == NULL)
+		return BadMatch;
+
+	stateManager.view()->DrawBitmap(scratch, srcRect.OffsetToCopy(B_ORIGIN), destRect);
 	return Success;
 }
 
 extern "C" void
 Xutf8DrawString(Display *display, Drawable w, XFontSet set, GC gc, int x, int y, const char* str, int len)
 {
-	DrawStateManager stateManager(w, gc);
+	// Text is only drawn with views.
+	DrawStateManager stateManager(w, gc, true, false);
 	BView* view = stateManager.view();
 	view->PushState();
 	if (set) {
@@ -448,7 +1740,7 @@ Xutf8DrawImageString(Display *display, Drawable w, XFontSet set, GC gc,
 	XRectangle background = make_xrect(x, y - height.ascent,
 		width, height.ascent + height.descent);
 	{
-		DrawStateManager stateManager(w, gc);
+		DrawStateManager stateManager(w, gc, true, false);
 		stateManager.view()->FillRect(brect_from_xrect(background), B_SOLID_LOW);
 	}
 
@@ -458,7 +1750,7 @@ Xutf8DrawImageString(Display *display, Drawable w, XFontSet set, GC gc,
 extern "C" int
 XDrawText(Display *display, Drawable w, GC gc, int x, int y, XTextItem* items, int count)
 {
-	DrawStateManager stateManager(w, gc);
+	DrawStateManager stateManager(w, gc, true, false);
 	BView* view = stateManager.view();
 	view->PushState();
 	for (int i = 0; i < count; i++) {
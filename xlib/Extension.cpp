@@ -4,7 +4,11 @@
  */
 #include "Extension.h"
 
+#include <cstring>
 #include <map>
+#include <pthread.h>
+#include <vector>
+#include <support/SupportDefs.h>
 
 #include "Debug.h"
 
@@ -17,6 +21,9 @@ static int sLastExtension = 1;
 
 static std::map<int, _XExtension*> sExtensions;
 
+static pthread_mutex_t sDestroyWindowHooksLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<DestroyWindowHook> sDestroyWindowHooks;
+
 void
 _x_extensions_close(Display* dpy)
 {
@@ -27,6 +34,25 @@ _x_extensions_close(Display* dpy)
 	sExtensions.clear();
 }
 
+void
+_x_add_destroy_window_hook(DestroyWindowHook hook)
+{
+	pthread_mutex_lock(&sDestroyWindowHooksLock);
+	sDestroyWindowHooks.push_back(hook);
+	pthread_mutex_unlock(&sDestroyWindowHooksLock);
+}
+
+void
+_x_call_destroy_window_hooks(Display* dpy, Window w)
+{
+	pthread_mutex_lock(&sDestroyWindowHooksLock);
+	const std::vector<DestroyWindowHook> hooks = sDestroyWindowHooks;
+	pthread_mutex_unlock(&sDestroyWindowHooksLock);
+
+	for (DestroyWindowHook hook : hooks)
+		hook(dpy, w);
+}
+
 extern "C" XExtCodes*
 XAddExtension(Display* dpy)
 {
@@ -54,23 +80,51 @@ XESetCloseDisplay(Display* dpy, int extension_id, CloseDisplayType proc)
 	return last;
 }
 
+// Extensions implemented in libXext and libXrender, which clients may check for by name.
+static const char* const kKnownExtensions[] = {
+	"DOUBLE-BUFFER",
+	"RENDER",
+};
+static const int kFirstKnownExtensionOpcode = 128;
+
 extern "C" Bool
 XQueryExtension(Display* display, const char* name,
 	int* major_opcode_return, int* first_event_return, int* first_error_return)
 {
-	UNIMPLEMENTED();
-	return 0;
+	for (int i = 0; i < B_COUNT_OF(kKnownExtensions); i++) {
+		if (strcmp(name, kKnownExtensions[i]) != 0)
+			continue;
+
+		*major_opcode_return = kFirstKnownExtensionOpcode + i;
+		*first_event_return = 0;
+		*first_error_return = 0;
+		return True;
+	}
+	return False;
 }
 
 extern "C" char**
 XListExtensions(Display* dpy, int* nextensions_return)
 {
-	UNIMPLEMENTED();
-	return NULL;
+	// The names are stored right after the list, so that it can be freed at once.
+	const int count = B_COUNT_OF(kKnownExtensions);
+	size_t size = sizeof(char*) * count;
+	for (int i = 0; i < count; i++)
+		size += strlen(kKnownExtensions[i]) + 1;
+
+	char** list = (char**)malloc(size);
+	char* names = (char*)(list + count);
+	for (int i = 0; i < count; i++) {
+		list[i] = strcpy(names, kKnownExtensions[i]);
+		names += strlen(names) + 1;
+	}
+	*nextensions_return = count;
+	return list;
 }
 
 extern "C" int
 XFreeExtensionList(char** list)
 {
+	free(list);
 	return Success;
 }
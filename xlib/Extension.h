@@ -9,3 +9,8 @@ extern "C" {
 }
 
 void _x_extensions_close(Display *dpy);
+
+/* Lets extensions release what they keep for a window when it is destroyed. */
+typedef void (*DestroyWindowHook)(Display* dpy, Window w);
+void _x_add_destroy_window_hook(DestroyWindowHook hook);
+void _x_call_destroy_window_hooks(Display* dpy, Window w);
@@ -6,9 +6,16 @@
 
 #include <interface/Region.h>
 #include <interface/Bitmap.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include <atomic>
+#include <list>
+#include <vector>
+
+#include "GC.h"
 #include "Drawables.h"
+#include "MaskScanner.h"
 #include "Color.h"
 #include "Font.h"
 
@@ -22,14 +29,52 @@ extern "C" {
 
 struct ClipMask {
 	BRegion region;
+	bool enabled = false;
+		// An empty region clips everything, unless this is unset.
+
+	// The region offset by the clip origin, for the version it was computed for.
+	BRegion offset_region;
+	uint64 offset_version = 0;
+};
+
+/* All GCs we create also carry the versions of their attribute groups,
+ * and their whole dash list (GCValues only has room for one dash.) */
+struct XGC : _XGC {
+	uint64 versions[kGCGroupCount];
+	std::vector<unsigned char> dash_list;
 };
 
+static const unsigned long kGCGroupMasks[kGCGroupCount] = {
+	GCFunction,
+	GCForeground,
+	GCBackground,
+	GCLineWidth,
+	GCCapStyle | GCJoinStyle,
+	GCFillRule,
+	GCFont,
+	GCSubwindowMode,
+	GCClipMask | GCClipXOrigin | GCClipYOrigin,
+};
+
+// Versions are unique across all GCs, and never 0.
+static std::atomic<uint64> sLastGCVersion(0);
+
+static void
+update_versions(XGC* gc, unsigned long mask)
+{
+	for (int i = 0; i < kGCGroupCount; i++) {
+		if (mask & kGCGroupMasks[i])
+			gc->versions[i] = ++sLastGCVersion;
+	}
+}
+
 extern "C" GC
 XCreateGC(Display* display, Window window,
 	unsigned long mask, XGCValues* gc_values)
 {
-	GC gc = new _XGC;
+	XGC* gc = new XGC;
 	gc->values.function = GXcopy;
+	gc->values.plane_mask = AllPlanes;
 	gc->values.foreground = BlackPixel(display, 0);
 	gc->values.background = WhitePixel(display, 0);
 	gc->values.line_style = LineSolid;
@@ -38,13 +83,19 @@ XCreateGC(Display* display, Window window,
 	gc->values.join_style = JoinMiter;
 	gc->values.fill_style = FillSolid;
 	gc->values.fill_rule = EvenOddRule;
-	gc->values.arc_mode = ArcChord;
+	gc->values.arc_mode = ArcPieSlice;
+	gc->values.tile = gc->values.stipple = None;
+	gc->values.ts_x_origin = gc->values.ts_y_origin = 0;
+	gc->values.dash_offset = 0;
+	gc->values.dashes = 4;
+	gc->dash_list.assign(2, 4);
 	gc->values.font = 0;
 	gc->values.subwindow_mode = ClipByChildren;
 	gc->values.graphics_exposures = True;
 	gc->values.clip_x_origin = gc->values.clip_y_origin = 0;
 	gc->values.clip_mask = None;
 	gc->dirty = 0;
+	update_versions(gc, ~0UL);
 	XChangeGC(display, gc, mask, gc_values);
 	return gc;
 }
@@ -53,12 +104,8 @@ extern "C" int
 XFreeGC(Display* display, GC gc)
 {
 	if (gc) {
-		XDrawable* drawable = Drawables::get(gc->gid);
-		if (drawable && drawable->last_gc == gc)
-			drawable->last_gc = NULL;
-
 		delete (ClipMask*)gc->values.clip_mask;
-		delete gc;
+		delete static_cast<XGC*>(gc);
 	}
 	return Success;
 }
@@ -170,89 +217,69 @@ XChangeGC(Display *display, GC gc, unsigned long mask, XGCValues *values)
 	}
 	if (mask & GCDashOffset)
 		gc->values.dash_offset = values->dash_offset;
-#if 0
-	// TODO
-	if (mask & GCDashList)
-		XSetDashes(display, gc, &values->dashes, 2);
-#endif
+	if (mask & GCDashList) {
+		// A single dash stands for a list of two.
+		const char dashes[2] = { values->dashes, values->dashes };
+		XSetDashes(display, gc, gc->values.dash_offset, dashes, 2);
+	}
 	gc->dirty |= mask;
 	return 0;
 }
 
-static int
-_x_compare_gcs(GC first, GC second)
-{
-	if (first == second)
-		return 0;
-	if (first == NULL || second == NULL)
-		return INT32_MAX;
-
-	int mask = 0;
-	if (first->values.function != second->values.function)
-		mask |= GCFunction;
-	if (first->values.plane_mask != second->values.plane_mask)
-		mask |= GCPlaneMask;
-	if (first->values.foreground != second->values.foreground)
-		mask |= GCForeground;
-	if (first->values.background != second->values.background)
-		mask |= GCBackground;
-	if (first->values.line_width != second->values.line_width)
-		mask |= GCLineWidth;
-	if (first->values.line_style != second->values.line_style)
-		mask |= GCLineStyle;
-	if (first->values.cap_style != second->values.cap_style)
-		mask |= GCCapStyle;
-	if (first->values.join_style != second->values.join_style)
-		mask |= GCJoinStyle;
-	if (first->values.fill_style != second->values.fill_style)
-		mask |= GCFillStyle;
-	if (first->values.fill_rule != second->values.fill_rule)
-		mask |= GCFillRule;
-	if (first->values.arc_mode != second->values.arc_mode)
-		mask |= GCArcMode;
-	if (first->values.tile != second->values.tile)
-		mask |= GCTile;
-	if (first->values.stipple != second->values.stipple)
-		mask |= GCStipple;
-	if (first->values.ts_x_origin != second->values.ts_x_origin)
-		mask |= GCTileStipXOrigin;
-	if (first->values.ts_y_origin != second->values.ts_y_origin)
-		mask |= GCTileStipYOrigin;
-	if (first->values.font != second->values.font)
-		mask |= GCFont;
-	if (first->values.subwindow_mode != second->values.subwindow_mode)
-		mask |= GCSubwindowMode;
-	if (first->values.graphics_exposures != second->values.graphics_exposures)
-		mask |= GCGraphicsExposures;
-	if (first->values.clip_x_origin != second->values.clip_x_origin)
-		mask |= GCClipXOrigin;
-	if (first->values.clip_y_origin != second->values.clip_y_origin)
-		mask |= GCClipYOrigin;
-	if (first->values.clip_mask != second->values.clip_mask)
-		mask |= GCClipMask;
-	if (first->values.dash_offset != second->values.dash_offset)
-		mask |= GCDashOffset;
-#if 0
-	// TODO
-	if (first->values.dash_list != second->values.dash_list)
-		mask |= GCDashList;
-#endif
+/* Whether two sets of values are the same, for the attributes of a group. */
+static bool
+same_values(int group, const XGCValues& first, const XGCValues& second)
+{
+	switch (group) {
+	case kGCFunctionGroup:
+		return first.function == second.function;
+	case kGCForegroundGroup:
+		return first.foreground == second.foreground;
+	case kGCBackgroundGroup:
+		return first.background == second.background;
+	case kGCLineWidthGroup:
+		return first.line_width == second.line_width;
+	case kGCLineModeGroup:
+		return first.cap_style == second.cap_style && first.join_style == second.join_style;
+	case kGCFillRuleGroup:
+		return first.fill_rule == second.fill_rule;
+	case kGCFontGroup:
+		return first.font == second.font;
+	case kGCSubwindowModeGroup:
+		return first.subwindow_mode == second.subwindow_mode;
+	}
 
-	return mask;
+	// Clip masks belong to a single GC, and may have changed without their pointer.
+	return false;
+}
+
+void
+GCState::invalidate(unsigned long mask)
+{
+	for (int i = 0; i < kGCGroupCount; i++) {
+		if (mask & kGCGroupMasks[i])
+			versions[i] = 0;
+	}
 }
 
 extern "C" int
 XCopyGC(Display *display, GC src, unsigned long mask, GC dest)
 {
-	int status = XChangeGC(display, dest, mask & ~GCClipMask, &src->values);
-	if (!status)
+	int status = XChangeGC(display, dest, mask & ~(GCClipMask | GCDashList), &src->values);
+	if (status != 0)
 		return status;
 
 	if (mask & GCClipMask) {
 		ClipMask* clip_mask = (ClipMask*)src->values.clip_mask;
-		dest->values.clip_mask = (Pixmap)(mask ? new ClipMask(*clip_mask) : None);
+		delete (ClipMask*)dest->values.clip_mask;
+		dest->values.clip_mask = (Pixmap)(clip_mask ? new ClipMask(*clip_mask) : NULL);
 		dest->dirty |= GCClipMask;
 	}
+	if (mask & GCDashList) {
+		static_cast<XGC*>(dest)->dash_list = static_cast<XGC*>(src)->dash_list;
+		dest->values.dashes = src->values.dashes;
+		dest->dirty |= GCDashList;
+	}
 	return 0;
 }
 
@@ -264,6 +291,14 @@ XSetFunction(Display *display, GC gc, int function)
 	return 0;
 }
 
+extern "C" int
+XSetPlaneMask(Display *display, GC gc, unsigned long plane_mask)
+{
+	gc->values.plane_mask = plane_mask;
+	gc->dirty |= GCPlaneMask;
+	return 0;
+}
+
 extern "C" int
 XSetForeground(Display *display, GC gc, unsigned long color)
 {
@@ -319,6 +354,31 @@ XSetFillStyle(Display* display, GC gc, int fill_style)
 	return 0;
 }
 
+extern "C" int
+XSetTile(Display* display, GC gc, Pixmap tile)
+{
+	gc->values.tile = tile;
+	gc->dirty |= GCTile;
+	return 0;
+}
+
+extern "C" int
+XSetStipple(Display* display, GC gc, Pixmap stipple)
+{
+	gc->values.stipple = stipple;
+	gc->dirty |= GCStipple;
+	return 0;
+}
+
+extern "C" int
+XSetTSOrigin(Display* display, GC gc, int ts_x_origin, int ts_y_origin)
+{
+	gc->values.ts_x_origin = ts_x_origin;
+	gc->values.ts_y_origin = ts_y_origin;
+	gc->dirty |= GCTileStipXOrigin | GCTileStipYOrigin;
+	return 0;
+}
+
 extern "C" int
 XSetFillRule(Display* display, GC gc, int fill_rule)
 {
@@ -360,6 +420,95 @@ XSetClipOrigin(Display *display, GC gc, int clip_x_origin, int clip_y_origin)
 	return 0;
 }
 
+static const size_t kRegionMergeBatch = 16;
+
+void
+_x_region_for_rects(const clipping_rect* rects, size_t count, int32 x, int32 y,
+	BRegion& region)
+{
+	// Halves of the list are built separately and then merged, as every
+	// Include() is a full union; so this does not take quadratic time.
+	if (count <= kRegionMergeBatch) {
+		for (size_t i = 0; i < count; i++) {
+			if (rects[i].left > rects[i].right || rects[i].top > rects[i].bottom)
+				continue;
+
+			clipping_rect clipping;
+			clipping.left = rects[i].left + x;
+			clipping.top = rects[i].top + y;
+			clipping.right = rects[i].right + x;
+			clipping.bottom = rects[i].bottom + y;
+			region.Include(clipping);
+		}
+		return;
+	}
+
+	BRegion other;
+	_x_region_for_rects(rects, count / 2, x, y, region);
+	_x_region_for_rects(rects + count / 2, count - count / 2, x, y, other);
+	region.Include(&other);
+}
+
+void
+_x_region_for_mask_bits(const uint8* bits, int32 bytesPerRow, int32 width, int32 height,
+	int32 x, int32 y, BRegion& region)
+{
+	std::vector<MaskScanner::Rect> rects;
+	MaskScanner::scan(bits, bytesPerRow, width, height, rects);
+
+	// The scanned rects are laid out as clipping_rects are.
+	static_assert(sizeof(MaskScanner::Rect) == sizeof(clipping_rect));
+	region.MakeEmpty();
+	_x_region_for_rects((const clipping_rect*)rects.data(), rects.size(), x, y, region);
+}
+
+/* The regions of recently used clip mask pixmaps, most recently used first.
+ * Toolkits tend to use the same few masks (e.g. of icons) over and over. */
+struct MaskRegion {
+	Pixmap pixmap;
+	uint32 generation;
+	BRegion region;
+};
+static const size_t kMaskRegionsCacheSize = 16;
+static pthread_mutex_t sMaskRegionsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::list<MaskRegion> sMaskRegions;
+
+bool
+_x_region_for_mask(XPixmap* pixmap, BRegion& region)
+{
+	if (pixmap->colorspace() != B_GRAY8)
+		return false;
+
+	pthread_mutex_lock(&sMaskRegionsLock);
+	for (auto it = sMaskRegions.begin(); it != sMaskRegions.end(); it++) {
+		if (it->pixmap != pixmap->id())
+			continue;
+
+		if (it->generation == pixmap->generation()) {
+			sMaskRegions.splice(sMaskRegions.begin(), sMaskRegions, it);
+			region = it->region;
+			pthread_mutex_unlock(&sMaskRegionsLock);
+			return true;
+		}
+		sMaskRegions.erase(it);
+		break;
+	}
+	pthread_mutex_unlock(&sMaskRegionsLock);
+
+	pixmap->sync();
+	const uint32 generation = pixmap->generation();
+	BBitmap* bitmap = pixmap->offscreen();
+	_x_region_for_mask_bits((const uint8*)bitmap->Bits(), bitmap->BytesPerRow(),
+		bitmap->Bounds().IntegerWidth() + 1, bitmap->Bounds().IntegerHeight() + 1, 0, 0, region);
+
+	pthread_mutex_lock(&sMaskRegionsLock);
+	sMaskRegions.push_front({pixmap->id(), generation, region});
+	if (sMaskRegions.size() > kMaskRegionsCacheSize)
+		sMaskRegions.pop_back();
+	pthread_mutex_unlock(&sMaskRegionsLock);
+	return true;
+}
+
 static inline ClipMask*
 gc_clip_mask(GC gc, bool allocate = true)
 {
@@ -377,6 +526,7 @@ XSetRegion(Display* display, GC gc, Region r)
 	ClipMask* mask = gc_clip_mask(gc);
 	BRegion* region = (BRegion*)r;
 	mask->region = *region;
+	mask->enabled = true;
 	gc->dirty |= GCClipMask;
 	return Success;
 }
@@ -391,6 +541,7 @@ XSetClipRectangles(Display *display, GC gc, int clip_x_origin, int clip_y_origin
 	mask->region.MakeEmpty();
 	for (int i = 0; i < count; i++)
 		XUnionRectWithRegion(&rect[i], (Region)&mask->region, (Region)&mask->region);
+	mask->enabled = true;
 
 	gc->dirty |= GCClipMask;
 	return Success;
@@ -405,6 +556,7 @@ XSetClipMask(Display* display, GC gc, Pixmap pixmap)
 			return Success;
 
 		mask->region.MakeEmpty();
+		mask->enabled = false;
 		gc->dirty |= GCClipMask;
 		return Success;
 	}
@@ -413,12 +565,13 @@ XSetClipMask(Display* display, GC gc, Pixmap pixmap)
 	if (!pxm)
 		return BadPixmap;
 
-	ClipMask* mask = gc_clip_mask(gc);
-	mask->region.Set(pxm->offscreen()->Bounds());
-
-	// TODO: Actually use the pixmap for clipping!
-	UNIMPLEMENTED();
+	BRegion region;
+	if (!_x_region_for_mask(pxm, region))
+		return BadMatch;
 
+	ClipMask* mask = gc_clip_mask(gc);
+	mask->region = region;
+	mask->enabled = true;
 	gc->dirty |= GCClipMask;
 	return Success;
 }
@@ -430,14 +583,33 @@ _x_gc_has_clipping(GC gc)
 	if (!mask)
 		return false;
 
-	return mask->region.CountRects() > 0;
+	return mask->enabled;
 }
 
 extern "C" Status
 XSetDashes(Display *display, GC gc, int dash_offset, const char *dash_list, int n)
 {
-	// Not supported.
-	return BadImplementation;
+	if (n <= 0)
+		return BadValue;
+	for (int i = 0; i < n; i++) {
+		if (dash_list[i] == 0)
+			return BadValue;
+	}
+
+	XGC* xgc = static_cast<XGC*>(gc);
+	xgc->dash_list.assign((const unsigned char*)dash_list, (const unsigned char*)dash_list + n);
+	gc->values.dash_offset = dash_offset;
+	gc->values.dashes = dash_list[0];
+	gc->dirty |= GCDashOffset | GCDashList;
+	return Success;
+}
+
+const unsigned char*
+_x_gc_dashes(GC gc, int& count)
+{
+	const std::vector<unsigned char>& dashes = static_cast<XGC*>(gc)->dash_list;
+	count = dashes.size();
+	return dashes.data();
 }
 
 void
@@ -448,38 +620,43 @@ _x_check_gc(XDrawable* drawable, GC gc)
 		return;
 	}
 
-	if (gc->gid != drawable->id()) {
-		XDrawable* previousDrawable = Drawables::get(gc->gid);
-		if (previousDrawable && previousDrawable->last_gc == gc)
-			previousDrawable->last_gc = NULL;
-
-		if (drawable->last_gc != gc)
-			gc->dirty = _x_compare_gcs(gc, drawable->last_gc);
+	XGC* xgc = static_cast<XGC*>(gc);
+	if (gc->dirty) {
+		update_versions(xgc, gc->dirty);
+		gc->dirty = 0;
+	}
 
-		gc->gid = drawable->id();
+	// Only groups whose versions differ from what the view last had applied are
+	// looked at, and they are only applied if their values differ too. (Switching
+	// between GCs which share most of their attributes is common.)
+	GCState& state = drawable->gc_state;
+	unsigned long dirty = 0;
+	for (int i = 0; i < kGCGroupCount; i++) {
+		if (state.versions[i] == xgc->versions[i])
+			continue;
+		if (state.versions[i] == 0 || !same_values(i, state.values, gc->values))
+			dirty |= kGCGroupMasks[i];
+		state.versions[i] = xgc->versions[i];
 	}
-	if (!gc->dirty)
+	if (!dirty)
 		return;
-	drawable->last_gc = gc;
+	state.values = gc->values;
 
 	BView* view = drawable->view();
 
-	if (gc->dirty & GCFunction) {
-		drawing_mode mode;
+	if (dirty & GCFunction) {
+		// Drawing which only uses the GC's colors goes through the software raster
+		// operations instead (see Drawing.cpp), so these only approximate the
+		// function for images drawn into windows.
+		drawing_mode mode = B_OP_COPY;
 		alpha_function func = B_ALPHA_OVERLAY;
 		switch (gc->values.function) {
-		//case GXclear:	break;
 		case GXand:
 			mode = B_OP_BLEND;
 		break;
-		//case GXandReverse: break;
-		case GXcopy:
-			mode = B_OP_COPY;
-		break;
 		case GXandInverted:
 			mode = B_OP_SUBTRACT;
 		break;
-		//case GXnoop: break;
 		case GXxor:
 			mode = B_OP_ALPHA;
 			func = B_ALPHA_COMPOSITE_SOURCE_IN;
@@ -488,31 +665,22 @@ _x_check_gc(XDrawable* drawable, GC gc)
 			mode = B_OP_ALPHA;
 			func = B_ALPHA_COMPOSITE_SOURCE_OUT;
 		break;
-		//case GXnor: break;
-		//case GXequiv: break;
 		case GXinvert:
 			mode = B_OP_INVERT;
 		break;
-		//case GXorReverse: break;
-		//case GXcopyInverted: break;
-		//case GXorInverted: break;
-		//case GXnand: break;
-		//case GXset: break;
-		default:
-			debugger("Unsupported GX mode!");
 		}
 		view->SetDrawingMode(mode);
 		view->SetBlendingMode(B_PIXEL_ALPHA, func);
 	}
 
-	if (gc->dirty & GCForeground)
-		view->SetHighColor(_x_pixel_to_rgb(gc->values.foreground));
-	if (gc->dirty & GCBackground)
-		view->SetLowColor(_x_pixel_to_rgb(gc->values.background));
-	if (gc->dirty & GCLineWidth)
+	if (dirty & GCForeground)
+		view->SetHighColor(drawable->pixel_color(gc->values.foreground));
+	if (dirty & GCBackground)
+		view->SetLowColor(drawable->pixel_color(gc->values.background));
+	if (dirty & GCLineWidth)
 		view->SetPenSize(gc->values.line_width);
 
-	if (gc->dirty & (GCCapStyle | GCJoinStyle)) {
+	if (dirty & (GCCapStyle | GCJoinStyle)) {
 		cap_mode cap;
 		switch (gc->values.cap_style) {
 		case CapRound:
@@ -549,7 +717,7 @@ _x_check_gc(XDrawable* drawable, GC gc)
 		view->SetLineMode(cap, join);
 	}
 
-	if (gc->dirty & GCFillRule) {
+	if (dirty & GCFillRule) {
 		int32 fillRule = 0;
 		switch (gc->values.fill_rule) {
 		case EvenOddRule:
@@ -565,12 +733,12 @@ _x_check_gc(XDrawable* drawable, GC gc)
 		view->SetFillRule(fillRule);
 	}
 
-	if ((gc->dirty & GCFont) && gc->values.font) {
+	if ((dirty & GCFont) && gc->values.font) {
 		BFont bfont = _bfont_from_font(gc->values.font);
 		view->SetFont(&bfont);
 	}
 
-	if (gc->dirty & GCSubwindowMode) {
+	if (dirty & GCSubwindowMode) {
 		switch (gc->values.subwindow_mode) {
 		case ClipByChildren:
 			view->SetFlags(view->Flags() & ~B_DRAW_ON_CHILDREN);
@@ -583,15 +751,48 @@ _x_check_gc(XDrawable* drawable, GC gc)
 		}
 	}
 
-	if (gc->dirty & (GCClipMask | GCClipXOrigin | GCClipYOrigin)) {
-		view->ConstrainClippingRegion(NULL);
-		ClipMask* mask = gc_clip_mask(gc, false);
-		if (mask && mask->region.CountRects() > 0) {
-			BRegion region = mask->region;
-			region.OffsetBy(gc->values.clip_x_origin, gc->values.clip_y_origin);
-			view->ConstrainClippingRegion(&region);
+	if (dirty & (GCClipMask | GCClipXOrigin | GCClipYOrigin)) {
+		// Clipping stays applied to the view until another GC takes over.
+		const BRegion* region = _x_gc_clip_region(gc);
+		if (region != NULL) {
+			view->ConstrainClippingRegion(const_cast<BRegion*>(region));
+			state.clipped = true;
+		} else if (state.clipped) {
+			view->ConstrainClippingRegion(NULL);
+			state.clipped = false;
 		}
 	}
+}
 
-	gc->dirty = 0;
+const BRegion*
+_x_gc_clip_region(GC gc)
+{
+	ClipMask* mask = gc_clip_mask(gc, false);
+	if (!mask || !mask->enabled)
+		return NULL;
+
+	XGC* xgc = static_cast<XGC*>(gc);
+	if (gc->dirty) {
+		update_versions(xgc, gc->dirty);
+		gc->dirty = 0;
+	}
+	const uint64 version = xgc->versions[kGCClipGroup];
+	if (mask->offset_version != version) {
+		mask->offset_region = mask->region;
+		mask->offset_region.OffsetBy(gc->values.clip_x_origin, gc->values.clip_y_origin);
+		mask->offset_version = version;
+	}
+	return &mask->offset_region;
+}
+
+void
+_x_reset_gc_clipping(XDrawable* drawable)
+{
+	GCState& state = drawable->gc_state;
+	if (!state.clipped)
+		return;
+
+	drawable->view()->ConstrainClippingRegion(NULL);
+	state.clipped = false;
+	state.invalidate(GCClipMask);
 }
@@ -4,8 +4,72 @@
  */
 #pragma once
 
+#include <support/SupportDefs.h>
+#include <interface/Region.h>
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+namespace BeXlib {
+
 // Predeclarations
-namespace BeXlib { class XDrawable; }
+class XDrawable;
+class XPixmap;
+
+/* The attributes of a GC which are applied to views, in the groups they are applied in.
+ * Every change to a group gives it a new version. */
+enum GCGroup {
+	kGCFunctionGroup = 0,
+	kGCForegroundGroup,
+	kGCBackgroundGroup,
+	kGCLineWidthGroup,
+	kGCLineModeGroup,
+	kGCFillRuleGroup,
+	kGCFontGroup,
+	kGCSubwindowModeGroup,
+	kGCClipGroup,
+
+	kGCGroupCount
+};
+
+/* The GC attributes a drawable's view last had applied, and their versions. */
+class GCState {
+public:
+	uint64 versions[kGCGroupCount] = {};
+	XGCValues values = {};
+	bool clipped = false;
+
+public:
+	/* Makes the groups with these GC value bits be applied again, e.g. because
+	 * the view was changed outside of _x_check_gc. */
+	void invalidate(unsigned long mask);
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
 
 void _x_check_gc(BeXlib::XDrawable* drawable, GC gc);
 bool _x_gc_has_clipping(GC gc);
+
+/* Returns the GC's whole dash list. */
+const unsigned char* _x_gc_dashes(GC gc, int& count);
+
+/* Returns the region the GC clips to, offset by its clip origin; or NULL if it does
+ * not clip. The offset region is cached until the clipping changes. */
+const BRegion* _x_gc_clip_region(GC gc);
+
+/* Includes the (inclusive) rects, offset by (x, y), in the region. Empty rects are skipped. */
+void _x_region_for_rects(const clipping_rect* rects, size_t count, int32 x, int32 y,
+	BRegion& region);
+
+/* Returns the region of the set pixels of a mask (see MaskScanner), offset by (x, y). */
+void _x_region_for_mask_bits(const uint8* bits, int32 bytesPerRow, int32 width, int32 height,
+	int32 x, int32 y, BRegion& region);
+
+/* Returns the region of the set pixels of a depth 1 pixmap. Conversions are cached. */
+bool _x_region_for_mask(BeXlib::XPixmap* pixmap, BRegion& region);
+
+/* Removes the clipping a GC left on the drawable's view, before drawing which does
+ * not use a GC. Must be called with the looper locked. */
+void _x_reset_gc_clipping(BeXlib::XDrawable* drawable);
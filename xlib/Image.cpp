@@ -125,14 +125,10 @@ XCreateImage(Display *display, Visual *visual,
 	image->data = data;
 	image->bitmap_pad = bitmap_pad;
 
-	if (depth == 8) {
-		image->bits_per_pixel = image->bitmap_unit = 8;
-	} else {
-		if (!visual && depth >= 24)
-			visual = display->screens[0].root_visual;
-		image->bits_per_pixel = depth;
-		image->bitmap_unit = ROUNDUP(depth, 8);
-	}
+	if (!visual && depth >= 24)
+		visual = display->screens[0].root_visual;
+	image->bits_per_pixel = _x_bits_per_pixel_for_depth(depth);
+	image->bitmap_unit = ROUNDUP(image->bits_per_pixel, 8);
 	image->bytes_per_line = bytes_per_line;
 
 	image->byte_order = LSBFirst;
@@ -170,11 +166,21 @@ XInitImage(XImage* image)
 	return 1;
 }
 
+color_space
+_x_color_space_for_ximage(XImage* image)
+{
+	// Images laid out the way we store drawables of their depth use the same
+	// color space (e.g. depth 24 at 32 bits per pixel has no alpha.)
+	if (image->bits_per_pixel == _x_bits_per_pixel_for_depth(image->depth))
+		return _x_color_space_for_depth(image->depth);
+	return _x_color_space_for(NULL, image->bits_per_pixel);
+}
+
 BBitmap*
 _bbitmap_for_ximage(XImage *image, uint32 flags)
 {
 	BBitmap* bitmap = new BBitmap(brect_from_xrect(make_xrect(0, 0, image->width, image->height)),
-		flags, _x_color_space_for(NULL, image->bits_per_pixel), image->bytes_per_line);
+		flags, _x_color_space_for_ximage(image), image->bytes_per_line);
 	if (!bitmap || bitmap->InitCheck() != B_OK) {
 		fprintf(stderr, "libX11: Failed to create bitmap for XImage!\n");
 		debugger("Bitmap creation failed");
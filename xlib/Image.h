@@ -10,4 +10,5 @@ extern "C" {
 #include <X11/Xlib.h>
 }
 
+color_space _x_color_space_for_ximage(XImage* image);
 BBitmap* _bbitmap_for_ximage(XImage* image, uint32 flags = 0);
@@ -0,0 +1,496 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "KeyMap.h"
+
+#include <climits>
+#include <cstring>
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+
+#include "tables/keysymlist.h"
+}
+
+#include "PerfectHash.h"
+
+namespace BeXlib {
+
+static const unsigned int kModeSwitchMask = Mod5Mask;
+static const unsigned int kNumLockMask = Mod2Mask;
+
+static constexpr bool
+keysym_names_equal(const char* a, const char* b)
+{
+	while (*a != '\0' && *a == *b)
+		a++, b++;
+	return *a == *b;
+}
+
+static constexpr PerfectHash<KEY_SYM_LIST_LENGTH, 2048> sKeySymsByName(
+	[](size_t i) { return perfect_hash_string(KEY_SYM_LIST[i].name); },
+	[](size_t a, size_t b) { return keysym_names_equal(KEY_SYM_LIST[a].name, KEY_SYM_LIST[b].name); });
+
+static constexpr PerfectHash<KEY_SYM_LIST_LENGTH, 2048> sKeySymsByValue(
+	[](size_t i) { return perfect_hash_integer(KEY_SYM_LIST[i].keySym); },
+	[](size_t a, size_t b) { return KEY_SYM_LIST[a].keySym == KEY_SYM_LIST[b].keySym; });
+
+static bool
+parse_hex(const char* string, unsigned long& value)
+{
+	if (*string == '\0')
+		return false;
+
+	value = 0;
+	for (; *string != '\0'; string++) {
+		const char c = *string;
+		int digit;
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			digit = c - 'A' + 10;
+		else
+			return false;
+		if (value > (ULONG_MAX >> 4))
+			return false;
+		value = (value << 4) | digit;
+	}
+	return true;
+}
+
+KeyMap::KeyMap()
+{
+	memset(_keysyms, 0, sizeof(_keysyms));
+	memset(_modifiers, 0, sizeof(_modifiers));
+}
+
+void
+KeyMap::build(const Key keys[kKeyCount])
+{
+	_keycodes.clear();
+
+	for (int i = 0; i < kKeyCount; i++) {
+		KeySym* syms = _keysyms[i];
+		for (int level = 0; level < kKeySymsPerKeyCode; level++) {
+			syms[level] = keys[i].keysyms[level];
+			if (syms[level] == NoSymbol)
+				syms[level] = keysym_for_utf8(keys[i].chars[level]);
+			if (keys[i].keypad)
+				syms[level] = keypad_keysym(syms[level]);
+		}
+
+		// Normalize each group the way the core protocol expects:
+		// a lone alphabetic keysym becomes a (lowercase, uppercase) pair.
+		for (int group = 0; group < kKeySymsPerKeyCode; group += 2) {
+			if (syms[group] == NoSymbol && syms[group + 1] != NoSymbol)
+				syms[group] = syms[group + 1];
+			if (syms[group + 1] == syms[group])
+				syms[group + 1] = NoSymbol;
+
+			if (syms[group + 1] == NoSymbol) {
+				KeySym lower, upper;
+				convert_case(syms[group], &lower, &upper);
+				if (lower != upper) {
+					syms[group] = lower;
+					syms[group + 1] = upper;
+				}
+			}
+		}
+
+		// Drop the second group if it is the same as the first.
+		if (syms[2] == syms[0] && syms[3] == syms[1])
+			syms[2] = syms[3] = NoSymbol;
+
+		_modifiers[i] = keysym_to_modifier(syms[0]);
+
+		for (int level = 0; level < kKeySymsPerKeyCode; level++) {
+			if (syms[level] != NoSymbol)
+				_keycodes.insert({syms[level], KeyCode(i + kMinKeyCode)});
+		}
+	}
+}
+
+KeySym
+KeyMap::keysym(unsigned int keycode, int index) const
+{
+	if (keycode < kMinKeyCode || keycode > kMaxKeyCode
+			|| index < 0 || index >= kKeySymsPerKeyCode)
+		return NoSymbol;
+	return _keysyms[keycode - kMinKeyCode][index];
+}
+
+KeySym
+KeyMap::lookup(unsigned int keycode, unsigned int state, unsigned int* consumed) const
+{
+	if (consumed)
+		*consumed = 0;
+	if (keycode < kMinKeyCode || keycode > kMaxKeyCode)
+		return NoSymbol;
+
+	const KeySym* syms = _keysyms[keycode - kMinKeyCode];
+	int group = 0;
+	if (syms[2] != NoSymbol || syms[3] != NoSymbol) {
+		if (consumed)
+			*consumed |= kModeSwitchMask;
+		if (state & kModeSwitchMask)
+			group = 2;
+	}
+
+	const KeySym lower = syms[group], upper = syms[group + 1];
+	if (upper == NoSymbol) {
+		// Only one level: Shift and Lock have no effect.
+		return lower;
+	}
+	if (consumed)
+		*consumed |= ShiftMask | LockMask;
+
+	if (IsKeypadKey(upper)) {
+		// NumLock selects the second level (the digits), and Shift undoes it.
+		if (consumed)
+			*consumed |= kNumLockMask;
+		if (state & kNumLockMask)
+			return (state & ShiftMask) ? lower : upper;
+	}
+
+	KeySym result = (state & ShiftMask) ? upper : lower;
+	if (state & LockMask) {
+		// Lock is CapsLock: whichever level is selected, use its uppercase form.
+		KeySym resultLower;
+		convert_case(result, &resultLower, &result);
+	}
+	return result;
+}
+
+KeyCode
+KeyMap::keycode(KeySym keysym) const
+{
+	const auto& result = _keycodes.find(keysym);
+	if (result == _keycodes.end())
+		return 0;
+	return result->second;
+}
+
+unsigned int
+KeyMap::modifiers(unsigned int keycode) const
+{
+	if (keycode < kMinKeyCode || keycode > kMaxKeyCode)
+		return 0;
+	return _modifiers[keycode - kMinKeyCode];
+}
+
+int
+KeyMap::lookup_text(KeySym keysym, unsigned int state, const char* typed,
+	char* buffer, int bufferSize)
+{
+	char text[4];
+	int length = keysym_to_utf8(keysym, text);
+
+	// Control characters typed are left to the conversion below, as Haiku's
+	// Control is not X's.
+	const int typedLength = (typed != NULL) ? strlen(typed) : 0;
+	if (typedLength > 0 && (unsigned char)typed[0] >= 0x20 && typed[0] != 0x7f
+			&& (typedLength != length || memcmp(typed, text, length) != 0)) {
+		if (typedLength > bufferSize)
+			return 0;
+		memcpy(buffer, typed, typedLength);
+		return typedLength;
+	}
+
+	if (length == 1 && (state & ControlMask)) {
+		// Control characters, in the same way as the real Xlib.
+		char c = text[0];
+		if ((c >= '@' && c < '\177') || c == ' ')
+			c &= 0x1F;
+		else if (c == '2')
+			c = '\000';
+		else if (c >= '3' && c <= '7')
+			c -= ('3' - '\033');
+		else if (c == '8')
+			c = '\177';
+		else if (c == '/')
+			c = '_' & 0x1F;
+		text[0] = c;
+	}
+	if (length > bufferSize)
+		return 0;
+
+	memcpy(buffer, text, length);
+	return length;
+}
+
+KeySym
+KeyMap::keysym_for_utf8(const char* chars)
+{
+	if (chars == NULL || chars[0] == '\0')
+		return NoSymbol;
+
+	const unsigned char* bytes = (const unsigned char*)chars;
+	unsigned long codepoint;
+	int length;
+	if (bytes[0] < 0x80) {
+		codepoint = bytes[0];
+		length = 1;
+	} else if ((bytes[0] & 0xe0) == 0xc0) {
+		codepoint = bytes[0] & 0x1f;
+		length = 2;
+	} else if ((bytes[0] & 0xf0) == 0xe0) {
+		codepoint = bytes[0] & 0x0f;
+		length = 3;
+	} else if ((bytes[0] & 0xf8) == 0xf0) {
+		codepoint = bytes[0] & 0x07;
+		length = 4;
+	} else {
+		return NoSymbol;
+	}
+	for (int i = 1; i < length; i++) {
+		if ((bytes[i] & 0xc0) != 0x80)
+			return NoSymbol;
+		codepoint = (codepoint << 6) | (bytes[i] & 0x3f);
+	}
+
+	// Only single characters can be mapped to a keysym.
+	if (bytes[length] != '\0')
+		return NoSymbol;
+
+	// Control characters do not have a direct keysym mapping.
+	if (codepoint < 0x20 || (codepoint >= 0x7f && codepoint < 0xa0))
+		return NoSymbol;
+	if (codepoint < 0x100)
+		return codepoint;
+	if (codepoint > 0x10ffff)
+		return NoSymbol;
+	return codepoint | 0x01000000;
+}
+
+KeySym
+KeyMap::keypad_keysym(KeySym keysym)
+{
+	if (keysym >= '0' && keysym <= '9')
+		return XK_KP_0 + (keysym - '0');
+
+	switch (keysym) {
+	case XK_space:		return XK_KP_Space;
+	case XK_Tab:		return XK_KP_Tab;
+	case XK_Return:		return XK_KP_Enter;
+	case XK_equal:		return XK_KP_Equal;
+	case XK_asterisk:	return XK_KP_Multiply;
+	case XK_plus:		return XK_KP_Add;
+	case XK_comma:		return XK_KP_Separator;
+	case XK_minus:		return XK_KP_Subtract;
+	case XK_period:		return XK_KP_Decimal;
+	case XK_slash:		return XK_KP_Divide;
+
+	case XK_Home:		return XK_KP_Home;
+	case XK_Left:		return XK_KP_Left;
+	case XK_Up:			return XK_KP_Up;
+	case XK_Right:		return XK_KP_Right;
+	case XK_Down:		return XK_KP_Down;
+	case XK_Page_Up:	return XK_KP_Page_Up;
+	case XK_Page_Down:	return XK_KP_Page_Down;
+	case XK_End:		return XK_KP_End;
+	case XK_Begin:		return XK_KP_Begin;
+	case XK_Insert:		return XK_KP_Insert;
+	case XK_Delete:		return XK_KP_Delete;
+	}
+	return keysym;
+}
+
+int
+KeyMap::keysym_to_utf8(KeySym keysym, char buffer[4])
+{
+	unsigned long codepoint;
+	if ((keysym >= 0x20 && keysym <= 0x7e) || (keysym >= 0xa0 && keysym <= 0xff)) {
+		codepoint = keysym;
+	} else if ((keysym & 0xff000000) == 0x01000000) {
+		codepoint = keysym & 0x00ffffff;
+	} else if ((keysym >= XK_BackSpace && keysym <= XK_Clear) || keysym == XK_Return
+			|| keysym == XK_Escape || keysym == XK_KP_Space || keysym == XK_KP_Tab
+			|| keysym == XK_KP_Enter || (keysym >= XK_KP_Multiply && keysym <= XK_KP_9)
+			|| keysym == XK_KP_Equal || keysym == XK_Delete) {
+		// Same as the real Xlib.
+		codepoint = keysym & 0x7f;
+	} else {
+		return 0;
+	}
+
+	if (codepoint < 0x80) {
+		buffer[0] = codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800) {
+		buffer[0] = 0xc0 | (codepoint >> 6);
+		buffer[1] = 0x80 | (codepoint & 0x3f);
+		return 2;
+	}
+	if (codepoint < 0x10000) {
+		buffer[0] = 0xe0 | (codepoint >> 12);
+		buffer[1] = 0x80 | ((codepoint >> 6) & 0x3f);
+		buffer[2] = 0x80 | (codepoint & 0x3f);
+		return 3;
+	}
+	buffer[0] = 0xf0 | (codepoint >> 18);
+	buffer[1] = 0x80 | ((codepoint >> 12) & 0x3f);
+	buffer[2] = 0x80 | ((codepoint >> 6) & 0x3f);
+	buffer[3] = 0x80 | (codepoint & 0x3f);
+	return 4;
+}
+
+unsigned int
+KeyMap::keysym_to_modifier(KeySym keysym)
+{
+	switch (keysym) {
+	case XK_Shift_L:
+	case XK_Shift_R:
+		return ShiftMask;
+
+	case XK_Caps_Lock:
+		return LockMask;
+
+	case XK_Control_L:
+	case XK_Control_R:
+		return ControlMask;
+
+	case XK_Alt_L:
+	case XK_Alt_R:
+	case XK_Meta_L:
+	case XK_Meta_R:
+		return Mod1Mask;
+
+	case XK_Num_Lock:
+		return Mod2Mask;
+
+	case XK_Scroll_Lock:
+		return Mod3Mask;
+
+	case XK_Super_L:
+	case XK_Super_R:
+	case XK_Hyper_L:
+	case XK_Hyper_R:
+		return Mod4Mask;
+
+	case XK_Mode_switch:
+	case XK_ISO_Level3_Shift:
+		return kModeSwitchMask;
+	}
+	return 0;
+}
+
+static void
+convert_case_ucs(unsigned long codepoint, unsigned long* lower, unsigned long* upper)
+{
+	*lower = *upper = codepoint;
+
+	if ((codepoint >= 'A' && codepoint <= 'Z')
+			|| (codepoint >= 0xc0 && codepoint <= 0xde && codepoint != 0xd7)) {
+		*lower = codepoint + 0x20;
+	} else if ((codepoint >= 'a' && codepoint <= 'z')
+			|| (codepoint >= 0xe0 && codepoint <= 0xfe && codepoint != 0xf7)) {
+		*upper = codepoint - 0x20;
+	} else if (codepoint == 0xb5) {
+		// The micro sign is a mu.
+		*upper = 0x39c;
+	} else if (codepoint == 0xff) {
+		*upper = 0x178;
+	} else if (codepoint == 0x178) {
+		*lower = 0xff;
+	} else if (codepoint == 0x130) {
+		// Dotted capital I and dotless small i pair with the ASCII letters, as in libX11.
+		*lower = 'i';
+	} else if (codepoint == 0x131) {
+		*upper = 'I';
+	} else if (codepoint == 0x17f) {
+		*upper = 'S';
+	} else if ((codepoint >= 0x100 && codepoint <= 0x12f)
+			|| (codepoint >= 0x132 && codepoint <= 0x137)
+			|| (codepoint >= 0x14a && codepoint <= 0x177)) {
+		// Latin Extended-A: alternating pairs, uppercase first.
+		*lower = codepoint | 1;
+		*upper = codepoint & ~1UL;
+	} else if ((codepoint >= 0x139 && codepoint <= 0x148)
+			|| (codepoint >= 0x179 && codepoint <= 0x17e)) {
+		// Latin Extended-A: alternating pairs, lowercase first.
+		*lower = (codepoint & 1) ? codepoint + 1 : codepoint;
+		*upper = (codepoint & 1) ? codepoint : codepoint - 1;
+	} else if (codepoint >= 0x391 && codepoint <= 0x3a9 && codepoint != 0x3a2) {
+		*lower = codepoint + 0x20;
+	} else if (codepoint >= 0x3b1 && codepoint <= 0x3c9 && codepoint != 0x3c2) {
+		*upper = codepoint - 0x20;
+	} else if (codepoint >= 0x400 && codepoint <= 0x40f) {
+		*lower = codepoint + 0x50;
+	} else if (codepoint >= 0x410 && codepoint <= 0x42f) {
+		*lower = codepoint + 0x20;
+	} else if (codepoint >= 0x430 && codepoint <= 0x44f) {
+		*upper = codepoint - 0x20;
+	} else if (codepoint >= 0x450 && codepoint <= 0x45f) {
+		*upper = codepoint - 0x50;
+	}
+}
+
+void
+KeyMap::convert_case(KeySym keysym, KeySym* lower, KeySym* upper)
+{
+	*lower = *upper = keysym;
+
+	if (keysym < 0x100 || (keysym & 0xff000000) == 0x01000000) {
+		unsigned long l, u;
+		convert_case_ucs(keysym & 0x00ffffff, &l, &u);
+		*lower = (l < 0x100) ? l : (l | 0x01000000);
+		*upper = (u < 0x100) ? u : (u | 0x01000000);
+	} else if (keysym >= XK_Serbian_dje && keysym <= XK_Serbian_dze) {
+		*upper = keysym + (XK_Serbian_DJE - XK_Serbian_dje);
+	} else if (keysym >= XK_Serbian_DJE && keysym <= XK_Serbian_DZE) {
+		*lower = keysym - (XK_Serbian_DJE - XK_Serbian_dje);
+	} else if (keysym >= XK_Cyrillic_yu && keysym <= XK_Cyrillic_hardsign) {
+		*upper = keysym + (XK_Cyrillic_YU - XK_Cyrillic_yu);
+	} else if (keysym >= XK_Cyrillic_YU && keysym <= XK_Cyrillic_HARDSIGN) {
+		*lower = keysym - (XK_Cyrillic_YU - XK_Cyrillic_yu);
+	} else if (keysym >= XK_Greek_alpha && keysym <= XK_Greek_omega
+			&& keysym != XK_Greek_finalsmallsigma) {
+		*upper = keysym - (XK_Greek_alpha - XK_Greek_ALPHA);
+	} else if (keysym >= XK_Greek_ALPHA && keysym <= XK_Greek_OMEGA) {
+		*lower = keysym + (XK_Greek_alpha - XK_Greek_ALPHA);
+	}
+}
+
+KeySym
+KeyMap::keysym_for_name(const char* name)
+{
+	if (name == NULL)
+		return NoSymbol;
+
+	const int32_t index = sKeySymsByName.find(perfect_hash_string(name));
+	if (index >= 0 && strcmp(KEY_SYM_LIST[index].name, name) == 0)
+		return KEY_SYM_LIST[index].keySym;
+
+	// Algorithmic keysyms, in the same way as the real Xlib.
+	unsigned long value;
+	if (name[0] == 'U' && parse_hex(name + 1, value)) {
+		if (value < 0x20 || (value > 0x7e && value < 0xa0) || value > 0x10ffff)
+			return NoSymbol;
+		if (value < 0x100)
+			return value;
+		return value | 0x01000000;
+	}
+	if (name[0] == '0' && name[1] == 'x' && parse_hex(name + 2, value)) {
+		if (value > 0x1fffffff)
+			return NoSymbol;
+		return value;
+	}
+	return NoSymbol;
+}
+
+const char*
+KeyMap::keysym_name(KeySym keysym)
+{
+	const int32_t index = sKeySymsByValue.find(perfect_hash_integer(keysym));
+	if (index >= 0 && KEY_SYM_LIST[index].keySym == keysym)
+		return KEY_SYM_LIST[index].name;
+	return NULL;
+}
+
+} // namespace BeXlib
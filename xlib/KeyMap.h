@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <unordered_map>
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+namespace BeXlib {
+
+/* A keycode -> keysym table with shift levels, in the core protocol layout:
+ * two groups (the second selected by Mode_switch) of two levels each.
+ *
+ * It is built from per-key character data rather than a Haiku key_map, so
+ * test/unit/KeyMapTest.cpp can check it against synthetic keymaps. */
+class KeyMap {
+public:
+	enum {
+		kMinKeyCode = 8,
+		kKeyCount = 128,
+		kMaxKeyCode = kMinKeyCode + kKeyCount - 1,
+
+		kKeySymsPerKeyCode = 4,
+	};
+
+	struct Key {
+		// UTF-8 text the key produces at each level (NULL or empty for none.)
+		const char* chars[kKeySymsPerKeyCode];
+
+		// Fixed symbols for non-character keys; override "chars" at their level if set.
+		KeySym keysyms[kKeySymsPerKeyCode];
+
+		// Keys of the numeric keypad get the XK_KP_* forms of their symbols.
+		bool keypad;
+	};
+
+public:
+	KeyMap();
+
+	void build(const Key keys[kKeyCount]);
+
+	KeySym keysym(unsigned int keycode, int index) const;
+	KeySym lookup(unsigned int keycode, unsigned int state,
+		unsigned int* consumed = NULL) const;
+	KeyCode keycode(KeySym keysym) const;
+	unsigned int modifiers(unsigned int keycode) const;
+
+	/* The text of a key press, as XLookupString returns it: what was typed if the
+	 * system composed something else than the keysym's character (as with dead
+	 * keys), and otherwise that character (made a control character by Control.)
+	 * Returns 0 if there is none, or it does not fit. */
+	static int lookup_text(KeySym keysym, unsigned int state, const char* typed,
+		char* buffer, int bufferSize);
+
+	/* Names as in XStringToKeysym, including "Uxxxx" and "0x" forms; names of
+	 * keysyms only come from the table, with aliases resolving to the first. */
+	static KeySym keysym_for_name(const char* name);
+	static const char* keysym_name(KeySym keysym);
+
+	static KeySym keysym_for_utf8(const char* chars);
+	static KeySym keypad_keysym(KeySym keysym);
+	static int keysym_to_utf8(KeySym keysym, char buffer[4]);
+	static unsigned int keysym_to_modifier(KeySym keysym);
+	static void convert_case(KeySym keysym, KeySym* lower, KeySym* upper);
+
+private:
+	KeySym _keysyms[kKeyCount][kKeySymsPerKeyCode];
+	unsigned char _modifiers[kKeyCount];
+	std::unordered_map<KeySym, KeyCode> _keycodes;
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
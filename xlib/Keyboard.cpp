@@ -5,217 +5,202 @@
 #include "Keyboard.h"
 
 #include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <string>
 #include <interface/InterfaceDefs.h>
 #include <interface/View.h>
+#include <support/String.h>
 
 #include "Debug.h"
+#include "Event.h"
+#include "KeyMap.h"
+#include "Locking.h"
 
 extern "C" {
 #include <X11/Xlib.h>
 #include <X11/Xlibint.h>
 #include <X11/Xutil.h>
 #include <X11/XKBlib.h>
-
-#include "tables/keysymlist.h"
 }
 
-// Unfortunately we cannot store an XK_* inside the KeyEvent, because
-// despite xkey.keycode being a 32-bit-integer, if it is any larger than
-// 255, real applications will assume invalidity and discard the event (ugh.)
-// We also cannot use the Haiku-native keycode definitions, as these do not
-// contain direct mappings for the modifier and function keys. So, we must
-// create a local keycode mapping scheme.
-enum class LocalKeyCode : KeyCode {
-	Unknown = 1,
+// X keycodes are Haiku key codes offset by 8, as X requires keycodes to be
+// at least 8 (and applications assume they are at most 255.) What keysyms
+// those produce is determined by the system keymap, which is translated into
+// a table (and kept up to date) here.
+static pthread_rwlock_t sKeyMapLock = PTHREAD_RWLOCK_INITIALIZER;
+static KeyMap sKeyMap;
+static bool sKeyMapLoaded = false;
+
+// Text Haiku typed for recent key events which the keymap alone would not
+// produce (e.g. after dead keys), for XLookupString to return.
+struct TypedText {
+	Window window;
+	Time time;
+	unsigned int keycode;
+	char text[8];
+};
+static pthread_mutex_t sTypedTextsLock = PTHREAD_MUTEX_INITIALIZER;
+static TypedText sTypedTexts[16];
+static uint32 sNextTypedText = 0;
 
-	start = 128,
+static KeySym
+map_x_from_be(int32 rawChar, int32 key)
+{
+	switch (rawChar) {
+	case B_BACKSPACE:	return XK_BackSpace;
+	case B_RETURN:		return XK_Return;
+	case B_TAB:			return XK_Tab;
+	case B_ESCAPE:		return XK_Escape;
+
+	case B_LEFT_ARROW:	return XK_Left;
+	case B_RIGHT_ARROW:	return XK_Right;
+	case B_UP_ARROW:	return XK_Up;
+	case B_DOWN_ARROW:	return XK_Down;
+
+	case B_INSERT:		return XK_Insert;
+	case B_DELETE:		return XK_Delete;
+	case B_HOME:		return XK_Home;
+	case B_END:			return XK_End;
+	case B_PAGE_UP:		return XK_Page_Up;
+	case B_PAGE_DOWN:	return XK_Page_Down;
 
-	LeftShift, RightShift,
-	LeftControl, RightControl,
-	LeftAlt, RightAlt,
-	CapsLock,
-	NumLock,
-	ScrollLock,
+	case B_FUNCTION_KEY:
+		switch (key) {
+		case B_F1_KEY:	return XK_F1;
+		case B_F2_KEY:	return XK_F2;
+		case B_F3_KEY:	return XK_F3;
+		case B_F4_KEY:	return XK_F4;
+		case B_F5_KEY:	return XK_F5;
+		case B_F6_KEY:	return XK_F6;
+		case B_F7_KEY:	return XK_F7;
+		case B_F8_KEY:	return XK_F8;
+		case B_F9_KEY:	return XK_F9;
+		case B_F10_KEY:	return XK_F10;
+		case B_F11_KEY:	return XK_F11;
+		case B_F12_KEY:	return XK_F12;
+
+		case B_PRINT_KEY:	return XK_Print;
+		case B_SCROLL_KEY:	return XK_Scroll_Lock;
+		case B_PAUSE_KEY:	return XK_Pause;
+		}
+		break;
 
-	Backspace,
-	Return,
-	Space,
-	Tab,
-	Escape,
+	default: break;
+	}
 
-	LeftArrow, RightArrow, UpArrow, DownArrow,
+	return NoSymbol;
+}
 
-	Insert, Delete,
-	Home, End,
-	PageUp, PageDown,
+static bool
+is_keypad_key(uint32 key)
+{
+	// Haiku's key codes for the numeric keypad, other than Num Lock.
+	switch (key) {
+	case 0x23: case 0x24: case 0x25:
+	case 0x37: case 0x38: case 0x39: case 0x3a:
+	case 0x48: case 0x49: case 0x4a:
+	case 0x58: case 0x59: case 0x5a: case 0x5b:
+	case 0x64: case 0x65:
+		return true;
+	}
+	return false;
+}
 
-	F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12,
+static KeySym
+map_x_modifier_from_be(const key_map* map, uint32 key)
+{
+	if (key == 0)
+		return NoSymbol;
 
-	count,
-};
-static_assert((int)LocalKeyCode::count < 255);
+	// These must agree with _x_get_button_state.
+	if (key == map->left_shift_key)		return XK_Shift_L;
+	if (key == map->right_shift_key)	return XK_Shift_R;
+	if (key == map->left_command_key)	return XK_Control_L;
+	if (key == map->right_command_key)	return XK_Control_R;
+	if (key == map->left_control_key)	return XK_Alt_L;
+	if (key == map->right_control_key)	return XK_Alt_R;
+	if (key == map->left_option_key)	return XK_Mode_switch;
+	if (key == map->right_option_key)	return XK_Mode_switch;
+	if (key == map->caps_key)			return XK_Caps_Lock;
+	if (key == map->num_key)			return XK_Num_Lock;
+	if (key == map->scroll_key)			return XK_Scroll_Lock;
+	if (key == map->menu_key)			return XK_Menu;
+	return NoSymbol;
+}
+
+static void
+load_keymap()
+{
+	key_map* map = NULL;
+	char* chars = NULL;
+	get_key_map(&map, &chars);
+
+	KeyMap::Key keys[KeyMap::kKeyCount] = {};
+	BString strings[KeyMap::kKeyCount][KeyMap::kKeySymsPerKeyCode];
+	if (map != NULL && chars != NULL) {
+		const int32* levels[KeyMap::kKeySymsPerKeyCode] = {
+			map->normal_map, map->shift_map, map->option_map, map->option_shift_map,
+		};
+		for (int32 key = 0; key < KeyMap::kKeyCount; key++) {
+			keys[key].keysyms[0] = map_x_modifier_from_be(map, key);
+			if (keys[key].keysyms[0] != NoSymbol)
+				continue;
+
+			// Haiku's keypad has the navigation keys in the normal map and the
+			// digits in the shift map, as X's does.
+			keys[key].keypad = is_keypad_key(key);
+			for (int level = 0; level < KeyMap::kKeySymsPerKeyCode; level++) {
+				const char* string = chars + levels[level][key];
+				strings[key][level].SetTo(string + 1, (uint8)string[0]);
+				keys[key].chars[level] = strings[key][level].String();
+				if (strings[key][level].Length() == 1)
+					keys[key].keysyms[level] = map_x_from_be(strings[key][level][0], key);
+			}
+		}
+	}
+	free(map);
+	free(chars);
+
+	sKeyMap.build(keys);
+	sKeyMapLoaded = true;
+}
 
-static inline bool
-is_allowed_ascii(const int32 c)
+void
+_x_init_keymap()
 {
-	return (c >= 32 /* ' ' */ && c <= 126 /* '~' */);
+	PthreadWriteLocker wrlock(sKeyMapLock);
+	if (!sKeyMapLoaded)
+		load_keymap();
 }
 
-static inline LocalKeyCode
-map_local_from_be(int32 rawChar, int32 key)
+void
+_x_reload_keymap(Display* display)
 {
-	switch (rawChar) {
-	case B_BACKSPACE:	return LocalKeyCode::Backspace;
-	case B_RETURN:		return LocalKeyCode::Return;
-	case B_SPACE:		return LocalKeyCode::Space;
-	case B_TAB:			return LocalKeyCode::Tab;
-	case B_ESCAPE:		return LocalKeyCode::Escape;
-
-	case B_LEFT_ARROW:	return LocalKeyCode::LeftArrow;
-	case B_RIGHT_ARROW:	return LocalKeyCode::RightArrow;
-	case B_UP_ARROW:	return LocalKeyCode::UpArrow;
-	case B_DOWN_ARROW:	return LocalKeyCode::DownArrow;
-
-	case B_INSERT:		return LocalKeyCode::Insert;
-	case B_DELETE:		return LocalKeyCode::Delete;
-	case B_HOME:		return LocalKeyCode::Home;
-	case B_END:			return LocalKeyCode::End;
-	case B_PAGE_UP:		return LocalKeyCode::PageUp;
-	case B_PAGE_DOWN:	return LocalKeyCode::PageDown;
+	PthreadWriteLocker wrlock(sKeyMapLock);
+	load_keymap();
+	wrlock.Unlock();
 
-	case B_FUNCTION_KEY:
-		switch (key) {
-		case B_F1_KEY:	return LocalKeyCode::F1;
-		case B_F2_KEY:	return LocalKeyCode::F2;
-		case B_F3_KEY:	return LocalKeyCode::F3;
-		case B_F4_KEY:	return LocalKeyCode::F4;
-		case B_F5_KEY:	return LocalKeyCode::F5;
-		case B_F6_KEY:	return LocalKeyCode::F6;
-		case B_F7_KEY:	return LocalKeyCode::F7;
-		case B_F8_KEY:	return LocalKeyCode::F8;
-		case B_F9_KEY:	return LocalKeyCode::F9;
-		case B_F10_KEY:	return LocalKeyCode::F10;
-		case B_F11_KEY:	return LocalKeyCode::F11;
-		case B_F12_KEY:	return LocalKeyCode::F12;
-		}
-		break;
+	if (!display)
+		return;
 
-	default: break;
-	}
+	XEvent event = {};
+	event.type = MappingNotify;
+	event.xmapping.request = MappingKeyboard;
+	event.xmapping.first_keycode = KeyMap::kMinKeyCode;
+	event.xmapping.count = KeyMap::kKeyCount;
+	_x_put_event(display, event);
 
-	return LocalKeyCode::Unknown;
-}
-
-static inline KeySym
-map_x_from_local(LocalKeyCode code)
-{
-	if (is_allowed_ascii((int32)code))
-		return (KeySym)code;
-
-	switch (code) {
-	default:
-	case LocalKeyCode::Unknown:			return NoSymbol;
-
-	case LocalKeyCode::LeftShift:		return XK_Shift_L;
-	case LocalKeyCode::RightShift:		return XK_Shift_R;
-
-	case LocalKeyCode::LeftControl:		return XK_Control_L;
-	case LocalKeyCode::RightControl:	return XK_Control_R;
-
-	case LocalKeyCode::LeftAlt:			return XK_Alt_L;
-	case LocalKeyCode::RightAlt:		return XK_Alt_R;
-
-	case LocalKeyCode::CapsLock:		return XK_Caps_Lock;
-	case LocalKeyCode::NumLock:			return XK_Num_Lock;
-	case LocalKeyCode::ScrollLock:		return XK_Scroll_Lock;
-
-	case LocalKeyCode::Backspace:		return XK_BackSpace;
-	case LocalKeyCode::Return:			return XK_Return;
-	case LocalKeyCode::Space:			return XK_space;
-	case LocalKeyCode::Tab:				return XK_Tab;
-	case LocalKeyCode::Escape:			return XK_Escape;
-
-	case LocalKeyCode::LeftArrow:		return XK_Left;
-	case LocalKeyCode::RightArrow:		return XK_Right;
-	case LocalKeyCode::UpArrow:			return XK_Up;
-	case LocalKeyCode::DownArrow:		return XK_Down;
-
-	case LocalKeyCode::Insert:			return XK_Insert;
-	case LocalKeyCode::Delete:			return XK_Delete;
-	case LocalKeyCode::Home:			return XK_Home;
-	case LocalKeyCode::End:				return XK_End;
-	case LocalKeyCode::PageUp:			return XK_Page_Up;
-	case LocalKeyCode::PageDown:		return XK_Page_Down;
-
-	case LocalKeyCode::F1:				return XK_F1;
-	case LocalKeyCode::F2:				return XK_F2;
-	case LocalKeyCode::F3:				return XK_F3;
-	case LocalKeyCode::F4:				return XK_F4;
-	case LocalKeyCode::F5:				return XK_F5;
-	case LocalKeyCode::F6:				return XK_F6;
-	case LocalKeyCode::F7:				return XK_F7;
-	case LocalKeyCode::F8:				return XK_F8;
-	case LocalKeyCode::F9:				return XK_F9;
-	case LocalKeyCode::F10:				return XK_F10;
-	case LocalKeyCode::F11:				return XK_F11;
-	case LocalKeyCode::F12:				return XK_F12;
-	}
+	event.xmapping.request = MappingModifier;
+	event.xmapping.first_keycode = event.xmapping.count = 0;
+	_x_put_event(display, event);
 }
 
 extern "C" KeyCode
 XKeysymToKeycode(Display* display, KeySym keysym)
 {
-	if (is_allowed_ascii((int32)keysym))
-		return (KeyCode)keysym;
-
-	LocalKeyCode key = (LocalKeyCode)0;
-	switch (keysym) {
-	default:
-	case XK_Shift_L:		key = LocalKeyCode::LeftShift; break;
-	case XK_Shift_R:		key = LocalKeyCode::RightShift; break;
-
-	case XK_Control_L:		key = LocalKeyCode::LeftControl; break;
-	case XK_Control_R:		key = LocalKeyCode::RightControl; break;
-
-	case XK_Alt_L:			key = LocalKeyCode::LeftAlt; break;
-	case XK_Alt_R:			key = LocalKeyCode::RightAlt; break;
-
-	case XK_Caps_Lock:		key = LocalKeyCode::CapsLock; break;
-	case XK_Num_Lock:		key = LocalKeyCode::NumLock; break;
-	case XK_Scroll_Lock:	key = LocalKeyCode::ScrollLock; break;
-
-	case XK_BackSpace:		key = LocalKeyCode::Backspace; break;
-	case XK_Return:			key = LocalKeyCode::Return; break;
-	case XK_space:			key = LocalKeyCode::Space; break;
-	case XK_Tab:			key = LocalKeyCode::Tab; break;
-	case XK_Escape:			key = LocalKeyCode::Escape; break;
-
-	case XK_Left:			key = LocalKeyCode::LeftArrow; break;
-	case XK_Right:			key = LocalKeyCode::RightArrow; break;
-	case XK_Up:				key = LocalKeyCode::UpArrow; break;
-	case XK_Down:			key = LocalKeyCode::DownArrow; break;
-
-	case XK_Insert:			key = LocalKeyCode::Insert; break;
-	case XK_Delete:			key = LocalKeyCode::Delete; break;
-	case XK_Home:			key = LocalKeyCode::Home; break;
-	case XK_End:			key = LocalKeyCode::End; break;
-	case XK_Page_Up:		key = LocalKeyCode::PageUp; break;
-	case XK_Page_Down:		key = LocalKeyCode::PageDown; break;
-
-	case XK_F1:				key = LocalKeyCode::F1; break;
-	case XK_F2:				key = LocalKeyCode::F2; break;
-	case XK_F3:				key = LocalKeyCode::F3; break;
-	case XK_F4:				key = LocalKeyCode::F4; break;
-	case XK_F5:				key = LocalKeyCode::F5; break;
-	case XK_F6:				key = LocalKeyCode::F6; break;
-	case XK_F7:				key = LocalKeyCode::F7; break;
-	case XK_F8:				key = LocalKeyCode::F8; break;
-	case XK_F9:				key = LocalKeyCode::F9; break;
-	case XK_F10:			key = LocalKeyCode::F10; break;
-	case XK_F11:			key = LocalKeyCode::F11; break;
-	case XK_F12:			key = LocalKeyCode::F12; break;
-	}
-	return (KeyCode)key;
+	PthreadReadLocker rdlock(sKeyMapLock);
+	return sKeyMap.keycode(keysym);
 }
 
 int
@@ -252,6 +237,10 @@ _x_get_button_state(int32 modifiers, int32 mouseButtons)
 		xmod |= Mod1Mask;
 	if (modifiers & B_NUM_LOCK)
 		xmod |= Mod2Mask;
+	if (modifiers & B_SCROLL_LOCK)
+		xmod |= Mod3Mask;
+	if (modifiers & B_OPTION_KEY)
+		xmod |= Mod5Mask;
 
 	if (mouseButtons & B_MOUSE_BUTTON(1))
 		xmod |= Button1Mask;
@@ -264,110 +253,148 @@ _x_get_button_state(int32 modifiers, int32 mouseButtons)
 }
 
 void
-_x_fill_key_event(XEvent* event, BMessage* message, const char* bytes, int32 numBytes)
+_x_fill_key_event(XEvent* event, BMessage* message)
 {
-	int32 rawChar = 0, key = 0;
-	message->FindInt32("raw_char", &rawChar);
+	int32 key = 0;
 	message->FindInt32("key", &key);
 
-	event->xkey.keycode = (int)map_local_from_be(rawChar, key);
+	event->xkey.keycode = (key >= 0 && key < KeyMap::kKeyCount) ? (key + KeyMap::kMinKeyCode) : 0;
 	event->xkey.state = _x_get_button_state(message);
+	event->xkey.same_screen = True;
 
-	if (event->xkey.keycode == (int)LocalKeyCode::Unknown && numBytes == 1) {
-		if (is_allowed_ascii(bytes[0]))
-			event->xkey.keycode = bytes[0];
-	}
+	const char* bytes = NULL;
+	if (message->FindString("bytes", &bytes) != B_OK || strlen(bytes) >= sizeof(TypedText::text))
+		return;
+
+	PthreadReadLocker rdlock(sKeyMapLock);
+	const KeySym keysym = sKeyMap.lookup(event->xkey.keycode, event->xkey.state);
+	rdlock.Unlock();
 
-	// abuse the "same_screen" field to store the bytes.
-	event->xkey.same_screen = 0;
-	memcpy(&event->xkey.same_screen, bytes,
-		min_c(numBytes, sizeof(event->xkey.same_screen)));
+	char typed[sizeof(TypedText::text)], text[sizeof(TypedText::text)];
+	const int typedLength = KeyMap::lookup_text(keysym, event->xkey.state, bytes,
+		typed, sizeof(typed));
+	const int length = KeyMap::lookup_text(keysym, event->xkey.state, NULL,
+		text, sizeof(text));
+	if (typedLength == length && memcmp(typed, text, length) == 0)
+		return;
+
+	pthread_mutex_lock(&sTypedTextsLock);
+	TypedText& entry = sTypedTexts[sNextTypedText++ % B_COUNT_OF(sTypedTexts)];
+	entry.window = event->xkey.window;
+	entry.time = event->xkey.time;
+	entry.keycode = event->xkey.keycode;
+	strlcpy(entry.text, bytes, sizeof(entry.text));
+	pthread_mutex_unlock(&sTypedTextsLock);
+}
+
+static bool
+find_typed_text(const XKeyEvent* event, char* text)
+{
+	bool found = false;
+	pthread_mutex_lock(&sTypedTextsLock);
+	for (const TypedText& entry : sTypedTexts) {
+		if (entry.time == event->time && entry.keycode == event->keycode
+				&& entry.window == event->window) {
+			strlcpy(text, entry.text, sizeof(entry.text));
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sTypedTextsLock);
+	return found;
 }
 
 extern "C" int
 XLookupString(XKeyEvent* key_event, char* buffer_return, int bytes_buffer,
 	KeySym* keysym_return, XComposeStatus* status_in_out)
 {
+	PthreadReadLocker rdlock(sKeyMapLock);
+	const KeySym keysym = sKeyMap.lookup(key_event->keycode, key_event->state);
+	rdlock.Unlock();
+
 	if (keysym_return)
-		*keysym_return = XLookupKeysym(key_event, 0);
+		*keysym_return = keysym;
 
-	if (!buffer_return)
+	if (!buffer_return || bytes_buffer <= 0)
 		return 0;
 
-	if (is_allowed_ascii(key_event->keycode)) {
-		buffer_return[0] = key_event->keycode;
-		return 1;
-	}
-
-	int copybytes = strnlen((const char*)&key_event->same_screen, sizeof(key_event->same_screen));
-	copybytes = min_c(copybytes, bytes_buffer);
-	if (copybytes <= 0)
-		return 0;
-	memcpy(buffer_return, &key_event->same_screen, copybytes);
-	return copybytes;
+	char typed[sizeof(TypedText::text)];
+	const bool wasTyped = !key_event->send_event && find_typed_text(key_event, typed);
+	return KeyMap::lookup_text(keysym, key_event->state, wasTyped ? typed : NULL,
+		buffer_return, bytes_buffer);
 }
 
 extern "C" KeySym
 XkbKeycodeToKeysym(Display* dpy, unsigned int kc, int group, int level)
 {
-	return map_x_from_local((LocalKeyCode)kc);
+	if (group < 0 || group > 1 || level < 0 || level > 1)
+		return NoSymbol;
+
+	PthreadReadLocker rdlock(sKeyMapLock);
+	return sKeyMap.keysym(kc, group * 2 + level);
 }
 
 extern "C" Bool
 XkbLookupKeySym(Display* dpy, KeyCode keycode,
 	unsigned int modifiers, unsigned int* modifiers_return, KeySym* keysym_return)
 {
-	*keysym_return = map_x_from_local((LocalKeyCode)keycode);
-	if (modifiers_return)
-		*modifiers_return = modifiers;
-	return (*keysym_return != NoSymbol);
+	return XkbTranslateKeyCode(NULL, keycode, modifiers, modifiers_return, keysym_return);
 }
 
-extern "C" unsigned int
-XkbKeysymToModifiers(Display* dpy, KeySym ks)
+extern "C" Bool
+XkbTranslateKeyCode(XkbDescPtr xkb, KeyCode key, unsigned int mods,
+	unsigned int* mods_rtrn, KeySym* keysym_rtrn)
 {
-	switch (ks) {
-	case XK_Shift_L:
-	case XK_Shift_R:
-		return ShiftMask;
-
-	case XK_Caps_Lock:
-		return LockMask;
-
-	case XK_Control_L:
-	case XK_Control_R:
-		return ControlMask;
+	unsigned int consumed;
+	PthreadReadLocker rdlock(sKeyMapLock);
+	*keysym_rtrn = sKeyMap.lookup(key, mods, &consumed);
+	rdlock.Unlock();
 
-	case XK_Alt_L:
-		return Mod1Mask;
-	case XK_Alt_R:
-		return Mod4Mask;
+	if (mods_rtrn)
+		*mods_rtrn = consumed;
+	return (*keysym_rtrn != NoSymbol);
+}
 
-	case XK_Num_Lock:
-		return Mod2Mask;
+extern "C" void
+XConvertCase(KeySym keysym, KeySym* lower_return, KeySym* upper_return)
+{
+	KeyMap::convert_case(keysym, lower_return, upper_return);
+}
 
-	case XK_Scroll_Lock:
-		return Mod3Mask;
-	}
-	return 0;
+extern "C" unsigned int
+XkbKeysymToModifiers(Display* dpy, KeySym ks)
+{
+	return KeyMap::keysym_to_modifier(ks);
 }
 
 extern "C" XModifierKeymap*
 XGetModifierMapping(Display* display)
 {
+	PthreadReadLocker rdlock(sKeyMapLock);
+
+	int count[8] = {};
+	for (int keycode = KeyMap::kMinKeyCode; keycode <= KeyMap::kMaxKeyCode; keycode++) {
+		const unsigned int modifiers = sKeyMap.modifiers(keycode);
+		for (int i = 0; i < 8; i++) {
+			if (modifiers & (1 << i))
+				count[i]++;
+		}
+	}
+
 	XModifierKeymap* map = (XModifierKeymap*)calloc(sizeof(XModifierKeymap), 1);
-	map->max_keypermod = 2;
-	map->modifiermap = (KeyCode*)calloc(sizeof(KeyCode), 16);
-	memset(map->modifiermap, 0, sizeof(KeyCode) * 16);
-	map->modifiermap[ShiftMapIndex * 2 + 0] = (uchar)LocalKeyCode::LeftShift;
-	map->modifiermap[ShiftMapIndex * 2 + 1] = (uchar)LocalKeyCode::RightShift;
-	map->modifiermap[LockMapIndex * 2 + 0] = (uchar)LocalKeyCode::CapsLock;
-	map->modifiermap[ControlMapIndex * 2 + 0] = (uchar)LocalKeyCode::LeftControl;
-	map->modifiermap[ControlMapIndex * 2 + 1] = (uchar)LocalKeyCode::RightControl;
-	map->modifiermap[Mod1MapIndex * 2 + 0] = (uchar)LocalKeyCode::LeftAlt;
-	map->modifiermap[Mod2MapIndex * 2 + 0] = (uchar)LocalKeyCode::NumLock;
-	map->modifiermap[Mod3MapIndex * 2 + 0] = (uchar)LocalKeyCode::ScrollLock;
-	map->modifiermap[Mod4MapIndex * 2 + 0] = (uchar)LocalKeyCode::RightAlt;
+	map->max_keypermod = 0;
+	for (int i = 0; i < 8; i++)
+		map->max_keypermod = max_c(map->max_keypermod, count[i]);
+	map->modifiermap = (KeyCode*)calloc(sizeof(KeyCode), 8 * max_c(map->max_keypermod, 1));
+
+	memset(count, 0, sizeof(count));
+	for (int keycode = KeyMap::kMinKeyCode; keycode <= KeyMap::kMaxKeyCode; keycode++) {
+		const unsigned int modifiers = sKeyMap.modifiers(keycode);
+		for (int i = 0; i < 8; i++) {
+			if (modifiers & (1 << i))
+				map->modifiermap[i * map->max_keypermod + count[i]++] = keycode;
+		}
+	}
 	return map;
 }
 
@@ -383,19 +410,21 @@ extern "C" KeySym*
 XGetKeyboardMapping(Display* dpy, unsigned int first_keycode, int keycode_count,
 	int* keysyms_per_keycode_return)
 {
-	if ((first_keycode + (keycode_count - 1)) > dpy->max_keycode)
+	if (first_keycode < dpy->min_keycode
+			|| (first_keycode + (keycode_count - 1)) > dpy->max_keycode)
 		return NULL;
 
-	KeySym* keysyms = (KeySym*)calloc(keycode_count, sizeof(KeySym));
+	const int perKeyCode = KeyMap::kKeySymsPerKeyCode;
+	KeySym* keysyms = (KeySym*)calloc(keycode_count * perKeyCode, sizeof(KeySym));
 	if (!keysyms)
 		return NULL;
+	*keysyms_per_keycode_return = perKeyCode;
 
-	// We only ever have one KeySym per keycode.
-	*keysyms_per_keycode_return = 1;
-
-	for (unsigned int i = 0; i < keycode_count; i++)
-		keysyms[i] = XKeycodeToKeysym(dpy, first_keycode + i, 0);
-
+	PthreadReadLocker rdlock(sKeyMapLock);
+	for (int i = 0; i < keycode_count; i++) {
+		for (int j = 0; j < perKeyCode; j++)
+			keysyms[i * perKeyCode + j] = sKeyMap.keysym(first_keycode + i, j);
+	}
 	return keysyms;
 }
 
@@ -403,6 +432,7 @@ extern "C" XkbDescPtr
 XkbGetMap(Display* display, unsigned int which, unsigned int device_spec)
 {
 	XkbDescPtr desc = (XkbDescPtr)calloc(sizeof(XkbDescRec), 1);
+	desc->dpy = display;
 	desc->device_spec = device_spec;
 	if (XkbGetUpdatedMap(display, which, desc) != Success) {
 		XkbFreeKeyboard(desc, 0, True);
@@ -411,12 +441,105 @@ XkbGetMap(Display* display, unsigned int which, unsigned int device_spec)
 	return desc;
 }
 
+static void
+free_client_map(XkbClientMapPtr map)
+{
+	if (!map)
+		return;
+
+	for (int i = 0; i < map->num_types; i++)
+		free(map->types[i].map);
+	free(map->types);
+	free(map->syms);
+	free(map->key_sym_map);
+	free(map->modmap);
+	free(map);
+}
+
+static void
+init_key_type(Display* display, XkbKeyTypePtr type, const char* name,
+	unsigned char levelModifiers[], int count)
+{
+	type->num_levels = count ? 2 : 1;
+	type->map_count = count;
+	type->map = count ? (XkbKTMapEntryPtr)calloc(count, sizeof(XkbKTMapEntryRec)) : NULL;
+	for (int i = 0; i < count; i++) {
+		type->mods.mask = type->mods.real_mods |= levelModifiers[i];
+
+		type->map[i].active = True;
+		type->map[i].level = 1;
+		type->map[i].mods.mask = type->map[i].mods.real_mods = levelModifiers[i];
+	}
+	type->name = XInternAtom(display, name, False);
+}
+
 extern "C" Status
 XkbGetUpdatedMap(Display* display, unsigned int which, XkbDescPtr xkb)
 {
-	xkb->min_key_code = 1;
-	xkb->max_key_code = 0;
-	// We do not actually fill anything in here, but leave it all zeros.
+	xkb->min_key_code = KeyMap::kMinKeyCode;
+	xkb->max_key_code = KeyMap::kMaxKeyCode;
+	if (!(which & XkbAllClientInfoMask))
+		return Success;
+
+	free_client_map(xkb->map);
+	XkbClientMapPtr map = xkb->map = (XkbClientMapPtr)calloc(1, sizeof(XkbClientMapRec));
+	if (!map)
+		return BadAlloc;
+
+	// The standard types, which are all that the table needs.
+	map->size_types = map->num_types = XkbNumRequiredTypes;
+	map->types = (XkbKeyTypePtr)calloc(map->size_types, sizeof(XkbKeyTypeRec));
+	unsigned char twoLevel[] = { ShiftMask },
+		alphabetic[] = { ShiftMask, LockMask },
+		keypad[] = { ShiftMask, Mod2Mask };
+	init_key_type(display, &map->types[XkbOneLevelIndex], "ONE_LEVEL", NULL, 0);
+	init_key_type(display, &map->types[XkbTwoLevelIndex], "TWO_LEVEL", twoLevel, 1);
+	init_key_type(display, &map->types[XkbAlphabeticIndex], "ALPHABETIC", alphabetic, 2);
+	init_key_type(display, &map->types[XkbKeypadIndex], "KEYPAD", keypad, 2);
+
+	map->key_sym_map = (XkbSymMapPtr)calloc(xkb->max_key_code + 1, sizeof(XkbSymMapRec));
+	map->modmap = (unsigned char*)calloc(xkb->max_key_code + 1, sizeof(unsigned char));
+
+	// Index 0 is reserved for keys without any symbols.
+	map->size_syms = 1 + KeyMap::kKeyCount * KeyMap::kKeySymsPerKeyCode;
+	map->syms = (KeySym*)calloc(map->size_syms, sizeof(KeySym));
+	map->num_syms = 1;
+
+	PthreadReadLocker rdlock(sKeyMapLock);
+	for (int keycode = xkb->min_key_code; keycode <= xkb->max_key_code; keycode++) {
+		KeySym syms[KeyMap::kKeySymsPerKeyCode];
+		for (int i = 0; i < KeyMap::kKeySymsPerKeyCode; i++)
+			syms[i] = sKeyMap.keysym(keycode, i);
+		map->modmap[keycode] = sKeyMap.modifiers(keycode);
+
+		const int groups = (syms[2] != NoSymbol || syms[3] != NoSymbol) ? 2
+			: (syms[0] != NoSymbol) ? 1 : 0;
+		const int width = (syms[1] != NoSymbol || syms[3] != NoSymbol) ? 2 : 1;
+		if (groups == 0)
+			continue;
+
+		XkbSymMapPtr symMap = &map->key_sym_map[keycode];
+		symMap->group_info = XkbSetNumGroups(0, groups);
+		symMap->width = width;
+		symMap->offset = map->num_syms;
+		for (int group = 0; group < groups; group++) {
+			const KeySym lower = syms[group * 2], upper = syms[group * 2 + 1];
+			KeySym convertedLower, convertedUpper;
+			KeyMap::convert_case(lower, &convertedLower, &convertedUpper);
+
+			if (width == 1)
+				symMap->kt_index[group] = XkbOneLevelIndex;
+			else if (lower != upper && convertedUpper == upper)
+				symMap->kt_index[group] = XkbAlphabeticIndex;
+			else if (IsKeypadKey(lower))
+				symMap->kt_index[group] = XkbKeypadIndex;
+			else
+				symMap->kt_index[group] = XkbTwoLevelIndex;
+
+			for (int level = 0; level < width; level++)
+				map->syms[map->num_syms++] = syms[group * 2 + level];
+		}
+	}
 	return Success;
 }
 
@@ -432,53 +555,66 @@ XkbFreeKeyboard(XkbDescPtr xkb, unsigned int which, Bool freeDesc)
 {
 	if (!xkb)
 		return;
-	// We never actually fill in any of the structures.
+
+	// The client map is the only structure we ever fill in.
+	if (freeDesc || (which & XkbAllClientInfoMask)) {
+		free_client_map(xkb->map);
+		xkb->map = NULL;
+	}
 	if (freeDesc)
 		free(xkb);
 }
 
+static pthread_rwlock_t sUnicodeNamesLock = PTHREAD_RWLOCK_INITIALIZER;
+static std::unordered_map<KeySym, std::string> sUnicodeNames;
+
 extern "C" KeySym
 XStringToKeysym(const char* string)
 {
-	if (string == NULL)
-		return NoSymbol;
-
-	for (int i = 0; i < KEY_SYM_LIST_LENGTH; i++) {
-		if (strcmp(KEY_SYM_LIST[i].name, string) == 0)
-			return KEY_SYM_LIST[i].keySym;
-	}
-	return NoSymbol;
+	return KeyMap::keysym_for_name(string);
 }
 
 extern "C" char*
 XKeysymToString(KeySym keysym)
 {
-	for (int i = 0; i < KEY_SYM_LIST_LENGTH; i++) {
-		if (KEY_SYM_LIST[i].keySym == keysym)
-			return (char*)KEY_SYM_LIST[i].name;
-	}
-	return NULL;
-}
+	const char* name = KeyMap::keysym_name(keysym);
+	if (name != NULL)
+		return (char*)name;
 
-// #pragma mark - minor functions
+	if (keysym < 0x01000100 || keysym > 0x0110ffff)
+		return NULL;
 
-extern "C" Bool
-XkbTranslateKeyCode(XkbDescPtr xkb, KeyCode key, unsigned int mods,
-	unsigned int* mods_rtrn, KeySym* keysym_rtrn)
-{
-	return XkbLookupKeySym(NULL, key, mods, mods_rtrn, keysym_rtrn);
+	// Unicode keysyms are named "U" followed by 4 or 6 hex digits.
+	// These are generated on demand, and then kept so that they can be returned
+	// without the caller having to free them (as with all other names.)
+	PthreadReadLocker rdlock(sUnicodeNamesLock);
+	auto result = sUnicodeNames.find(keysym);
+	if (result != sUnicodeNames.end())
+		return (char*)result->second.c_str();
+	rdlock.Unlock();
+
+	char unicodeName[8];
+	const unsigned long value = keysym & 0xffffff;
+	snprintf(unicodeName, sizeof(unicodeName), (value & 0xff0000) ? "U%06lX" : "U%04lX", value);
+
+	PthreadWriteLocker wrlock(sUnicodeNamesLock);
+	result = sUnicodeNames.insert({keysym, unicodeName}).first;
+	return (char*)result->second.c_str();
 }
 
+// #pragma mark - minor functions
+
 extern "C" KeySym
 XKeycodeToKeysym(Display* dpy, unsigned int kc, int index)
 {
-	return XkbKeycodeToKeysym(dpy, kc, 0, 0);
+	PthreadReadLocker rdlock(sKeyMapLock);
+	return sKeyMap.keysym(kc, index);
 }
 
 extern "C" KeySym
 XLookupKeysym(XKeyEvent* key_event, int index)
 {
-	return XkbKeycodeToKeysym(key_event->display, key_event->keycode, 0, 0);
+	return XKeycodeToKeysym(key_event->display, key_event->keycode, index);
 }
 
 extern "C" Display*
@@ -517,12 +653,6 @@ XkbTranslateKeySym(Display* dpy, KeySym* sym_return, unsigned int modifiers, cha
 	return 0;
 }
 
-extern "C" void
-XConvertCase(KeySym keysym, KeySym *lower_return, KeySym *upper_return)
-{
-	UNIMPLEMENTED();
-}
-
 extern "C" int
 XGetKeyboardControl(Display* dpy, XKeyboardState* state_return)
 {
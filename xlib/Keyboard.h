@@ -13,4 +13,7 @@ extern "C" {
 int _x_get_button_state(BMessage* message);
 int _x_get_button_state(int32 modifiers = -1, int32 mouseButtons = -1);
 
-void _x_fill_key_event(XEvent* event, BMessage* message, const char* bytes, int32 numBytes);
+void _x_init_keymap();
+void _x_reload_keymap(Display* display);
+
+void _x_fill_key_event(XEvent* event, BMessage* message);
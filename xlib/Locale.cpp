@@ -7,52 +7,144 @@
 #include <kernel/OS.h>
 #include <langinfo.h>
 #include <iconv.h>
+#include <cerrno>
+#include <cstring>
+#include <utility>
 
 #include "Atom.h"
 #include "Property.h"
 #include "Debug.h"
+#include "UTF8.h"
 
 extern "C" {
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 }
 
+// #pragma mark - conversion
+
+namespace {
+/* Recently used converters to UTF-8, so that text drawing and measuring
+ * does not have to open (and close) a new one every time. */
+class Converters {
+private:
+	static const int kCount = 4;
+
+	struct Entry {
+		BString encoding;
+		iconv_t cd;
+	};
+	Entry _entries[kCount];
+	int _used = 0;
+
+public:
+	~Converters();
+
+	iconv_t get(const char* encoding);
+};
+}
+
+static thread_local Converters sConverters;
+
+Converters::~Converters()
+{
+	for (int i = 0; i < _used; i++)
+		iconv_close(_entries[i].cd);
+}
+
+iconv_t
+Converters::get(const char* encoding)
+{
+	int index = 0;
+	for (; index < _used; index++) {
+		if (_entries[index].encoding.ICompare(encoding) == 0)
+			break;
+	}
+
+	if (index == _used) {
+		iconv_t cd = iconv_open("UTF-8", encoding);
+		if (cd == (iconv_t)-1)
+			return cd;
+
+		// Evict the least recently used converter, if need be.
+		if (_used == kCount)
+			iconv_close(_entries[--index].cd);
+		else
+			_used++;
+		_entries[index].encoding = encoding;
+		_entries[index].cd = cd;
+	} else {
+		// Reset the shift state left over from the last conversion.
+		iconv(_entries[index].cd, NULL, NULL, NULL, NULL);
+	}
+
+	// Keep the entries in most-recently-used order.
+	for (; index > 0; index--)
+		std::swap(_entries[index], _entries[index - 1]);
+	return _entries[0].cd;
+}
+
+static bool
+is_latin1(const char* encoding)
+{
+	return strcasecmp(encoding, "ISO-8859-1") == 0 || strcasecmp(encoding, "ISO8859-1") == 0
+		|| strcasecmp(encoding, "ISO_8859-1") == 0 || strcasecmp(encoding, "LATIN1") == 0;
+}
+
 static inline BString
 convert_to_utf8(const char* encoding, const void* str, int strBytesLen)
 {
+	// The locale's codeset is always a superset of ASCII.
+	const bool asciiCompatible = (encoding == NULL);
 	if (encoding == NULL)
 		encoding = nl_langinfo(CODESET);
 	if (strBytesLen == -1)
 		strBytesLen = strlen((const char*)str);
-	if (strcasecmp(encoding, "UTF-8") == 0) {
+	if (strBytesLen <= 0)
+		return BString();
+	if (strcasecmp(encoding, "UTF-8") == 0 || strcasecmp(encoding, "UTF8") == 0
+			|| (asciiCompatible && UTF8::ascii_length((const uint8*)str, strBytesLen) == (size_t)strBytesLen)) {
 		// Well, this is easy.
 		return BString((const char*)str, strBytesLen);
 	}
 
 	BString ret;
+	if (is_latin1(encoding)) {
+		char* out = ret.LockBuffer(strBytesLen * 2);
+		if (out == NULL)
+			return BString();
+		ret.UnlockBuffer(UTF8::from_latin1((const uint8*)str, strBytesLen, out) - out);
+		return ret;
+	}
 
-	iconv_t cd = iconv_open("UTF-8", encoding);
+	iconv_t cd = sConverters.get(encoding);
 	if (cd == (iconv_t)-1)
 		return BString();
 
-	char* out = ret.LockBuffer(strBytesLen);
-	char* outStart = out;
-	size_t remainingIn = strBytesLen, remainingOut = strBytesLen;
+	// No encoding takes more than 4 bytes of UTF-8 per input byte,
+	// not even with the replacement characters for invalid input.
+	const size_t maxLength = size_t(strBytesLen) * 4;
+	char* outStart = ret.LockBuffer(maxLength);
+	if (outStart == NULL)
+		return BString();
+
+	char* in = (char*)str;
+	char* out = outStart;
+	size_t remainingIn = strBytesLen, remainingOut = maxLength;
 	while (remainingIn) {
-		status_t result = iconv(cd, (char**)&str, &remainingIn, (char**)&out, &remainingOut);
-		if (result < 0)
-			result = errno;
-
-		if (result == E2BIG) {
-			const size_t length = out - outStart;
-			ret.UnlockBuffer(length);
-			remainingOut = (length < 64) ? 128 : length * 1.5;
-			outStart = ret.LockBuffer(remainingOut);
-			out = outStart + length;
-			remainingOut -= length;
-		}
+		if (iconv(cd, &in, &remainingIn, &out, &remainingOut) != (size_t)-1)
+			break;
+		if (errno != EILSEQ)
+			break;
+
+		// Skip the invalid byte.
+		in++;
+		remainingIn--;
+		memcpy(out, "\xef\xbf\xbd", 3);
+		out += 3;
+		remainingOut -= 3;
 	}
-	iconv_close(cd);
+	iconv(cd, NULL, NULL, &out, &remainingOut);
 	ret.UnlockBuffer(out - outStart);
 	return ret;
 }
@@ -60,8 +152,16 @@ convert_to_utf8(const char* encoding, const void* str, int strBytesLen)
 static inline BString
 convert_to_utf8(const XChar2b* str, int nchars)
 {
-	static_assert(sizeof(XChar2b) == sizeof(uint16));
-	return convert_to_utf8("UCS-2", str, nchars * 2);
+	if (nchars <= 0)
+		return BString();
+
+	// Each character takes at most 3 bytes of UTF-8.
+	BString ret;
+	char* out = ret.LockBuffer(nchars * 3);
+	if (out == NULL)
+		return BString();
+	ret.UnlockBuffer(UTF8::from_ucs2(str, nchars, out) - out);
+	return ret;
 }
 
 // #pragma mark - general
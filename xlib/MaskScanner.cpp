@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "MaskScanner.h"
+
+#include <cstring>
+
+namespace BeXlib {
+
+struct Span {
+	int32_t left, right;
+
+	bool operator==(const Span& other) const
+	{
+		return left == other.left && right == other.right;
+	}
+};
+
+static const uint64_t kHighBits = 0x8080808080808080ULL;
+
+/* Returns the index of the first byte with any bits set, in memory order. */
+static inline int
+first_byte(uint64_t bits)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return __builtin_ctzll(bits) / 8;
+#else
+	return __builtin_clzll(bits) / 8;
+#endif
+}
+
+/* Returns a mask of the bytes from "index" (in memory order) to the end of a word. */
+static inline uint64_t
+bytes_from(int index)
+{
+	if (index >= 8)
+		return 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return ~0ULL << (index * 8);
+#else
+	return ~0ULL >> (index * 8);
+#endif
+}
+
+static void
+find_spans(const uint8_t* row, int32_t width, std::vector<Span>& spans)
+{
+	spans.clear();
+	bool inside = false;
+	int32_t start = 0;
+
+	int32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint64_t word;
+		memcpy(&word, row + x, sizeof(word));
+		word &= kHighBits;
+
+		// Most words do not contain the start or end of a span.
+		if (word == (inside ? kHighBits : 0))
+			continue;
+
+		uint64_t remaining = ~0ULL;
+		while (true) {
+			const uint64_t changes = (inside ? (word ^ kHighBits) : word) & remaining;
+			if (changes == 0)
+				break;
+
+			const int index = first_byte(changes);
+			if (inside)
+				spans.push_back({start, x + index - 1});
+			else
+				start = x + index;
+			inside = !inside;
+			remaining = bytes_from(index + 1);
+		}
+	}
+
+	for (; x < width; x++) {
+		const bool set = (row[x] & 0x80) != 0;
+		if (set == inside)
+			continue;
+
+		if (inside)
+			spans.push_back({start, x - 1});
+		else
+			start = x;
+		inside = set;
+	}
+	if (inside)
+		spans.push_back({start, width - 1});
+}
+
+void
+MaskScanner::scan(const uint8_t* bits, int32_t bytesPerRow,
+	int32_t width, int32_t height, std::vector<Rect>& rects)
+{
+	rects.clear();
+
+	std::vector<Span> previous, current;
+	size_t band = 0;
+		// Where the rectangles of the current band start.
+	for (int32_t y = 0; y < height; y++) {
+		const uint8_t* row = bits + y * bytesPerRow;
+		// Rows are often exactly the same as the one before, which is quick to check.
+		bool same = (y > 0 && memcmp(row, row - bytesPerRow, width) == 0);
+		if (!same) {
+			find_spans(row, width, current);
+			same = (y > 0 && current == previous);
+		}
+		if (same) {
+			// Extend the current band down to this row.
+			for (size_t i = band; i < rects.size(); i++)
+				rects[i].bottom = y;
+			continue;
+		}
+
+		band = rects.size();
+		for (const Span& span : current)
+			rects.push_back({span.left, y, span.right, y});
+		previous.swap(current);
+	}
+}
+
+} // namespace BeXlib
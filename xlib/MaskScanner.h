@@ -0,0 +1,34 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace BeXlib {
+
+/* Converts masks into the rectangles of a y-banded region: each row is split
+ * into spans of set pixels, and consecutive rows with the same spans are
+ * merged into one band.
+ *
+ * Masks have one byte per pixel, which is set if its high bit is (as depth 1
+ * pixmaps are stored as B_GRAY8, with 0xFF for set bits.) They are scanned
+ * a word at a time, so long runs of the same value are skipped quickly.
+ *
+ * MaskScannerTest compares the rectangles against the masks they came from. */
+class MaskScanner {
+public:
+	struct Rect {
+		int32_t left, top, right, bottom;
+			// Inclusive, as with clipping_rect.
+	};
+
+public:
+	static void scan(const uint8_t* bits, int32_t bytesPerRow,
+		int32_t width, int32_t height, std::vector<Rect>& rects);
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
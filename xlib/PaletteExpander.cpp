@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "PaletteExpander.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace BeXlib {
+
+void
+PaletteExpander::expand(const uint8_t* source, uint32_t* dest, int32_t count,
+	const uint32_t* palette)
+{
+	static const bool sHaveAVX2 = have_avx2();
+	if (sHaveAVX2)
+		expand_avx2(source, dest, count, palette);
+	else
+		expand_scalar(source, dest, count, palette);
+}
+
+bool
+PaletteExpander::have_avx2()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+void
+PaletteExpander::expand_scalar(const uint8_t* source, uint32_t* dest, int32_t count,
+	const uint32_t* palette)
+{
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		uint32_t indexes;
+		memcpy(&indexes, source + i, sizeof(indexes));
+		dest[i + 0] = palette[indexes & 0xFF];
+		dest[i + 1] = palette[(indexes >> 8) & 0xFF];
+		dest[i + 2] = palette[(indexes >> 16) & 0xFF];
+		dest[i + 3] = palette[indexes >> 24];
+	}
+	for (; i < count; i++)
+		dest[i] = palette[source[i]];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void
+PaletteExpander::expand_avx2(const uint8_t* source, uint32_t* dest, int32_t count,
+	const uint32_t* palette)
+{
+	int32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i indexes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + i)));
+		_mm256_storeu_si256((__m256i*)(dest + i),
+			_mm256_i32gather_epi32((const int*)palette, indexes, 4));
+	}
+	expand_scalar(source + i, dest + i, count - i, palette);
+}
+#else
+void
+PaletteExpander::expand_avx2(const uint8_t* source, uint32_t* dest, int32_t count,
+	const uint32_t* palette)
+{
+	expand_scalar(source, dest, count, palette);
+}
+#endif
+
+} // namespace BeXlib
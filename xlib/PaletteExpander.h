@@ -0,0 +1,31 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace BeXlib {
+
+/* Expands rows of 8-bit colormap indexes into 32-bit pixels, for indexed
+ * pixmaps and images shown in windows. Where AVX2 is available, 8 indexes
+ * are looked up at once with a gather.
+ *
+ * The kernels are public so that PaletteExpanderTest can compare each of
+ * them against plain lookups. */
+class PaletteExpander {
+public:
+	static void expand(const uint8_t* source, uint32_t* dest, int32_t count,
+		const uint32_t* palette);
+
+	static bool have_avx2();
+	static void expand_scalar(const uint8_t* source, uint32_t* dest, int32_t count,
+		const uint32_t* palette);
+	static void expand_avx2(const uint8_t* source, uint32_t* dest, int32_t count,
+		const uint32_t* palette);
+		// Only if have_avx2().
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
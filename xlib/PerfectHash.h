@@ -0,0 +1,157 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace BeXlib {
+
+static constexpr uint32_t
+perfect_hash_mix(uint32_t hash, uint32_t seed)
+{
+	hash ^= seed * 0x9E3779B9u;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static constexpr uint32_t
+perfect_hash_string(const char* string, bool foldCase = false)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (; *string != '\0'; string++) {
+		char c = *string;
+		if (foldCase && c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		hash = (hash ^ uint8_t(c)) * 16777619u;
+	}
+	return hash;
+}
+
+static constexpr uint32_t
+perfect_hash_integer(uint64_t value)
+{
+	return perfect_hash_mix(uint32_t(value) ^ uint32_t(value >> 32), 0);
+}
+
+/* Compile-time "hash and displace" perfect hash over a static table.
+ *
+ * Keys are distributed into buckets by their hash; each bucket then gets a
+ * displacement, chosen (largest buckets first) so that every key in it lands
+ * in a distinct, free slot. A lookup is thus always exactly one probe.
+ *
+ * The table only stores indexes into the source table, so callers must still
+ * compare the key at the returned index against what they looked up.
+ * Duplicate keys (as determined by "equal") are dropped, keeping the first. */
+template<size_t Count, size_t Slots>
+class PerfectHash {
+	static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+	static_assert(Slots >= Count && Slots <= INT16_MAX, "Bad slot count");
+
+	static constexpr size_t kBuckets = (Count + 3) / 4;
+
+	uint32_t _hashes[Count] = {};
+	uint16_t _displacements[kBuckets] = {};
+	int16_t _slots[Slots] = {};
+
+public:
+	template<typename Hash, typename Equal>
+	constexpr PerfectHash(Hash hash, Equal equal)
+	{
+		for (size_t i = 0; i < Slots; i++)
+			_slots[i] = -1;
+
+		// Chain the keys of each bucket together, in table order.
+		int16_t heads[kBuckets] = {}, tails[kBuckets] = {}, next[Count] = {};
+		size_t sizes[kBuckets] = {};
+		for (size_t i = 0; i < kBuckets; i++)
+			heads[i] = tails[i] = -1;
+		for (size_t i = 0; i < Count; i++) {
+			_hashes[i] = hash(i);
+			next[i] = -1;
+
+			const size_t bucket = _hashes[i] % kBuckets;
+			bool duplicate = false;
+			for (int16_t j = heads[bucket]; j != -1; j = next[j]) {
+				if (_hashes[j] == _hashes[i] && equal(size_t(j), i))
+					duplicate = true;
+			}
+			if (duplicate)
+				continue;
+
+			if (tails[bucket] == -1)
+				heads[bucket] = int16_t(i);
+			else
+				next[tails[bucket]] = int16_t(i);
+			tails[bucket] = int16_t(i);
+			sizes[bucket]++;
+		}
+
+		size_t largest = 0;
+		for (size_t i = 0; i < kBuckets; i++) {
+			if (sizes[i] > largest)
+				largest = sizes[i];
+		}
+
+		for (size_t size = largest; size > 0; size--) {
+			for (size_t bucket = 0; bucket < kBuckets; bucket++) {
+				if (sizes[bucket] == size)
+					_place(bucket, heads[bucket], next);
+			}
+		}
+	}
+
+	/* Returns the only index at which a key with this hash could be, or -1. */
+	constexpr int32_t
+	find(uint32_t hash) const
+	{
+		const uint16_t displacement = _displacements[hash % kBuckets];
+		const int16_t index = _slots[perfect_hash_mix(hash, displacement) & (Slots - 1)];
+		if (index < 0 || _hashes[index] != hash)
+			return -1;
+		return index;
+	}
+
+private:
+	constexpr void
+	_place(size_t bucket, int16_t head, const int16_t* next)
+	{
+		for (uint32_t displacement = 1; displacement <= UINT16_MAX; displacement++) {
+			size_t taken[Count > 32 ? 32 : Count] = {};
+			size_t placed = 0;
+			bool fits = true;
+			for (int16_t i = head; i != -1 && fits; i = next[i]) {
+				const size_t slot = perfect_hash_mix(_hashes[i], displacement) & (Slots - 1);
+				if (_slots[slot] != -1 || placed == (sizeof(taken) / sizeof(taken[0])))
+					fits = false;
+				for (size_t j = 0; j < placed && fits; j++) {
+					if (taken[j] == slot)
+						fits = false;
+				}
+				if (fits)
+					taken[placed++] = slot;
+			}
+			if (!fits)
+				continue;
+
+			placed = 0;
+			for (int16_t i = head; i != -1; i = next[i])
+				_slots[taken[placed++]] = i;
+			_displacements[bucket] = uint16_t(displacement);
+			return;
+		}
+
+		// Only reachable if two distinct keys have identical hashes.
+		throw "PerfectHash: unable to place bucket";
+	}
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
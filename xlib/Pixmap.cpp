@@ -6,21 +6,22 @@
 #include <X11/Xlib.h>
 
 #include <interface/Bitmap.h>
-#include <support/StackOrHeapArray.h>
 
+#include "Color.h"
 #include "Drawing.h"
 #include "Drawables.h"
 #include "Debug.h"
-#include "Bits.h"
 
 extern "C" XPixmapFormatValues*
 XListPixmapFormats(Display* dpy, int* count_return)
 {
 	// We theoretically support more formats than this.
 	static const XPixmapFormatValues formats[] = {
+		{.depth = 1, .bits_per_pixel = 1, .scanline_pad = 32},
+		{.depth = 8, .bits_per_pixel = 8, .scanline_pad = 32},
+		{.depth = 16, .bits_per_pixel = 16, .scanline_pad = 32},
+		{.depth = 24, .bits_per_pixel = 32, .scanline_pad = 32},
 		{.depth = 32, .bits_per_pixel = 32, .scanline_pad = 32},
-		{.depth = 24, .bits_per_pixel = 24, .scanline_pad = 32},
-		{.depth = 16, .bits_per_pixel = 16, .scanline_pad = 16},
 	};
 	static const int count = B_COUNT_OF(formats);
 
@@ -30,31 +31,61 @@ XListPixmapFormats(Display* dpy, int* count_return)
 	return ret;
 }
 
+/* Returns BadValue for pixmaps the server would refuse to create. */
+static int
+check_pixmap(unsigned int width, unsigned int height, unsigned int depth)
+{
+	if (width == 0 || height == 0)
+		return BadValue;
+	if (_x_color_space_for_depth(depth) == B_NO_COLOR_SPACE)
+		return BadValue;
+	return Success;
+}
+
 extern "C" Pixmap
 XCreatePixmap(Display* display, Drawable d,
 	unsigned int width, unsigned int height, unsigned int depth)
 {
+	if (check_pixmap(width, height, depth) != Success)
+		return None;
+
 	BRect rect(brect_from_xrect(make_xrect(0, 0, width, height)));
 	XPixmap* pixmap = new XPixmap(display, rect, depth);
 	return pixmap->id();
 }
 
+/* Expands LSB-first 1-bit rows into pixels of type T, four at a time. */
+template<typename T>
+static void
+expand_bitmap_data(const uint8* data, unsigned int width, unsigned int height,
+	uint8* dest, int32 destBytesPerRow, T fg, T bg)
+{
+	T nibbles[16][4];
+	for (int i = 0; i < 16; i++) {
+		for (int bit = 0; bit < 4; bit++)
+			nibbles[i][bit] = (i & (1 << bit)) ? fg : bg;
+	}
+
+	const int32 bpr = (width + 7) / 8;
+	const unsigned int fullBytes = width / 8, remainder = width % 8;
+	for (unsigned int y = 0; y < height; y++) {
+		const uint8* src = data + y * bpr;
+		T* row = (T*)(dest + y * destBytesPerRow);
+		for (unsigned int x = 0; x < fullBytes; x++) {
+			memcpy(row, nibbles[src[x] & 0xF], sizeof(nibbles[0]));
+			memcpy(row + 4, nibbles[src[x] >> 4], sizeof(nibbles[0]));
+			row += 8;
+		}
+		for (unsigned int bit = 0; bit < remainder; bit++)
+			row[bit] = (src[fullBytes] & (1 << bit)) ? fg : bg;
+	}
+}
+
 extern "C" Pixmap
 XCreateBitmapFromData(Display* display, Drawable d,
 	const char* data, unsigned int width, unsigned int height)
 {
-	const int32 bpr = (width + 7) / 8, bytesLength = bpr * height;
-
-	// Bitmap data is "MSB first", but we need "LSB first" for the import.
-	// Additionally, B_GRAY1 interprets a 1 as 0x00 and 0 as 0xFF, so we need to invert.
-	BStackOrHeapArray<uint8, 128> converted(bpr * height);
-	for (int i = 0; i < bytesLength; i++)
-		converted[i] = ~REVERSE_BITS(data[i]);
-
-	BRect rect(brect_from_xrect(make_xrect(0, 0, width, height)));
-	XPixmap* pixmap = new XPixmap(display, rect, 1);
-	pixmap->offscreen()->ImportBits(converted, width * height, bpr, 0, B_GRAY1);
-	return pixmap->id();
+	return XCreatePixmapFromBitmapData(display, d, (char*)data, width, height, 1, 0, 1);
 }
 
 extern "C" Pixmap
@@ -62,11 +93,46 @@ XCreatePixmapFromBitmapData(Display* display, Drawable d,
 	char* data, unsigned int width, unsigned int height,
 	unsigned long fg, unsigned long bg, unsigned int depth)
 {
-	if (fg == 1 && bg == 0 && depth == 1)
-		return XCreateBitmapFromData(display, d, data, width, height);
+	if (check_pixmap(width, height, depth) != Success)
+		return None;
+
+	BRect rect(brect_from_xrect(make_xrect(0, 0, width, height)));
+	XPixmap* pixmap = new XPixmap(display, rect, depth);
 
-	debugger("Unimplemented");
-	return 0;
+	// Write the pixels straight into the bitmap, once nothing else will.
+	pixmap->sync();
+	BBitmap* offscreen = pixmap->offscreen();
+	uint8* bits = (uint8*)offscreen->Bits();
+	const int32 bpr = offscreen->BytesPerRow();
+
+	switch (offscreen->ColorSpace()) {
+	case B_GRAY8:
+		if (depth == 1) {
+			// Bitmaps are stored with 0xFF for set bits.
+			fg = (fg & 1) ? 0xFF : 0;
+			bg = (bg & 1) ? 0xFF : 0;
+		}
+		expand_bitmap_data<uint8>((const uint8*)data, width, height, bits, bpr, fg, bg);
+		break;
+
+	case B_RGB15:
+	case B_RGB16:
+		expand_bitmap_data<uint16>((const uint8*)data, width, height, bits, bpr, fg, bg);
+		break;
+
+	case B_RGB32:
+		fg |= 0xFF000000;
+		bg |= 0xFF000000;
+		// fall through
+	case B_RGBA32:
+		expand_bitmap_data<uint32>((const uint8*)data, width, height, bits, bpr, fg, bg);
+		break;
+
+	default:
+		debugger("Unsupported pixmap color space!");
+		break;
+	}
+	return pixmap->id();
 }
 
 extern "C" int
@@ -4,11 +4,16 @@
  */
 #include "Property.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <unordered_map>
+#include <vector>
 
 #include "Atom.h"
 #include "Debug.h"
 #include "Drawables.h"
+#include "Locking.h"
+#include "PropertyStore.h"
 #include "Selection.h"
 #include "Settings.h"
 
@@ -64,6 +69,9 @@ unknown_property(const char* format, Atom atom1, Atom atom2 = None)
 	free(value2);
 }
 
+static pthread_rwlock_t sPropertiesLock = PTHREAD_RWLOCK_INITIALIZER;
+static std::unordered_map<Window, PropertyStore> sProperties;
+
 static void
 _x_property_notify(XWindow* window, Atom property, int state)
 {
@@ -79,6 +87,115 @@ _x_property_notify(XWindow* window, Atom property, int state)
 	_x_put_event(window->display(), event);
 }
 
+void
+_x_property_notify(Display* dpy, Window w, Atom property, int state)
+{
+	if (w != DefaultRootWindow(dpy)) {
+		_x_property_notify(Drawables::get_window(w), property, state);
+		return;
+	}
+
+	// Event masks cannot be selected on the root window, so always send these.
+	XEvent event = {};
+	event.type = PropertyNotify;
+	event.xproperty.window = w;
+	event.xproperty.time = _x_current_time();
+	event.xproperty.atom = property;
+	event.xproperty.state = state;
+	_x_put_event(dpy, event);
+}
+
+/* Returns (part of) a format 8 value, as XGetWindowProperty would.
+ * Returns true if the value has been read completely. */
+bool
+_x_get_property_slice(const char* data, size_t length, Atom type,
+	long long_offset, long long_length, Atom* actual_type_return, int* actual_format_return,
+	unsigned long* nitems_return, unsigned long* bytes_after_return, unsigned char** prop_return)
+{
+	const size_t offset = std::min(length, size_t(std::max(long_offset, 0L)) * 4);
+	size_t count = length - offset;
+	if (long_length >= 0)
+		count = std::min(count, size_t(long_length) * 4);
+
+	char* buffer = (char*)malloc(count + 1);
+	if (!buffer)
+		return false;
+	memcpy(buffer, data + offset, count);
+	buffer[count] = '\0';
+
+	*actual_type_return = type;
+	*actual_format_return = 8;
+	*nitems_return = count;
+	*bytes_after_return = length - offset - count;
+	*prop_return = (unsigned char*)buffer;
+	return *bytes_after_return == 0;
+}
+
+static bool
+is_property_window(Display* dpy, Window w)
+{
+	return w == DefaultRootWindow(dpy) || Drawables::get_window(w) != NULL;
+}
+
+void
+_x_remove_properties(Window w)
+{
+	PthreadWriteLocker locker(sPropertiesLock);
+	sProperties.erase(w);
+}
+
+static int
+get_stored_property(Display* dpy, Window w, Atom property,
+	long long_offset, long long_length, Bool del, Atom req_type,
+	Atom* actual_type_return, int* actual_format_return,
+	unsigned long* nitems_return, unsigned long* bytes_after_return, unsigned char** prop_return)
+{
+	PthreadWriteLocker locker(sPropertiesLock);
+	const auto store = sProperties.find(w);
+	PropertyStore::Value value;
+	if (store == sProperties.end() || !store->second.get(property, value))
+		return Success;
+
+	// Offsets and lengths are in 32-bit units of the protocol representation,
+	// in which each item takes (format / 8) bytes.
+	const unsigned long protocolItemSize = value.format / 8;
+	const unsigned long length = value.nitems * protocolItemSize;
+
+	*actual_type_return = value.type;
+	*actual_format_return = value.format;
+	if (req_type != AnyPropertyType && req_type != value.type) {
+		*bytes_after_return = length;
+		return Success;
+	}
+
+	const unsigned long offset = 4 * (unsigned long)long_offset;
+	if (long_offset < 0 || offset > length)
+		return BadValue;
+	unsigned long count = length - offset;
+	if (long_length >= 0 && count > 4 * (unsigned long)long_length)
+		count = 4 * (unsigned long)long_length;
+
+	// Only copy the requested slice, as the real Xlib does (with a terminator.)
+	const size_t itemSize = PropertyStore::item_size(value.format);
+	const unsigned long nitems = count / protocolItemSize;
+	unsigned char* data = (unsigned char*)malloc(nitems * itemSize + 1);
+	if (!data)
+		return BadAlloc;
+	memcpy(data, value.data + (offset / protocolItemSize) * itemSize, nitems * itemSize);
+	data[nitems * itemSize] = '\0';
+
+	*nitems_return = nitems;
+	*bytes_after_return = length - offset - count;
+	*prop_return = data;
+
+	if (del && *bytes_after_return == 0) {
+		store->second.remove(property);
+		locker.Unlock();
+		_x_property_notify(dpy, w, property, PropertyDelete);
+	}
+	return Success;
+}
+
 extern "C" int
 XGetWindowProperty(Display* dpy, Window w, Atom property,
 	long long_offset, long long_length, Bool del, Atom req_type,
@@ -94,13 +211,13 @@ XGetWindowProperty(Display* dpy, Window w, Atom property,
 
 	switch (property) {
 	case Atoms::_XSETTINGS_SETTINGS:
-		return _x_handle_get_settings(dpy, w, actual_type_return, actual_format_return,
-			nitems_return, prop_return);
+		return _x_handle_get_settings(dpy, w, long_offset, long_length,
+			actual_type_return, actual_format_return, nitems_return, bytes_after_return, prop_return);
 
 	case Atoms::_MOTIF_WM_HINTS: {
 		XWindow* window = Drawables::get_window(w);
 		if (!window || !window->bwindow)
-			return BadWindow;
+			break;
 		BWindow* bwindow = window->bwindow;
 
 		long* values = (long*)calloc(sizeof(long), 4);
@@ -166,12 +283,14 @@ XGetWindowProperty(Display* dpy, Window w, Atom property,
 	}
 
 	// This could be a clipboard fetch; that's handled separately.
-	if (_x_handle_get_clipboard(dpy, w, property, actual_type_return, actual_format_return,
-			nitems_return, prop_return))
+	if (_x_handle_get_clipboard(dpy, w, property, long_offset, long_length, del,
+			actual_type_return, actual_format_return, nitems_return, bytes_after_return, prop_return))
 		return Success;
 
-	unknown_property("libX11: unhandled Property (get): %s<%s>\n", property, req_type);
-	return BadImplementation;
+	if (!is_property_window(dpy, w))
+		return BadWindow;
+	return get_stored_property(dpy, w, property, long_offset, long_length, del, req_type,
+		actual_type_return, actual_format_return, nitems_return, bytes_after_return, prop_return);
 }
 
 extern "C" Status
@@ -194,32 +313,65 @@ XGetTextProperty(Display *display, Window w,
 	return False;
 }
 
+static void
+apply_net_wm_state(XWindow* window, const std::vector<Atom>& states)
+{
+	if (!window || !window->bwindow)
+		return;
+
+	for (const Atom state : states) {
+		switch (state) {
+		case Atoms::_NET_WM_STATE_MODAL:
+			window->bwindow->SetFeel(window->transient_for ?
+				B_MODAL_SUBSET_WINDOW_FEEL : B_MODAL_APP_WINDOW_FEEL);
+			window->bwindow->Activate();
+			break;
+
+		default:
+			unknown_property("libX11: unhandled _NET_WM_STATE: %s\n", state);
+			break;
+		}
+	}
+
+	// Adding a window to a subset only works if it has a SUBSET feel.
+	// So we add it (again) after changing feels.
+	if (XWindow* transient_for = Drawables::get_window(window->transient_for))
+		transient_for->bwindow->AddToSubset(window->bwindow);
+}
+
 extern "C" int
 XChangeProperty(Display* dpy, Window w, Atom property, Atom type,
 	int format, int mode, const unsigned char* data, int nelements)
 {
-	// TODO: mode?
+	if (property == Atoms::CLIPBOARD)
+		return _x_handle_set_clipboard(dpy, w, type, format, data, nelements);
 
-	switch (property) {
-	case Atoms::CLIPBOARD:
-		return _x_handle_set_clipboard(dpy, w, type, data, nelements);
+	if (!is_property_window(dpy, w))
+		return BadWindow;
+	if (format != 8 && format != 16 && format != 32)
+		return BadValue;
+	if (nelements < 0)
+		return BadValue;
 
+	// Some properties have effects beyond being stored.
+	switch (property) {
 	case Atoms::WM_PROTOCOLS:
-		return XSetWMProtocols(dpy, w, (Atom*)data, nelements);
+		XSetWMProtocols(dpy, w, (Atom*)data, nelements);
+		break;
 
 	case XA_WM_NAME:
 	case Atoms::WM_NAME:
 	case Atoms::_NET_WM_NAME: {
 		XTextProperty tp = make_text_property(type, format, data, nelements);
 		XSetWMName(dpy, w, &tp);
-		return Success;
+		break;
 	}
 	case XA_WM_ICON_NAME:
 	case Atoms::WM_ICON_NAME:
 	case Atoms::_NET_WM_ICON_NAME: {
 		XTextProperty tp = make_text_property(type, format, data, nelements);
 		XSetWMIconName(dpy, w, &tp);
-		return Success;
+		break;
 	}
 
 	case Atoms::_MOTIF_WM_HINTS: {
@@ -228,7 +380,7 @@ XChangeProperty(Display* dpy, Window w, Atom property, Atom type,
 
 		XWindow* window = Drawables::get_window(w);
 		if (!window || !window->bwindow)
-			return BadWindow;
+			break;
 		BWindow* bwindow = window->bwindow;
 
 		long* values = (long*)data;
@@ -286,14 +438,14 @@ XChangeProperty(Display* dpy, Window w, Atom property, Atom type,
 			// TODO: What is this for?
 		}
 
-		return Success;
+		break;
 	}
 	case Atoms::_NET_WM_WINDOW_TYPE: {
 		if (type != XA_ATOM || nelements != 1)
 			return BadValue;
 		XWindow* window = Drawables::get_window(w);
 		if (!window || !window->bwindow)
-			return BadWindow;
+			break;
 		BWindow* bwindow = window->bwindow;
 
 		switch (*(Atom*)data) {
@@ -320,58 +472,37 @@ XChangeProperty(Display* dpy, Window w, Atom property, Atom type,
 			break;
 		}
 
-		return Success;
+		break;
 	}
-	case Atoms::_NET_WM_STATE: {
-		if (type != XA_ATOM || nelements < 1)
+	case Atoms::_NET_WM_STATE:
+		// This is applied once stored, as appending or prepending adds to the states.
+		if (type != XA_ATOM || format != 32 || nelements < 1)
 			return BadValue;
-
-		XWindow* window = Drawables::get_window(w);
-		if (!window || !window->bwindow)
-			return BadWindow;
-
-		Atom* values = (Atom*)data;
-		for (int i = 0; i < nelements; i++) {
-			switch (values[i]) {
-			case Atoms::_NET_WM_STATE_MODAL:
-				window->bwindow->SetFeel(window->transient_for ?
-					B_MODAL_SUBSET_WINDOW_FEEL : B_MODAL_APP_WINDOW_FEEL);
-				window->bwindow->Activate();
-				break;
-
-			default:
-				unknown_property("libX11: unhandled _NET_WM_STATE: %s\n", values[i]);
-				break;
-			}
-		}
-
-		// Adding a window to a subset only works if it has a SUBSET feel.
-		// So we add it (again) after changing feels.
-		if (XWindow* transient_for = Drawables::get_window(window->transient_for))
-			transient_for->bwindow->AddToSubset(window->bwindow);
-
-		return Success;
-	}
-
-	case Atoms::_NET_WM_USER_TIME:
-	case Atoms::_NET_WM_USER_TIME_WINDOW:
-	case Atoms::_NET_WM_ICON:
-		// We don't care about these.
 		break;
 
-	default: {
-		if (type == XA_ATOM && nelements)
-			unknown_property("libX11: unhandled Property: %s = %s\n", property, *(Atom*)data);
-		else
-			unknown_property("libX11: unhandled Property: %s<%s>\n", property, type);
-
-		// Send a property-change event anyway.
-		// (Some applications set a bogus property to get the time field from the reply event.)
-		_x_property_notify(Drawables::get_window(w), property, PropertyDelete);
+	default:
 		break;
 	}
+
+	PthreadWriteLocker locker(sPropertiesLock);
+	PropertyStore& store = sProperties[w];
+	const int status = store.change(property, type, format, mode, data, nelements);
+	std::vector<Atom> states;
+	PropertyStore::Value value;
+	if (status == Success && property == Atoms::_NET_WM_STATE && store.get(property, value)) {
+		const Atom* atoms = (const Atom*)value.data;
+		states.assign(atoms, atoms + value.nitems);
 	}
-	return BadImplementation;
+	locker.Unlock();
+	if (status != Success)
+		return status;
+
+	if (property == Atoms::_NET_WM_STATE)
+		apply_net_wm_state(Drawables::get_window(w), states);
+
+	// (Some applications set a bogus property to get the time field from the reply event.)
+	_x_property_notify(dpy, w, property, PropertyNewValue);
+	return Success;
 }
 
 extern "C" void
@@ -386,16 +517,60 @@ extern "C" Atom*
 XListProperties(Display* dpy, Window w,
 	int* num_prop_return)
 {
-	UNIMPLEMENTED();
 	*num_prop_return = 0;
-	return NULL;
+
+	PthreadReadLocker locker(sPropertiesLock);
+	const auto store = sProperties.find(w);
+	if (store == sProperties.end() || store->second.count() == 0)
+		return NULL;
+
+	Atom* properties = (Atom*)malloc(sizeof(Atom) * store->second.count());
+	if (!properties)
+		return NULL;
+	store->second.list(properties);
+	*num_prop_return = store->second.count();
+	return properties;
 }
 
 extern "C" int
 XDeleteProperty(Display* display, Window w, Atom property)
 {
-	unknown_property("libX11: unhandled Property (delete): %s\n", property, None);
-	return BadImplementation;
+	if (_x_handle_delete_clipboard(display, w, property))
+		return Success;
+	if (!is_property_window(display, w))
+		return BadWindow;
+
+	PthreadWriteLocker locker(sPropertiesLock);
+	const auto store = sProperties.find(w);
+	if (store == sProperties.end() || !store->second.remove(property))
+		return Success;
+	locker.Unlock();
+
+	_x_property_notify(display, w, property, PropertyDelete);
+	return Success;
+}
+
+extern "C" int
+XRotateWindowProperties(Display* display, Window w,
+	Atom* properties, int num_prop, int npositions)
+{
+	if (!is_property_window(display, w))
+		return BadWindow;
+
+	if (num_prop == 0)
+		return Success;
+
+	PthreadWriteLocker locker(sPropertiesLock);
+	const auto store = sProperties.find(w);
+	if (store == sProperties.end() || !store->second.rotate(properties, num_prop, npositions))
+		return BadMatch;
+	locker.Unlock();
+
+	if ((npositions % num_prop) == 0)
+		return Success;
+	for (int i = 0; i < num_prop; i++)
+		_x_property_notify(display, w, properties[i], PropertyNewValue);
+	return Success;
 }
 
 void
@@ -430,7 +605,7 @@ _x_handle_send_root(Display* dpy, const XEvent& event)
 				continue;
 
 			if (action == _NET_WM_STATE_ADD) {
-				XChangeProperty(dpy, event.xclient.window, Atoms::_NET_WM_STATE, XA_ATOM, -1,
+				XChangeProperty(dpy, event.xclient.window, Atoms::_NET_WM_STATE, XA_ATOM, 32,
 					PropModeAppend, (unsigned char*)&value, 1);
 			} else {
 				// FIXME: This is not correct at all!
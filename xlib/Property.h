@@ -21,4 +21,9 @@ make_text_property(Atom type, int format, const void* data, int length = -1, boo
 	return ret;
 }
 
+void _x_property_notify(Display* dpy, Window w, Atom property, int state);
+bool _x_get_property_slice(const char* data, size_t length, Atom type,
+	long long_offset, long long_length, Atom* actual_type_return, int* actual_format_return,
+	unsigned long* nitems_return, unsigned long* bytes_after_return, unsigned char** prop_return);
+void _x_remove_properties(Window w);
 void _x_handle_send_root(Display* dpy, const XEvent& event);
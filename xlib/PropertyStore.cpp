@@ -0,0 +1,226 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "PropertyStore.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+namespace BeXlib {
+
+static const size_t kMinimumCompactSize = 4096;
+
+static inline size_t
+align_size(size_t size)
+{
+	// Keep every value aligned, so format 32 items can be read in place.
+	return (size + sizeof(long) - 1) & ~(sizeof(long) - 1);
+}
+
+size_t
+PropertyStore::item_size(int format)
+{
+	switch (format) {
+	case 8:		return 1;
+	case 16:	return sizeof(short);
+	case 32:	return sizeof(long);
+	}
+	return 0;
+}
+
+int
+PropertyStore::change(Atom property, Atom type, int format, int mode,
+	const unsigned char* data, unsigned long nitems)
+{
+	if (format != 8 && format != 16 && format != 32)
+		return BadValue;
+	if (mode != PropModeReplace && mode != PropModePrepend && mode != PropModeAppend)
+		return BadValue;
+
+	const size_t size = nitems * item_size(format);
+	Entry* entry = _find(property);
+	if (entry == NULL) {
+		_entries.push_back({property, type, uint32_t(format), uint32_t(_arena.size()), 0, 0});
+		entry = &_entries.back();
+		mode = PropModeReplace;
+	} else if (mode != PropModeReplace
+			&& (entry->type != type || entry->format != uint32_t(format))) {
+		return BadMatch;
+	}
+
+	if (mode == PropModeReplace) {
+		entry->type = type;
+		entry->format = format;
+		entry->size = 0;
+
+		// Give back most of the space if the value shrank a lot.
+		if (entry->capacity > kMinimumCompactSize && size < entry->capacity / 4) {
+			_garbage += entry->capacity - align_size(size);
+			entry->capacity = align_size(size);
+		}
+		if (!_reserve(*entry, size))
+			return BadAlloc;
+		if (size)
+			memcpy(_arena.data() + entry->offset, data, size);
+		entry->size = size;
+	} else {
+		const size_t oldSize = entry->size;
+		if (!_reserve(*entry, oldSize + size))
+			return BadAlloc;
+
+		unsigned char* value = _arena.data() + entry->offset;
+		if (mode == PropModeAppend) {
+			memcpy(value + oldSize, data, size);
+		} else {
+			memmove(value + size, value, oldSize);
+			memcpy(value, data, size);
+		}
+		entry->size = oldSize + size;
+	}
+
+	_compact();
+	return Success;
+}
+
+bool
+PropertyStore::get(Atom property, Value& value) const
+{
+	const Entry* entry = _find(property);
+	if (entry == NULL)
+		return false;
+
+	value.type = entry->type;
+	value.format = entry->format;
+	value.nitems = entry->size / item_size(entry->format);
+	value.data = _arena.data() + entry->offset;
+	return true;
+}
+
+bool
+PropertyStore::remove(Atom property)
+{
+	Entry* entry = _find(property);
+	if (entry == NULL)
+		return false;
+
+	_garbage += entry->capacity;
+	_entries.erase(_entries.begin() + (entry - _entries.data()));
+	_compact();
+	return true;
+}
+
+void
+PropertyStore::list(Atom* properties) const
+{
+	for (const Entry& entry : _entries)
+		*properties++ = entry.name;
+}
+
+bool
+PropertyStore::rotate(const Atom* properties, int count, int positions)
+{
+	std::vector<Entry*> entries(count);
+	for (int i = 0; i < count; i++) {
+		entries[i] = _find(properties[i]);
+		if (entries[i] == NULL)
+			return false;
+		for (int j = 0; j < i; j++) {
+			if (entries[j] == entries[i])
+				return false;
+		}
+	}
+	if (count == 0)
+		return true;
+
+	// Only the values move, and those are just references into the arena.
+	std::vector<Entry> values(count);
+	for (int i = 0; i < count; i++)
+		values[i] = *entries[i];
+
+	positions %= count;
+	if (positions < 0)
+		positions += count;
+	for (int i = 0; i < count; i++) {
+		Entry* entry = entries[(i + positions) % count];
+		const Atom name = entry->name;
+		*entry = values[i];
+		entry->name = name;
+	}
+	return true;
+}
+
+PropertyStore::Entry*
+PropertyStore::_find(Atom property)
+{
+	for (Entry& entry : _entries) {
+		if (entry.name == property)
+			return &entry;
+	}
+	return NULL;
+}
+
+const PropertyStore::Entry*
+PropertyStore::_find(Atom property) const
+{
+	return const_cast<PropertyStore*>(this)->_find(property);
+}
+
+bool
+PropertyStore::_reserve(Entry& entry, size_t size)
+{
+	if (size <= entry.capacity)
+		return true;
+
+	// Leave room to grow, in case this value is being built up by appending.
+	size_t capacity = align_size(std::max(size, size_t(entry.size) * 2));
+	if (entry.offset + entry.capacity == _arena.size()) {
+		// This is the last value in the arena, so it can just be extended.
+		if (entry.offset + capacity > UINT32_MAX)
+			return false;
+		_arena.resize(entry.offset + capacity);
+		entry.capacity = capacity;
+		return true;
+	}
+
+	const size_t offset = _arena.size();
+	if (offset + capacity > UINT32_MAX)
+		return false;
+	_arena.resize(offset + capacity);
+	memcpy(_arena.data() + offset, _arena.data() + entry.offset, entry.size);
+
+	_garbage += entry.capacity;
+	entry.offset = offset;
+	entry.capacity = capacity;
+	return true;
+}
+
+void
+PropertyStore::_compact()
+{
+	if (_garbage < kMinimumCompactSize || _garbage < _arena.size() / 2)
+		return;
+
+	std::vector<unsigned char> arena;
+	size_t size = 0;
+	for (const Entry& entry : _entries)
+		size += align_size(entry.size);
+	arena.resize(size);
+
+	size_t offset = 0;
+	for (Entry& entry : _entries) {
+		memcpy(arena.data() + offset, _arena.data() + entry.offset, entry.size);
+		entry.offset = offset;
+		entry.capacity = align_size(entry.size);
+		offset += entry.capacity;
+	}
+
+	_arena.swap(arena);
+	_garbage = 0;
+}
+
+} // namespace BeXlib
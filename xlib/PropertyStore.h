@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+namespace BeXlib {
+
+/* The properties of a single window.
+ *
+ * Values are kept in the client representation (format 32 items are longs)
+ * and stored back to back in one arena, with some slack after each so that
+ * appending does not usually need to move anything.
+ * (test/unit/PropertyStoreTest.cpp exercises it outside of Haiku.) */
+class PropertyStore {
+public:
+	struct Value {
+		Atom type;
+		int format;
+		unsigned long nitems;
+		const unsigned char* data;
+			// Only valid until the store is next modified.
+	};
+
+public:
+	static size_t item_size(int format);
+
+	/* Returns Success, BadValue, BadMatch or BadAlloc. */
+	int change(Atom property, Atom type, int format, int mode,
+		const unsigned char* data, unsigned long nitems);
+	bool get(Atom property, Value& value) const;
+	bool remove(Atom property);
+
+	size_t count() const { return _entries.size(); }
+	void list(Atom* properties) const;
+	bool rotate(const Atom* properties, int count, int positions);
+
+private:
+	struct Entry {
+		Atom name;
+		Atom type;
+		uint32_t format;
+		uint32_t offset;
+		uint32_t size;
+		uint32_t capacity;
+	};
+
+	Entry* _find(Atom property);
+	const Entry* _find(Atom property) const;
+	bool _reserve(Entry& entry, size_t size);
+	void _compact();
+
+private:
+	std::vector<Entry> _entries;
+	std::vector<unsigned char> _arena;
+	size_t _garbage = 0;
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
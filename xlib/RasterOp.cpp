@@ -0,0 +1,126 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "RasterOp.h"
+
+#include <cstring>
+#include <type_traits>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+namespace BeXlib {
+
+/* Works on single pixels as well as on vectors of them. */
+template<int kFunction, typename T>
+static inline T
+combine(T src, T dst)
+{
+	switch (kFunction) {
+	case GXclear:			return src ^ src;
+	case GXand:				return src & dst;
+	case GXandReverse:		return src & ~dst;
+	case GXcopy:			return src;
+	case GXandInverted:		return ~src & dst;
+	case GXnoop:			return dst;
+	case GXxor:				return src ^ dst;
+	case GXor:				return src | dst;
+	case GXnor:				return ~(src | dst);
+	case GXequiv:			return ~src ^ dst;
+	case GXinvert:			return ~dst;
+	case GXorReverse:		return src | ~dst;
+	case GXcopyInverted:	return ~src;
+	case GXorInverted:		return ~src | dst;
+	case GXnand:			return ~(src & dst);
+	case GXset:				return ~(src ^ src);
+	}
+	return dst;
+}
+
+template<int kFunction, typename T>
+static void
+apply_row(const void* source, uint32_t pixel, const uint8_t* mask, uint32_t planes,
+	void* dest, int32_t width)
+{
+	typedef T Vector __attribute__((vector_size(16)));
+	typedef typename std::make_signed<T>::type S;
+	typedef S SignedVector __attribute__((vector_size(16)));
+	const int32_t kLanes = sizeof(Vector) / sizeof(T);
+	typedef int8_t MaskVector __attribute__((vector_size(kLanes)));
+
+	const T* src = (const T*)source;
+	T* dst = (T*)dest;
+	const Vector solid = Vector{} + T(pixel);
+	const Vector planeMask = Vector{} + T(planes);
+
+	int32_t x = 0;
+	for (; x + kLanes <= width; x += kLanes) {
+		Vector s = solid, d, m = planeMask;
+		if (src != NULL)
+			memcpy(&s, src + x, sizeof(Vector));
+		memcpy(&d, dst + x, sizeof(Vector));
+		if (mask != NULL) {
+			// Sign-extend the mask bytes, so their high bits fill the lanes.
+			MaskVector coverage;
+			memcpy(&coverage, mask + x, sizeof(MaskVector));
+			m &= (Vector)(__builtin_convertvector(coverage, SignedVector) >> 7);
+		}
+
+		d = (combine<kFunction>(s, d) & m) | (d & ~m);
+		memcpy(dst + x, &d, sizeof(Vector));
+	}
+
+	for (; x < width; x++) {
+		if (mask != NULL && !(mask[x] & 0x80))
+			continue;
+
+		const T s = (src != NULL) ? src[x] : T(pixel), d = dst[x];
+		dst[x] = T((combine<kFunction>(s, d) & T(planes)) | (d & ~T(planes)));
+	}
+}
+
+typedef void (*apply_func)(const void* source, uint32_t pixel, const uint8_t* mask,
+	uint32_t planes, void* dest, int32_t width);
+
+#define KERNELS(function) \
+	{ apply_row<function, uint8_t>, apply_row<function, uint16_t>, apply_row<function, uint32_t> }
+
+// Indexed by function, then by pixel size.
+static const apply_func kKernels[16][3] = {
+	KERNELS(GXclear),
+	KERNELS(GXand),
+	KERNELS(GXandReverse),
+	KERNELS(GXcopy),
+	KERNELS(GXandInverted),
+	KERNELS(GXnoop),
+	KERNELS(GXxor),
+	KERNELS(GXor),
+	KERNELS(GXnor),
+	KERNELS(GXequiv),
+	KERNELS(GXinvert),
+	KERNELS(GXorReverse),
+	KERNELS(GXcopyInverted),
+	KERNELS(GXorInverted),
+	KERNELS(GXnand),
+	KERNELS(GXset),
+};
+
+#undef KERNELS
+
+void
+RasterOp::apply(int function, int bytesPerPixel, const void* source, uint32_t pixel,
+	const uint8_t* mask, uint32_t planes, void* dest, int32_t width)
+{
+	if (function < GXclear || function > GXset || width <= 0)
+		return;
+
+	switch (bytesPerPixel) {
+	case 1: kKernels[function][0](source, pixel, mask, planes, dest, width); break;
+	case 2: kKernels[function][1](source, pixel, mask, planes, dest, width); break;
+	case 4: kKernels[function][2](source, pixel, mask, planes, dest, width); break;
+	}
+}
+
+} // namespace BeXlib
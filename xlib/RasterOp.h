@@ -0,0 +1,27 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace BeXlib {
+
+/* The 16 GX raster operations, with plane masks, in software.
+ *
+ * Each row is combined 16 bytes at a time, with a kernel for every function
+ * and pixel size. RasterOpTest checks every kernel bit for bit against the
+ * definitions in the protocol. */
+class RasterOp {
+public:
+	/* dest = (function(source, dest) & planes) | (dest & ~planes), for a row of
+	 * pixels of 1, 2 or 4 bytes. If "source" is NULL, "pixel" is used for every
+	 * pixel instead; if "mask" is not NULL, only pixels whose mask byte has its
+	 * high bit set are changed. */
+	static void apply(int function, int bytesPerPixel, const void* source, uint32_t pixel,
+		const uint8_t* mask, uint32_t planes, void* dest, int32_t width);
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
@@ -0,0 +1,741 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+namespace BeXlib {
+
+// Outlines are filled in fixed point, with this many steps per pixel.
+static const int64_t kFixedOne = 256;
+// Coordinates beyond this are clamped, so that the fixed point math cannot overflow.
+static const double kMaximumCoordinate = 1 << 20;
+
+// Wide lines meeting at less than this get bevel joins rather than miter joins.
+static const double kMinimumMiterAngle = 11 * M_PI / 180;
+
+static inline int64_t
+ceil_div(int64_t numerator, int64_t denominator)
+{
+	// The denominator is always positive.
+	return numerator / denominator + ((numerator % denominator) > 0 ? 1 : 0);
+}
+
+static inline int64_t
+to_fixed(double value)
+{
+	value = std::min(std::max(value, -kMaximumCoordinate), kMaximumCoordinate);
+	return llround(value * kFixedOne);
+}
+
+static inline int32_t
+ceil_int(double value)
+{
+	value = std::min(std::max(value, -kMaximumCoordinate), kMaximumCoordinate);
+	return int32_t(ceil(value));
+}
+
+static inline int32_t
+floor_int(double value)
+{
+	value = std::min(std::max(value, -kMaximumCoordinate), kMaximumCoordinate);
+	return int32_t(floor(value));
+}
+
+/* Returns the unit vector at an angle in 64ths of a degree, exactly along the axes. */
+static void
+direction(int32_t angle, double& x, double& y)
+{
+	angle %= 360 * 64;
+	if (angle < 0)
+		angle += 360 * 64;
+	switch (angle) {
+	case 0:				x = 1; y = 0; return;
+	case 90 * 64:		x = 0; y = 1; return;
+	case 180 * 64:		x = -1; y = 0; return;
+	case 270 * 64:		x = 0; y = -1; return;
+	}
+	const double radians = angle / 64.0 * M_PI / 180;
+	x = cos(radians);
+	y = sin(radians);
+}
+
+/* Finds the columns of a row of an ellipse, "dy" being the row's distance from the
+ * center divided by the vertical radius. Rows only touching the top of the outline
+ * cover the point there, if it is a pixel's center: the ellipse is below it. */
+static bool
+ellipse_columns(double center, double radius, double dy, int32_t& left, int32_t& right)
+{
+	const double squared = 1 - dy * dy;
+	if (squared <= 0) {
+		if (dy > 0 || center != floor(center))
+			return false;
+		left = int32_t(center);
+		right = left + 1;
+		return true;
+	}
+
+	const double half = radius * sqrt(squared);
+	left = ceil_int(center - half);
+	right = ceil_int(center + half);
+	return left < right;
+}
+
+/* Limits the columns from "left" up to "right" to those where
+ * factor * (column - center) <= limit, or < if "strict". */
+static void
+limit_columns(double factor, double limit, double center, bool strict,
+	int32_t& left, int32_t& right)
+{
+	if (factor == 0) {
+		if (strict ? !(limit > 0) : !(limit >= 0))
+			right = left;
+		return;
+	}
+
+	const double threshold = center + limit / factor;
+	if (factor > 0)
+		right = std::min(right, strict ? ceil_int(threshold) : (floor_int(threshold) + 1));
+	else
+		left = std::max(left, strict ? (floor_int(threshold) + 1) : ceil_int(threshold));
+}
+
+Rasterizer::Rasterizer(uint8_t* bits, int32_t bytesPerRow, int32_t width, int32_t height)
+	: _bits(bits)
+	, _bytes_per_row(bytesPerRow)
+	, _width(width)
+	, _height(height)
+	, _origin_x(0)
+	, _origin_y(0)
+	, _drawn({0, 0, -1, -1})
+	, _dash_total(0)
+	, _dash_offset(0)
+	, _dash_index(0)
+	, _dash_remaining(0)
+{
+}
+
+void
+Rasterizer::set_origin(int32_t x, int32_t y)
+{
+	_origin_x = x;
+	_origin_y = y;
+}
+
+void
+Rasterizer::set_dashes(const unsigned char* dashes, int count, int offset)
+{
+	// Lists of odd length are used twice, so that dashes alternate.
+	_dashes.clear();
+	_dash_total = 0;
+	const int length = (count % 2) ? (count * 2) : count;
+	for (int i = 0; i < length; i++) {
+		_dashes.push_back(dashes[i % count]);
+		_dash_total += _dashes.back();
+	}
+	if (_dash_total <= 0)
+		_dashes.clear();
+	_dash_offset = offset;
+	restart_dashes();
+}
+
+void
+Rasterizer::restart_dashes()
+{
+	if (_dashes.empty())
+		return;
+
+	_dash_index = 0;
+	_dash_remaining = _dashes[0];
+	int32_t offset = _dash_offset % _dash_total;
+	if (offset < 0)
+		offset += _dash_total;
+	while (offset >= _dash_remaining) {
+		offset -= _dash_remaining;
+		_dash_index = (_dash_index + 1) % _dashes.size();
+		_dash_remaining = _dashes[_dash_index];
+	}
+	_dash_remaining -= offset;
+}
+
+/* Covers the pixels from "left" up to (but not including) "right". */
+void
+Rasterizer::_span(int32_t y, int32_t left, int32_t right)
+{
+	if (y < _origin_y || y >= (_origin_y + _height))
+		return;
+	left = std::max(left, _origin_x);
+	right = std::min(right, _origin_x + _width);
+	if (left >= right)
+		return;
+
+	memset(_bits + (y - _origin_y) * _bytes_per_row + (left - _origin_x), 0xFF, right - left);
+	if (_drawn.left > _drawn.right) {
+		_drawn = {left, y, right - 1, y};
+		return;
+	}
+	_drawn.left = std::min(_drawn.left, left);
+	_drawn.right = std::max(_drawn.right, right - 1);
+	_drawn.top = std::min(_drawn.top, y);
+	_drawn.bottom = std::max(_drawn.bottom, y);
+}
+
+/* Covers a pixel of a zero-width line, if it is in an on dash. */
+void
+Rasterizer::_dot(int32_t x, int32_t y)
+{
+	if (_dashes.empty()) {
+		_span(y, x, x + 1);
+		return;
+	}
+
+	if ((_dash_index % 2) == 0)
+		_span(y, x, x + 1);
+	if (--_dash_remaining <= 0) {
+		_dash_index = (_dash_index + 1) % _dashes.size();
+		_dash_remaining = _dashes[_dash_index];
+	}
+}
+
+void
+Rasterizer::point(int32_t x, int32_t y)
+{
+	_span(y, x, x + 1);
+}
+
+void
+Rasterizer::fill_rect(int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	const int32_t top = std::max(y, _origin_y), bottom = std::min(y + height, _origin_y + _height);
+	for (int32_t row = top; row < bottom; row++)
+		_span(row, x, x + width);
+}
+
+// #pragma mark - zero-width lines
+
+void
+Rasterizer::line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, bool last)
+{
+	const int32_t dx = x2 - x1, dy = y2 - y1;
+	if (_dashes.empty() && dy == 0 && dx != 0) {
+		// Horizontal lines are spans; which end is left out depends on the direction.
+		if (dx > 0)
+			_span(y1, x1, x2 + (last ? 1 : 0));
+		else
+			_span(y1, x2 + (last ? 0 : 1), x1 + 1);
+		return;
+	}
+
+	const int32_t stepX = (dx < 0) ? -1 : 1, stepY = (dy < 0) ? -1 : 1;
+	const bool xMajor = std::abs(dx) >= std::abs(dy);
+	const int64_t major = xMajor ? std::abs(dx) : std::abs(dy),
+		minor = xMajor ? std::abs(dy) : std::abs(dx);
+	const int32_t minorStep = xMajor ? stepY : stepX;
+
+	// Ties go towards the smaller coordinate, whichever way the line goes.
+	int64_t error = 2 * minor - major - (minorStep > 0 ? 1 : 0);
+	int32_t x = x1, y = y1;
+	const int64_t count = major + (last ? 1 : 0);
+	for (int64_t i = 0; i < count; i++) {
+		_dot(x, y);
+		if (error >= 0) {
+			if (xMajor)
+				y += stepY;
+			else
+				x += stepX;
+			error -= 2 * major;
+		}
+		error += 2 * minor;
+		if (xMajor)
+			x += stepX;
+		else
+			y += stepY;
+	}
+}
+
+void
+Rasterizer::lines(const Point* points, int32_t count, bool last)
+{
+	for (int32_t i = 0; i < (count - 1); i++)
+		line(points[i].x, points[i].y, points[i + 1].x, points[i + 1].y, false);
+	if (last && count > 0)
+		_dot(points[count - 1].x, points[count - 1].y);
+}
+
+// #pragma mark - wide lines
+
+void
+Rasterizer::wide_line(double x1, double y1, double x2, double y2, double width, int capStyle)
+{
+	const double halfWidth = width / 2;
+	if (x1 == x2 && y1 == y2) {
+		// Points have no direction: projecting caps are squares aligned to the axes.
+		if (capStyle == CapProjecting) {
+			const double square[] = {
+				x1 - halfWidth, y1 - halfWidth, x1 + halfWidth, y1 - halfWidth,
+				x1 + halfWidth, y1 + halfWidth, x1 - halfWidth, y1 + halfWidth,
+			};
+			_fill_polygon(square, 4);
+		} else if (capStyle == CapRound) {
+			_fill_circle(x1, y1, width);
+		}
+		return;
+	}
+
+	const bool projecting = (capStyle == CapProjecting);
+	_segment(x1, y1, x2, y2, halfWidth, projecting, projecting);
+	if (capStyle == CapRound) {
+		_fill_circle(x1, y1, width);
+		_fill_circle(x2, y2, width);
+	}
+}
+
+void
+Rasterizer::wide_lines(const Point* points, int32_t count, double width,
+	int capStyle, int joinStyle)
+{
+	// Repeated points would make segments without a direction.
+	std::vector<Point> path;
+	path.reserve(count);
+	for (int32_t i = 0; i < count; i++) {
+		if (path.empty() || path.back().x != points[i].x || path.back().y != points[i].y)
+			path.push_back(points[i]);
+	}
+	if (path.empty())
+		return;
+	if (path.size() == 1) {
+		wide_line(path[0].x, path[0].y, path[0].x, path[0].y, width, capStyle);
+		return;
+	}
+
+	const bool closed = path.size() > 2 && path.front().x == path.back().x
+		&& path.front().y == path.back().y;
+	const bool projecting = !closed && capStyle == CapProjecting;
+	const double halfWidth = width / 2;
+	const size_t segments = path.size() - 1;
+	for (size_t i = 0; i < segments; i++) {
+		_segment(path[i].x, path[i].y, path[i + 1].x, path[i + 1].y, halfWidth,
+			projecting && i == 0, projecting && i == (segments - 1));
+	}
+
+	for (size_t i = closed ? 0 : 1; i < segments; i++) {
+		const Point& previous = path[(i == 0) ? (segments - 1) : (i - 1)];
+		const Point& vertex = path[i];
+		const Point& next = path[i + 1];
+		_join(vertex.x, vertex.y, vertex.x - previous.x, vertex.y - previous.y,
+			next.x - vertex.x, next.y - vertex.y, halfWidth, joinStyle);
+	}
+
+	if (!closed && capStyle == CapRound) {
+		_fill_circle(path.front().x, path.front().y, width);
+		_fill_circle(path.back().x, path.back().y, width);
+	}
+}
+
+/* Fills the body of a wide line, extending it by half its width at either end
+ * for projecting caps. */
+void
+Rasterizer::_segment(double x1, double y1, double x2, double y2, double halfWidth,
+	bool projectStart, bool projectEnd)
+{
+	const double length = hypot(x2 - x1, y2 - y1);
+	const double dx = (x2 - x1) / length * halfWidth, dy = (y2 - y1) / length * halfWidth;
+	if (projectStart) {
+		x1 -= dx;
+		y1 -= dy;
+	}
+	if (projectEnd) {
+		x2 += dx;
+		y2 += dy;
+	}
+
+	// The normal, pointing to one side of the line.
+	const double nx = -dy, ny = dx;
+	const double quad[] = {
+		x1 + nx, y1 + ny, x2 + nx, y2 + ny,
+		x2 - nx, y2 - ny, x1 - nx, y1 - ny,
+	};
+	_fill_polygon(quad, 4);
+}
+
+/* Fills the join of two segments of a wide line, on the outside of the turn
+ * (the inside is already covered by the segments themselves.) */
+void
+Rasterizer::_join(double x, double y, double dx1, double dy1, double dx2, double dy2,
+	double halfWidth, int joinStyle)
+{
+	if (joinStyle == JoinRound) {
+		_fill_circle(x, y, halfWidth * 2);
+		return;
+	}
+
+	const double length1 = hypot(dx1, dy1), length2 = hypot(dx2, dy2);
+	dx1 /= length1;
+	dy1 /= length1;
+	dx2 /= length2;
+	dy2 /= length2;
+	const double cross = dx1 * dy2 - dy1 * dx2, dot = dx1 * dx2 + dy1 * dy2;
+	if (cross == 0)
+		return;
+
+	// The corners of the two segments on the outside of the turn.
+	const double side = (cross > 0) ? -halfWidth : halfWidth;
+	const double ax = x - dy1 * side, ay = y + dx1 * side,
+		bx = x - dy2 * side, by = y + dx2 * side;
+
+	// The angle between the segments is pi minus the angle the path turns by.
+	const double angle = M_PI - acos(std::min(std::max(dot, -1.0), 1.0));
+	if (joinStyle == JoinMiter && angle >= kMinimumMiterAngle) {
+		// The miter's tip is along the bisector of the two normals.
+		const double scale = side / (1 + dot);
+		const double mx = x - (dy1 + dy2) * scale, my = y + (dx1 + dx2) * scale;
+		const double miter[] = {x, y, ax, ay, mx, my, bx, by};
+		_fill_polygon(miter, 4);
+		return;
+	}
+
+	const double bevel[] = {x, y, ax, ay, bx, by};
+	_fill_polygon(bevel, 3);
+}
+
+void
+Rasterizer::_fill_circle(double x, double y, double diameter)
+{
+	const double radius = diameter / 2;
+	const int32_t top = std::max(ceil_int(y - radius), _origin_y),
+		bottom = std::min(ceil_int(y + radius), _origin_y + _height);
+	for (int32_t row = top; row < bottom; row++) {
+		int32_t left, right;
+		if (ellipse_columns(x, radius, (row - y) / radius, left, right))
+			_span(row, left, right);
+	}
+}
+
+// #pragma mark - polygons
+
+void
+Rasterizer::fill_polygon(const Point* points, int32_t count, bool winding)
+{
+	std::vector<int64_t> coordinates(count * 2);
+	for (int32_t i = 0; i < count; i++) {
+		coordinates[i * 2] = to_fixed(points[i].x);
+		coordinates[i * 2 + 1] = to_fixed(points[i].y);
+	}
+	_fill_fixed(coordinates.data(), count, winding);
+}
+
+/* Fills an outline given as pairs of coordinates. */
+void
+Rasterizer::_fill_polygon(const double* coordinates, int32_t count, bool winding)
+{
+	_fixed.resize(count * 2);
+	for (int32_t i = 0; i < count * 2; i++)
+		_fixed[i] = to_fixed(coordinates[i]);
+	_fill_fixed(_fixed.data(), count, winding);
+}
+
+/* Covers the pixels whose centers are inside the outline. Each row of centers
+ * crosses the edges which start at or above it and end below it; and spans begin
+ * at the first center at or right of a crossing, and end before the next. */
+void
+Rasterizer::_fill_fixed(const int64_t* coordinates, int32_t count, bool winding)
+{
+	_edges.clear();
+	int64_t minY = INT64_MAX, maxY = INT64_MIN;
+	for (int32_t i = 0; i < count; i++) {
+		const int32_t next = (i + 1) % count;
+		const int64_t x1 = coordinates[i * 2], y1 = coordinates[i * 2 + 1],
+			x2 = coordinates[next * 2], y2 = coordinates[next * 2 + 1];
+		if (y1 == y2)
+			continue;
+
+		if (y1 < y2)
+			_edges.push_back({x1, y1, x2, y2, 1});
+		else
+			_edges.push_back({x2, y2, x1, y1, -1});
+		minY = std::min(minY, std::min(y1, y2));
+		maxY = std::max(maxY, std::max(y1, y2));
+	}
+	if (_edges.empty())
+		return;
+
+	std::sort(_edges.begin(), _edges.end(),
+		[](const Edge& a, const Edge& b) { return a.y1 < b.y1; });
+
+	const int32_t top = std::max(int32_t(ceil_div(minY, kFixedOne)), _origin_y),
+		bottom = std::min(int32_t(ceil_div(maxY, kFixedOne)), _origin_y + _height);
+	_active.clear();
+	size_t nextEdge = 0;
+	for (int32_t y = top; y < bottom; y++) {
+		const int64_t centerY = y * kFixedOne;
+		while (nextEdge < _edges.size() && _edges[nextEdge].y1 <= centerY)
+			_active.push_back(nextEdge++);
+
+		_crossings.clear();
+		for (size_t i = 0; i < _active.size(); ) {
+			const Edge& edge = _edges[_active[i]];
+			if (edge.y2 <= centerY) {
+				_active[i] = _active.back();
+				_active.pop_back();
+				continue;
+			}
+
+			const int64_t height = edge.y2 - edge.y1;
+			const int64_t x = ceil_div(edge.x1 * height + (centerY - edge.y1) * (edge.x2 - edge.x1),
+				height * kFixedOne);
+			_crossings.push_back({int32_t(x), edge.direction});
+			i++;
+		}
+		std::sort(_crossings.begin(), _crossings.end(),
+			[](const Crossing& a, const Crossing& b) { return a.x < b.x; });
+
+		int inside = 0;
+		for (size_t i = 0; i + 1 < _crossings.size(); i++) {
+			inside += winding ? _crossings[i].direction : 1;
+			if (winding ? (inside != 0) : (inside % 2) != 0)
+				_span(y, _crossings[i].x, _crossings[i + 1].x);
+		}
+	}
+}
+
+// #pragma mark - arcs
+
+/* The ellipse an arc is part of, and the directions it starts and ends in on the
+ * circle the ellipse is scaled from (in which y goes up.) Arcs go counterclockwise
+ * from their start to their end. */
+struct Rasterizer::Arc {
+	double centerX, centerY, radiusX, radiusY;
+	double start, extent;
+		// In radians; the extent is negative for arcs going clockwise.
+	bool full, reflex;
+	double startX, startY, endX, endY;
+
+	Arc(int32_t x, int32_t y, int32_t width, int32_t height, int32_t angle1, int32_t angle2)
+	{
+		radiusX = width / 2.0;
+		radiusY = height / 2.0;
+		centerX = x + radiusX;
+		centerY = y + radiusY;
+
+		angle2 = std::min(std::max(angle2, -360 * 64), 360 * 64);
+		start = angle1 / 64.0 * M_PI / 180;
+		extent = angle2 / 64.0 * M_PI / 180;
+		full = std::abs(angle2) >= 360 * 64;
+		reflex = std::abs(angle2) > 180 * 64;
+
+		const int32_t first = (angle2 < 0) ? (angle1 + angle2) : angle1;
+		direction(first, startX, startY);
+		direction(first + std::abs(angle2), endX, endY);
+	}
+
+	/* The row's distance from the center, in the circle's coordinates. */
+	double row_offset(int32_t row) const { return (centerY - row) / radiusY; }
+
+	double x_at(double angle) const { return centerX + radiusX * cos(angle); }
+	double y_at(double angle) const { return centerY - radiusY * sin(angle); }
+};
+
+/* Covers the columns of a row of the arc's ellipse which are inside its pie slice:
+ * right of its start and left of its end (crossing products, with the columns
+ * scaled back to the circle by the horizontal radius.) */
+void
+Rasterizer::_slice_span(const Arc& arc, int32_t row, int32_t left, int32_t right)
+{
+	if (arc.full) {
+		_span(row, left, right);
+		return;
+	}
+
+	const double v = arc.row_offset(row), scale = v * arc.radiusX;
+	if (!arc.reflex) {
+		limit_columns(arc.startY, arc.startX * scale, arc.centerX, false, left, right);
+		limit_columns(-arc.endY, -arc.endX * scale, arc.centerX, false, left, right);
+		_span(row, left, right);
+		return;
+	}
+
+	// Slices of more than half the ellipse are everything but the rest of it.
+	int32_t restLeft = left, restRight = right;
+	limit_columns(arc.endY, arc.endX * scale, arc.centerX, true, restLeft, restRight);
+	limit_columns(-arc.startY, -arc.startX * scale, arc.centerX, true, restLeft, restRight);
+	if (restLeft >= restRight) {
+		_span(row, left, right);
+		return;
+	}
+	_span(row, left, restLeft);
+	_span(row, restRight, right);
+}
+
+void
+Rasterizer::arc(int32_t x, int32_t y, int32_t width, int32_t height,
+	int32_t angle1, int32_t angle2)
+{
+	if (width < 0 || height < 0 || angle2 == 0)
+		return;
+
+	const Arc shape(x, y, width, height, angle1, angle2);
+	if (!_dashes.empty() || width < 2 || height < 2) {
+		// Dashes go along the arc, and tiny ellipses have no inside to outline.
+		_flattened_arc(shape);
+		return;
+	}
+
+	// The outline is what is inside the ellipse, but not inside it in all four
+	// directions; so each row has at most two spans of it.
+	const int32_t top = std::max(ceil_int(shape.centerY - shape.radiusY), _origin_y),
+		bottom = std::min(ceil_int(shape.centerY + shape.radiusY), _origin_y + _height);
+	int32_t left, right, aboveLeft = 0, aboveRight = 0, belowLeft, belowRight;
+	if (!ellipse_columns(shape.centerX, shape.radiusX, -shape.row_offset(top - 1),
+			aboveLeft, aboveRight))
+		aboveLeft = aboveRight = 0;
+	if (!ellipse_columns(shape.centerX, shape.radiusX, -shape.row_offset(top),
+			left, right))
+		left = right = 0;
+	for (int32_t row = top; row < bottom; row++) {
+		if (!ellipse_columns(shape.centerX, shape.radiusX, -shape.row_offset(row + 1),
+				belowLeft, belowRight))
+			belowLeft = belowRight = 0;
+
+		if (left < right) {
+			const int32_t innerLeft = std::max(std::max(left + 1, aboveLeft), belowLeft),
+				innerRight = std::min(std::min(right - 1, aboveRight), belowRight);
+			if (innerLeft >= innerRight) {
+				_slice_span(shape, row, left, right);
+			} else {
+				_slice_span(shape, row, left, innerLeft);
+				_slice_span(shape, row, innerRight, right);
+			}
+		}
+
+		aboveLeft = left;
+		aboveRight = right;
+		left = belowLeft;
+		right = belowRight;
+	}
+}
+
+/* Draws a zero-width arc as lines between points about a pixel apart. */
+void
+Rasterizer::_flattened_arc(const Arc& arc)
+{
+	const int32_t count = std::max(
+		int32_t(ceil(fabs(arc.extent) * std::max(arc.radiusX, arc.radiusY))), 4);
+	std::vector<Point> points;
+	points.reserve(count + 1);
+	for (int32_t i = 0; i <= count; i++) {
+		const double angle = arc.start + arc.extent * i / count;
+		const Point point = {int32_t(floor(arc.x_at(angle) + 0.5)),
+			int32_t(floor(arc.y_at(angle) + 0.5))};
+		if (points.empty() || points.back().x != point.x || points.back().y != point.y)
+			points.push_back(point);
+	}
+	lines(points.data(), points.size(), true);
+}
+
+void
+Rasterizer::wide_arc(int32_t x, int32_t y, int32_t width, int32_t height,
+	int32_t angle1, int32_t angle2, double lineWidth, int capStyle)
+{
+	if (width < 0 || height < 0 || angle2 == 0)
+		return;
+
+	const Arc shape(x, y, width, height, angle1, angle2);
+	const double halfWidth = lineWidth / 2;
+
+	// Points about four pixels apart along the outer edge, which is still within a
+	// small fraction of a pixel of the curve in between.
+	const int32_t count = std::max(int32_t(ceil(fabs(shape.extent)
+		* (std::max(shape.radiusX, shape.radiusY) + halfWidth) / 4)), 8);
+	if (width == 0 || height == 0) {
+		// Flat ellipses are lines, which have no normals to offset along.
+		std::vector<Point> points;
+		for (int32_t i = 0; i <= count; i++) {
+			const double angle = shape.start + shape.extent * i / count;
+			points.push_back({int32_t(floor(shape.x_at(angle) + 0.5)),
+				int32_t(floor(shape.y_at(angle) + 0.5))});
+		}
+		wide_lines(points.data(), points.size(), lineWidth,
+			shape.full ? CapButt : capStyle, JoinRound);
+		return;
+	}
+
+	// The outline is the arc moved out by half the width along its normals, and
+	// back along the arc moved in; full ellipses make a ring, whose seam cancels out.
+	std::vector<double> outline((count + 1) * 4);
+	double startNormalX = 0, startNormalY = 0, endNormalX = 0, endNormalY = 0;
+	for (int32_t i = 0; i <= count; i++) {
+		const double angle = shape.start + shape.extent * i / count;
+		double normalX = cos(angle) / shape.radiusX, normalY = -sin(angle) / shape.radiusY;
+		const double length = hypot(normalX, normalY);
+		normalX *= halfWidth / length;
+		normalY *= halfWidth / length;
+
+		const double pointX = shape.x_at(angle), pointY = shape.y_at(angle);
+		outline[i * 2] = pointX + normalX;
+		outline[i * 2 + 1] = pointY + normalY;
+		outline[(count * 2 + 1 - i) * 2] = pointX - normalX;
+		outline[(count * 2 + 1 - i) * 2 + 1] = pointY - normalY;
+		if (i == 0) {
+			startNormalX = normalX;
+			startNormalY = normalY;
+		}
+		endNormalX = normalX;
+		endNormalY = normalY;
+	}
+	_fill_polygon(outline.data(), (count + 1) * 2, true);
+	if (shape.full)
+		return;
+
+	const double startX = shape.x_at(shape.start), startY = shape.y_at(shape.start),
+		endX = shape.x_at(shape.start + shape.extent), endY = shape.y_at(shape.start + shape.extent);
+	if (capStyle == CapRound) {
+		_fill_circle(startX, startY, lineWidth);
+		_fill_circle(endX, endY, lineWidth);
+	} else if (capStyle == CapProjecting) {
+		// The arc goes along the normals turned a quarter, one way or the other.
+		const double turn = (shape.extent > 0) ? 1 : -1;
+		_segment(startX - startNormalY * turn, startY + startNormalX * turn, startX, startY,
+			halfWidth, false, false);
+		_segment(endX, endY, endX + endNormalY * turn, endY - endNormalX * turn,
+			halfWidth, false, false);
+	}
+}
+
+void
+Rasterizer::fill_arc(int32_t x, int32_t y, int32_t width, int32_t height,
+	int32_t angle1, int32_t angle2, bool chord)
+{
+	if (width <= 0 || height <= 0 || angle2 == 0)
+		return;
+
+	const Arc shape(x, y, width, height, angle1, angle2);
+	const double chordX = shape.endX - shape.startX, chordY = shape.endY - shape.startY;
+
+	const int32_t top = std::max(ceil_int(shape.centerY - shape.radiusY), _origin_y),
+		bottom = std::min(ceil_int(shape.centerY + shape.radiusY), _origin_y + _height);
+	for (int32_t row = top; row < bottom; row++) {
+		const double v = shape.row_offset(row);
+		int32_t left, right;
+		if (!ellipse_columns(shape.centerX, shape.radiusX, -v, left, right))
+			continue;
+		if (!chord || shape.full) {
+			_slice_span(shape, row, left, right);
+			continue;
+		}
+
+		// Chords keep what is right of the line from the arc's start to its end.
+		limit_columns(-chordY, shape.radiusX * (-chordX * (v - shape.startY)
+			- chordY * shape.startX), shape.centerX, false, left, right);
+		_span(row, left, right);
+	}
+}
+
+} // namespace BeXlib
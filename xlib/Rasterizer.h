@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BeXlib {
+
+/* Scan-converts the X core primitives into a coverage mask, with the pixels the
+ * X11 protocol says they cover, so that pixmaps can be drawn into without views.
+ *
+ * Masks have one byte per pixel, as with MaskScanner; covered pixels are set to
+ * 0xFF. Everything drawn into a mask before it is used is one union, so pixels
+ * covered more than once (e.g. where the segments of a wide line meet) are still
+ * only combined once.
+ *
+ * Zero-width lines use Bresenham's algorithm, breaking ties towards the smaller
+ * coordinate so that lines cover the same pixels whichever way they are drawn.
+ * Everything else covers the pixels whose centers are inside its outline; centers
+ * on the outline belong to the shape on their right, or below them.
+ *
+ * Nothing here uses Haiku APIs; see test/unit/RasterizerTest.cpp. */
+class Rasterizer {
+public:
+	struct Point {
+		int32_t x, y;
+	};
+	struct Rect {
+		int32_t left, top, right, bottom;
+			// Inclusive, as with clipping_rect.
+	};
+
+public:
+	Rasterizer(uint8_t* bits, int32_t bytesPerRow, int32_t width, int32_t height);
+
+	/* Makes the mask's first pixel be at this point, for masks which only cover
+	 * part of what is drawn into. Everything outside the mask is clipped. */
+	void set_origin(int32_t x, int32_t y);
+
+	/* The bounds of what was drawn so far; "left" is greater than "right" if nothing was. */
+	const Rect& drawn() const { return _drawn; }
+
+	/* Dashes zero-width lines and arcs from now on, a pixel at a time (see Dasher
+	 * for the list.) The dashes continue from one line to the next until restarted. */
+	void set_dashes(const unsigned char* dashes, int count, int offset);
+	void restart_dashes();
+
+	void point(int32_t x, int32_t y);
+	void fill_rect(int32_t x, int32_t y, int32_t width, int32_t height);
+
+	/* Zero-width lines. The final point is only drawn if "last" is set (it is not
+	 * for CapNotLast); points shared by consecutive lines are drawn once. */
+	void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, bool last);
+	void lines(const Point* points, int32_t count, bool last);
+
+	/* Wide lines, with the X cap and join styles. Polylines which end where they
+	 * start are joined there instead of having caps. */
+	void wide_line(double x1, double y1, double x2, double y2, double width, int capStyle);
+	void wide_lines(const Point* points, int32_t count, double width,
+		int capStyle, int joinStyle);
+
+	void fill_polygon(const Point* points, int32_t count, bool winding);
+
+	/* Arcs of the ellipse inscribed in the rectangle, starting at "angle1" and
+	 * extending for "angle2", in 64ths of a degree. Angles are measured on the
+	 * circle the ellipse is scaled from. Filled arcs are pie slices, or closed
+	 * by the chord between their ends. */
+	void arc(int32_t x, int32_t y, int32_t width, int32_t height,
+		int32_t angle1, int32_t angle2);
+	void wide_arc(int32_t x, int32_t y, int32_t width, int32_t height,
+		int32_t angle1, int32_t angle2, double lineWidth, int capStyle);
+	void fill_arc(int32_t x, int32_t y, int32_t width, int32_t height,
+		int32_t angle1, int32_t angle2, bool chord);
+
+private:
+	struct Edge {
+		int64_t x1, y1, x2, y2;
+			// In fixed point, with y1 < y2.
+		int direction;
+	};
+	struct Crossing {
+		int32_t x;
+		int direction;
+	};
+	struct Arc;
+
+	void _span(int32_t y, int32_t left, int32_t right);
+	void _dot(int32_t x, int32_t y);
+
+	void _segment(double x1, double y1, double x2, double y2, double halfWidth,
+		bool projectStart, bool projectEnd);
+	void _join(double x, double y, double dx1, double dy1, double dx2, double dy2,
+		double halfWidth, int joinStyle);
+	void _fill_circle(double x, double y, double diameter);
+	void _fill_polygon(const double* coordinates, int32_t count, bool winding = false);
+	void _fill_fixed(const int64_t* coordinates, int32_t count, bool winding);
+
+	void _slice_span(const Arc& arc, int32_t row, int32_t left, int32_t right);
+	void _flattened_arc(const Arc& arc);
+
+private:
+	uint8_t* _bits;
+	int32_t _bytes_per_row;
+	int32_t _width, _height;
+	int32_t _origin_x, _origin_y;
+	Rect _drawn;
+
+	std::vector<int32_t> _dashes;
+	int32_t _dash_total;
+	int32_t _dash_offset;
+	size_t _dash_index;
+	int32_t _dash_remaining;
+
+	std::vector<int64_t> _fixed;
+	std::vector<Edge> _edges;
+	std::vector<size_t> _active;
+	std::vector<Crossing> _crossings;
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
@@ -4,13 +4,18 @@
  */
 #include "Selection.h"
 
-#include <list>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
 #include <app/Application.h>
 #include <app/Clipboard.h>
 
 #include "Atom.h"
 #include "Debug.h"
 #include "Event.h"
+#include "Locking.h"
+#include "Property.h"
 
 extern "C" {
 #include <X11/Xlib.h>
@@ -18,11 +23,71 @@ extern "C" {
 #undef Data
 }
 
+// Guards the requests and transfers below, which the event loop and the
+// client's own threads may be working on at once.
+static pthread_rwlock_t sTransferLock = PTHREAD_RWLOCK_INITIALIZER;
+
 static Atom sCurrentSelectionRequestProperty = None;
 static Atom sCurrentSelectionRequestTarget = None;
+static Window sCurrentSelectionRequestor = None;
 
 static Window sCurrentSelectionRequestee = None;
 
+// The window which last took ownership of the clipboard, and the clipboard
+// count after its data was committed.
+static Window sSelectionOwner = None;
+static std::atomic<int32> sOwnedClipboardCount(-1);
+
+/* The contents of the system clipboard, as of its last change, so that the
+ * registrar is only asked for them once. Requests copy what they ask for out of
+ * this message (as XGetWindowProperty's callers free what it returns) until the
+ * clipboard changes again. The count is the system count from before the data
+ * was fetched, so that a change in between only causes another fetch. */
+struct ClipboardCache {
+	struct View {
+		const void* data;
+		ssize_t length;
+	};
+
+	int32 count = -1;
+	BMessage data;
+	std::vector<Atom> targets;
+	std::unordered_map<Atom, View> views;
+};
+static pthread_rwlock_t sClipboardLock = PTHREAD_RWLOCK_INITIALIZER;
+static ClipboardCache sClipboard;
+static std::atomic<int32> sClipboardCount(-2);
+
+/* An incremental ("INCR") transfer of clipboard data to a requestor.
+ * Each chunk is sent once the requestor deletes the previous one. */
+struct OutgoingTransfer {
+	enum {
+		kNone,
+		kAnnounced,
+		kSending,
+	} state = kNone;
+	size_t offset = 0;
+	size_t size = 0;
+	int32 clipboardCount = 0;
+};
+static OutgoingTransfer sOutgoing;
+
+/* An incremental transfer of selection data into the clipboard. */
+struct IncomingTransfer {
+	bool active = false;
+	char* buffer = NULL;
+	size_t size = 0;
+	size_t capacity = 0;
+};
+static IncomingTransfer sIncoming;
+
+static size_t
+transfer_chunk_size(Display* dpy)
+{
+	// Same as the largest property a single ChangeProperty request could set.
+	return XMaxRequestSize(dpy) * 4;
+}
+
 static void
 request_selection(Display* display, Window owner, Atom selection, Atom target)
 {
@@ -41,6 +106,7 @@ extern "C" Window
 XGetSelectionOwner(Display* display, Atom selection)
 {
 	if (selection == Atoms::CLIPBOARD) {
+		PthreadReadLocker locker(sTransferLock);
 		if (sCurrentSelectionRequestee != None)
 			return sCurrentSelectionRequestee;
 
@@ -61,6 +127,14 @@ extern "C" int
 XSetSelectionOwner(Display* display, Atom selection, Window owner, Time time)
 {
 	if (selection == Atoms::CLIPBOARD) {
+		PthreadWriteLocker locker(sTransferLock);
+		sSelectionOwner = owner;
+		if (owner == None) {
+			sCurrentSelectionRequestee = None;
+			return 0;
+		}
+
+		sOwnedClipboardCount = be_clipboard->SystemCount();
 		sCurrentSelectionRequestee = owner;
 		request_selection(display, owner, selection, Atoms::TARGETS);
 		return 0;
@@ -99,8 +173,12 @@ _x_handle_send_root_selection(Display* dpy, const XEvent& event)
 		if (event.xselectionrequest.selection != Atoms::CLIPBOARD)
 			return; // This should not happen, as XGetSelectionOwner returns None.
 
+		PthreadWriteLocker locker(sTransferLock);
 		sCurrentSelectionRequestProperty = event.xselectionrequest.property;
 		sCurrentSelectionRequestTarget = event.xselectionrequest.target;
+		sCurrentSelectionRequestor = event.xselectionrequest.requestor;
+		sOutgoing = OutgoingTransfer();
+		locker.Unlock();
 
 		XEvent sevent = {};
 		sevent.type = SelectionNotify;
@@ -117,76 +195,245 @@ _x_handle_send_root_selection(Display* dpy, const XEvent& event)
 	UNIMPLEMENTED();
 }
 
+void
+_x_clipboard_changed(Display* dpy)
+{
+	const int32 count = be_clipboard->SystemCount();
+	sClipboardCount = count;
+
+	// Someone else has set the clipboard, so its owner has lost the selection.
+	PthreadWriteLocker locker(sTransferLock);
+	const Window owner = sSelectionOwner;
+	if (!dpy || owner == None || count == sOwnedClipboardCount)
+		return;
+	sSelectionOwner = None;
+	locker.Unlock();
+
+	XEvent event = {};
+	event.type = SelectionClear;
+	event.xselectionclear.window = owner;
+	event.xselectionclear.selection = Atoms::CLIPBOARD;
+	event.xselectionclear.time = _x_current_time();
+	_x_put_event(dpy, event);
+}
+
+static void
+update_clipboard_cache(Display* dpy)
+{
+	const int32 count = be_clipboard->SystemCount();
+	if (!be_clipboard->Lock())
+		return;
+	sClipboard.data = *be_clipboard->Data();
+	sClipboard.count = count;
+	be_clipboard->Unlock();
+
+	sClipboard.targets.clear();
+	sClipboard.views.clear();
+
+	char* name;
+	for (int32 i = 0; sClipboard.data.GetInfo(B_MIME_DATA, i, &name, NULL, NULL) == B_OK; i++) {
+		ClipboardCache::View view;
+		if (sClipboard.data.FindData(name, B_MIME_TYPE, &view.data, &view.length) != B_OK)
+			continue;
+
+		const Atom atom = XInternAtom(dpy, name, False);
+		sClipboard.targets.push_back(atom);
+		sClipboard.views[atom] = view;
+
+		if (strcmp(name, "text/plain") == 0) {
+			sClipboard.targets.push_back(Atoms::UTF8_STRING);
+			sClipboard.views[Atoms::UTF8_STRING] = view;
+			sClipboard.views[XA_STRING] = view;
+		}
+	}
+}
+
+static void
+check_clipboard_cache(Display* dpy)
+{
+	PthreadReadLocker readLocker(sClipboardLock);
+	if (sClipboard.count == sClipboardCount)
+		return;
+	readLocker.Unlock();
+
+	PthreadWriteLocker writeLocker(sClipboardLock);
+	if (sClipboard.count != sClipboardCount)
+		update_clipboard_cache(dpy);
+}
+
+/* Must be called with the clipboard locked. */
+static void
+commit_clipboard()
+{
+	// Recorded first, as the change may be seen before Commit() returns, and the
+	// owner must not be told it lost the selection to itself.
+	sOwnedClipboardCount = be_clipboard->SystemCount() + 1;
+	be_clipboard->Commit();
+	sOwnedClipboardCount = be_clipboard->SystemCount();
+}
+
+/* The functions below must be called with the transfer lock held. */
+
+static void
+finish_selection_request()
+{
+	sCurrentSelectionRequestProperty = None;
+	sCurrentSelectionRequestor = None;
+	sOutgoing = OutgoingTransfer();
+}
+
+/* Moves on to the next chunk of an outgoing transfer, once the requestor has
+ * deleted the property. Returns true if the transfer is complete. */
+static bool
+advance_outgoing_transfer(Display* dpy)
+{
+	if (sOutgoing.state == OutgoingTransfer::kAnnounced) {
+		sOutgoing.state = OutgoingTransfer::kSending;
+		sOutgoing.offset = 0;
+	} else if (sOutgoing.offset >= sOutgoing.size) {
+		// The final, empty chunk has been received.
+		return true;
+	} else {
+		sOutgoing.offset += std::min(transfer_chunk_size(dpy), sOutgoing.size - sOutgoing.offset);
+	}
+
+	_x_property_notify(dpy, sCurrentSelectionRequestor, sCurrentSelectionRequestProperty,
+		PropertyNewValue);
+	return false;
+}
+
+static bool
+get_clipboard_data(Display* dpy, Atom type, const char* data, size_t length,
+	long long_offset, long long_length, Bool del,
+	Atom* actual_type_return, int* actual_format_return,
+	unsigned long* nitems_return, unsigned long* bytes_after_return, unsigned char** prop_return)
+{
+	const size_t chunkSize = transfer_chunk_size(dpy);
+	if (sOutgoing.state == OutgoingTransfer::kNone && length <= chunkSize) {
+		return _x_get_property_slice(data, length, type, long_offset, long_length,
+			actual_type_return, actual_format_return, nitems_return, bytes_after_return, prop_return);
+	}
+
+	if (sOutgoing.state != OutgoingTransfer::kSending) {
+		// Too large to send at once: announce an incremental transfer.
+		if (sOutgoing.state == OutgoingTransfer::kNone) {
+			sOutgoing.state = OutgoingTransfer::kAnnounced;
+			sOutgoing.size = length;
+			sOutgoing.clipboardCount = sClipboard.count;
+		}
+
+		long* size = (long*)malloc(sizeof(long));
+		*size = sOutgoing.size;
+
+		*actual_type_return = Atoms::INCR;
+		*actual_format_return = 32;
+		*nitems_return = 1;
+		*prop_return = (unsigned char*)size;
+		return del ? advance_outgoing_transfer(dpy) : false;
+	}
+
+	if (sClipboard.count != sOutgoing.clipboardCount || length != sOutgoing.size) {
+		// The clipboard changed in the middle of the transfer. End it here.
+		sOutgoing.size = sOutgoing.offset = 0;
+	}
+
+	// Only the chunk is copied out of the cached message.
+	const size_t chunk = std::min(chunkSize, sOutgoing.size - sOutgoing.offset);
+	_x_get_property_slice(data + sOutgoing.offset, chunk, type, long_offset, long_length,
+		actual_type_return, actual_format_return, nitems_return, bytes_after_return, prop_return);
+	if (del && *bytes_after_return == 0)
+		return advance_outgoing_transfer(dpy);
+	return false;
+}
+
 bool
 _x_handle_get_clipboard(Display* dpy, Window w, Atom property,
+	long long_offset, long long_length, Bool del,
 	Atom* actual_type_return, int* actual_format_return,
-	unsigned long* nitems_return, unsigned char** prop_return)
+	unsigned long* nitems_return, unsigned long* bytes_after_return, unsigned char** prop_return)
 {
-	if (property != sCurrentSelectionRequestProperty)
+	PthreadWriteLocker transferLocker(sTransferLock);
+	if (property != sCurrentSelectionRequestProperty || w != sCurrentSelectionRequestor)
 		return false;
 
-	BString requestTypeName; {
-		char* atomName = XGetAtomName(dpy, sCurrentSelectionRequestTarget);
-		requestTypeName = atomName;
-		XFree(atomName);
-	}
-
 	// Some special cases.
-	if (requestTypeName == "text/plain;charset=utf-8")
+	static const Atom textPlainUTF8 = XInternAtom(dpy, "text/plain;charset=utf-8", False);
+	if (sCurrentSelectionRequestTarget == textPlainUTF8)
 		sCurrentSelectionRequestTarget = Atoms::UTF8_STRING;
 
-	be_clipboard->Lock();
-	const BMessage* clip = be_clipboard->Data();
-
-	switch (sCurrentSelectionRequestTarget) {
-	case Atoms::TARGETS: {
-		char* name;
-		std::list<Atom> atoms;
-		int32 i = 1;
-		while (clip->GetInfo(B_MIME_DATA, i++, &name, NULL, NULL) == B_OK) {
-			atoms.push_back(XInternAtom(dpy, name, False));
-
-			if (strcmp(name, "text/plain") == 0)
-				atoms.push_back(Atoms::UTF8_STRING);
-		}
+	check_clipboard_cache(dpy);
+	PthreadReadLocker locker(sClipboardLock);
 
-		Atom* atoms_return = (Atom*)malloc(sizeof(Atom) * atoms.size());
-		std::copy(atoms.begin(), atoms.end(), atoms_return);
+	bool finished = true;
+	if (sCurrentSelectionRequestTarget == Atoms::TARGETS) {
+		const std::vector<Atom>& targets = sClipboard.targets;
+		Atom* atoms_return = (Atom*)malloc(sizeof(Atom) * std::max<size_t>(targets.size(), 1));
+		std::copy(targets.begin(), targets.end(), atoms_return);
 
 		*actual_type_return = XA_ATOM;
 		*actual_format_return = 32;
-		*nitems_return = atoms.size();
+		*nitems_return = targets.size();
 		*prop_return = (unsigned char*)atoms_return;
-		break;
+	} else {
+		const auto view = sClipboard.views.find(sCurrentSelectionRequestTarget);
+		if (view != sClipboard.views.end()) {
+			// Text is always sent as UTF-8; everything else as the raw MIME data.
+			const Atom type = (sCurrentSelectionRequestTarget == XA_STRING)
+				? Atoms::UTF8_STRING : sCurrentSelectionRequestTarget;
+			finished = get_clipboard_data(dpy, type, (const char*)view->second.data,
+				view->second.length, long_offset, long_length, del, actual_type_return,
+				actual_format_return, nitems_return, bytes_after_return, prop_return);
+		}
 	}
+	locker.Unlock();
 
-	case XA_STRING:
-	case Atoms::UTF8_STRING: {
-		const char* text;
-		ssize_t textLength;
-		clip->FindData("text/plain", B_MIME_TYPE, (const void**)&text, &textLength);
+	if (finished)
+		finish_selection_request();
+	return true;
+}
 
-		char* textBuffer = (char*)calloc(sizeof(char), textLength + 1);
-		memcpy(textBuffer, text, textLength);
+bool
+_x_handle_delete_clipboard(Display* dpy, Window w, Atom property)
+{
+	PthreadWriteLocker locker(sTransferLock);
+	if (property != sCurrentSelectionRequestProperty || w != sCurrentSelectionRequestor
+			|| sOutgoing.state == OutgoingTransfer::kNone)
+		return false;
 
-		*actual_type_return = Atoms::UTF8_STRING;
-		*actual_format_return = 8;
-		*nitems_return = textLength;
-		*prop_return = (unsigned char*)textBuffer;
-		break;
-	}
+	if (advance_outgoing_transfer(dpy))
+		finish_selection_request();
+	return true;
+}
+
+static void
+set_clipboard_data(Atom type, const void* data, size_t length)
+{
+	bool changed = false;
+	be_clipboard->Lock();
+	BMessage* clip = be_clipboard->Data();
 
-	// TODO: More types (esp. raw MIME fetches!)
+	if (type == Atoms::UTF8_STRING) {
+		clip->AddData("text/plain", B_MIME_TYPE, data, length);
+		changed = true;
 	}
 
+	if (changed)
+		commit_clipboard();
 	be_clipboard->Unlock();
-	sCurrentSelectionRequestProperty = None;
-	return true;
+}
+
+static void
+reset_incoming_transfer()
+{
+	free(sIncoming.buffer);
+	sIncoming = IncomingTransfer();
 }
 
 Status
-_x_handle_set_clipboard(Display* dpy, Window w, Atom type, const unsigned char* data, int nelements)
+_x_handle_set_clipboard(Display* dpy, Window w, Atom type, int format,
+	const unsigned char* data, int nelements)
 {
+	PthreadWriteLocker locker(sTransferLock);
 	if (type == XA_ATOM) {
 		// First pass: possible types are being sent.
 		const Atom* atoms = (const Atom*)data;
@@ -203,7 +450,7 @@ _x_handle_set_clipboard(Display* dpy, Window w, Atom type, const unsigned char*
 			// Clear the clipboard as we are about to set it.
 			be_clipboard->Lock();
 			be_clipboard->Clear();
-			be_clipboard->Commit();
+			commit_clipboard();
 			be_clipboard->Unlock();
 		}
 
@@ -214,23 +461,47 @@ _x_handle_set_clipboard(Display* dpy, Window w, Atom type, const unsigned char*
 
 	// Actual data is being sent. Let's handle it.
 	if (type == Atoms::INCR) {
-		// TODO: incremental data receive!
-		UNIMPLEMENTED();
-		return BadImplementation;
+		// The data will be sent in chunks, each one after we delete the property.
+		// The value is a lower bound on the total size.
+		reset_incoming_transfer();
+		sIncoming.active = true;
+		if (format == 32 && nelements >= 1 && ((const long*)data)[0] > 0) {
+			const size_t size = ((const long*)data)[0];
+			sIncoming.buffer = (char*)malloc(size);
+			if (sIncoming.buffer)
+				sIncoming.capacity = size;
+		}
+
+		_x_property_notify(dpy, w, Atoms::CLIPBOARD, PropertyDelete);
+		return Success;
 	}
 
-	bool changed = false;
-	be_clipboard->Lock();
-	BMessage* clip = be_clipboard->Data();
+	const size_t length = nelements * (format == 32 ? sizeof(long) : (format / 8));
+	if (sIncoming.active) {
+		if (length == 0) {
+			// An empty chunk ends the transfer.
+			set_clipboard_data(type, sIncoming.buffer, sIncoming.size);
+			reset_incoming_transfer();
+			return Success;
+		}
 
-	if (type == Atoms::UTF8_STRING) {
-		clip->AddData("text/plain", B_MIME_TYPE, data, nelements);
-		changed = true;
-	}
+		if (sIncoming.size + length > sIncoming.capacity) {
+			const size_t capacity = std::max(sIncoming.size + length, sIncoming.capacity * 2);
+			char* buffer = (char*)realloc(sIncoming.buffer, capacity);
+			if (!buffer) {
+				reset_incoming_transfer();
+				return BadAlloc;
+			}
+			sIncoming.buffer = buffer;
+			sIncoming.capacity = capacity;
+		}
+		memcpy(sIncoming.buffer + sIncoming.size, data, length);
+		sIncoming.size += length;
 
-	if (changed)
-		be_clipboard->Commit();
-	be_clipboard->Unlock();
+		_x_property_notify(dpy, w, Atoms::CLIPBOARD, PropertyDelete);
+		return Success;
+	}
 
+	set_clipboard_data(type, data, length);
 	return Success;
 }
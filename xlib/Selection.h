@@ -8,8 +8,12 @@ extern "C" {
 #include <X11/Xlib.h>
 }
 
+void _x_clipboard_changed(Display* dpy);
 void _x_handle_send_root_selection(Display* dpy, const XEvent& event);
 bool _x_handle_get_clipboard(Display* dpy, Window w, Atom property,
+	long long_offset, long long_length, Bool del,
 	Atom* actual_type_return, int* actual_format_return, unsigned long* nitems_return,
-	unsigned char** prop_return);
-Status _x_handle_set_clipboard(Display* dpy, Window w, Atom type, const unsigned char* data, int nelements);
+	unsigned long* bytes_after_return, unsigned char** prop_return);
+bool _x_handle_delete_clipboard(Display* dpy, Window w, Atom property);
+Status _x_handle_set_clipboard(Display* dpy, Window w, Atom type, int format,
+	const unsigned char* data, int nelements);
@@ -8,6 +8,7 @@ extern "C" {
 #include <X11/Xlib.h>
 }
 
-int _x_handle_get_settings(Display* dpy, Window w,
-	Atom* actual_type_return, int* actual_format_return, unsigned long* nitems_return,
-	unsigned char** prop_return);
+void _x_settings_changed(Display* dpy);
+int _x_handle_get_settings(Display* dpy, Window w, long long_offset, long long_length,
+	Atom* actual_type_return, int* actual_format_return,
+	unsigned long* nitems_return, unsigned long* bytes_after_return, unsigned char** prop_return);
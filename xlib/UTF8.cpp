@@ -0,0 +1,100 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "UTF8.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace BeXlib {
+
+size_t
+UTF8::ascii_length(const uint8_t* str, size_t length)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 16 <= length; i += 16) {
+		const int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(str + i)));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i + 8 <= length; i += 8) {
+		uint64_t chunk;
+		memcpy(&chunk, str + i, sizeof(chunk));
+		if ((chunk & 0x8080808080808080ULL) != 0)
+			break;
+	}
+	while (i < length && str[i] < 0x80)
+		i++;
+	return i;
+}
+
+char*
+UTF8::from_latin1(const uint8_t* str, size_t length, char* out)
+{
+	size_t i = 0;
+	while (i < length) {
+		const size_t ascii = ascii_length(str + i, length - i);
+		memcpy(out, str + i, ascii);
+		out += ascii;
+		i += ascii;
+
+		for (; i < length && str[i] >= 0x80; i++) {
+			*out++ = 0xc0 | (str[i] >> 6);
+			*out++ = 0x80 | (str[i] & 0x3f);
+		}
+	}
+	return out;
+}
+
+char*
+UTF8::from_ucs2(const XChar2b* str, size_t count, char* out)
+{
+	static_assert(sizeof(XChar2b) == sizeof(uint16_t));
+
+	size_t i = 0;
+	while (i < count) {
+#if defined(__SSE2__)
+		// Copy runs of ASCII 8 characters at a time. "byte1" is the high byte,
+		// so read as little-endian words, ASCII characters are 0x??00.
+		const __m128i nonASCII = _mm_set1_epi16(0x80ff);
+		for (; i + 8 <= count; i += 8) {
+			const __m128i chunk = _mm_loadu_si128((const __m128i*)(str + i));
+			const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(chunk, nonASCII),
+				_mm_setzero_si128());
+			if (_mm_movemask_epi8(ascii) != 0xffff)
+				break;
+			const __m128i low = _mm_srli_epi16(chunk, 8);
+			_mm_storel_epi64((__m128i*)out, _mm_packus_epi16(low, low));
+			out += 8;
+		}
+		if (i == count)
+			break;
+#endif
+
+		const uint16_t c = (str[i].byte1 << 8) | str[i].byte2;
+		i++;
+		if (c < 0x80) {
+			*out++ = c;
+		} else if (c < 0x800) {
+			*out++ = 0xc0 | (c >> 6);
+			*out++ = 0x80 | (c & 0x3f);
+		} else if (c >= 0xd800 && c <= 0xdfff) {
+			// Surrogates are not characters in UCS-2.
+			memcpy(out, "\xef\xbf\xbd", 3);
+			out += 3;
+		} else {
+			*out++ = 0xe0 | (c >> 12);
+			*out++ = 0x80 | ((c >> 6) & 0x3f);
+			*out++ = 0x80 | (c & 0x3f);
+		}
+	}
+	return out;
+}
+
+} // namespace BeXlib
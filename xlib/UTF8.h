@@ -0,0 +1,32 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+namespace BeXlib {
+
+/* Conversions to UTF-8 which are common enough not to go through iconv.
+ * The output buffers must have room for the longest possible result:
+ * 2 bytes per Latin-1 character, and 3 per UCS-2 one. Both return
+ * the end of what they wrote. (See test/unit/UTF8Test.cpp.) */
+class UTF8 {
+public:
+	/* The length of the leading run of ASCII characters. */
+	static size_t ascii_length(const uint8_t* str, size_t length);
+
+	static char* from_latin1(const uint8_t* str, size_t length, char* out);
+
+	/* XChar2b text, high byte first; surrogates become U+FFFD. */
+	static char* from_ucs2(const XChar2b* str, size_t count, char* out);
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
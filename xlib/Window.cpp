@@ -50,6 +50,15 @@ XCreateWindow(Display* display, Window parent, int x, int y, unsigned int w,
 	window->border_width(border_width);
 
 	XWindow* parent_window = Drawables::get_window(parent);
+	if (visual == CopyFromParent) {
+		visual = parent_window ? parent_window->visual() : DefaultVisual(display, DefaultScreen(display));
+		if (depth == CopyFromParent)
+			depth = parent_window ? parent_window->depth() : DefaultDepth(display, DefaultScreen(display));
+	}
+	if (depth == CopyFromParent)
+		depth = _x_depth_for_visual(display, visual);
+	window->visual(visual, depth);
+
 	if (!parent_window) {
 		window->create_bwindow();
 		window->bwindow->MoveTo(x, y);
@@ -83,6 +92,10 @@ XChangeWindowAttributes(Display *display, Window w,
 	if (!window)
 		return BadWindow;
 
+	// This must come first, as it determines what the pixel values mean.
+	if (vmask & CWColormap)
+		XSetWindowColormap(display, w, attr->colormap);
+
 	if (vmask & CWBackPixmap)
 		XSetWindowBackgroundPixmap(display, w, attr->background_pixmap);
 	if (vmask & CWBackPixel)
@@ -173,10 +186,11 @@ XGetWindowAttributes(Display* display, Window w,
 
 	window_attributes_return->root = DefaultRootWindow(display);
 	window_attributes_return->screen = &display->screens[0];
-	// TODO: Not necessarily correct for pixmaps!
-	window_attributes_return->visual = window_attributes_return->screen->root_visual;
+	window_attributes_return->visual = window->visual();
+	window_attributes_return->depth = window->depth();
+	window_attributes_return->colormap = window->colormap != None
+		? window->colormap : window_attributes_return->screen->cmap;
 	window_attributes_return->c_class = window_attributes_return->visual->c_class;
-	window_attributes_return->depth = _x_depth_for_color_space(window->colorspace());
 
 	BRect frame;
 	window->view()->LockLooper();
@@ -717,7 +731,22 @@ XSetWindowBackground(Display *display, Window w, unsigned long bg)
 	XWindow* window = Drawables::get_window(w);
 	if (!window)
 		return BadWindow;
-	window->background_color(_x_pixel_to_rgb(bg));
+	window->background_color(window->pixel_color(bg));
+	return Success;
+}
+
+extern "C" int
+XSetWindowColormap(Display *display, Window w, Colormap colormap)
+{
+	XWindow* window = Drawables::get_window(w);
+	if (!window)
+		return BadWindow;
+
+	window->view()->LockLooper();
+	window->colormap = _x_colormap(colormap) ? colormap : None;
+	window->gc_state.invalidate(GCForeground | GCBackground);
+	window->view()->Invalidate();
+	window->view()->UnlockLooper();
 	return Success;
 }
 
@@ -779,13 +808,15 @@ XClearArea(Display *display, Window w,
 
 	BRect rect(brect_from_xrect(make_xrect(x, y, width, height)));
 	window->view()->LockLooper();
+	_x_reset_gc_clipping(window);
+	window->forget_indexes();
 	if (exposures) {
 		window->view()->Invalidate(rect);
 	} else {
 		// TODO: This won't work correctly if there is a background pixmap set.
 		if (window->view()->LowColor() != window->view()->ViewColor()) {
 			window->view()->SetLowColor(window->view()->ViewColor());
-			window->last_gc = NULL;
+			window->gc_state.invalidate(GCBackground);
 		}
 		window->view()->FillRect(rect, B_SOLID_LOW);
 		window->draw_border(rect);
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "XSettings.h"
+
+#include <cstring>
+
+extern "C" {
+#include <X11/X.h>
+}
+
+namespace BeXlib {
+
+bool
+XSetting::SameValue(const XSetting& other) const
+{
+	return type == other.type && integer == other.integer && string == other.string
+		&& memcmp(color, other.color, sizeof(color)) == 0;
+}
+
+namespace {
+/* Encodes settings into the _XSETTINGS_SETTINGS property format. */
+class XSettingsEncoder final {
+	std::vector<uint8_t>& _data;
+
+public:
+	XSettingsEncoder(std::vector<uint8_t>& data)
+		: _data(data)
+	{
+	}
+
+	void
+	Encode(uint32_t serial, const std::vector<XSetting>& settings)
+	{
+		_data.clear();
+
+		// header
+		_Append(uint8_t(LSBFirst)); /* byte order */
+		for (int i = 0; i < 3; i++)
+			_Append(uint8_t(0)); /* unused */
+		_Append(uint32_t(serial)); /* SERIAL */
+		_Append(uint32_t(settings.size())); /* N_SETTINGS */
+
+		for (const XSetting& setting : settings) {
+			_Append(uint8_t(setting.type));
+			_Append(uint8_t(0)); // unused
+			_Append(uint16_t(setting.name.length()));
+			_AppendPadded(setting.name);
+			_Append(uint32_t(setting.last_change_serial));
+
+			switch (setting.type) {
+			case XSetting::XSettingsTypeInteger:
+				_Append(uint32_t(setting.integer));
+				break;
+			case XSetting::XSettingsTypeString:
+				_Append(uint32_t(setting.string.length()));
+				_AppendPadded(setting.string);
+				break;
+			case XSetting::XSettingsTypeColor:
+				for (int i = 0; i < 4; i++)
+					_Append(uint16_t(setting.color[i]));
+				break;
+			}
+		}
+	}
+
+private:
+	static int
+	_Padding(int len, int to = 4)
+	{
+		return ((len + to - 1) & (~(to - 1))) - len;
+	}
+
+	template<typename T>
+	void
+	_Append(T value)
+	{
+		// We assume everything is little-endian at present.
+		const uint8_t* bytes = (const uint8_t*)&value;
+		_data.insert(_data.end(), bytes, bytes + sizeof(T));
+	}
+
+	void
+	_AppendPadded(const std::string& string)
+	{
+		_data.insert(_data.end(), string.begin(), string.end());
+		_data.insert(_data.end(), _Padding(string.length()), 0);
+	}
+};
+}
+
+bool
+XSettings::update(std::vector<XSetting> settings)
+{
+	bool changed = _data.empty() || settings.size() != _settings.size();
+	for (XSetting& setting : settings) {
+		setting.last_change_serial = _serial + 1;
+		for (const XSetting& old : _settings) {
+			if (old.name == setting.name && old.SameValue(setting)) {
+				setting.last_change_serial = old.last_change_serial;
+				break;
+			}
+		}
+		if (setting.last_change_serial > _serial)
+			changed = true;
+	}
+	if (!changed)
+		return false;
+
+	_serial++;
+	_settings.swap(settings);
+	encode(_serial, _settings, _data);
+	return true;
+}
+
+void
+XSettings::encode(uint32_t serial, const std::vector<XSetting>& settings,
+	std::vector<uint8_t>& data)
+{
+	XSettingsEncoder(data).Encode(serial, settings);
+}
+
+} // namespace BeXlib
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace BeXlib {
+
+/* A single setting, as described by the XSETTINGS specification. */
+struct XSetting {
+	enum Type {
+		XSettingsTypeInteger	= 0,
+		XSettingsTypeString		= 1,
+		XSettingsTypeColor		= 2,
+	};
+
+	std::string name;
+	Type type;
+	int32_t integer = 0;
+	std::string string;
+	uint16_t color[4] = {};
+		// Red, green, blue and alpha.
+	uint32_t last_change_serial = 0;
+
+	XSetting(const std::string& _name, int32_t value)
+		: name(_name), type(XSettingsTypeInteger), integer(value) {}
+	XSetting(const std::string& _name, const std::string& value)
+		: name(_name), type(XSettingsTypeString), string(value) {}
+	XSetting(const std::string& _name, uint16_t red, uint16_t green, uint16_t blue,
+			uint16_t alpha = 0xffff)
+		: name(_name), type(XSettingsTypeColor), color{red, green, blue, alpha} {}
+
+	bool SameValue(const XSetting& other) const;
+};
+
+/* The published settings, and their encoding as the _XSETTINGS_SETTINGS
+ * property, which is only redone when they change.
+ * (test/unit/XSettingsTest.cpp checks it against the specification.) */
+class XSettings {
+public:
+	/* Replaces the settings. If any are new or different, the serial is bumped,
+	 * and given to them as their last-change serial. Returns whether it was. */
+	bool update(std::vector<XSetting> settings);
+
+	uint32_t serial() const { return _serial; }
+	const std::vector<uint8_t>& data() const { return _data; }
+
+	static void encode(uint32_t serial, const std::vector<XSetting>& settings,
+		std::vector<uint8_t>& data);
+
+private:
+	std::vector<XSetting> _settings;
+	std::vector<uint8_t> _data;
+	uint32_t _serial = 0;
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
@@ -103,13 +103,6 @@ XListInstalledColormaps(Display* display, Window w, int* num_return)
 	return NULL;
 }
 
-int
-XSetWindowColormap(Display *display, Window w, Colormap colormap)
-{
-	UNIMPLEMENTED();
-	return BadImplementation;
-}
-
 Status
 XGetWMColormapWindows(Display *display, Window w, Window **windows_return,
 			  int *count_return)
@@ -136,14 +129,7 @@ XSetWMHints(Display *display, Window w, XWMHints *wm_hints)
 int
 XRefreshKeyboardMapping(XMappingEvent *event_map)
 {
-	UNIMPLEMENTED();
-	return 0;
-}
-
-VisualID
-XVisualIDFromVisual(Visual *visual)
-{
-	UNIMPLEMENTED();
+	// The keymap is reloaded as soon as the system one changes, so there is nothing to do.
 	return 0;
 }
 
@@ -8,7 +8,8 @@ typedef struct {
 	unsigned char blue;
 } XColorEntry;
 
-static XColorEntry xColors[] = {
+/* constexpr, so that lookup tables can be generated from this at compile time. */
+static constexpr XColorEntry xColors[] = {
 	{"alice blue", 240, 248, 255},
 	{"AliceBlue", 240, 248, 255},
 	{"antique white", 250, 235, 215},
@@ -791,7 +792,8 @@ static XColorEntry xColors[] = {
 	{"yellow3", 205, 205, 0},
 	{"yellow4", 139, 139, 0},
 	{"YellowGreen", 154, 205, 50},
-	{NULL, 0, 0, 0}
 };
 
+#define X_COLORS_LENGTH (sizeof(xColors) / sizeof(xColors[0]))
+
 #endif
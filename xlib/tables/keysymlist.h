@@ -3,7 +3,8 @@
 
 #include <X11/keysym.h>
 
-static const struct {
+/* constexpr, so that lookup tables can be generated from this at compile time. */
+static constexpr struct {
     KeySym keySym;
     const char* name;
 } KEY_SYM_LIST[] = {
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#include "Compositor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace BeXlib {
+
+// #pragma mark - pixels
+
+static inline uint32_t
+multiply(uint32_t pixel, uint32_t alpha)
+{
+	// Multiplies all four channels at once, two at a time, rounding correctly.
+	uint32_t rb = (pixel & 0x00FF00FF) * alpha + 0x00800080;
+	rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+	uint32_t ag = ((pixel >> 8) & 0x00FF00FF) * alpha + 0x00800080;
+	ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+	return rb | ag;
+}
+
+static inline uint32_t
+add_saturate(uint32_t a, uint32_t b)
+{
+	uint32_t rb = (a & 0x00FF00FF) + (b & 0x00FF00FF);
+	uint32_t ag = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF);
+	rb |= 0x01000100 - ((rb >> 8) & 0x00010001);
+	ag |= 0x01000100 - ((ag >> 8) & 0x00010001);
+	return (rb & 0x00FF00FF) | ((ag & 0x00FF00FF) << 8);
+}
+
+static inline uint32_t
+fetch(const Surface& surface, int32_t x, int32_t y)
+{
+	if (surface.solid)
+		return surface.color;
+
+	x -= surface.x;
+	y -= surface.y;
+	if (surface.repeat) {
+		x %= surface.width;
+		if (x < 0)
+			x += surface.width;
+		y %= surface.height;
+		if (y < 0)
+			y += surface.height;
+	} else if (x < 0 || y < 0 || x >= surface.width || y >= surface.height) {
+		return 0;
+	}
+
+	const uint8_t* row = surface.bits + y * surface.bytes_per_row;
+	switch (surface.format) {
+	case PixelFormat::ARGB32:
+		return ((const uint32_t*)row)[x];
+	case PixelFormat::RGB24:
+		return ((const uint32_t*)row)[x] | 0xFF000000;
+	case PixelFormat::A8:
+		return uint32_t(row[x]) << 24;
+	}
+	return 0;
+}
+
+/* Returns the pixels of a row, either in place or fetched into "buffer". */
+static uint32_t*
+fetch_row(const Surface& surface, int32_t x, int32_t y, int32_t width, uint32_t* buffer)
+{
+	const int32_t localX = x - surface.x, localY = y - surface.y;
+	if (!surface.solid && surface.format == PixelFormat::ARGB32
+			&& localX >= 0 && localY >= 0 && localY < surface.height
+			&& localX + width <= surface.width) {
+		return (uint32_t*)(surface.bits + localY * surface.bytes_per_row) + localX;
+	}
+
+	for (int32_t i = 0; i < width; i++)
+		buffer[i] = fetch(surface, x + i, y);
+	return buffer;
+}
+
+static void
+store_row(Surface& surface, int32_t x, int32_t y, int32_t width, const uint32_t* pixels)
+{
+	uint8_t* row = surface.bits + (y - surface.y) * surface.bytes_per_row;
+	x -= surface.x;
+	switch (surface.format) {
+	case PixelFormat::ARGB32:
+		if ((const uint8_t*)pixels != row + x * 4)
+			memcpy(row + x * 4, pixels, width * sizeof(uint32_t));
+		break;
+	case PixelFormat::RGB24:
+		for (int32_t i = 0; i < width; i++)
+			((uint32_t*)row)[x + i] = pixels[i] | 0xFF000000;
+		break;
+	case PixelFormat::A8:
+		for (int32_t i = 0; i < width; i++)
+			row[x + i] = pixels[i] >> 24;
+		break;
+	}
+}
+
+// #pragma mark - operators
+
+enum Factor {
+	kZero,
+	kOne,
+	kSourceAlpha,
+	kDestAlpha,
+	kInverseSourceAlpha,
+	kInverseDestAlpha,
+};
+
+template<Factor kFactor>
+static inline uint32_t
+factor(uint32_t sourceAlpha, uint32_t destAlpha)
+{
+	switch (kFactor) {
+	case kZero:					return 0;
+	case kOne:					return 255;
+	case kSourceAlpha:			return sourceAlpha;
+	case kDestAlpha:			return destAlpha;
+	case kInverseSourceAlpha:	return 255 - sourceAlpha;
+	case kInverseDestAlpha:		return 255 - destAlpha;
+	}
+	return 0;
+}
+
+/* dest = src * source factor + dest * dest factor (Porter-Duff.) */
+template<Factor kSource, Factor kDest>
+static void
+combine(uint32_t* dest, const uint32_t* src, int32_t width)
+{
+	for (int32_t i = 0; i < width; i++) {
+		const uint32_t sourceAlpha = src[i] >> 24, destAlpha = dest[i] >> 24;
+		dest[i] = add_saturate(
+			multiply(src[i], factor<kSource>(sourceAlpha, destAlpha)),
+			multiply(dest[i], factor<kDest>(sourceAlpha, destAlpha)));
+	}
+}
+
+static void
+combine_src(uint32_t* dest, const uint32_t* src, int32_t width)
+{
+	if (dest != src)
+		memcpy(dest, src, width * sizeof(uint32_t));
+}
+
+static void
+combine_over(uint32_t* dest, const uint32_t* src, int32_t width)
+{
+	// This is also right for opaque and transparent pixels, so don't branch on those.
+	for (int32_t i = 0; i < width; i++)
+		dest[i] = src[i] + multiply(dest[i], 255 - (src[i] >> 24));
+}
+
+typedef void (*combine_func)(uint32_t* dest, const uint32_t* src, int32_t width);
+
+// Indexed by PictOp.
+static const combine_func kOperators[] = {
+	combine<kZero, kZero>,								// Clear
+	combine_src,										// Src
+	combine<kZero, kOne>,								// Dst
+	combine_over,										// Over
+	combine<kInverseDestAlpha, kOne>,					// OverReverse
+	combine<kDestAlpha, kZero>,							// In
+	combine<kZero, kSourceAlpha>,						// InReverse
+	combine<kInverseDestAlpha, kZero>,					// Out
+	combine<kZero, kInverseSourceAlpha>,				// OutReverse
+	combine<kDestAlpha, kInverseSourceAlpha>,			// Atop
+	combine<kInverseDestAlpha, kSourceAlpha>,			// AtopReverse
+	combine<kInverseDestAlpha, kInverseSourceAlpha>,	// Xor
+	combine<kOne, kOne>,								// Add
+};
+
+bool
+Compositor::supports(int op)
+{
+	return op >= PictOpClear && op <= PictOpAdd;
+}
+
+void
+Compositor::composite(int op, const Surface& src, int32_t srcX, int32_t srcY,
+	const Surface* mask, int32_t maskX, int32_t maskY,
+	Surface& dest, int32_t destX, int32_t destY, int32_t width, int32_t height)
+{
+	if (!supports(op) || width <= 0 || height <= 0)
+		return;
+
+	static thread_local std::vector<uint32_t> sourceRow, maskRow, destRow;
+	sourceRow.resize(width);
+	maskRow.resize(width);
+	destRow.resize(width);
+
+	for (int32_t y = 0; y < height; y++) {
+		const uint32_t* source = fetch_row(src, srcX, srcY + y, width, sourceRow.data());
+		if (mask != NULL) {
+			const uint32_t* alpha = fetch_row(*mask, maskX, maskY + y, width, maskRow.data());
+			for (int32_t i = 0; i < width; i++)
+				sourceRow[i] = multiply(source[i], alpha[i] >> 24);
+			source = sourceRow.data();
+		}
+
+		// ARGB32 destinations are combined in place.
+		uint32_t* pixels = fetch_row(dest, destX, destY + y, width, destRow.data());
+		kOperators[op](pixels, source, width);
+		store_row(dest, destX, destY + y, width, pixels);
+	}
+}
+
+uint32_t
+Compositor::pack_color(const XRenderColor& color)
+{
+	// The color is already premultiplied; it only has to be narrowed, and kept valid.
+	const uint32_t alpha = color.alpha >> 8;
+	return (alpha << 24) | (std::min<uint32_t>(color.red >> 8, alpha) << 16)
+		| (std::min<uint32_t>(color.green >> 8, alpha) << 8)
+		| std::min<uint32_t>(color.blue >> 8, alpha);
+}
+
+void
+Compositor::unpremultiply(uint32_t* pixels, int32_t count)
+{
+	for (int32_t i = 0; i < count; i++) {
+		const uint32_t alpha = pixels[i] >> 24;
+		if (alpha == 255 || alpha == 0)
+			continue;
+
+		const uint32_t red = ((pixels[i] >> 16) & 0xFF) * 255 / alpha,
+			green = ((pixels[i] >> 8) & 0xFF) * 255 / alpha,
+			blue = (pixels[i] & 0xFF) * 255 / alpha;
+		pixels[i] = (alpha << 24) | (std::min(red, 255u) << 16)
+			| (std::min(green, 255u) << 8) | std::min(blue, 255u);
+	}
+}
+
+// #pragma mark - trapezoids
+
+static const int kSubsamples = 16;
+
+static inline XFixed
+line_x(const XLineFixed& line, XFixed y)
+{
+	const int64_t dy = int64_t(line.p2.y) - line.p1.y;
+	if (dy == 0)
+		return line.p1.x;
+	return line.p1.x + XFixed((int64_t(y) - line.p1.y) * (int64_t(line.p2.x) - line.p1.x) / dy);
+}
+
+static inline int32_t
+fixed_floor(XFixed value)
+{
+	return value >> 16;
+}
+
+static inline int32_t
+fixed_ceil(XFixed value)
+{
+	return (value + 0xFFFF) >> 16;
+}
+
+bool
+Compositor::trapezoid_bounds(const XTrapezoid* traps, int count,
+	int32_t& left, int32_t& top, int32_t& right, int32_t& bottom)
+{
+	bool any = false;
+	for (int i = 0; i < count; i++) {
+		const XTrapezoid& trap = traps[i];
+		if (trap.bottom <= trap.top)
+			continue;
+
+		const XFixed x1 = std::min(line_x(trap.left, trap.top), line_x(trap.left, trap.bottom)),
+			x2 = std::max(line_x(trap.right, trap.top), line_x(trap.right, trap.bottom));
+		if (!any) {
+			left = fixed_floor(x1);
+			top = fixed_floor(trap.top);
+			right = fixed_ceil(x2);
+			bottom = fixed_ceil(trap.bottom);
+			any = true;
+			continue;
+		}
+		left = std::min(left, fixed_floor(x1));
+		top = std::min(top, fixed_floor(trap.top));
+		right = std::max(right, fixed_ceil(x2));
+		bottom = std::max(bottom, fixed_ceil(trap.bottom));
+	}
+	return any;
+}
+
+void
+Compositor::rasterize_trapezoids(const XTrapezoid* traps, int count, Surface& mask)
+{
+	// Coverage is sampled on kSubsamples lines per row, and is exact horizontally.
+	// Each sample line adds partial coverage for the pixels at the ends of its
+	// span, and a step (which is integrated afterwards) for the pixels in between.
+	std::vector<int32_t> coverage(mask.width + 1), steps(mask.width + 1);
+	const XFixed minX = XFixed(mask.x) << 16, maxX = XFixed(mask.x + mask.width) << 16;
+
+	for (int i = 0; i < count; i++) {
+		const XTrapezoid& trap = traps[i];
+		if (trap.bottom <= trap.top)
+			continue;
+
+		const int32_t firstRow = std::max(fixed_floor(trap.top), mask.y),
+			lastRow = std::min(fixed_ceil(trap.bottom), mask.y + mask.height);
+		for (int32_t row = firstRow; row < lastRow; row++) {
+			std::fill(coverage.begin(), coverage.end(), 0);
+			std::fill(steps.begin(), steps.end(), 0);
+			bool covered = false;
+
+			for (int sample = 0; sample < kSubsamples; sample++) {
+				const XFixed y = (XFixed(row) << 16) + ((2 * sample + 1) << 16) / (2 * kSubsamples);
+				if (y < trap.top || y >= trap.bottom)
+					continue;
+
+				const XFixed x1 = std::max(line_x(trap.left, y), minX),
+					x2 = std::min(line_x(trap.right, y), maxX);
+				if (x1 >= x2)
+					continue;
+				covered = true;
+
+				const int32_t first = fixed_floor(x1) - mask.x, last = fixed_floor(x2 - 1) - mask.x;
+				if (first == last) {
+					coverage[first] += x2 - x1;
+					continue;
+				}
+				coverage[first] += ((first + mask.x + 1) << 16) - x1;
+				coverage[last] += x2 - ((last + mask.x) << 16);
+				steps[first + 1] += 1 << 16;
+				steps[last] -= 1 << 16;
+			}
+			if (!covered)
+				continue;
+
+			uint8_t* bits = mask.bits + (row - mask.y) * mask.bytes_per_row;
+			int32_t step = 0;
+			for (int32_t x = 0; x < mask.width; x++) {
+				step += steps[x];
+				const int32_t alpha = int32_t((int64_t(coverage[x] + step) * 255
+					+ (kSubsamples << 15)) / (kSubsamples << 16));
+				if (alpha != 0)
+					bits[x] = std::min(255, bits[x] + alpha);
+			}
+		}
+	}
+}
+
+} // namespace BeXlib
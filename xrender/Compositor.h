@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+#include <X11/extensions/Xrender.h>
+}
+
+namespace BeXlib {
+
+/* Pixels as RENDER sees them. ARGB32 is premultiplied; RGB24 has no alpha
+ * (its top byte is written as 0xFF); A8 is alpha only. */
+enum class PixelFormat {
+	ARGB32,
+	RGB24,
+	A8,
+};
+
+struct Surface {
+	uint8_t* bits = NULL;
+	int32_t bytes_per_row = 0;
+	int32_t x = 0, y = 0;
+		// Where the first pixel is, in the picture's coordinates.
+	int32_t width = 0, height = 0;
+	PixelFormat format = PixelFormat::ARGB32;
+	bool repeat = false;
+
+	bool solid = false;
+	uint32_t color = 0;
+		// Premultiplied ARGB, for solid fills.
+};
+
+/* A software implementation of the RENDER operators. It is plain C++, and is
+ * checked against floating-point compositing in test/unit/CompositorTest.cpp. */
+class Compositor {
+public:
+	static bool supports(int op);
+
+	/* dest = (src IN mask) OP dest, for a rectangle which must be inside the destination. */
+	static void composite(int op, const Surface& src, int32_t srcX, int32_t srcY,
+		const Surface* mask, int32_t maskX, int32_t maskY,
+		Surface& dest, int32_t destX, int32_t destY, int32_t width, int32_t height);
+
+	/* XRenderColors are premultiplied, as ARGB32 pixels are. */
+	static uint32_t pack_color(const XRenderColor& color);
+	static void unpremultiply(uint32_t* pixels, int32_t count);
+
+	/* Adds the coverage of the trapezoids into an A8 mask. */
+	static void rasterize_trapezoids(const XTrapezoid* traps, int count, Surface& mask);
+	static bool trapezoid_bounds(const XTrapezoid* traps, int count,
+		int32_t& left, int32_t& top, int32_t& right, int32_t& bottom);
+};
+
+} // namespace BeXlib
+using namespace BeXlib;
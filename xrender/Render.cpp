@@ -0,0 +1,1019 @@
+/*
+ * Copyright 2022, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT license.
+ */
+
+#include <interface/Bitmap.h>
+#include <interface/Region.h>
+#include <interface/Screen.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Color.h"
+#include "Compositor.h"
+#include "Drawables.h"
+#include "Drawing.h"
+#include "Locking.h"
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+}
+
+#include "Debug.h"
+
+/* Pictures are composited in software, directly in the bitmaps of pixmaps.
+ * Windows are drawn into with the view's alpha drawing modes where the operator
+ * allows it, and are otherwise read back from the screen first.
+ *
+ * Only the parts of RENDER 0.4 which toolkits (and Cairo in particular) actually
+ * need are implemented: transforms, filters and gradients are not advertised. */
+
+enum {
+	kFormatARGB32 = 1,
+	kFormatRGB24,
+	kFormatA8,
+	kFormatA1,
+};
+
+static XRenderPictFormat sFormats[] = {
+	{kFormatARGB32, PictTypeDirect, 32, {16, 0xFF, 8, 0xFF, 0, 0xFF, 24, 0xFF}, None},
+	{kFormatRGB24, PictTypeDirect, 24, {16, 0xFF, 8, 0xFF, 0, 0xFF, 0, 0}, None},
+	{kFormatA8, PictTypeDirect, 8, {0, 0, 0, 0, 0, 0, 0, 0xFF}, None},
+	{kFormatA1, PictTypeDirect, 1, {0, 0, 0, 0, 0, 0, 0, 0x01}, None},
+};
+static const int kFormatCount = sizeof(sFormats) / sizeof(sFormats[0]);
+
+struct XPicture {
+	Drawable drawable = None;
+	const XRenderPictFormat* format = NULL;
+	bool repeat = false;
+
+	bool solid = false;
+	uint32 color = 0;
+
+	bool clipped = false;
+	BRegion clip;
+	int clip_x = 0, clip_y = 0;
+};
+
+struct XGlyph {
+	XGlyphInfo info;
+	std::vector<uint8> alpha;
+};
+
+struct XGlyphSet {
+	const XRenderPictFormat* format;
+	std::map<Glyph, XGlyph> glyphs;
+};
+
+static std::atomic<XID> sLastID(0x70000000);
+	// Far away from the IDs of drawables.
+
+static pthread_rwlock_t sPicturesLock = PTHREAD_RWLOCK_INITIALIZER;
+static std::map<Picture, XPicture> sPictures;
+static std::map<GlyphSet, std::shared_ptr<XGlyphSet>> sGlyphSets;
+
+static XPicture*
+get_picture(Picture id)
+{
+	const auto& it = sPictures.find(id);
+	if (it == sPictures.end())
+		return NULL;
+	return &it->second;
+}
+
+static XGlyphSet*
+get_glyph_set(GlyphSet id)
+{
+	const auto& it = sGlyphSets.find(id);
+	if (it == sGlyphSets.end())
+		return NULL;
+	return it->second.get();
+}
+
+// #pragma mark - surfaces
+
+static bool
+surface_for_bitmap(BBitmap* bitmap, const XRenderPictFormat* format, Surface& surface)
+{
+	switch (bitmap->ColorSpace()) {
+	case B_RGBA32:
+		surface.format = (format != NULL && format->direct.alphaMask != 0)
+			? PixelFormat::ARGB32 : PixelFormat::RGB24;
+		break;
+	case B_RGB32:
+		surface.format = PixelFormat::RGB24;
+		break;
+	case B_GRAY8:
+		// Depth 1 pixmaps also store 0xFF for set bits, so they work as A8.
+		surface.format = PixelFormat::A8;
+		break;
+	default:
+		return false;
+	}
+
+	surface.bits = (uint8_t*)bitmap->Bits();
+	surface.bytes_per_row = bitmap->BytesPerRow();
+	surface.x = surface.y = 0;
+	surface.width = bitmap->Bounds().IntegerWidth() + 1;
+	surface.height = bitmap->Bounds().IntegerHeight() + 1;
+	return true;
+}
+
+/* Reads back what is on screen of part of a window into the bitmap, which must be
+ * large enough. (Windows are not backed by anything we could read otherwise.) */
+static bool
+read_window(XWindow* window, const BRect& rect, BBitmap* bitmap)
+{
+	BView* view = window->view();
+	view->LockLooper();
+	view->Sync();
+	const BPoint screenOffset = view->ConvertToScreen(B_ORIGIN);
+	view->UnlockLooper();
+
+	BRect bounds = rect.OffsetByCopy(screenOffset);
+	return BScreen().ReadBitmap(bitmap, false, &bounds) == B_OK;
+}
+
+/* Prepares a picture to be read from, at least in the given rectangle. */
+static bool
+source_surface(const XPicture& picture, BRect rect, Surface& surface,
+	std::unique_ptr<BBitmap>& readBack)
+{
+	surface.repeat = picture.repeat;
+	if (picture.solid) {
+		surface.solid = true;
+		surface.color = picture.color;
+		return true;
+	}
+
+	XDrawable* drawable = Drawables::get(picture.drawable);
+	if (XPixmap* pixmap = dynamic_cast<XPixmap*>(drawable)) {
+		pixmap->sync();
+		return surface_for_bitmap(pixmap->offscreen(), picture.format, surface);
+	}
+
+	XWindow* window = dynamic_cast<XWindow*>(drawable);
+	if (window == NULL)
+		return false;
+
+	const BRect bounds(B_ORIGIN, window->size());
+	rect = picture.repeat ? bounds : (rect & bounds);
+	if (!rect.IsValid()) {
+		// Nothing of the window is needed, so it is all transparent.
+		surface.solid = true;
+		surface.color = 0;
+		return true;
+	}
+
+	readBack.reset(new BBitmap(rect.OffsetToCopy(B_ORIGIN), 0, B_RGBA32));
+	if (!read_window(window, rect, readBack.get()))
+		return false;
+
+	surface_for_bitmap(readBack.get(), NULL, surface);
+	surface.x = int32(rect.left);
+	surface.y = int32(rect.top);
+	return true;
+}
+
+/* The part of the destination which an operation affects. */
+static BRegion
+destination_region(const XPicture& picture, XDrawable* drawable,
+	int32 x, int32 y, int32 width, int32 height)
+{
+	BRegion region(BRect(x, y, x + width - 1, y + height - 1));
+	BRegion bounds(BRect(B_ORIGIN, drawable->size()));
+	region.IntersectWith(&bounds);
+	if (picture.clipped) {
+		BRegion clip(picture.clip);
+		clip.OffsetBy(picture.clip_x, picture.clip_y);
+		region.IntersectWith(&clip);
+	}
+	return region;
+}
+
+static void
+composite_region(int op, const Surface& source, int32 srcX, int32 srcY,
+	const Surface* mask, int32 maskX, int32 maskY,
+	Surface& dest, const BRegion& region, int32 dstX, int32 dstY)
+{
+	for (int32 i = 0; i < region.CountRects(); i++) {
+		const clipping_rect rect = region.RectAtInt(i);
+		const int32 dx = rect.left - dstX, dy = rect.top - dstY;
+		Compositor::composite(op, source, srcX + dx, srcY + dy, mask, maskX + dx, maskY + dy,
+			dest, rect.left, rect.top, rect.right - rect.left + 1, rect.bottom - rect.top + 1);
+	}
+}
+
+static void
+composite_to_window(int op, const Surface& source, int32 srcX, int32 srcY,
+	const Surface* mask, int32 maskX, int32 maskY,
+	XWindow* window, BRegion& region, int32 dstX, int32 dstY)
+{
+	const BRect frame = region.Frame();
+	BBitmap* scratch = window->scratch_bitmap_for(frame.Size(), B_RGBA32);
+	if (!scratch->IsValid())
+		return;
+
+	Surface dest;
+	surface_for_bitmap(scratch, NULL, dest);
+	dest.x = int32(frame.left);
+	dest.y = int32(frame.top);
+
+	if (op == PictOpOver) {
+		// Let the app_server do the blending: compute (src IN mask) only.
+		dest.format = PixelFormat::ARGB32;
+		composite_region(PictOpSrc, source, srcX, srcY, mask, maskX, maskY,
+			dest, region, dstX, dstY);
+
+		const int32 width = frame.IntegerWidth() + 1;
+		for (int32 y = 0; y <= frame.IntegerHeight(); y++) {
+			Compositor::unpremultiply((uint32_t*)(dest.bits + y * dest.bytes_per_row),
+				width);
+		}
+	} else if (op == PictOpSrc) {
+		composite_region(op, source, srcX, srcY, mask, maskX, maskY,
+			dest, region, dstX, dstY);
+	} else {
+		// Everything else needs the current contents of the window.
+		if (!read_window(window, frame, scratch))
+			return;
+		composite_region(op, source, srcX, srcY, mask, maskX, maskY,
+			dest, region, dstX, dstY);
+	}
+
+	BView* view = window->view();
+	view->LockLooper();
+	_x_reset_gc_clipping(window);
+	window->forget_indexes();
+	view->PushState();
+	view->ConstrainClippingRegion(&region);
+	if (op == PictOpOver) {
+		view->SetDrawingMode(B_OP_ALPHA);
+		view->SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+	} else {
+		view->SetDrawingMode(B_OP_COPY);
+	}
+	view->DrawBitmap(scratch, frame.OffsetToCopy(B_ORIGIN), frame);
+	view->PopState();
+	view->UnlockLooper();
+}
+
+/* dst = (src IN mask) OP dst. Must be called with the pictures locked. */
+static void
+composite(int op, const XPicture& src, int32 srcX, int32 srcY,
+	const Surface* mask, int32 maskX, int32 maskY,
+	const XPicture& dst, int32 dstX, int32 dstY, int32 width, int32 height)
+{
+	if (!Compositor::supports(op)) {
+		UNIMPLEMENTED();
+		return;
+	}
+
+	XDrawable* drawable = Drawables::get(dst.drawable);
+	if (drawable == NULL || width <= 0 || height <= 0)
+		return;
+
+	BRegion region = destination_region(dst, drawable, dstX, dstY, width, height);
+	if (region.CountRects() == 0)
+		return;
+
+	Surface source;
+	std::unique_ptr<BBitmap> readBack;
+	if (!source_surface(src, region.Frame().OffsetByCopy(srcX - dstX, srcY - dstY),
+			source, readBack)) {
+		UNIMPLEMENTED();
+		return;
+	}
+
+	if (XPixmap* pixmap = dynamic_cast<XPixmap*>(drawable)) {
+		Surface dest;
+		pixmap->sync();
+		if (!surface_for_bitmap(pixmap->offscreen(), dst.format, dest)) {
+			UNIMPLEMENTED();
+			return;
+		}
+		composite_region(op, source, srcX, srcY, mask, maskX, maskY,
+			dest, region, dstX, dstY);
+		pixmap->mark_changed();
+		return;
+	}
+
+	if (XWindow* window = dynamic_cast<XWindow*>(drawable)) {
+		composite_to_window(op, source, srcX, srcY, mask, maskX, maskY,
+			window, region, dstX, dstY);
+	}
+}
+
+/* An A8 mask covering a rectangle of the destination. */
+class AlphaMask {
+	std::vector<uint8_t> _bits;
+
+public:
+	Surface surface;
+
+	AlphaMask(int32 left, int32 top, int32 right, int32 bottom)
+	{
+		surface.format = PixelFormat::A8;
+		surface.x = left;
+		surface.y = top;
+		surface.width = right - left;
+		surface.height = bottom - top;
+		surface.bytes_per_row = surface.width;
+		_bits.resize(surface.width * surface.height);
+		surface.bits = _bits.data();
+	}
+};
+
+// #pragma mark - formats
+
+extern "C" Bool
+XRenderQueryExtension(Display* dpy, int* event_basep, int* error_basep)
+{
+	*event_basep = 0;
+	*error_basep = 0;
+	return True;
+}
+
+extern "C" Status
+XRenderQueryVersion(Display* dpy, int* major_versionp, int* minor_versionp)
+{
+	// Later versions add transforms, filters and gradients, which we do not have.
+	*major_versionp = 0;
+	*minor_versionp = 4;
+	return 1;
+}
+
+extern "C" Status
+XRenderQueryFormats(Display* dpy)
+{
+	return 1;
+}
+
+extern "C" int
+XRenderQuerySubpixelOrder(Display* dpy, int screen)
+{
+	return SubPixelUnknown;
+}
+
+extern "C" Bool
+XRenderSetSubpixelOrder(Display* dpy, int screen, int subpixel)
+{
+	return False;
+}
+
+extern "C" XRenderPictFormat*
+XRenderFindVisualFormat(Display* dpy, _Xconst Visual* visual)
+{
+	switch (_x_depth_for_visual(dpy, const_cast<Visual*>(visual))) {
+	case 24:	return &sFormats[1];
+	case 32:	return &sFormats[0];
+	}
+
+	// Other visuals' pixels are not stored in a way we can composite.
+	return NULL;
+}
+
+extern "C" XRenderPictFormat*
+XRenderFindFormat(Display* dpy, unsigned long mask,
+	_Xconst XRenderPictFormat* templ, int count)
+{
+	for (int i = 0; i < kFormatCount; i++) {
+		const XRenderPictFormat& format = sFormats[i];
+		if ((mask & PictFormatID) && templ->id != format.id)
+			continue;
+		if ((mask & PictFormatType) && templ->type != format.type)
+			continue;
+		if ((mask & PictFormatDepth) && templ->depth != format.depth)
+			continue;
+		if ((mask & PictFormatRed) && templ->direct.red != format.direct.red)
+			continue;
+		if ((mask & PictFormatRedMask) && templ->direct.redMask != format.direct.redMask)
+			continue;
+		if ((mask & PictFormatGreen) && templ->direct.green != format.direct.green)
+			continue;
+		if ((mask & PictFormatGreenMask) && templ->direct.greenMask != format.direct.greenMask)
+			continue;
+		if ((mask & PictFormatBlue) && templ->direct.blue != format.direct.blue)
+			continue;
+		if ((mask & PictFormatBlueMask) && templ->direct.blueMask != format.direct.blueMask)
+			continue;
+		if ((mask & PictFormatAlpha) && templ->direct.alpha != format.direct.alpha)
+			continue;
+		if ((mask & PictFormatAlphaMask) && templ->direct.alphaMask != format.direct.alphaMask)
+			continue;
+		if ((mask & PictFormatColormap) && templ->colormap != format.colormap)
+			continue;
+
+		if (count-- == 0)
+			return &sFormats[i];
+	}
+	return NULL;
+}
+
+extern "C" XRenderPictFormat*
+XRenderFindStandardFormat(Display* dpy, int format)
+{
+	switch (format) {
+	case PictStandardARGB32:	return &sFormats[0];
+	case PictStandardRGB24:		return &sFormats[1];
+	case PictStandardA8:		return &sFormats[2];
+	case PictStandardA1:		return &sFormats[3];
+	}
+	return NULL;
+}
+
+extern "C" XIndexValue*
+XRenderQueryPictIndexValues(Display* dpy, _Xconst XRenderPictFormat* format, int* num)
+{
+	// There are no indexed formats.
+	*num = 0;
+	return NULL;
+}
+
+// #pragma mark - pictures
+
+static void
+change_picture(XPicture& picture, unsigned long valuemask,
+	_Xconst XRenderPictureAttributes* attributes)
+{
+	if (valuemask & CPRepeat)
+		picture.repeat = (attributes->repeat != RepeatNone);
+	if (valuemask & CPClipXOrigin)
+		picture.clip_x = attributes->clip_x_origin;
+	if (valuemask & CPClipYOrigin)
+		picture.clip_y = attributes->clip_y_origin;
+	if (valuemask & CPClipMask) {
+		picture.clipped = false;
+		picture.clip.MakeEmpty();
+		XPixmap* mask = Drawables::get_pixmap(attributes->clip_mask);
+		if (mask != NULL)
+			picture.clipped = _x_region_for_mask(mask, picture.clip);
+	}
+}
+
+extern "C" Picture
+XRenderCreatePicture(Display* dpy, Drawable drawable, _Xconst XRenderPictFormat* format,
+	unsigned long valuemask, _Xconst XRenderPictureAttributes* attributes)
+{
+	if (Drawables::get(drawable) == NULL)
+		return None;
+
+	PthreadWriteLocker locker(sPicturesLock);
+	const Picture id = sLastID++;
+	XPicture& picture = sPictures[id];
+	picture.drawable = drawable;
+	picture.format = format;
+	change_picture(picture, valuemask, attributes);
+	return id;
+}
+
+extern "C" Picture
+XRenderCreateSolidFill(Display* dpy, const XRenderColor* color)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	const Picture id = sLastID++;
+	XPicture& picture = sPictures[id];
+	picture.format = &sFormats[0];
+	picture.solid = true;
+	picture.color = Compositor::pack_color(*color);
+	return id;
+}
+
+extern "C" void
+XRenderChangePicture(Display* dpy, Picture picture, unsigned long valuemask,
+	_Xconst XRenderPictureAttributes* attributes)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	if (XPicture* pict = get_picture(picture))
+		change_picture(*pict, valuemask, attributes);
+}
+
+extern "C" void
+XRenderSetPictureClipRectangles(Display* dpy, Picture picture,
+	int xOrigin, int yOrigin, _Xconst XRectangle* rects, int n)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	XPicture* pict = get_picture(picture);
+	if (pict == NULL)
+		return;
+
+	pict->clipped = true;
+	pict->clip.MakeEmpty();
+	for (int i = 0; i < n; i++) {
+		if (rects[i].width == 0 || rects[i].height == 0)
+			continue;
+		pict->clip.Include(brect_from_xrect(rects[i]));
+	}
+	pict->clip_x = xOrigin;
+	pict->clip_y = yOrigin;
+}
+
+extern "C" void
+XRenderSetPictureClipRegion(Display* dpy, Picture picture, Region r)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	XPicture* pict = get_picture(picture);
+	if (pict == NULL)
+		return;
+
+	pict->clipped = true;
+	pict->clip = *(BRegion*)r;
+	pict->clip_x = pict->clip_y = 0;
+}
+
+extern "C" void
+XRenderFreePicture(Display* dpy, Picture picture)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	sPictures.erase(picture);
+}
+
+extern "C" void
+XRenderComposite(Display* dpy, int op, Picture src, Picture mask, Picture dst,
+	int src_x, int src_y, int mask_x, int mask_y, int dst_x, int dst_y,
+	unsigned int width, unsigned int height)
+{
+	PthreadReadLocker locker(sPicturesLock);
+	XPicture* source = get_picture(src);
+	XPicture* dest = get_picture(dst);
+	if (source == NULL || dest == NULL)
+		return;
+
+	Surface maskSurface;
+	std::unique_ptr<BBitmap> maskReadBack;
+	if (mask != None) {
+		XPicture* maskPicture = get_picture(mask);
+		if (maskPicture == NULL)
+			return;
+
+		const BRect maskRect = brect_from_xrect(make_xrect(mask_x, mask_y, width, height));
+		if (!source_surface(*maskPicture, maskRect, maskSurface, maskReadBack)) {
+			UNIMPLEMENTED();
+			return;
+		}
+	}
+
+	composite(op, *source, src_x, src_y, mask != None ? &maskSurface : NULL, mask_x, mask_y,
+		*dest, dst_x, dst_y, width, height);
+}
+
+extern "C" void
+XRenderFillRectangles(Display* dpy, int op, Picture dst, _Xconst XRenderColor* color,
+	_Xconst XRectangle* rectangles, int n_rects)
+{
+	PthreadReadLocker locker(sPicturesLock);
+	XPicture* dest = get_picture(dst);
+	if (dest == NULL)
+		return;
+
+	XPicture source;
+	source.solid = true;
+	source.color = Compositor::pack_color(*color);
+
+	XWindow* window = Drawables::get_window(dest->drawable);
+	if (window != NULL && (op == PictOpSrc || op == PictOpOver)) {
+		// These can be drawn directly.
+		BRegion clip = destination_region(*dest, window, 0, 0,
+			window->size().IntegerWidth() + 1, window->size().IntegerHeight() + 1);
+		BView* view = window->view();
+		view->LockLooper();
+		_x_reset_gc_clipping(window);
+		window->forget_indexes();
+		view->PushState();
+		view->ConstrainClippingRegion(&clip);
+		if (op == PictOpOver) {
+			view->SetDrawingMode(B_OP_ALPHA);
+			view->SetBlendingMode(B_CONSTANT_ALPHA, B_ALPHA_OVERLAY);
+			// Views blend straight colors, not premultiplied ones.
+			uint32_t straight = source.color;
+			Compositor::unpremultiply(&straight, 1);
+			view->SetHighColor((straight >> 16) & 0xFF, (straight >> 8) & 0xFF,
+				straight & 0xFF, straight >> 24);
+		} else {
+			view->SetDrawingMode(B_OP_COPY);
+			view->SetHighColor(_x_pixel_to_rgb(source.color));
+		}
+		for (int i = 0; i < n_rects; i++)
+			view->FillRect(brect_from_xrect(rectangles[i]));
+		view->PopState();
+		view->UnlockLooper();
+		return;
+	}
+
+	for (int i = 0; i < n_rects; i++) {
+		composite(op, source, 0, 0, NULL, 0, 0, *dest,
+			rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height);
+	}
+}
+
+extern "C" void
+XRenderFillRectangle(Display* dpy, int op, Picture dst, _Xconst XRenderColor* color,
+	int x, int y, unsigned int width, unsigned int height)
+{
+	const XRectangle rect = make_xrect(x, y, width, height);
+	XRenderFillRectangles(dpy, op, dst, color, &rect, 1);
+}
+
+// #pragma mark - glyphs
+
+extern "C" GlyphSet
+XRenderCreateGlyphSet(Display* dpy, _Xconst XRenderPictFormat* format)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	const GlyphSet id = sLastID++;
+	std::shared_ptr<XGlyphSet>& glyphSet = sGlyphSets[id];
+	glyphSet.reset(new XGlyphSet);
+	glyphSet->format = format;
+	return id;
+}
+
+extern "C" GlyphSet
+XRenderReferenceGlyphSet(Display* dpy, GlyphSet existing)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	const auto& it = sGlyphSets.find(existing);
+	if (it == sGlyphSets.end())
+		return None;
+
+	// Both names refer to the same glyphs.
+	std::shared_ptr<XGlyphSet> glyphSet = it->second;
+	const GlyphSet id = sLastID++;
+	sGlyphSets[id] = glyphSet;
+	return id;
+}
+
+extern "C" void
+XRenderFreeGlyphSet(Display* dpy, GlyphSet glyphset)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	sGlyphSets.erase(glyphset);
+}
+
+extern "C" void
+XRenderAddGlyphs(Display* dpy, GlyphSet glyphset, _Xconst Glyph* gids,
+	_Xconst XGlyphInfo* glyphs, int nglyphs, _Xconst char* images, int nbyte_images)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	XGlyphSet* glyphSet = get_glyph_set(glyphset);
+	if (glyphSet == NULL || glyphSet->format == NULL)
+		return;
+
+	const int depth = glyphSet->format->depth;
+	const bool lsbFirst = (BitmapBitOrder(dpy) == LSBFirst);
+	const uint8* image = (const uint8*)images;
+	const uint8* end = image + nbyte_images;
+	for (int i = 0; i < nglyphs; i++) {
+		const XGlyphInfo& info = glyphs[i];
+		int32 stride;
+		switch (depth) {
+		case 1:		stride = ((info.width + 31) / 32) * 4; break;
+		case 8:		stride = (info.width + 3) & ~3; break;
+		case 32:	stride = info.width * 4; break;
+		default:
+			UNIMPLEMENTED();
+			return;
+		}
+		if (image + stride * info.height > end)
+			break;
+
+		// Everything is stored as alpha, which is all that is needed to draw text.
+		XGlyph& glyph = glyphSet->glyphs[gids[i]];
+		glyph.info = info;
+		glyph.alpha.resize(info.width * info.height);
+		uint8* alpha = glyph.alpha.data();
+		for (int32 y = 0; y < info.height; y++) {
+			const uint8* row = image + y * stride;
+			for (int32 x = 0; x < info.width; x++) {
+				switch (depth) {
+				case 1: {
+					const int bit = lsbFirst ? (x & 7) : (7 - (x & 7));
+					*alpha++ = (row[x / 8] & (1 << bit)) ? 0xFF : 0;
+					break;
+				}
+				case 8:
+					*alpha++ = row[x];
+					break;
+				case 32:
+					*alpha++ = ((const uint32*)row)[x] >> 24;
+					break;
+				}
+			}
+		}
+		image += stride * info.height;
+	}
+}
+
+extern "C" void
+XRenderFreeGlyphs(Display* dpy, GlyphSet glyphset, _Xconst Glyph* gids, int nglyphs)
+{
+	PthreadWriteLocker locker(sPicturesLock);
+	XGlyphSet* glyphSet = get_glyph_set(glyphset);
+	if (glyphSet == NULL)
+		return;
+
+	for (int i = 0; i < nglyphs; i++)
+		glyphSet->glyphs.erase(gids[i]);
+}
+
+static inline Glyph
+glyph_index(char c)
+{
+	// Glyph indexes are unsigned.
+	return (unsigned char)c;
+}
+
+static inline Glyph
+glyph_index(unsigned short c)
+{
+	return c;
+}
+
+static inline Glyph
+glyph_index(unsigned int c)
+{
+	return c;
+}
+
+/* Calls the function with every glyph of the elements and where it is drawn. */
+template<typename Element, typename Function>
+static void
+for_each_glyph(const Element* elts, int nelt, Function function)
+{
+	// The offset of each element is relative to where the previous one ended.
+	int32 x = 0, y = 0;
+	for (int i = 0; i < nelt; i++) {
+		x += elts[i].xOff;
+		y += elts[i].yOff;
+
+		XGlyphSet* glyphSet = get_glyph_set(elts[i].glyphset);
+		if (glyphSet == NULL)
+			continue;
+
+		for (int c = 0; c < elts[i].nchars; c++) {
+			const auto& it = glyphSet->glyphs.find(glyph_index(elts[i].chars[c]));
+			if (it == glyphSet->glyphs.end())
+				continue;
+
+			const XGlyph& glyph = it->second;
+			function(glyph, x - glyph.info.x, y - glyph.info.y);
+			x += glyph.info.xOff;
+			y += glyph.info.yOff;
+		}
+	}
+}
+
+template<typename Element>
+static void
+composite_glyphs(int op, Picture src, Picture dst, int xSrc, int ySrc,
+	const Element* elts, int nelt)
+{
+	PthreadReadLocker locker(sPicturesLock);
+	XPicture* source = get_picture(src);
+	XPicture* dest = get_picture(dst);
+	if (source == NULL || dest == NULL || nelt <= 0)
+		return;
+
+	bool any = false;
+	int32 left = 0, top = 0, right = 0, bottom = 0;
+	for_each_glyph(elts, nelt, [&](const XGlyph& glyph, int32 x, int32 y) {
+		if (glyph.info.width == 0 || glyph.info.height == 0)
+			return;
+		if (!any) {
+			left = x;
+			top = y;
+			right = x + glyph.info.width;
+			bottom = y + glyph.info.height;
+			any = true;
+			return;
+		}
+		left = std::min(left, x);
+		top = std::min(top, y);
+		right = std::max(right, x + glyph.info.width);
+		bottom = std::max(bottom, y + glyph.info.height);
+	});
+	if (!any)
+		return;
+
+	// All glyphs are added into one mask, which is then composited at once.
+	AlphaMask mask(left, top, right, bottom);
+	for_each_glyph(elts, nelt, [&](const XGlyph& glyph, int32 x, int32 y) {
+		const uint8* alpha = glyph.alpha.data();
+		for (int32 row = 0; row < glyph.info.height; row++) {
+			uint8* bits = mask.surface.bits + (y - top + row) * mask.surface.bytes_per_row
+				+ (x - left);
+			for (int32 column = 0; column < glyph.info.width; column++)
+				bits[column] = std::min(255, bits[column] + *alpha++);
+		}
+	});
+
+	// The source is aligned with where the first element starts.
+	composite(op, *source, xSrc + (left - elts[0].xOff), ySrc + (top - elts[0].yOff),
+		&mask.surface, left, top, *dest, left, top, right - left, bottom - top);
+}
+
+extern "C" void
+XRenderCompositeText8(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc, int xDst, int yDst,
+	_Xconst XGlyphElt8* elts, int nelt)
+{
+	composite_glyphs(op, src, dst, xSrc, ySrc, elts, nelt);
+}
+
+extern "C" void
+XRenderCompositeText16(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc, int xDst, int yDst,
+	_Xconst XGlyphElt16* elts, int nelt)
+{
+	composite_glyphs(op, src, dst, xSrc, ySrc, elts, nelt);
+}
+
+extern "C" void
+XRenderCompositeText32(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc, int xDst, int yDst,
+	_Xconst XGlyphElt32* elts, int nelt)
+{
+	composite_glyphs(op, src, dst, xSrc, ySrc, elts, nelt);
+}
+
+extern "C" void
+XRenderCompositeString8(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, GlyphSet glyphset,
+	int xSrc, int ySrc, int xDst, int yDst, _Xconst char* string, int nchar)
+{
+	const XGlyphElt8 elt = {glyphset, string, nchar, xDst, yDst};
+	composite_glyphs(op, src, dst, xSrc, ySrc, &elt, 1);
+}
+
+extern "C" void
+XRenderCompositeString16(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, GlyphSet glyphset,
+	int xSrc, int ySrc, int xDst, int yDst, _Xconst unsigned short* string, int nchar)
+{
+	const XGlyphElt16 elt = {glyphset, string, nchar, xDst, yDst};
+	composite_glyphs(op, src, dst, xSrc, ySrc, &elt, 1);
+}
+
+extern "C" void
+XRenderCompositeString32(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, GlyphSet glyphset,
+	int xSrc, int ySrc, int xDst, int yDst, _Xconst unsigned int* string, int nchar)
+{
+	const XGlyphElt32 elt = {glyphset, string, nchar, xDst, yDst};
+	composite_glyphs(op, src, dst, xSrc, ySrc, &elt, 1);
+}
+
+// #pragma mark - trapezoids
+
+extern "C" void
+XRenderCompositeTrapezoids(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc,
+	_Xconst XTrapezoid* traps, int ntrap)
+{
+	PthreadReadLocker locker(sPicturesLock);
+	XPicture* source = get_picture(src);
+	XPicture* dest = get_picture(dst);
+	if (source == NULL || dest == NULL || ntrap <= 0)
+		return;
+
+	int32 left, top, right, bottom;
+	if (!Compositor::trapezoid_bounds(traps, ntrap, left, top, right, bottom))
+		return;
+
+	// Only the part of the trapezoids inside the destination needs to be rasterized.
+	XDrawable* drawable = Drawables::get(dest->drawable);
+	if (drawable == NULL)
+		return;
+	left = std::max<int32>(left, 0);
+	top = std::max<int32>(top, 0);
+	right = std::min<int32>(right, drawable->size().IntegerWidth() + 1);
+	bottom = std::min<int32>(bottom, drawable->size().IntegerHeight() + 1);
+	if (left >= right || top >= bottom)
+		return;
+
+	AlphaMask mask(left, top, right, bottom);
+	Compositor::rasterize_trapezoids(traps, ntrap, mask.surface);
+
+	// The source is aligned with the first point of the first trapezoid.
+	const int32 xDst = traps[0].left.p1.x >> 16, yDst = traps[0].left.p1.y >> 16;
+	composite(op, *source, xSrc + (left - xDst), ySrc + (top - yDst),
+		&mask.surface, left, top, *dest, left, top, right - left, bottom - top);
+}
+
+// #pragma mark - unimplemented
+
+extern "C" void
+XRenderSetPictureTransform(Display* dpy, Picture picture, XTransform* transform)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" void
+XRenderCompositeTriangles(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc,
+	_Xconst XTriangle* triangles, int ntriangle)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" void
+XRenderCompositeTriStrip(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc,
+	_Xconst XPointFixed* points, int npoint)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" void
+XRenderCompositeTriFan(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc,
+	_Xconst XPointFixed* points, int npoint)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" void
+XRenderCompositeDoublePoly(Display* dpy, int op, Picture src, Picture dst,
+	_Xconst XRenderPictFormat* maskFormat, int xSrc, int ySrc, int xDst, int yDst,
+	_Xconst XPointDouble* fpoints, int npoints, int winding)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" Status
+XRenderParseColor(Display* dpy, char* spec, XRenderColor* def)
+{
+	XColor color;
+	if (!XParseColor(dpy, DefaultColormap(dpy, DefaultScreen(dpy)), spec, &color))
+		return 0;
+
+	def->red = color.red;
+	def->green = color.green;
+	def->blue = color.blue;
+	def->alpha = 0xFFFF;
+	return 1;
+}
+
+extern "C" Cursor
+XRenderCreateCursor(Display* dpy, Picture source, unsigned int x, unsigned int y)
+{
+	UNIMPLEMENTED();
+	return None;
+}
+
+extern "C" XFilters*
+XRenderQueryFilters(Display* dpy, Drawable drawable)
+{
+	UNIMPLEMENTED();
+	return NULL;
+}
+
+extern "C" void
+XRenderSetPictureFilter(Display* dpy, Picture picture, const char* filter,
+	XFixed* params, int nparams)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" Cursor
+XRenderCreateAnimCursor(Display* dpy, int ncursor, XAnimCursor* cursors)
+{
+	UNIMPLEMENTED();
+	return None;
+}
+
+extern "C" void
+XRenderAddTraps(Display* dpy, Picture picture, int xOff, int yOff,
+	_Xconst XTrap* traps, int ntrap)
+{
+	UNIMPLEMENTED();
+}
+
+extern "C" Picture
+XRenderCreateLinearGradient(Display* dpy, const XLinearGradient* gradient,
+	const XFixed* stops, const XRenderColor* colors, int nstops)
+{
+	UNIMPLEMENTED();
+	return None;
+}
+
+extern "C" Picture
+XRenderCreateRadialGradient(Display* dpy, const XRadialGradient* gradient,
+	const XFixed* stops, const XRenderColor* colors, int nstops)
+{
+	UNIMPLEMENTED();
+	return None;
+}
+
+extern "C" Picture
+XRenderCreateConicalGradient(Display* dpy, const XConicalGradient* gradient,
+	const XFixed* stops, const XRenderColor* colors, int nstops)
+{
+	UNIMPLEMENTED();
+	return None;
+}